@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) in vec2 corner;  // template mesh, unit radius
+layout (location = 1) in vec2 center;  // per instance
+layout (location = 2) in float size;
+layout (location = 3) in vec4 color;
+
+uniform mat4 projection;
+
+out vec4 ourColor;
+
+void main() {
+	gl_Position = projection * vec4(center + size * corner, 0.0, 1.0);
+	ourColor = color;
+}
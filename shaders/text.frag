@@ -8,6 +8,8 @@ uniform vec4 textColor;
 
 void main()
 {    
-	vec4 sampled = vec4(1.0, 1.0, 1.0, texture(ourTexture, TexCoord).r);
+	// glyph coordinates are in pixels of the atlas, which grows
+	vec2 uv = TexCoord / vec2(textureSize(ourTexture, 0));
+	vec4 sampled = vec4(1.0, 1.0, 1.0, texture(ourTexture, uv).r);
 	FragColor = textColor * sampled;
 }  
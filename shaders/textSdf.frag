@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D ourTexture;
+uniform vec4 textColor;
+
+void main()
+{
+	// glyphs are signed distance fields, 0.5 on the outline: the edge is
+	// smoothed over one pixel on screen whatever the size or zoom
+	vec2 uv = TexCoord / vec2(textureSize(ourTexture, 0));
+	float d = texture(ourTexture, uv).r;
+	float w = fwidth(d);
+	float alpha = smoothstep(0.5 - w, 0.5 + w, d);
+	FragColor = textColor * vec4(1.0, 1.0, 1.0, alpha);
+}
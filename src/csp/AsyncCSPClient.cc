@@ -0,0 +1,246 @@
+#include "csp/AsyncCSPClient.hh"
+
+#include <signal.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "csp/IPV4Socket.hh"
+#include "csp/XDLRequest.hh"
+
+using namespace std;
+
+ConnectionPool::ConnectionPool(uint32_t maxIdlePerHost,
+                               Clock::duration maxIdleTime)
+    : maxIdlePerHost(maxIdlePerHost),
+      maxIdleTime(maxIdleTime),
+      connects("csp.client.connects"),
+      reuses("csp.client.reuses") {}
+
+ConnectionPool::~ConnectionPool() {
+  for (auto& h : hosts)
+    for (auto& i : h.second.idle) delete i.s;
+}
+
+// caller holds the lock
+ConnectionPool::Host& ConnectionPool::getHost(const string& name,
+                                              uint16_t port) {
+  string key = name + ':' + to_string(port);
+  auto it = hosts.find(key);
+  if (it == hosts.end())
+    it = hosts.emplace(key, Host{name, port, vector<Idle>()}).first;
+  return it->second;
+}
+
+IPV4Socket* ConnectionPool::acquire(const string& name, uint16_t port,
+                                    bool& reused) {
+  const char* address;
+  {
+    lock_guard<mutex> g(lock);
+    Host& h = getHost(name, port);
+    Clock::time_point now = Clock::now();
+    while (!h.idle.empty()) {
+      Idle i = h.idle.back();
+      h.idle.pop_back();
+      if (now - i.since < maxIdleTime) {
+        reuses.add();
+        reused = true;
+        return i.s;
+      }
+      delete i.s;  // the server has closed its end by now
+    }
+    address = h.name.c_str();  // unordered_map nodes do not move
+  }
+  // connect without holding the lock so other hosts are not held up
+  connects.add();
+  reused = false;
+  return new IPV4Socket(address, port);
+}
+
+void ConnectionPool::release(const string& name, uint16_t port,
+                             IPV4Socket* s) {
+  IPV4Socket* discard = nullptr;
+  {
+    lock_guard<mutex> g(lock);
+    Host& h = getHost(name, port);
+    if (h.idle.size() < maxIdlePerHost)
+      h.idle.push_back(Idle{s, Clock::now()});
+    else
+      discard = s;
+  }
+  delete discard;
+}
+
+uint32_t ConnectionPool::idleCount(const string& name, uint16_t port) {
+  lock_guard<mutex> g(lock);
+  return getHost(name, port).idle.size();
+}
+
+// expire idle connections before the server does
+constexpr chrono::milliseconds MAX_IDLE(XDLRequest::KEEP_ALIVE_MILLIS - 50);
+
+AsyncCSPClient::AsyncCSPClient(uint32_t numThreads, uint32_t maxIdlePerHost)
+    : pool(maxIdlePerHost, MAX_IDLE),
+      stopping(false),
+      requests("csp.client.requests"),
+      failures("csp.client.failures") {
+#ifdef __linux__
+  // writing to a connection the server closed must fail, not kill us
+  signal(SIGPIPE, SIG_IGN);
+#endif
+  for (uint32_t i = 0; i < numThreads; i++)
+    workers.emplace_back(&AsyncCSPClient::work, this);
+}
+
+/*
+  Requests still queued are not sent. They fail with an error like any
+  other, and their callbacks run here along with those not yet drained,
+  so every request is answered exactly once.
+*/
+AsyncCSPClient::~AsyncCSPClient() {
+  {
+    lock_guard<mutex> g(jobLock);
+    stopping = true;
+  }
+  jobReady.notify_all();
+  for (auto& t : workers) t.join();
+  for (Job& j : jobs) {
+    CSPResponse r{j.requestID, vector<char>(), "client shut down"};
+    failures.add();
+    complete(j, r);
+  }
+  jobs.clear();
+  drainCompletions();
+}
+
+void AsyncCSPClient::enqueue(Job&& j) {
+  {
+    lock_guard<mutex> g(jobLock);
+    jobs.push_back(std::move(j));
+  }
+  jobReady.notify_one();
+}
+
+future<CSPResponse> AsyncCSPClient::pageRequest(const string& host,
+                                                uint16_t port,
+                                                uint32_t requestID) {
+  auto promise = make_shared<std::promise<CSPResponse>>();
+  future<CSPResponse> f = promise->get_future();
+  enqueue(Job{host, port, requestID, nullptr, promise});
+  return f;
+}
+
+void AsyncCSPClient::pageRequest(const string& host, uint16_t port,
+                                 uint32_t requestID,
+                                 function<void(CSPResponse&)> onDone) {
+  enqueue(Job{host, port, requestID,
+              [onDone](CSPResponse& r) -> function<void()> {
+                return [onDone, r = std::move(r)]() mutable { onDone(r); };
+              },
+              nullptr});
+}
+
+uint32_t AsyncCSPClient::drainCompletions() {
+  uint32_t count = 0;
+  function<void()> f;
+  while (completions.pop(f)) {
+    f();
+    count++;
+  }
+  return count;
+}
+
+void AsyncCSPClient::work() {
+  for (;;) {
+    Job j;
+    {
+      unique_lock<mutex> g(jobLock);
+      jobReady.wait(g, [this]() { return stopping || !jobs.empty(); });
+      if (stopping) return;
+      j = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    requests.add();
+    CSPResponse r = fetch(j);
+    if (!r.ok()) failures.add();
+    complete(j, r);
+  }
+}
+
+// hand the response to the future, or decode it and queue the callback
+void AsyncCSPClient::complete(Job& j, CSPResponse& r) {
+  if (!j.finish) {
+    j.promise->set_value(std::move(r));
+    return;
+  }
+  try {
+    completions.push(j.finish(r));
+  } catch (const Ex& e) {
+    failures.add();
+    cerr << "request " << j.requestID << " failed: " << e << '\n';
+  } catch (const exception& e) {
+    failures.add();
+    cerr << "request " << j.requestID << " failed: " << e.what() << '\n';
+  } catch (...) {  // an escaping exception would terminate the worker
+    failures.add();
+    cerr << "request " << j.requestID << " failed\n";
+  }
+}
+
+/*
+  Send one framed request and read the length-prefixed response. Returns
+  false if the connection closed first; a reused connection may have been
+  closed by the server while idle.
+*/
+bool AsyncCSPClient::exchange(IPV4Socket& s, uint32_t requestID,
+                              vector<char>& data) {
+  s.send(requestID | XDLRequest::FRAMED);
+  Buffer& in = s.getIn();
+  while (in.getReadLen() < sizeof(uint64_t))
+    if (!in.receiveMore()) return false;
+  uint64_t len;
+  memcpy(&len, in.getReadPtr(), sizeof(len));
+  in.advanceRead(sizeof(len));
+  data.resize(len);  // 0 if the server did not recognize the request id
+  if (len == 0) return true;
+  for (uint64_t have = 0;;) {
+    uint32_t n = min<uint64_t>(in.getReadLen(), len - have);
+    memcpy(data.data() + have, in.getReadPtr(), n);
+    in.advanceRead(n);
+    have += n;
+    if (have == len) return true;
+    if (!in.receiveMore()) return false;
+  }
+}
+
+CSPResponse AsyncCSPClient::fetch(const Job& j) {
+  CSPResponse r{j.requestID, vector<char>(), string()};
+  // retry once on a fresh connection if a pooled one turns out to be dead
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool reused = false;
+    IPV4Socket* s = nullptr;
+    try {
+      s = pool.acquire(j.host, j.port, reused);
+      if (exchange(*s, j.requestID, r.data)) {
+        pool.release(j.host, j.port, s);
+        if (r.data.empty()) r.error = "illegal request id";
+        return r;
+      }
+      r.error = "connection closed before the response was complete";
+    } catch (const Ex& e) {
+      ostringstream msg;
+      msg << e;
+      r.error = msg.str();
+    } catch (const exception& e) {
+      r.error = e.what();
+    } catch (...) {
+      r.error = "unknown error";
+    }
+    delete s;
+    if (!reused) return r;
+    r.error.clear();
+  }
+  return r;
+}
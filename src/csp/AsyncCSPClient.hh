@@ -0,0 +1,152 @@
+#pragma once
+
+/**
+   Download pages without blocking the render thread.
+
+   Requests are queued to a small set of worker threads that do the
+   connect, send and receive. Each (host, port) has a pool of idle
+   connections so that following requests skip the connect; the server
+   keeps a connection open briefly after a framed response (see
+   XDLRequest::FRAMED).
+
+   A result comes back one of two ways:
+
+   future: pageRequest(host, port, id) returns a std::future<CSPResponse>
+     that is fulfilled on the worker thread.
+
+   callback: pageRequest(host, port, id, onDone) runs onDone on whichever
+     thread calls drainCompletions(). GLWin::mainLoop drains once per
+     frame, so callbacks can safely touch the scene. The completion queue
+     is lock free, so a busy worker never stalls a frame.
+
+   decode: pageRequest(host, port, id, decode, onDone) also runs
+     decode(response) on the worker as soon as the page arrives, and hands
+     only what it returns to onDone, so parsing a large page doesn't cost
+     a frame either.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "util/MPSCQueue.hh"
+#include "util/StatCounter.hh"
+
+class IPV4Socket;
+
+struct CSPResponse {
+  uint32_t requestID;
+  std::vector<char> data;  // the response bytes, without the length
+  std::string error;       // empty if the request succeeded
+  bool ok() const { return error.empty(); }
+};
+
+/*
+  Idle connections per (host, port). Connections older than maxIdleTime
+  are closed rather than reused, because the server will have given up on
+  them. Thread safe.
+*/
+class ConnectionPool {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+ private:
+  struct Idle {
+    IPV4Socket* s;
+    Clock::time_point since;
+  };
+  struct Host {
+    std::string name;  // IPV4Socket keeps a pointer to this
+    uint16_t port;
+    std::vector<Idle> idle;
+  };
+  std::mutex lock;
+  std::unordered_map<std::string, Host> hosts;
+  uint32_t maxIdlePerHost;
+  Clock::duration maxIdleTime;
+  StatCounter connects, reuses;
+
+  Host& getHost(const std::string& name, uint16_t port);
+
+ public:
+  ConnectionPool(uint32_t maxIdlePerHost, Clock::duration maxIdleTime);
+  ~ConnectionPool();
+  ConnectionPool(const ConnectionPool& orig) = delete;
+  ConnectionPool& operator=(const ConnectionPool& orig) = delete;
+
+  // an idle connection if there is one, otherwise a new one (may throw)
+  IPV4Socket* acquire(const std::string& host, uint16_t port, bool& reused);
+  // return a healthy connection for reuse
+  void release(const std::string& host, uint16_t port, IPV4Socket* s);
+  uint32_t idleCount(const std::string& host, uint16_t port);
+};
+
+class AsyncCSPClient {
+ private:
+  struct Job {
+    std::string host;
+    uint16_t port;
+    uint32_t requestID;
+    // run on the worker, returns what is left for drainCompletions
+    std::function<std::function<void()>(CSPResponse&)> finish;
+    std::shared_ptr<std::promise<CSPResponse>> promise;  // if no finish
+  };
+
+  ConnectionPool pool;
+  std::mutex jobLock;
+  std::condition_variable jobReady;
+  std::deque<Job> jobs;
+  bool stopping;
+  std::vector<std::thread> workers;
+  MPSCQueue<std::function<void()>> completions;
+  StatCounter requests, failures;
+
+  void work();
+  void complete(Job& j, CSPResponse& r);
+  CSPResponse fetch(const Job& j);
+  bool exchange(IPV4Socket& s, uint32_t requestID, std::vector<char>& data);
+  void enqueue(Job&& j);
+
+ public:
+  AsyncCSPClient(uint32_t numThreads = 4, uint32_t maxIdlePerHost = 4);
+  ~AsyncCSPClient();
+  AsyncCSPClient(const AsyncCSPClient& orig) = delete;
+  AsyncCSPClient& operator=(const AsyncCSPClient& orig) = delete;
+
+  std::future<CSPResponse> pageRequest(const std::string& host, uint16_t port,
+                                       uint32_t requestID);
+  void pageRequest(const std::string& host, uint16_t port, uint32_t requestID,
+                   std::function<void(CSPResponse&)> onDone);
+  /*
+    decode(CSPResponse&) runs on the worker, for failed requests too, and
+    may throw, which is reported and counted as a failure. onDone gets a
+    reference to its result from drainCompletions.
+  */
+  template <typename Decode, typename Done>
+  void pageRequest(const std::string& host, uint16_t port, uint32_t requestID,
+                   Decode decode, Done onDone) {
+    using Result = decltype(decode(std::declval<CSPResponse&>()));
+    enqueue(Job{host, port, requestID,
+                [decode, onDone](CSPResponse& r) -> std::function<void()> {
+                  auto result = std::make_shared<Result>(decode(r));
+                  return [onDone, result]() mutable { onDone(*result); };
+                },
+                nullptr});
+  }
+
+  // run callbacks for finished requests, returns how many ran
+  uint32_t drainCompletions();
+  uint32_t idleConnections(const std::string& host, uint16_t port) {
+    return pool.idleCount(host, port);
+  }
+};
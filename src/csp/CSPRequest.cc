@@ -3,12 +3,6 @@
 #include <csp/csp.hh>
 #include <iostream>
 
-#include "../../base/testCompile/benchmark0.hh"
-#include "../../base/testCompile/benchmark1.hh"
-#include "../../base/testCompile/benchmark2.hh"
-#include "../../base/testCompile/benchmark3.hh"
-#include "../../base/testCompile/benchmark4.hh"
-#include "../../base/testCompile/benchmark5.hh"
 #include "csp/CSPServlet.hh"
 #include "csp/cspservlet/CSPTest1.hh"
 #include "csp/cspservlet/CSPTest2.hh"
@@ -28,12 +22,8 @@ CSPRequest::CSPRequest() : Request() {
   CSPServlet::add(new CSPTest5());
   CSPServlet::add(new CSPTest6());
   CSPServlet::add(new CSPTest7());
-  CSPServlet::add(new csp::benchmark0());
-  CSPServlet::add(new csp::benchmark1());
-  CSPServlet::add(new csp::benchmark2());
-  CSPServlet::add(new csp::benchmark3());
-  CSPServlet::add(new csp::benchmark4());
-  CSPServlet::add(new csp::benchmark5());
+  // the generated benchmark servlets (base/testCompile) are added by the
+  // programs that compile them, they are not part of this library
   cout << "Successfully added servlet" << endl;
 }
 void CSPRequest::handle(int fd) {
@@ -43,7 +33,7 @@ void CSPRequest::handle(int fd) {
   in.displayRaw();
   // buffer ..   buffer+dataSize
   //  for now, hardcoded first 4 bytes of buffer are the servlet index number
-  uint32_t servletId = in.read<uint32_t>();
+  uint32_t servletId = in.readU32();
   cout << "servletId: " << servletId << '\n';
   if (servletId >= CSPServlet::servlets.size()) {
     // srvlog.error(Errcode::ILLEGAL_SERVLETID);
@@ -54,7 +44,9 @@ void CSPRequest::handle(int fd) {
     return;
   }
   CSPServlet* csps = CSPServlet::servlets.at(servletId);
-  csps->request(*this);
+  // the rest of the request is the servlet parameters, which key the cache
+  CSPServlet::cache.serve(servletId, in.getReadPtr(), in.getReadLen(), out,
+                          [&]() { csps->request(*this); });
 
   out.flush();
 }
@@ -1,3 +1,6 @@
 #include "csp/CSPServlet.hh"
 
 std::vector<CSPServlet*> CSPServlet::servlets = {};
+ResponseCache CSPServlet::cache;
+
+CSPServlet::~CSPServlet() {}
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "csp/Request.hh"
+#include "csp/ResponseCache.hh"
 #include "csp/Servlet.hh"
 
 class CSPRequest;
@@ -22,6 +23,16 @@ class CSPServlet {
     return servlets.size() - 1;
   }
 
+  // output of servlets added this way is cached for ttl, see ResponseCache
+  static ResponseCache cache;
+  static int add(CSPServlet* s, ResponseCache::Clock::duration ttl) {
+    int id = add(s);
+    cache.enable(id, ttl);
+    return id;
+  }
+  // call when the data behind a cached servlet changes
+  static void invalidate(int id) { cache.invalidate(id); }
+
   virtual void request(CSPRequest& r) = 0;
 
   friend class CSPRequest;
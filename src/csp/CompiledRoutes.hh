@@ -0,0 +1,321 @@
+#pragma once
+
+/**
+   Routing table compiled once at server startup.
+
+   ServletMap probes a open-addressed table and compares std::string names.
+   Since the set of URLs a server answers is fixed after startup, we can do
+   better: routes are registered with add()/addPattern() and then compile()
+   builds
+
+   1. a minimal perfect hash (CHD, "compress, hash and displace") over all
+      literal URLs, so an exact lookup is one hash of the url, one probe into
+      the slot table and one memcmp against the stored key, and
+   2. a flattened prefix trie for parameterized routes such as
+      "/stock/:symbol/quote", or prefixes ending in a "*" wildcard.
+
+   Lookup takes a pointer and length into the receive Buffer and never
+   allocates.  Parameters are returned as pointer/length views into the same
+   bytes.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "util/Ex.hh"
+#include "util/PerfectHash.hh"
+
+class HttpServlet;
+
+template <typename Handler>
+class CompiledRoutes {
+ public:
+  static constexpr uint32_t MAX_PARAMS = 8;
+
+  struct View {
+    const char* ptr;
+    uint32_t len;
+  };
+
+  struct Match {
+    Handler h;
+    uint32_t numParams;
+    View params[MAX_PARAMS];
+  };
+
+ private:
+  struct Slot {
+    uint32_t keyOffset;
+    uint32_t keyLen;
+    Handler h;
+  };
+
+  /*
+    trie node for parameterized routes. Children of a node are stored
+    contiguously in nodes[], sorted by literal segment so they can be
+    binary searched.
+  */
+  struct TrieNode {
+    uint32_t segOffset;   // literal segment in keyBytes
+    uint32_t segLen;
+    uint32_t firstChild;  // index into nodes
+    uint32_t numChildren;
+    int32_t paramChild;   // child that matches any one segment, -1 if none
+    bool hasHandler;
+    bool hasWildcard;     // "*" matches the rest of the url
+    Handler h;
+    Handler wildcard;
+  };
+
+  // routes as registered, before compile()
+  struct Pending {
+    std::string name;
+    Handler h;
+  };
+  std::vector<Pending> literals;
+  std::vector<Pending> patterns;
+
+  std::vector<char> keyBytes;  // every literal url and trie segment, packed
+  std::vector<Slot> slots;     // size n, one per literal url
+  std::vector<uint32_t> displace;  // PerfectHash, one per bucket
+  std::vector<TrieNode> nodes;
+  uint64_t seed;
+
+  uint32_t slotOf(const char* s, uint32_t len) const {
+    return PerfectHash::slot(PerfectHash::hash(s, len, seed), displace.data(),
+                             slots.size());
+  }
+
+  uint32_t addKeyBytes(const char* s, uint32_t len) {
+    uint32_t offset = keyBytes.size();
+    keyBytes.insert(keyBytes.end(), s, s + len);
+    return offset;
+  }
+
+  bool equals(uint32_t offset, uint32_t keyLen, const char* s,
+              uint32_t len) const {
+    return keyLen == len && memcmp(keyBytes.data() + offset, s, len) == 0;
+  }
+
+  void buildTrie();
+  bool matchTrie(uint32_t node, const char* s, const char* end,
+                 Match& m) const;
+
+ public:
+  CompiledRoutes() : seed(0) {}
+
+  // exact url, for example "test1.hsp"
+  void add(const std::string& name, Handler h) {
+    literals.push_back(Pending{name, h});
+  }
+
+  /*
+    parameterized url. Segments are separated by '/', a segment ":name"
+    matches any single segment and a final "*" matches the remainder of the
+    url, for example "/stock/:symbol/quote" or "/static/" followed by "*"
+  */
+  void addPattern(const std::string& pattern, Handler h) {
+    patterns.push_back(Pending{pattern, h});
+  }
+
+  /*
+    Build the perfect hash and trie. Must be called once after all routes
+    are added and before any lookup. Duplicate literal urls are an error.
+  */
+  void compile();
+
+  uint32_t size() const { return slots.size(); }
+  uint32_t trieSize() const { return nodes.size(); }
+  size_t memoryUsed() const {
+    return keyBytes.size() + slots.size() * sizeof(Slot) +
+           displace.size() * sizeof(uint32_t) +
+           nodes.size() * sizeof(TrieNode);
+  }
+
+  // exact match only: one hash, one probe, one memcmp
+  Handler get(const char* s, uint32_t len) const {
+    if (slots.empty()) return Handler();
+    const Slot& slot = slots[slotOf(s, len)];
+    return equals(slot.keyOffset, slot.keyLen, s, len) ? slot.h : Handler();
+  }
+
+  /*
+    exact match first, then the parameterized routes. Returns false if
+    nothing matches. On success m.params point into s.
+  */
+  bool match(const char* s, uint32_t len, Match& m) const {
+    m.numParams = 0;
+    if (!slots.empty()) {
+      const Slot& slot = slots[slotOf(s, len)];
+      if (equals(slot.keyOffset, slot.keyLen, s, len)) {
+        m.h = slot.h;
+        return true;
+      }
+    }
+    if (nodes.empty()) return false;
+    if (len > 0 && *s == '/') s++, len--;
+    return matchTrie(0, s, s + len, m);
+  }
+};
+
+using CompiledServletMap = CompiledRoutes<HttpServlet*>;
+
+template <typename Handler>
+void CompiledRoutes<Handler>::buildTrie() {
+  nodes.clear();
+  if (patterns.empty()) return;
+  // build a pointer-free tree first, then flatten breadth first so that the
+  // children of every node are contiguous and sorted
+  struct Build {
+    std::string seg;
+    std::vector<uint32_t> children;
+    int32_t param = -1;
+    bool hasHandler = false, hasWildcard = false;
+    Handler h = Handler(), wildcard = Handler();
+  };
+  std::vector<Build> tree(1);
+  for (const Pending& p : patterns) {
+    uint32_t cur = 0;
+    size_t pos = (!p.name.empty() && p.name[0] == '/') ? 1 : 0;
+    while (true) {
+      size_t slash = p.name.find('/', pos);
+      std::string seg = p.name.substr(
+          pos, slash == std::string::npos ? std::string::npos : slash - pos);
+      if (seg == "*") {
+        tree[cur].hasWildcard = true;
+        tree[cur].wildcard = p.h;
+        break;
+      }
+      int32_t next = -1;
+      if (!seg.empty() && seg[0] == ':') {
+        next = tree[cur].param;
+        if (next < 0) {
+          next = tree.size();
+          tree.emplace_back();
+          tree[cur].param = next;
+        }
+      } else {
+        for (uint32_t c : tree[cur].children)
+          if (tree[c].seg == seg) next = c;
+        if (next < 0) {
+          next = tree.size();
+          tree.emplace_back();
+          tree[next].seg = seg;
+          tree[cur].children.push_back(next);
+        }
+      }
+      cur = next;
+      if (slash == std::string::npos) {
+        tree[cur].hasHandler = true;
+        tree[cur].h = p.h;
+        break;
+      }
+      pos = slash + 1;
+    }
+  }
+
+  // flatten: newIndex[old] is the position in nodes
+  std::vector<uint32_t> newIndex(tree.size());
+  std::vector<uint32_t> queue{0};
+  nodes.push_back(TrieNode{});
+  newIndex[0] = 0;
+  for (size_t qi = 0; qi < queue.size(); qi++) {
+    Build& b = tree[queue[qi]];
+    std::sort(
+        b.children.begin(), b.children.end(),
+        [&](uint32_t x, uint32_t y) { return tree[x].seg < tree[y].seg; });
+    TrieNode& out = nodes[newIndex[queue[qi]]];
+    out.segOffset = addKeyBytes(b.seg.c_str(), b.seg.size());
+    out.segLen = b.seg.size();
+    out.hasHandler = b.hasHandler;
+    out.hasWildcard = b.hasWildcard;
+    out.h = b.h;
+    out.wildcard = b.wildcard;
+    out.firstChild = nodes.size();
+    out.numChildren = b.children.size();
+    out.paramChild = -1;
+    // note: out may be invalidated by push_back, so finish with it first
+    uint32_t self = newIndex[queue[qi]];
+    for (uint32_t c : b.children) {
+      newIndex[c] = nodes.size();
+      nodes.push_back(TrieNode{});
+      queue.push_back(c);
+    }
+    if (b.param >= 0) {
+      newIndex[b.param] = nodes.size();
+      nodes[self].paramChild = nodes.size();
+      nodes.push_back(TrieNode{});
+      queue.push_back(b.param);
+    }
+  }
+}
+
+template <typename Handler>
+bool CompiledRoutes<Handler>::matchTrie(uint32_t node, const char* s,
+                                        const char* end, Match& m) const {
+  const TrieNode& t = nodes[node];
+  if (s == nullptr) {  // consumed the last segment
+    if (!t.hasHandler) return false;
+    m.h = t.h;
+    return true;
+  }
+  const char* slash = (const char*)memchr(s, '/', end - s);
+  const char* segEnd = slash ? slash : end;
+  uint32_t segLen = segEnd - s;
+  // nullptr after the last segment, rather than a pointer past the end
+  const char* next = slash ? slash + 1 : nullptr;
+
+  // literal segments take priority over parameters, which take priority
+  // over the wildcard
+  uint32_t lo = t.firstChild, hi = t.firstChild + t.numChildren;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    const TrieNode& c = nodes[mid];
+    int cmp = memcmp(keyBytes.data() + c.segOffset, s,
+                     std::min(c.segLen, segLen));
+    if (cmp == 0) cmp = int(c.segLen) - int(segLen);
+    if (cmp == 0) {
+      if (matchTrie(mid, next, end, m)) return true;
+      break;
+    }
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (t.paramChild >= 0 && segLen > 0 && m.numParams < MAX_PARAMS) {
+    m.params[m.numParams++] = View{s, segLen};
+    if (matchTrie(t.paramChild, next, end, m)) return true;
+    m.numParams--;
+  }
+  if (t.hasWildcard && m.numParams < MAX_PARAMS) {
+    m.params[m.numParams++] = View{s, uint32_t(end - s)};
+    m.h = t.wildcard;
+    return true;
+  }
+  return false;
+}
+
+template <typename Handler>
+void CompiledRoutes<Handler>::compile() {
+  keyBytes.clear();
+  slots.clear();
+  if (!literals.empty()) {
+    std::vector<std::string_view> names;
+    for (const Pending& p : literals) names.push_back(p.name);
+    seed = PerfectHash::build(names, displace);  // throws on duplicates
+    slots.resize(literals.size());
+    for (const Pending& p : literals)
+      slots[slotOf(p.name.c_str(), p.name.size())] =
+          Slot{addKeyBytes(p.name.c_str(), p.name.size()),
+               uint32_t(p.name.size()), p.h};
+  }
+  buildTrie();
+  literals.clear();
+  literals.shrink_to_fit();
+  patterns.clear();
+  patterns.shrink_to_fit();
+}
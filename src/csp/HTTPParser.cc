@@ -0,0 +1,174 @@
+#include "csp/HTTPParser.hh"
+
+#include <cstring>
+
+#if defined(__SSE4_2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+/*
+  A set of stop characters, written as inclusive byte ranges the way
+  PCMPESTRI wants them (up to 8 ranges in 16 bytes), plus the equivalent
+  256 entry table for the scalar path.
+*/
+struct CharRanges {
+  alignas(16) char ranges[16];
+  int len;  // bytes used in ranges, 2 per range
+  bool stop[256];
+
+  constexpr CharRanges(const char r[], int len) : ranges(), len(len), stop() {
+    for (int i = 0; i < len; i++) ranges[i] = r[i];
+    for (int i = 0; i < len; i += 2)
+      for (int c = uint8_t(r[i]); c <= uint8_t(r[i + 1]); c++) stop[c] = true;
+  }
+};
+
+// method and path end at a space or any control character
+constexpr CharRanges TOKEN_END("\x00\x20\x7f\x7f", 4);
+// header names also end at ':'
+constexpr CharRanges NAME_END("\x00\x20::\x7f\x7f", 6);
+// header values may contain spaces and tabs, but not CR, LF or other controls
+constexpr CharRanges VALUE_END("\x00\x08\x0a\x1f\x7f\x7f", 6);
+
+inline const char* findStop(const char* p, const char* end,
+                            const CharRanges& cr) {
+#ifdef __SSE4_2__
+  const __m128i ranges = _mm_load_si128((const __m128i*)cr.ranges);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    int i = _mm_cmpestri(
+        ranges, cr.len, v, 16,
+        _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+    if (i != 16) return p + i;
+    p += 16;
+  }
+#endif
+  while (p < end && !cr.stop[uint8_t(*p)]) p++;
+  return p;
+}
+
+inline const char* findByte(const char* p, const char* end, char c) {
+#ifdef __AVX2__
+  const __m256i target = _mm256_set1_epi8(c);
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, target));
+    if (mask != 0) return p + __builtin_ctz(mask);
+    p += 32;
+  }
+#endif
+  const char* found = (const char*)memchr(p, c, end - p);
+  return found ? found : end;
+}
+
+inline bool equalsIgnoreCase(const HTTPView& v, const char s[]) {
+  for (uint32_t i = 0; i < v.len; i++, s++) {
+    if (*s == '\0') return false;
+    char c = v.ptr[i];
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    if (c != *s) return false;
+  }
+  return *s == '\0';
+}
+
+// advance past "\r\n" or "\n", nullptr if neither
+inline const char* skipEOL(const char* p, const char* end) {
+  if (p < end && *p == '\r') p++;
+  if (p < end && *p == '\n') return p + 1;
+  return nullptr;
+}
+}  // namespace
+
+bool HTTPView::operator==(const char s[]) const {
+  return strncmp(ptr, s, len) == 0 && s[len] == '\0';
+}
+
+const HTTPView* HTTPParsedRequest::getHeader(const char name[]) const {
+  for (uint32_t i = 0; i < numHeaders; i++)
+    if (equalsIgnoreCase(headers[i].name, name)) return &headers[i].value;
+  return nullptr;
+}
+
+const char* HTTPParser::findEndOfHead(const char* p, const char* end) {
+  while ((p = findByte(p, end, '\n')) < end) {
+    p++;
+    if (p < end && *p == '\n') return p + 1;
+    if (end - p >= 2 && p[0] == '\r' && p[1] == '\n') return p + 2;
+  }
+  return nullptr;
+}
+
+int HTTPParser::parse(const char* buf, size_t len, HTTPParsedRequest& r,
+                      size_t lastLen) {
+  const char* end = buf + len;
+  const char* p = buf;
+  // ignore empty lines before the request line (RFC 7230 3.5), so that
+  // they are not taken for the blank line ending an empty head
+  while (p < end && (*p == '\r' || *p == '\n')) p++;
+  // the terminator may have been split across reads, back up 3 bytes
+  const char* from = buf + (lastLen > 3 ? lastLen - 3 : 0);
+  const char* headEnd = findEndOfHead(from > p ? from : p, end);
+  if (headEnd == nullptr) return len > MAX_HEAD_SIZE ? ERROR : INCOMPLETE;
+
+  const char* q = findStop(p, headEnd, TOKEN_END);
+  if (q == p || *q != ' ') return ERROR;
+  r.method = HTTPView{p, uint32_t(q - p)};
+  p = q + 1;
+
+  q = findStop(p, headEnd, TOKEN_END);
+  if (q == p || *q != ' ') return ERROR;
+  r.path = HTTPView{p, uint32_t(q - p)};
+  p = q + 1;
+
+  if (headEnd - p < 8 || memcmp(p, "HTTP/1.", 7) != 0 || p[7] < '0' ||
+      p[7] > '9')
+    return ERROR;
+  r.minorVersion = p[7] - '0';
+  if ((p = skipEOL(p + 8, headEnd)) == nullptr) return ERROR;
+
+  r.numHeaders = 0;
+  r.host = HTTPView{nullptr, 0};
+  r.contentLength = 0;
+  r.keepAlive = r.minorVersion >= 1;
+  while (true) {
+    const char* next = skipEOL(p, headEnd);
+    if (next != nullptr) break;  // blank line, end of head
+    if (r.numHeaders == HTTPParsedRequest::MAX_HEADERS) return ERROR;
+
+    // obsolete line folding (leading whitespace) is rejected, RFC 7230 3.2.4
+    q = findStop(p, headEnd, NAME_END);
+    if (q == p || *q != ':') return ERROR;
+    HTTPHeader& h = r.headers[r.numHeaders++];
+    h.name = HTTPView{p, uint32_t(q - p)};
+    for (p = q + 1; *p == ' ' || *p == '\t'; p++)
+      ;
+    q = findStop(p, headEnd, VALUE_END);
+    const char* valueEnd = q;
+    while (valueEnd > p && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+      valueEnd--;
+    h.value = HTTPView{p, uint32_t(valueEnd - p)};
+    if ((p = skipEOL(q, headEnd)) == nullptr) return ERROR;
+
+    // the few headers the server acts on are picked out here
+    if (equalsIgnoreCase(h.name, "host")) {
+      r.host = h.value;
+    } else if (equalsIgnoreCase(h.name, "content-length")) {
+      if (h.value.len == 0) return ERROR;
+      uint64_t n = 0;
+      for (uint32_t i = 0; i < h.value.len; i++) {
+        char c = h.value.ptr[i];
+        if (c < '0' || c > '9') return ERROR;
+        if (n > (UINT64_MAX - (c - '0')) / 10) return ERROR;  // overflow
+        n = n * 10 + (c - '0');
+      }
+      r.contentLength = n;
+    } else if (equalsIgnoreCase(h.name, "connection")) {
+      if (equalsIgnoreCase(h.value, "close"))
+        r.keepAlive = false;
+      else if (equalsIgnoreCase(h.value, "keep-alive"))
+        r.keepAlive = true;
+    }
+  }
+  return headEnd - buf;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+   Zero-copy HTTP/1.1 request parser.
+
+   The request line and headers are parsed in place: every field is a
+   pointer and length into the bytes that were received, nothing is copied
+   or allocated.  Delimiters are found 16 bytes at a time with SSE4.2
+   PCMPESTRI (and 32 at a time with AVX2 when looking for the end of the
+   head), in the manner of picohttpparser.  Without those instruction sets
+   (build with GRAIL_NATIVE) the same code falls back to a table lookup per
+   byte.
+
+   parse() returns the number of bytes in the request head, so pipelined
+   requests are handled by advancing past head + contentLength and parsing
+   again.  If the head is not all there yet it returns INCOMPLETE; read more
+   and call again, passing the previous length so the scan for the blank
+   line does not start over.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+struct HTTPView {
+  const char* ptr;
+  uint32_t len;
+  bool operator==(const char s[]) const;
+};
+
+struct HTTPHeader {
+  HTTPView name;
+  HTTPView value;
+};
+
+struct HTTPParsedRequest {
+  static constexpr uint32_t MAX_HEADERS = 64;
+  HTTPView method;
+  HTTPView path;
+  int minorVersion;  // HTTP/1.x
+  uint32_t numHeaders;
+  HTTPHeader headers[MAX_HEADERS];
+  HTTPView host;           // copy of the Host header, len=0 if absent
+  uint64_t contentLength;  // 0 if absent
+  bool keepAlive;
+
+  // case insensitive header lookup, nullptr if absent
+  const HTTPView* getHeader(const char name[]) const;
+};
+
+class HTTPParser {
+ public:
+  static constexpr int ERROR = -1;
+  static constexpr int INCOMPLETE = -2;
+  // a head this long with no blank line is an error, not a slow client
+  static constexpr size_t MAX_HEAD_SIZE = 65536;
+
+  /*
+    parse one request head from buf[0..len). lastLen is the length passed
+    on the previous call for the same request, 0 the first time.
+    Returns the size of the head (request line + headers + blank line),
+    ERROR or INCOMPLETE.
+  */
+  static int parse(const char* buf, size_t len, HTTPParsedRequest& r,
+                   size_t lastLen = 0);
+
+  // position just past the first "\r\n\r\n" (or "\n\n"), nullptr if none
+  static const char* findEndOfHead(const char* buf, const char* end);
+};
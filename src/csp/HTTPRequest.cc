@@ -11,25 +11,15 @@
 
 #include "csp/HTTPRequest.hh"
 
-#include <servlets/Test1.h>
-#include <servlets/Test2.h>
-#include <servlets/Test3.h>
-#include <servlets/Test5.h>
-#include <servlets/Test6.h>
-#include <servlets/Test7.h>
-#include <servlets/benchmark0.h>
-#include <servlets/benchmark1.h>
-#include <servlets/benchmark2.h>
-#include <servlets/benchmark3.h>
-#include <servlets/benchmark4.h>
-#include <servlets/benchmark5.h>
 #include <unistd.h>
 
 #include <cstring>
 #include <iostream>
 #include <string>
 
+#include "csp/HTTPParser.hh"
 #include "csp/HttpServlet.hh"
+#include "csp/SocketIO.hh"
 
 using namespace std;
 
@@ -37,30 +27,14 @@ const string HTTPRequest::POST = "POST";
 const string HTTPRequest::GET = "GET";
 const string HTTPRequest::UNIMPLEMENTED = "???";
 
-HTTPRequest::HTTPRequest(const char* ReqType) : Request(), servlets(1024) {
-  if (strcmp(ReqType, "SERVER") == 0) {
-    servlets.add("test1.hsp", new Test1);
-    servlets.add("test2.hsp", new Test2);
-    servlets.add("test3.hsp", new Test3);
-    servlets.add("test5.hsp", new Test5);
-    servlets.add("test6.hsp", new Test6);
-    servlets.add("test7.hsp", new Test7);
-    servlets.add("benchmark0.hsp", new Benchmark0);
-    servlets.add("benchmark1.hsp", new Benchmark1);
-    servlets.add("benchmark2.hsp", new Benchmark2);
-    servlets.add("benchmark3.hsp", new Benchmark3);
-    servlets.add("benchmark4.hsp", new Benchmark4);
-    servlets.add("benchmark5.hsp", new Benchmark5);
-  } else if (strcmp(ReqType, "CLIENT") == 0) {
-    //        servlets = NULL;
-  }
-}
+extern char NOT_FOUND[];
+extern char BAD_REQUEST[];
+extern char NOT_IMPLEMENTED[];
 
-HTTPRequest::~HTTPRequest() {
-  if (url != nullptr) delete url;
-  if (host != nullptr) delete host;
-  if (httpVersion != nullptr) delete httpVersion;
-}
+// ReqType was "SERVER" or "CLIENT", servers now add their own servlets
+HTTPRequest::HTTPRequest(const char*) : Request(), routesCompiled(false) {}
+
+HTTPRequest::~HTTPRequest() {}
 #if 0
 inline const char * HTTPRequest::getNextToken(int &cursor, int &tokenLength) {
 	while (isspace(buffer[cursor])) {
@@ -86,71 +60,77 @@ void printString(const char *ptr) {
 }
 #endif
 
-// TODO: this code used to use char* buffer.  Now make it use Buffer object "in"
-void HTTPRequest::tokenize() {
-  //	Buffer& in = getIn(); // Buffer "in" is in HTTPRequest class
-  //	int cursor = 0;
-  //	const char * currentToken = getNextToken(cursor, currentTokenLength);
-
-  uint32_t currentTokenLength = 0;
-
-  if (in.parseToken(POST))
-    method = POST.c_str();
-  else if (in.parseToken(GET))
-    method = GET.c_str();
-  else
-    method = UNIMPLEMENTED.c_str();
-
-  cout << "Method: " << method << endl;
-
-  if (!in.getUrl(url, urlLength)) {  // what is the url and where is it?
-    cerr << "can't find url";
-    url = "/";
-    urlLength = 1;
+/*
+  Parse the request head sitting in the receive buffer. Fields of req are
+  views into in, so they are only valid until the buffer is advanced.
+  Reads more from the socket when the head arrived in several pieces.
+  Returns the length of the head or HTTPParser::ERROR.
+*/
+int HTTPRequest::tokenize() {
+  size_t lastLen = 0;
+  while (true) {
+    int headLen =
+        HTTPParser::parse(in.getReadPtr(), in.getReadLen(), req, lastLen);
+    if (headLen != HTTPParser::INCOMPLETE) return headLen;
+    lastLen = in.getReadLen();
+    if (!in.receiveMore()) return HTTPParser::ERROR;
   }
+}
 
-  if (!in.getHTTPVersion(httpVersion, currentTokenLength)) {
-    cerr << "Can't read HTTP version number" << endl;
+// discard n bytes of input, some of which may not have arrived yet
+void HTTPRequest::skipInput(uint64_t n) {
+  while (n > in.getReadLen()) {
+    n -= in.getReadLen();
+    in.advanceRead(in.getReadLen());
+    if (!in.receiveMore()) return;
   }
-  //
-  if (!in.getHost(host, hostLength)) {
-    cerr << "can't read host" << endl;
-  }
-
-  //    in.pointToStart();
-
-  //	body = getNextToken(cursor, currentTokenLength);
-  //	bodySize = sizeof(body);
-  //	bodyLength = currentTokenLength;
+  in.advanceRead(n);
 }
 
 // Server side
 void HTTPRequest::handle(int sckt) {
+  if (!routesCompiled) {
+    servlets.compile();
+    routesCompiled = true;
+  }
   in.attachRead(sckt);
   out.attachWrite(sckt);
 
-  tokenize();
-  cout << "HTTP version: " << httpVersion << endl;
-  cout << "host: " << host << '\n';
-  //	cout << "hostLength: " << hostLength << endl;
-  cout << "url: " << url << '\n';
-  //	cout  << "urllength: " << urlLength << endl;
-  HttpServlet* srv = servlets.get(url, strlen(url));
-  srv->request(out);
-  cout << '\n';
-#if 0
-	if (url[urlLength-1]=='/')e
-		;//	temp+= "/index.html";
- 	else temp+= string(url, urlLength);
-#endif
-  //	HttpServlet* s = servlets.get(url, urlLength);
-  //
-  //  if (s == nullptr) {
-  //		cerr << "url not found: "<< url << std::endl;
-  //		return;
-  //	}
-  //	s->request((*this).getOut());
-  //    out.flush();
+  // a client may pipeline several requests on one connection, or send each
+  // only after reading the response to the last
+  while (in.getReadLen() > 0) {
+    int headLen = tokenize();
+    if (headLen == HTTPParser::ERROR) {
+      out.append(BAD_REQUEST);
+      break;
+    }
+
+    // servlets are registered without the leading /
+    const char* url = req.path.ptr;
+    uint32_t urlLength = req.path.len;
+    if (urlLength > 0 && *url == '/') url++, urlLength--;
+    CompiledServletMap::Match route;
+    HttpServlet* srv =
+        servlets.match(url, urlLength, route) ? route.h : nullptr;
+    if (srv == nullptr)
+      out.append(NOT_FOUND);
+    else if (req.method == "GET" || req.method == "POST")
+      srv->request(out);
+    else
+      out.append(NOT_IMPLEMENTED);
+
+    bool keepAlive = req.keepAlive;
+    skipInput(headLen + req.contentLength);
+    if (!keepAlive) break;
+    if (in.getReadLen() == 0) {
+      out.flush();  // the client may be waiting for this before sending more
+      // an idle connection must not hold up the accept loop for long
+      if (!SocketIO::waitReadable(sckt, KEEP_ALIVE_MILLIS) ||
+          !in.receiveMore())
+        break;
+    }
+  }
+  out.flush();
 }
 
 // Client side
@@ -172,6 +152,18 @@ char NOT_FOUND[] = "HTTP/1.1 404 NOT FOUND\r\n" SERVER_STRING
                    "your request because the resource specified\r\n"
                    "is unavailable or nonexistent.\r\n</BODY></HTML>\r\n";
 
+char BAD_REQUEST[] = "HTTP/1.1 400 BAD REQUEST\r\n" SERVER_STRING
+                     "Content-Type: text/html\r\n\r\n"
+                     "<HTML><TITLE>Bad Request</TITLE>\r\n"
+                     "<BODY><P>Malformed request.\r\n</BODY></HTML>\r\n";
+
+char NOT_IMPLEMENTED[] = "HTTP/1.1 501 Method Not Implemented\r\n"
+                         SERVER_STRING
+                         "Content-Type: text/html\r\n\r\n"
+                         "<HTML><TITLE>Method Not Implemented</TITLE>\r\n"
+                         "<BODY><P>HTTP request method not supported.\r\n"
+                         "</BODY></HTML>\r\n";
+
 const char HEADER[] = "HTTP/1.1 200 OK\r\n" SERVER_STRING "Content-Type: ";
 
 // const unsigned int HEADER_SIZE = sizeof(HEADER)-1;
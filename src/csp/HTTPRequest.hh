@@ -2,24 +2,20 @@
 
 #include <string>
 
+#include "csp/CompiledRoutes.hh"
+#include "csp/HTTPParser.hh"
 #include "csp/Request.hh"
-#include "csp/ServletMap.hh"
 
 class HTTPRequest : public Request {
  private:
-  void tokenize();
-  const char* method;
-  const char* url = nullptr;  // the complete url including socket number
-                              // http://www.foo.com/test1.hsp
-  uint32_t urlLength;
-  const char* httpVersion = nullptr;
-  const char* host = nullptr;
-  uint32_t hostLength;
-  //	const char* body;
-  //	size_t bodySize;
-  //	size_t bodyLength;
-  // TODO: static servlet map!
-  // ServletMap servlets;
+  int tokenize();
+  void skipInput(uint64_t n);
+  HTTPParsedRequest req;  // views into in, valid for the current request
+  // how long a keep-alive connection may wait for its next request
+  static constexpr int KEEP_ALIVE_MILLIS = 5000;
+  // routes are fixed once the first request is handled
+  CompiledServletMap servlets;
+  bool routesCompiled;
 
  public:
   HTTPRequest(const char* ReqType);
@@ -28,6 +24,16 @@ class HTTPRequest : public Request {
   const static std::string GET;
   const static std::string UNIMPLEMENTED;
 
+  /*
+    Register a servlet for an exact url, such as "test1.hsp", or a pattern
+    (see CompiledRoutes::addPattern). Only before the first request.
+  */
+  void addServlet(const std::string& url, HttpServlet* srv) {
+    servlets.add(url, srv);
+  }
+  void addServletPattern(const std::string& pattern, HttpServlet* srv) {
+    servlets.addPattern(pattern, srv);
+  }
   void handle(int sckt) override;
   void handle(int sckt, const char* command) override;
 };
@@ -35,6 +35,29 @@ inline void testResult(int result, const char *file, int lineNum, Errcode err) {
 }
 #endif
 
+/*
+  Handle one connection with its output flow controlled, so a client that
+  stops reading costs the server at most Buffer::STALL_MILLIS. That client,
+  or one that hangs up mid-response, is dropped and the server goes on to
+  the next connection. listenFd lets the request notice clients waiting
+  behind this one.
+*/
+static void serve(Request *req, int fd, int listenFd) {
+  constexpr uint32_t HIGH_WATER = 256 * 1024, LOW_WATER = 64 * 1024;
+  req->setListener(listenFd);
+  Buffer &out = req->getOut();
+  out.enableFlowControl(HIGH_WATER, LOW_WATER);
+  try {
+    req->handle(fd);
+    // send whatever flow control still has queued before closing
+    if (!out.finishOutput(Buffer::STALL_MILLIS))
+      cerr << "dropping client that stopped reading\n";
+  } catch (const Ex &e) {
+    if (e.e != Errcode::SOCKET_STALLED && e.e != Errcode::SOCKET_SEND) throw;
+    cerr << "dropping client: " << e;
+  }
+}
+
 // Initializes Winsock
 void Socket::classInit() {
 #ifdef _WIN32
@@ -106,7 +129,7 @@ void IPV4Socket::wait() {
     if (returnsckt >= 0) {
       cout << "CONNECT SUCCESSFULLY"
            << "\n";
-      req->handle(returnsckt);
+      serve(req, returnsckt, sckt);
       close(returnsckt);
       // if you are not familiar with socket, try below code
       //			read(senderSock,testin, sizeof(testin)-1);
@@ -239,7 +262,7 @@ void IPV4Socket::wait() {
 
     if (returnsckt >= 0) {
       cout << "CONNECT SUCCESSFULLY" << endl;
-      req->handle(returnsckt);
+      serve(req, returnsckt, sckt);
       close(returnsckt);
       // csp18summer: if you are not familiar with socket, try below code
       //			read(senderSock,testin, sizeof(testin)-1);
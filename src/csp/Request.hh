@@ -18,9 +18,15 @@ constexpr size_t BUFSIZE = 1500 * 30;
 class Request {
  protected:
   Buffer in, out;
+  int listener;  // see setListener
 
  public:
-  Request() : in(BUFSIZE, false), out(BUFSIZE, true) {}
+  Request() : in(BUFSIZE, false), out(BUFSIZE, true), listener(-1) {}
+  /*
+    The server's listening socket, so a request that holds its connection
+    open can give way as soon as another client is waiting. -1 if none.
+  */
+  void setListener(int fd) { listener = fd; }
   virtual ~Request() = 0;
   virtual void handle(int sckt) = 0;
   virtual void handle(int sckt, const char* command) = 0;
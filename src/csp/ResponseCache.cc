@@ -0,0 +1,209 @@
+#include "csp/ResponseCache.hh"
+
+#include "util/Buffer.hh"
+
+using namespace std;
+
+ResponseCache::ResponseCache(size_t maxBytes, bool stampedeProtection)
+    : maxBytes(maxBytes),
+      bytesUsed(0),
+      stampedeProtection(stampedeProtection),
+      hits("csp.cache.hits"),
+      misses("csp.cache.misses"),
+      waits("csp.cache.stampede_waits"),
+      nanosSaved("csp.cache.ns_saved"),
+      bytesServed("csp.cache.bytes_served"),
+      bytesCached("csp.cache.bytes_cached") {}
+
+void ResponseCache::enable(uint32_t servletId, Clock::duration ttl) {
+  lock_guard<mutex> l(lock);
+  ServletCache& sc = servlets[servletId];
+  sc.ttl = ttl;
+}
+
+void ResponseCache::disable(uint32_t servletId) {
+  lock_guard<mutex> l(lock);
+  auto s = servlets.find(servletId);
+  if (s == servlets.end()) return;
+  eraseEntries(s->second);
+  servlets.erase(s);
+  ready.notify_all();
+}
+
+bool ResponseCache::isEnabled(uint32_t servletId) const {
+  lock_guard<mutex> l(lock);
+  return servlets.find(servletId) != servlets.end();
+}
+
+// caller holds lock
+void ResponseCache::eraseEntries(ServletCache& sc) {
+  for (auto& e : sc.entries)
+    if (e.second.slab) bytesUsed -= e.second.slab->size();
+  sc.entries.clear();
+  sc.generation++;
+  bytesCached.set(bytesUsed);
+}
+
+// caller holds lock
+void ResponseCache::purgeExpired(Clock::time_point now) {
+  for (auto& s : servlets) {
+    auto& entries = s.second.entries;
+    for (auto e = entries.begin(); e != entries.end();) {
+      if (!e->second.computing && e->second.expires <= now) {
+        bytesUsed -= e->second.slab->size();
+        e = entries.erase(e);
+      } else {
+        ++e;
+      }
+    }
+  }
+  bytesCached.set(bytesUsed);
+}
+
+void ResponseCache::serve(uint32_t servletId, const char* params,
+                          uint32_t len, Buffer& out,
+                          const function<void()>& compute) {
+  string_view key(params, len);
+  unique_lock<mutex> l(lock);
+  auto s = servlets.find(servletId);
+  if (s == servlets.end()) {
+    l.unlock();
+    compute();
+    return;
+  }
+
+  while (true) {
+    auto e = s->second.entries.find(key);
+    if (e == s->second.entries.end()) break;
+    Entry& entry = e->second;
+    if (!entry.computing) {
+      if (Clock::now() >= entry.expires) break;
+      shared_ptr<const vector<char>> slab = entry.slab;
+      uint64_t saved = entry.computeNanos;
+      l.unlock();
+      hits.add();
+      nanosSaved.add(saved);
+      bytesServed.add(slab->size());
+      out.specialWrite(slab->data(), slab->size());
+      return;
+    }
+    if (!stampedeProtection) break;
+    // someone else is computing this key, wait for their result
+    waits.add();
+    ready.wait(l);
+    s = servlets.find(servletId);
+    if (s == servlets.end()) {  // disabled while we waited
+      l.unlock();
+      compute();
+      return;
+    }
+  }
+
+  misses.add();
+  const uint64_t generation = s->second.generation;
+  if (stampedeProtection) {
+    Entry& placeholder = s->second.entries[string(key)];
+    if (placeholder.slab) bytesUsed -= placeholder.slab->size();
+    placeholder = Entry{nullptr, Clock::time_point(), 0, generation, true};
+  }
+  l.unlock();
+
+  // run the servlet with its output captured into a new slab
+  auto slab = make_shared<vector<char>>();
+  out.flush();  // anything already written is not part of the response
+  Clock::time_point t0 = Clock::now();
+  out.setCapture(slab.get());
+  try {
+    compute();
+    out.flush();
+  } catch (...) {
+    out.setCapture(nullptr);
+    l.lock();
+    s = servlets.find(servletId);
+    if (stampedeProtection && s != servlets.end()) {
+      auto e = s->second.entries.find(key);
+      if (e != s->second.entries.end() && e->second.computing &&
+          e->second.generation == generation)
+        s->second.entries.erase(e);
+    }
+    l.unlock();
+    ready.notify_all();
+    throw;
+  }
+  out.setCapture(nullptr);
+  Clock::time_point t1 = Clock::now();
+  uint64_t computeNanos =
+      chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count();
+
+  l.lock();
+  s = servlets.find(servletId);
+  if (s != servlets.end()) {
+    auto e = s->second.entries.find(key);
+    bool ours = e != s->second.entries.end() && e->second.computing &&
+                e->second.generation == generation;
+    // an invalidate while we computed means our result may already be stale
+    bool fresh = s->second.generation == generation;
+    if (fresh && bytesUsed + slab->size() > maxBytes) {
+      purgeExpired(t1);
+      e = s->second.entries.find(key);  // the expired entry may be gone
+    }
+    if (fresh && bytesUsed + slab->size() <= maxBytes) {
+      if (e == s->second.entries.end())
+        e = s->second.entries.emplace(string(key), Entry()).first;
+      else if (e->second.slab)
+        bytesUsed -= e->second.slab->size();
+      e->second = Entry{slab, t1 + s->second.ttl, computeNanos, generation,
+                        false};
+      bytesUsed += slab->size();
+      bytesCached.set(bytesUsed);
+    } else if (ours) {
+      s->second.entries.erase(e);  // not stored, let the waiters compute
+    }
+  }
+  l.unlock();
+  ready.notify_all();
+  out.specialWrite(slab->data(), slab->size());
+}
+
+void ResponseCache::invalidate(uint32_t servletId) {
+  lock_guard<mutex> l(lock);
+  auto s = servlets.find(servletId);
+  if (s != servlets.end()) eraseEntries(s->second);
+  ready.notify_all();
+}
+
+void ResponseCache::invalidate(uint32_t servletId, const char* params,
+                               uint32_t len) {
+  lock_guard<mutex> l(lock);
+  auto s = servlets.find(servletId);
+  if (s == servlets.end()) return;
+  // a result being computed right now for any key of this servlet may be
+  // stale too, so it is not stored
+  s->second.generation++;
+  auto e = s->second.entries.find(string_view(params, len));
+  if (e == s->second.entries.end()) return;
+  if (e->second.slab) bytesUsed -= e->second.slab->size();
+  s->second.entries.erase(e);
+  bytesCached.set(bytesUsed);
+  ready.notify_all();
+}
+
+void ResponseCache::invalidateAll() {
+  lock_guard<mutex> l(lock);
+  for (auto& s : servlets) eraseEntries(s.second);
+  ready.notify_all();
+}
+
+double ResponseCache::hitRate() const {
+  uint64_t h = hits.get(), total = h + misses.get();
+  return total == 0 ? 0 : double(h) / total;
+}
+
+void ResponseCache::report(ostream& s) const {
+  s << "response cache: " << hits.get() << " hits, " << misses.get()
+    << " misses, hit rate " << hitRate() * 100 << "%, "
+    << waits.get() << " stampede waits\n"
+    << "  servlet time saved " << nanosSaved.get() * 1e-6 << " ms, "
+    << bytesServed.get() << " bytes served from " << bytesUsed
+    << " bytes cached\n";
+}
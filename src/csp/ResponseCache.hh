@@ -0,0 +1,109 @@
+#pragma once
+
+/**
+   Opt-in cache of servlet output.
+
+   Many CSP servlets return the same bytes until the data behind them
+   changes. A servlet that opts in (enable(servletId, ttl)) has its output
+   captured the first time a given set of request parameters is seen, and
+   the captured bytes (a preserialized slab) are written straight to the
+   socket for later requests until the ttl runs out or the data owner calls
+   invalidate().
+
+   With stampede protection on, concurrent misses on the same key compute
+   once: the first thread runs the servlet and the others wait for its
+   result instead of all hitting the data source at the same moment.
+
+   Hits, misses, waits and the servlet time saved by hits are published as
+   StatCounters under "csp.cache.*".
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "util/StatCounter.hh"
+
+class Buffer;
+
+class ResponseCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+ private:
+  struct Entry {
+    std::shared_ptr<const std::vector<char>> slab;
+    Clock::time_point expires;
+    uint64_t computeNanos;  // what a hit on this entry saves
+    uint64_t generation;    // servlet generation when computed
+    bool computing;         // placeholder while the first miss computes
+  };
+
+  // lets find() take a string_view of the parameters without copying them
+  struct KeyHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>()(s);
+    }
+  };
+
+  struct ServletCache {
+    Clock::duration ttl = Clock::duration(0);
+    uint64_t generation = 0;  // bumped by invalidate, in-flight results die
+    std::unordered_map<std::string, Entry, KeyHash, std::equal_to<>> entries;
+  };
+
+  std::unordered_map<uint32_t, ServletCache> servlets;
+  mutable std::mutex lock;
+  std::condition_variable ready;
+  size_t maxBytes;
+  size_t bytesUsed;
+  bool stampedeProtection;
+
+  StatCounter hits;
+  StatCounter misses;
+  StatCounter waits;
+  StatCounter nanosSaved;
+  StatCounter bytesServed;
+  StatCounter bytesCached;
+
+  void purgeExpired(Clock::time_point now);
+  void eraseEntries(ServletCache& sc);
+
+ public:
+  ResponseCache(size_t maxBytes = 64 * 1024 * 1024,
+                bool stampedeProtection = true);
+  ResponseCache(const ResponseCache& orig) = delete;
+  ResponseCache& operator=(const ResponseCache& orig) = delete;
+
+  // cache the output of this servlet for ttl
+  void enable(uint32_t servletId, Clock::duration ttl);
+  void disable(uint32_t servletId);
+  bool isEnabled(uint32_t servletId) const;
+  void setStampedeProtection(bool on) { stampedeProtection = on; }
+
+  /*
+    Write the response for (servletId, params) to out, either from the
+    cache or by calling compute, which must write the servlet output into
+    out. Servlets that are not enabled just run compute.
+  */
+  void serve(uint32_t servletId, const char* params, uint32_t len,
+             Buffer& out, const std::function<void()>& compute);
+
+  // invalidation hooks for whoever owns the data behind a servlet
+  void invalidate(uint32_t servletId);
+  void invalidate(uint32_t servletId, const char* params, uint32_t len);
+  void invalidateAll();
+
+  size_t getBytesUsed() const { return bytesUsed; }
+  double hitRate() const;
+  void report(std::ostream& s) const;
+};
@@ -47,7 +47,7 @@ class Socket {
   Socket(uint16_t port, Request* req);
 
   Socket(uint16_t port);  // Constructor for server (addres not specified)
-  ~Socket();
+  virtual ~Socket();
 
   static void classCleanup();
   static void classInit();
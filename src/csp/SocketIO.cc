@@ -1,16 +1,24 @@
 #include "csp/SocketIO.hh"
 
+#ifdef __linux__
+#include <poll.h>
+#endif
+
 #include <cstdint>
 
 #include "csp/csp.hh"
 
 // TODO: Look into logging WSAGetLastError and strerror(errno)
 // Using the logging object in csp.hh?
+// may send fewer than size bytes, callers must loop
 int SocketIO::send(socket_t sckt, const char *buf, int size, int flags) {
-  uint32_t bytesSent;
-  if ((bytesSent = ::send(sckt, (char *)buf, size, 0)) == err_code) {
+  int bytesSent;
+  while ((bytesSent = ::send(sckt, (char *)buf, size, 0)) == err_code) {
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;  // SO_SNDTIMEO
     if (errno != EBADF) throw Ex1(Errcode::SOCKET_SEND);
     perror("Warning on send(): ");
+    break;
   }
   return bytesSent;
 }
@@ -22,4 +30,57 @@ int SocketIO::recv(socket_t sckt, const char *buf, int size, int flags) {
     perror("Warning on recv()");
   }
   return bytesRecv;
-}
\ No newline at end of file
+}
+
+/*
+  Send without blocking, only this call: the socket stays blocking for
+  reads. Returns 0 if the kernel send buffer is full.
+*/
+int SocketIO::trySend(socket_t sckt, const char *buf, int size) {
+#ifdef __linux__
+  int bytesSent;
+  while ((bytesSent = ::send(sckt, buf, size, MSG_DONTWAIT | MSG_NOSIGNAL)) ==
+         err_code) {
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+    throw Ex1(Errcode::SOCKET_SEND);
+  }
+  return bytesSent;
+#else
+  return send(sckt, buf, size, 0);
+#endif
+}
+
+bool SocketIO::waitWritable(socket_t sckt, int timeoutMillis) {
+#ifdef __linux__
+  pollfd p{sckt, POLLOUT, 0};
+  int result;
+  while ((result = poll(&p, 1, timeoutMillis)) < 0 && errno == EINTR)
+    ;
+#elif _WIN32
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(sckt, &fds);
+  timeval t{timeoutMillis / 1000, (timeoutMillis % 1000) * 1000};
+  int result = select(0, nullptr, &fds, nullptr, &t);
+#endif
+  if (result < 0) throw Ex1(Errcode::SOCKET_SEND);
+  return result > 0;
+}
+
+bool SocketIO::waitReadable(socket_t sckt, int timeoutMillis) {
+#ifdef __linux__
+  pollfd p{sckt, POLLIN, 0};
+  int result;
+  while ((result = poll(&p, 1, timeoutMillis)) < 0 && errno == EINTR)
+    ;
+#elif _WIN32
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(sckt, &fds);
+  timeval t{timeoutMillis / 1000, (timeoutMillis % 1000) * 1000};
+  int result = select(0, &fds, nullptr, nullptr, &t);
+#endif
+  if (result < 0) throw Ex1(Errcode::SOCKET_RECV);
+  return result > 0;
+}
@@ -35,4 +35,9 @@ class SocketIO {
  public:
   static int send(socket_t sckt, const char *buf, int size, int flags);
   static int recv(socket_t sckt, const char *buf, int size, int flags);
+  static int trySend(socket_t sckt, const char *buf, int size);
+  // false if the socket is still full after timeoutMillis
+  static bool waitWritable(socket_t sckt, int timeoutMillis);
+  // false if nothing arrives within timeoutMillis
+  static bool waitReadable(socket_t sckt, int timeoutMillis);
 };
\ No newline at end of file
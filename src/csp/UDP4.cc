@@ -0,0 +1,179 @@
+#include "csp/UDP4.hh"
+
+#include <errno.h>
+#include <memory.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+#include "csp/csp.hh"
+
+/*
+  All operating system specific datagram code is here, as IPV4Socket.cc
+  does for TCP.
+*/
+
+using namespace std;
+
+static void testResult(int result, const char* file, int lineNum,
+                       Errcode err) {
+  if (result < 0) throw Ex(file, lineNum, err);
+}
+
+// Constructor for client, datagrams go to addr:port by default
+UDP4Socket::UDP4Socket(const char* addr, uint16_t port)
+    : Socket(addr, port), lossRate(0), rng(12345), dropped(0) {
+  testResult(sckt = socket(AF_INET, SOCK_DGRAM, 0), __FILE__, __LINE__,
+             Errcode::SOCKET);
+  memset(sockaddress, 0, sizeof(sockaddress));
+  sockaddr_in* sockAddr = (sockaddr_in*)sockaddress;
+  sockAddr->sin_family = AF_INET;
+  sockAddr->sin_addr.s_addr = inet_addr(address);
+  sockAddr->sin_port = htons(port);
+}
+
+// Constructor for server, bound to port on all interfaces
+UDP4Socket::UDP4Socket(uint16_t port)
+    : Socket(port), lossRate(0), rng(54321), dropped(0) {
+  int yes = 1;
+  testResult(sckt = socket(AF_INET, SOCK_DGRAM, 0), __FILE__, __LINE__,
+             Errcode::SOCKET);
+  testResult(setsockopt(sckt, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes,
+                        sizeof(yes)),
+             __FILE__, __LINE__, Errcode::SETSOCKOPT);
+  memset(sockaddress, 0, sizeof(sockaddress));
+  sockaddr_in* sockAddr = (sockaddr_in*)sockaddress;
+  sockAddr->sin_family = AF_INET;
+  sockAddr->sin_addr.s_addr = INADDR_ANY;
+  sockAddr->sin_port = htons(port);
+  testResult(::bind(sckt, (struct sockaddr*)sockAddr, sizeof(sockaddr_in)),
+             __FILE__, __LINE__, Errcode::SOCKET_BIND);
+}
+
+UDP4Socket::~UDP4Socket() { close(sckt); }
+
+void UDP4Socket::getDefaultPeer(char peer[16]) const {
+  memcpy(peer, sockaddress, 16);
+}
+
+uint16_t UDP4Socket::getLocalPort() const {
+  sockaddr_in local;
+  socklen_t len = sizeof(local);
+  testResult(getsockname(sckt, (struct sockaddr*)&local, &len), __FILE__,
+             __LINE__, Errcode::SOCKET);
+  return ntohs(local.sin_port);
+}
+
+void UDP4Socket::wait() { wait(-1); }
+
+bool UDP4Socket::wait(int timeoutMillis) {
+#ifdef __linux__
+  pollfd p{sckt, POLLIN, 0};
+  int result = poll(&p, 1, timeoutMillis);
+#else
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(sckt, &fds);
+  timeval t{timeoutMillis / 1000, (timeoutMillis % 1000) * 1000};
+  int result = select(sckt + 1, &fds, nullptr, nullptr,
+                      timeoutMillis < 0 ? nullptr : &t);
+#endif
+  if (result < 0 && errno != EINTR) throw Ex1(Errcode::SOCKET_RECV);
+  return result > 0;
+}
+
+#ifdef __linux__
+static void setHeader(msghdr& h, char peer[16], iovec* iov) {
+  memset(&h, 0, sizeof(h));
+  h.msg_name = peer;
+  h.msg_namelen = sizeof(sockaddr_in);
+  h.msg_iov = iov;
+  h.msg_iovlen = 1;
+}
+
+uint32_t UDP4Socket::sendBatch(Datagram d[], uint32_t n) {
+  mmsghdr msgs[MAX_BATCH];
+  iovec iov[MAX_BATCH];
+  uint32_t sent = 0;
+  while (n > 0) {
+    uint32_t count = 0;
+    for (; count < MAX_BATCH && n > 0; d++, n--) {
+      if (lossRate > 0 &&
+          std::uniform_real_distribution<double>(0, 1)(rng) < lossRate) {
+        dropped++;
+        sent++;  // as far as the caller knows, it went out
+        continue;
+      }
+      iov[count] = iovec{d->data, d->len};
+      setHeader(msgs[count].msg_hdr, d->peer, &iov[count]);
+      count++;
+    }
+    uint32_t done = 0;
+    while (done < count) {
+      int result = sendmmsg(sckt, msgs + done, count - done, 0);
+      if (result < 0) {
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == ENOBUFS) {
+          // a full socket buffer is the same as loss on the wire, and the
+          // rest of the datagrams would only find it full too
+          dropped += count - done + n;
+          return sent + done;
+        }
+        throw Ex1(Errcode::SOCKET_SEND);
+      }
+      done += result;
+    }
+    sent += done;
+  }
+  return sent;
+}
+
+uint32_t UDP4Socket::receiveBatch(Datagram d[], uint32_t n) {
+  if (n > MAX_BATCH) n = MAX_BATCH;
+  mmsghdr msgs[MAX_BATCH];
+  iovec iov[MAX_BATCH];
+  for (uint32_t i = 0; i < n; i++) {
+    iov[i] = iovec{d[i].data, Datagram::MAX_PAYLOAD};
+    setHeader(msgs[i].msg_hdr, d[i].peer, &iov[i]);
+  }
+  int result;
+  do {
+    result = recvmmsg(sckt, msgs, n, MSG_DONTWAIT, nullptr);
+  } while (result < 0 && errno == EINTR);
+  if (result < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+    throw Ex1(Errcode::SOCKET_RECV);
+  }
+  for (int i = 0; i < result; i++) d[i].len = msgs[i].msg_len;
+  return result;
+}
+#else
+// no batched system calls, one datagram at a time
+uint32_t UDP4Socket::sendBatch(Datagram d[], uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    if (lossRate > 0 &&
+        std::uniform_real_distribution<double>(0, 1)(rng) < lossRate) {
+      dropped++;
+      continue;
+    }
+    sendto(sckt, d[i].data, d[i].len, 0, (struct sockaddr*)d[i].peer,
+           sizeof(sockaddr_in));
+  }
+  return n;
+}
+
+uint32_t UDP4Socket::receiveBatch(Datagram d[], uint32_t n) {
+  uint32_t i;
+  for (i = 0; i < n && wait(0); i++) {
+    socklen_t len = sizeof(sockaddr_in);
+    int result = recvfrom(sckt, d[i].data, Datagram::MAX_PAYLOAD, 0,
+                          (struct sockaddr*)d[i].peer, &len);
+    if (result < 0) break;
+    d[i].len = result;
+  }
+  return i;
+}
+#endif
@@ -1,22 +1,64 @@
 #pragma once
 
 #include <cstdint>
+#include <random>
 #include <string>
 
-#include "Socket.hh"
-#include "csp/Request.hh"
+#include "csp/Socket.hh"
+#include "csp/SocketIO.hh"
 
-class UDPV4Socket : public Socket {
+/*
+  One IPv4 datagram. peer holds the sockaddr_in it came from or goes to,
+  stored as bytes so that callers do not need the system headers.
+*/
+struct Datagram {
+  // 1500 byte ethernet MTU less 20 bytes IP and 8 bytes UDP header
+  static constexpr uint32_t MAX_PAYLOAD = 1472;
+  char peer[16];
+  uint32_t len;
+  char data[MAX_PAYLOAD];
+};
+
+/*
+  UDP4Socket sends and receives datagrams without acknowledgement. On Linux
+  each sendBatch/receiveBatch is a single sendmmsg/recvmmsg system call for
+  up to MAX_BATCH datagrams. Guaranteed delivery is layered on top by
+  UDP4Connection.
+*/
+class UDP4Socket : public Socket {
  private:
-  int sckt;
+  socket_t sckt;
+  double lossRate;  // fraction of outgoing datagrams dropped, for testing
+  std::minstd_rand rng;
+  uint64_t dropped;
 
  public:
+  static constexpr uint32_t MAX_BATCH = 64;
+
   UDP4Socket(const char* addr, uint16_t port);  // Client
-  UDP4Socket(uint16_t port);                    // Server
-  ~IPV4Socket() { close(sckt); }
-  void listenOnPort();
-  void wait();
-  void send(const char* buf, uint32_t len);
-  //  void ack(BadPackets p);
-  void send(uint32_t reqn);  // For CSP
+  UDP4Socket(uint16_t port);  // Server, port 0 picks a free port
+  ~UDP4Socket();
+  UDP4Socket(const UDP4Socket& orig) = delete;
+  UDP4Socket& operator=(const UDP4Socket& orig) = delete;
+
+  void wait() override;  // block until a datagram arrives
+  // block until a datagram arrives or timeoutMillis pass, false on timeout
+  bool wait(int timeoutMillis);
+
+  /*
+    returns how many of the n datagrams were handed to the kernel. Once the
+    socket buffer is full the rest are counted in getDropped, like the
+    simulated loss, and are left for the caller to resend.
+  */
+  uint32_t sendBatch(Datagram d[], uint32_t n);
+  // does not block, returns the number of datagrams received (0..n)
+  uint32_t receiveBatch(Datagram d[], uint32_t n);
+
+  // for a client, the server address given to the constructor
+  void getDefaultPeer(char peer[16]) const;
+  uint16_t getLocalPort() const;
+
+  // simulate a lossy network: drop this fraction of outgoing datagrams
+  void setLossRate(double p) { lossRate = p; }
+  uint64_t getDropped() const { return dropped; }
 };
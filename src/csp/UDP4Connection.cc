@@ -0,0 +1,264 @@
+#include "csp/UDP4Connection.hh"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace std::chrono_literals;
+
+// retransmit timer limits, tuned for LAN rather than RFC 6298's 1 second
+constexpr UDP4Connection::Clock::duration MIN_RTO = 10ms;
+constexpr UDP4Connection::Clock::duration MAX_RTO = 2s;
+constexpr UDP4Connection::Clock::duration INITIAL_RTO = 100ms;
+
+// sequence numbers wrap, so compare them by signed distance
+static int32_t seqDiff(uint32_t a, uint32_t b) { return int32_t(a - b); }
+
+void UDP4Connection::putHeader(char* p, const Header& h) {
+  const uint32_t words[3] = {htonl(h.seq), htonl(uint32_t(h.sackBits >> 32)),
+                             htonl(uint32_t(h.sackBits))};
+  p[0] = h.type;
+  memset(p + 1, 0, sizeof(h.unused));
+  memcpy(p + 4, words, sizeof(words));
+}
+
+UDP4Connection::Header UDP4Connection::getHeader(const char* p) {
+  uint32_t words[3];
+  memcpy(words, p + 4, sizeof(words));
+  return Header{uint8_t(p[0]),
+                {0, 0, 0},
+                ntohl(words[0]),
+                uint64_t(ntohl(words[1])) << 32 | ntohl(words[2])};
+}
+
+UDP4Connection::UDP4Connection(UDP4Socket& s)
+    : s(s),
+      sendBase(0),
+      nextSeq(0),
+      srtt(0),
+      rttvar(0),
+      rto(INITIAL_RTO),
+      haveRTT(false),
+      receiveBase(0),
+      ackNeeded(false),
+      latestOut(0),
+      latestIn(0),
+      haveLatest(false),
+      newLatest(false),
+      numOutgoing(0),
+      retransmits(0),
+      duplicates(0),
+      staleDropped(0) {
+  s.getDefaultPeer(peer);
+  hasPeer = ((sockaddr_in*)peer)->sin_addr.s_addr != INADDR_ANY;
+  for (uint32_t i = 0; i < WINDOW; i++) {
+    window[i].inUse = false;
+    reorder[i].received = false;
+  }
+}
+
+void UDP4Connection::queue(const Datagram& d) {
+  if (numOutgoing == UDP4Socket::MAX_BATCH) flush();
+  Datagram& out = outgoing[numOutgoing++];
+  memcpy(out.peer, d.peer, sizeof(out.peer));
+  out.len = d.len;
+  memcpy(out.data, d.data, d.len);
+}
+
+void UDP4Connection::queue(PacketType type, uint32_t seq, uint64_t sackBits,
+                           const char* data, uint32_t len) {
+  if (numOutgoing == UDP4Socket::MAX_BATCH) flush();
+  Datagram& out = outgoing[numOutgoing++];
+  memcpy(out.peer, peer, sizeof(peer));
+  putHeader(out.data, Header{type, {0, 0, 0}, seq, sackBits});
+  if (len > 0) memcpy(out.data + sizeof(Header), data, len);  // acks: none
+  out.len = sizeof(Header) + len;
+}
+
+void UDP4Connection::flush() {
+  if (numOutgoing == 0) return;
+  s.sendBatch(outgoing, numOutgoing);
+  numOutgoing = 0;
+}
+
+bool UDP4Connection::send(const char* data, uint32_t len) {
+  if (!hasPeer || len > MAX_MESSAGE || nextSeq - sendBase >= WINDOW)
+    return false;
+  SendSlot& slot = window[nextSeq % WINDOW];
+  memcpy(slot.d.peer, peer, sizeof(peer));
+  putHeader(slot.d.data, Header{DATA, {0, 0, 0}, nextSeq, 0});
+  memcpy(slot.d.data + sizeof(Header), data, len);
+  slot.d.len = sizeof(Header) + len;
+  slot.sent = Clock::now();
+  slot.inUse = true;
+  slot.retransmitted = false;
+  queue(slot.d);
+  nextSeq++;
+  return true;
+}
+
+void UDP4Connection::publish(const char* data, uint32_t len) {
+  if (!hasPeer || len > MAX_MESSAGE) return;
+  queue(LATEST, latestOut++, 0, data, len);
+}
+
+void UDP4Connection::poll(int timeoutMillis) {
+  flush();
+  // do not sleep past the earliest retransmit
+  Clock::time_point now = Clock::now();
+  for (uint32_t seq = sendBase; seq != nextSeq; seq++) {
+    const SendSlot& slot = window[seq % WINDOW];
+    if (!slot.inUse) continue;
+    int64_t due = chrono::duration_cast<chrono::milliseconds>(slot.sent + rto -
+                                                              now)
+                      .count();
+    if (due < 0) due = 0;
+    if (timeoutMillis < 0 || due < timeoutMillis) timeoutMillis = due;
+  }
+
+  if (s.wait(timeoutMillis)) {
+    uint32_t n;
+    do {
+      n = s.receiveBatch(incoming, UDP4Socket::MAX_BATCH);
+      for (uint32_t i = 0; i < n; i++) receive(incoming[i]);
+    } while (n == UDP4Socket::MAX_BATCH);
+  }
+  if (ackNeeded) sendAck();
+  retransmitExpired(Clock::now());
+  flush();
+}
+
+void UDP4Connection::receive(const Datagram& d) {
+  if (d.len < sizeof(Header)) return;
+  if (!hasPeer) {
+    memcpy(peer, d.peer, sizeof(peer));
+    hasPeer = true;
+  } else if (memcmp(peer, d.peer, 8) != 0) {  // family, port and address
+    return;
+  }
+  const Header h = getHeader(d.data);
+  const char* payload = d.data + sizeof(h);
+  uint32_t len = d.len - sizeof(h);
+  switch (h.type) {
+    case DATA:
+      receiveData(h, payload, len);
+      break;
+    case ACK:
+      receiveAck(h);
+      break;
+    case LATEST:
+      if (haveLatest && seqDiff(h.seq, latestIn) <= 0) {
+        staleDropped++;  // an older value overtaken by a newer one
+        break;
+      }
+      latestIn = h.seq;
+      haveLatest = newLatest = true;
+      latestValue.assign(payload, payload + len);
+      break;
+  }
+}
+
+void UDP4Connection::receiveData(const Header& h, const char* data,
+                                 uint32_t len) {
+  ackNeeded = true;  // even for duplicates, the earlier ack may be lost
+  int32_t ahead = seqDiff(h.seq, receiveBase);
+  if (ahead < 0 || ahead >= int32_t(WINDOW)) {
+    duplicates++;
+    return;
+  }
+  ReceiveSlot& slot = reorder[h.seq % WINDOW];
+  if (slot.received) {
+    duplicates++;
+    return;
+  }
+  slot.data.assign(data, data + len);
+  slot.received = true;
+  for (ReceiveSlot* r = &reorder[receiveBase % WINDOW]; r->received;
+       r = &reorder[receiveBase % WINDOW]) {
+    inbox.push_back(std::move(r->data));
+    r->received = false;
+    receiveBase++;
+  }
+}
+
+void UDP4Connection::sendAck() {
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i + 1 < WINDOW; i++)
+    if (reorder[(receiveBase + 1 + i) % WINDOW].received) bits |= 1ULL << i;
+  queue(ACK, receiveBase, bits, nullptr, 0);
+  ackNeeded = false;
+}
+
+void UDP4Connection::acknowledge(uint32_t seq, Clock::time_point now) {
+  SendSlot& slot = window[seq % WINDOW];
+  if (!slot.inUse) return;
+  if (!slot.retransmitted) updateRTT(now - slot.sent);
+  slot.inUse = false;
+}
+
+void UDP4Connection::receiveAck(const Header& h) {
+  uint32_t cumulative = h.seq;
+  if (seqDiff(cumulative, sendBase) < 0 || seqDiff(cumulative, nextSeq) > 0)
+    return;  // stale or bogus
+  Clock::time_point now = Clock::now();
+  for (uint32_t seq = sendBase; seq != cumulative; seq++)
+    acknowledge(seq, now);
+  for (uint32_t i = 0; i < 64; i++)
+    if ((h.sackBits >> i) & 1) {
+      uint32_t seq = cumulative + 1 + i;
+      if (seqDiff(seq, nextSeq) < 0) acknowledge(seq, now);
+    }
+  while (sendBase != nextSeq && !window[sendBase % WINDOW].inUse) sendBase++;
+
+  // fast retransmit: three later packets arrived but this one did not
+  if (sendBase != nextSeq && __builtin_popcountll(h.sackBits) >= 3) {
+    SendSlot& slot = window[sendBase % WINDOW];
+    if (slot.inUse && now - slot.sent >= (haveRTT ? srtt : rto)) {
+      slot.sent = now;
+      slot.retransmitted = true;
+      retransmits++;
+      queue(slot.d);
+    }
+  }
+}
+
+void UDP4Connection::retransmitExpired(Clock::time_point now) {
+  bool expired = false;
+  for (uint32_t seq = sendBase; seq != nextSeq; seq++) {
+    SendSlot& slot = window[seq % WINDOW];
+    if (!slot.inUse || now - slot.sent < rto) continue;
+    slot.sent = now;
+    slot.retransmitted = true;
+    retransmits++;
+    queue(slot.d);
+    expired = true;
+  }
+  if (expired) rto = min(rto * 2, MAX_RTO);  // back off until acks return
+}
+
+void UDP4Connection::updateRTT(Clock::duration sample) {
+  if (!haveRTT) {
+    srtt = sample;
+    rttvar = sample / 2;
+    haveRTT = true;
+  } else {
+    Clock::duration err = srtt > sample ? srtt - sample : sample - srtt;
+    rttvar = (rttvar * 3 + err) / 4;
+    srtt = (srtt * 7 + sample) / 8;
+  }
+  rto = std::clamp(srtt + 4 * rttvar, MIN_RTO, MAX_RTO);
+}
+
+bool UDP4Connection::receive(vector<char>& msg) {
+  if (inbox.empty()) return false;
+  msg = std::move(inbox.front());
+  inbox.pop_front();
+  return true;
+}
+
+bool UDP4Connection::latest(vector<char>& value) {
+  if (!newLatest) return false;
+  value = latestValue;
+  newLatest = false;
+  return true;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+/**
+   Delivery guarantees on top of UDP4Socket, for one peer.
+
+   Two channels share the socket:
+
+   reliable, ordered: send() numbers each message. The receiver buffers
+     anything that arrives out of order and delivers in sequence. Each batch
+     of received data is answered with one ACK carrying the next expected
+     sequence number and a 64 bit selective-ack map of what arrived beyond
+     it, so one lost packet does not force resending everything after it.
+     Unacknowledged packets are resent when a retransmit timer, adapted to
+     the measured round trip time (RFC 6298), expires.
+
+   latest value wins: publish() is for streaming telemetry into charts.
+     Nothing is acknowledged or resent, and a packet older than the newest
+     value already received is simply dropped.
+
+   Outgoing datagrams are queued and sent with one sendBatch per poll().
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "csp/UDP4.hh"
+
+class UDP4Connection {
+ public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr uint32_t WINDOW = 64;  // unacknowledged packets in flight
+
+ private:
+  enum PacketType : uint8_t { DATA = 1, ACK = 2, LATEST = 3 };
+  struct Header {
+    uint8_t type;
+    uint8_t unused[3];
+    uint32_t seq;       // DATA, LATEST: sequence; ACK: next expected
+    uint64_t sackBits;  // ACK: bit i set means seq+1+i was received
+  };
+  // the header goes on the wire in network byte order
+  static void putHeader(char* p, const Header& h);
+  static Header getHeader(const char* p);
+
+ public:
+  static constexpr uint32_t MAX_MESSAGE =
+      Datagram::MAX_PAYLOAD - sizeof(Header);
+
+ private:
+  struct SendSlot {
+    Datagram d;
+    Clock::time_point sent;
+    bool inUse;
+    bool retransmitted;  // no RTT sample from retransmitted packets (Karn)
+  };
+  struct ReceiveSlot {
+    std::vector<char> data;
+    bool received;
+  };
+
+  UDP4Socket& s;
+  char peer[16];
+  bool hasPeer;
+
+  // reliable sender
+  SendSlot window[WINDOW];
+  uint32_t sendBase;  // oldest unacknowledged
+  uint32_t nextSeq;
+  Clock::duration srtt, rttvar, rto;
+  bool haveRTT;
+
+  // reliable receiver
+  ReceiveSlot reorder[WINDOW];
+  uint32_t receiveBase;  // next sequence to deliver
+  bool ackNeeded;
+  std::deque<std::vector<char>> inbox;
+
+  // latest value channel
+  uint32_t latestOut;
+  uint32_t latestIn;
+  bool haveLatest, newLatest;
+  std::vector<char> latestValue;
+
+  Datagram outgoing[UDP4Socket::MAX_BATCH];
+  uint32_t numOutgoing;
+  Datagram incoming[UDP4Socket::MAX_BATCH];
+
+  uint64_t retransmits, duplicates, staleDropped;
+
+  void queue(const Datagram& d);
+  void queue(PacketType type, uint32_t seq, uint64_t sackBits,
+             const char* data, uint32_t len);
+  void receive(const Datagram& d);
+  void receiveData(const Header& h, const char* data, uint32_t len);
+  void receiveAck(const Header& h);
+  void acknowledge(uint32_t seq, Clock::time_point now);
+  void sendAck();
+  void retransmitExpired(Clock::time_point now);
+  void updateRTT(Clock::duration sample);
+
+ public:
+  // a client talks to the address the socket was created with; a server
+  // answers whoever sends to it first
+  UDP4Connection(UDP4Socket& s);
+  UDP4Connection(const UDP4Connection& orig) = delete;
+  UDP4Connection& operator=(const UDP4Connection& orig) = delete;
+
+  // reliable, ordered. false if the window is full: poll() and try again
+  bool send(const char* data, uint32_t len);
+  // unreliable, only the newest value matters
+  void publish(const char* data, uint32_t len);
+
+  /*
+    send what is queued, wait up to timeoutMillis for datagrams, process
+    them, answer with acks and resend anything whose timer expired
+  */
+  void poll(int timeoutMillis);
+  void flush();
+
+  // next in-order reliable message, false if none yet
+  bool receive(std::vector<char>& msg);
+  // newest published value if it changed since the last call
+  bool latest(std::vector<char>& value);
+
+  uint32_t inFlight() const { return nextSeq - sendBase; }
+  uint64_t getRetransmits() const { return retransmits; }
+  uint64_t getDuplicates() const { return duplicates; }
+  uint64_t getStaleDropped() const { return staleDropped; }
+  Clock::duration getRTO() const { return rto; }
+};
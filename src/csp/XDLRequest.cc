@@ -3,6 +3,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#endif
 
 #include <csp/csp.hh>
 #include <cstdint>
@@ -210,25 +213,60 @@ void XDLRequest::handle(int fd) {
   out.attachWrite(fd);
   in.attachRead(fd);
   in.displayRawRead();
-  // buffer ..   buffer+dataSize
-  // for now, hardcoded first 4 bytes of buffer is the request number
-  uint32_t requestId = in.readU32();
-  cout << "requestId: " << requestId << '\n';
-  if (requestId >= xdlData.size()) {
-    // srvlog.error(Errcode::ILLEGAL_SERVLETID);
-    // commented this line out because it causes an error
-    // ERROR: In function `CSPRequest::handle(int)':
-    // CSPRequest.cc:(.text+0xf6): undefined reference to `srvlog'
-    cout << "ERROR::ILLEGAL_SERVLETID\n";
-    return;
-  }
+  do {
+    // for now, hardcoded first 4 bytes of buffer is the request number
+    uint32_t requestId = in.readU32();
+    bool framed = (requestId & FRAMED) != 0;
+    requestId &= ~FRAMED;
+    if (requestId >= xdlData.size()) {
+      // srvlog.error(Errcode::ILLEGAL_SERVLETID);
+      // commented this line out because it causes an error
+      // ERROR: In function `CSPRequest::handle(int)':
+      // CSPRequest.cc:(.text+0xf6): undefined reference to `srvlog'
+      if (!framed) return;
+      out.write(uint64_t(0));
+      out.flush();
+      continue;
+    }
 
-  const XDLType* x = xdlData[requestId];
-  // Struct* s = (Struct*)st->getSymbol(root);
-  x->writeXDLMeta(out);
-  x->writeXDL(out);
-  out.displayRaw();
-  out.flush();
+    const XDLType* x = xdlData[requestId];
+    if (!framed) {
+      // Struct* s = (Struct*)st->getSymbol(root);
+      x->writeXDLMeta(out);
+      x->writeXDL(out);
+      out.displayRaw();
+      out.flush();
+      return;
+    }
+    // the length has to go first, so build the response before sending it
+    vector<char> response;
+    out.setCapture(&response);
+    x->writeXDLMeta(out);
+    x->writeXDL(out);
+    out.flush();
+    out.setCapture(nullptr);
+    out.write(uint64_t(response.size()));
+    out.specialWrite(response.data(), response.size());
+  } while (waitForNextRequest(fd));
+}
+
+/*
+  After a framed response, hold the connection open briefly for the client
+  to reuse. This server handles one connection at a time, so the wait ends
+  as soon as another client is waiting on the listening socket. Without
+  one to watch, only a request that has already arrived is served.
+*/
+bool XDLRequest::waitForNextRequest(int fd) {
+#ifdef __linux__
+  pollfd p[2] = {{fd, POLLIN, 0}, {listener, POLLIN, 0}};
+  const int n = listener >= 0 ? 2 : 1;
+  if (poll(p, n, n == 2 ? KEEP_ALIVE_MILLIS : 0) <= 0) return false;
+  if (n == 2 && (p[1].revents & POLLIN)) return false;  // someone is waiting
+  in.attachRead(fd);
+  return in.getReadLen() >= sizeof(uint32_t);  // 0 means the client closed
+#else
+  return false;
+#endif
 }
 
 XDLRequest::~XDLRequest() {
@@ -7,9 +7,22 @@
 
 class XDLCompiler;
 class XDLRequest : public Request {
+ public:
+  /*
+    A request id with FRAMED set asks for the response to be preceded by
+    its length in bytes (uint64_t, 0 if the id is illegal) and the
+    connection to stay open for up to KEEP_ALIVE_MILLIS waiting for the
+    next request, unless another client is waiting to connect.
+    AsyncCSPClient uses this to reuse pooled connections. Without the bit
+    the response is unframed and the connection closes after it.
+  */
+  static constexpr uint32_t FRAMED = 0x80000000;
+  static constexpr int KEEP_ALIVE_MILLIS = 200;
+
  private:
   DynArray<const XDLType*> xdlData;
   XDLCompiler* compiler;
+  bool waitForNextRequest(int fd);
 
  public:
   XDLRequest(const char filename[]);
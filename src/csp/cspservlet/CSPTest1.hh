@@ -12,7 +12,7 @@ class CSPTest1 : public CSPServlet {
   CSPTest1() {}
   ~CSPTest1() {}
   void request(CSPRequest& r) {
-    cout << "Test1 is loaded\n";
+    std::cout << "Test1 is loaded\n";
     Buffer& out = r.getOut();
     uint32_t x = 12345;
     out << x;
@@ -11,7 +11,7 @@ class CSPTest2 : public CSPServlet {
   CSPTest2() {}
   ~CSPTest2() {}
   void request(CSPRequest& r) {
-    cout << "Test2 is loaded\n";
+    std::cout << "Test2 is loaded\n";
     Buffer& out = r.getOut();
     for (uint32_t x = 0; x < 1024; x++)
       // out.write(x);
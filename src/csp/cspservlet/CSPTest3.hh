@@ -12,10 +12,10 @@ class CSPTest3 : public CSPServlet {
   CSPTest3() {}
   ~CSPTest3() {}
   void request(CSPRequest& r) {
-    cout << "Test3 is loaded\n";
+    std::cout << "Test3 is loaded\n";
     Buffer& out = r.getOut();
-    string first = "Dov";
-    string last = "Kruger";
+    std::string first = "Dov";
+    std::string last = "Kruger";
     out << first << last;
   }
 };
@@ -23,7 +23,7 @@ class CSPTest4 : public CSPServlet {
     int64_t h = -12345678901234567;
     float i = 1.234567;
     double j = 1.23456789012345;
-    string s = "This is a test string.";
+    std::string s = "This is a test string.";
     out << a << b << c << d << e << f << g << h << i << j << s;
   }
 };
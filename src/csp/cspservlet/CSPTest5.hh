@@ -21,7 +21,7 @@ class CSPTest5 : public CSPServlet {
       mylist.add(i);
     }
     for (int i = 0; i < 15; i++) {
-      cout << (int)mylist.getData(i) << "\n";
+      std::cout << (int)mylist.getData(i) << "\n";
     }
     // out << mylist;
     out.writeList(mylist);
@@ -29,7 +29,7 @@ class CSPTest6 : public CSPServlet {
             mylist.add(Student("Ivan", "Valiaev", 12345))
             out << mylist;
      */
-    cout << "Test6 is loaded\n";
+    std::cout << "Test6 is loaded\n";
     Buffer& out = r.getOut();
     Student test = Student("Ivan", "Valiaev", 12345);
     out.writeStudent(test);
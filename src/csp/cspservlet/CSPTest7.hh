@@ -28,24 +28,24 @@ class CSPTest7 : public CSPServlet {
             mylist.add(Student("Ivan", "Valiaev", 12345))
             out << mylist;
      */
-    cout << "Test7 is loaded\n";
+    std::cout << "Test7 is loaded\n";
     // Buffer& out = r.getOut();
     Student test1 = Student("John", "Smith", 12345);
     Student test2 = Student("Bobby", "Tables", 54321);
-    cout << "test1: " << test1.getFirst() << "\n";
-    cout << "test2: " << test2.getFirst() << "\n";
-    cout << "\n";
+    std::cout << "test1: " << test1.getFirst() << "\n";
+    std::cout << "test2: " << test2.getFirst() << "\n";
+    std::cout << "\n";
     List1<Student> mylist;
     mylist.add(test1);
-    // cout<<"item1: "<<mylist.getData(0).getFirst()<<"\n";
+    // std::cout<<"item1: "<<mylist.getData(0).getFirst()<<"\n";
     mylist.add(test2);
-    cout << "item1: " << mylist.getData(0).getFirst() << "\n";
-    cout << "item1: " << mylist.getData(0).getLast() << "\n";
-    cout << "item1: " << (int)mylist.getData(0).getID() << "\n";
-    cout << "\n";
-    cout << "item2: " << mylist.getData(1).getFirst() << "\n";
-    cout << "item2: " << mylist.getData(1).getLast() << "\n";
-    cout << "item2: " << (int)mylist.getData(1).getID() << "\n";
+    std::cout << "item1: " << mylist.getData(0).getFirst() << "\n";
+    std::cout << "item1: " << mylist.getData(0).getLast() << "\n";
+    std::cout << "item1: " << (int)mylist.getData(0).getID() << "\n";
+    std::cout << "\n";
+    std::cout << "item2: " << mylist.getData(1).getFirst() << "\n";
+    std::cout << "item2: " << mylist.getData(1).getLast() << "\n";
+    std::cout << "item2: " << (int)mylist.getData(1).getID() << "\n";
 
     Buffer& out = r.getOut();
     out.writeList(mylist);
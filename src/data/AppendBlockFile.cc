@@ -0,0 +1,193 @@
+#include "data/AppendBlockFile.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "util/Ex.hh"
+#include "util/PlatFlags.hh"
+
+using namespace std;
+
+namespace {
+using GeneralHeader = BlockLoader::GeneralHeader;
+
+uint64_t load(uint64_t& committed) {
+  return atomic_ref<uint64_t>(committed).load(memory_order_acquire);
+}
+
+// make a rename or create in the directory holding filename durable
+void syncDirectory(const string& filename) {
+  const size_t slash = filename.rfind('/');
+  const string dir = slash == string::npos ? "." : filename.substr(0, slash);
+  int d = ::open(dir.c_str(), O_RDONLY);
+  if (d < 0) throw Ex2(Errcode::DIR_NOT_FOUND, dir);
+  fsync(d);
+  ::close(d);
+}
+
+bool writeAll(int fh, const void* p, uint64_t bytes, uint64_t offset) {
+  return pwrite(fh, p, bytes, offset) == int64_t(bytes);
+}
+}  // namespace
+
+AppendBlockFile::AppendBlockFile(const char filename[], uint64_t reserveBytes)
+    : filename(filename),
+      reserveBytes(reserveBytes),
+      fh(-1),
+      map(nullptr),
+      mapBytes(0),
+      header(nullptr) {}
+
+void AppendBlockFile::open(bool writable) {
+  fh = ::open(filename.c_str(), (writable ? O_RDWR : O_RDONLY) | O_BINARY);
+  if (fh < 0) throw Ex2(Errcode::FILE_NOT_FOUND, filename);
+  struct stat s;
+  fstat(fh, &s);
+  if (uint64_t(s.st_size) < dataOffset())
+    throw Ex2(Errcode::FILE_READ, filename);
+  mapRows(0, writable);
+  const GeneralHeader* g = (const GeneralHeader*)map;
+  if (g->magic != GeneralHeader::bh ||
+      g->type != uint16_t(BlockLoader::Type::appendblock) ||
+      g->version != VERSION || header->rowBytes == 0 ||
+      dataOffset() + load(header->numRows) * header->rowBytes >
+          uint64_t(s.st_size))
+    throw Ex2(Errcode::FILE_READ, filename);
+  mapRows(load(header->numRows), writable);
+}
+
+void AppendBlockFile::close() {
+  if (map != nullptr) munmap(map, mapBytes);
+  if (fh >= 0) ::close(fh);
+  map = nullptr;
+  fh = -1;
+}
+
+void AppendBlockFile::mapRows(uint64_t numRows, bool writable) {
+  const uint64_t rowBytes = header == nullptr ? 0 : header->rowBytes;
+  const uint64_t needed = dataOffset() + numRows * rowBytes;
+  if (map != nullptr && needed <= mapBytes) return;
+  if (map != nullptr) munmap(map, mapBytes);
+  // pages past the end of the file become readable as the file grows
+  mapBytes = max(needed + reserveBytes, dataOffset());
+  void* p = mmap(nullptr, mapBytes, PROT_READ | (writable ? PROT_WRITE : 0),
+                 MAP_SHARED, fh, 0);
+  if (p == MAP_FAILED) {
+    map = nullptr;
+    throw Ex2(Errcode::FILE_READ, filename);
+  }
+  map = (char*)p;
+  header = (Header*)(map + sizeof(GeneralHeader));
+}
+
+uint64_t AppendBlockFile::getNumRows() const {
+  return min(load(header->numRows),
+             (mapBytes - dataOffset()) / header->rowBytes);
+}
+
+AppendBlockWriter::AppendBlockWriter(const char filename[], uint32_t rowBytes,
+                                     uint64_t reserveBytes)
+    : AppendBlockFile(filename, reserveBytes) {
+  if (rowBytes < sizeof(double)) throw Ex1(Errcode::BAD_ARGUMENT);
+  // a compaction that didn't get as far as renaming is abandoned
+  unlink((this->filename + ".compact").c_str());
+  int f = ::open(filename, O_RDWR | O_CREAT | O_BINARY, 0644);
+  if (f < 0) throw Ex2(Errcode::FILE_NOT_FOUND, filename);
+  struct stat s;
+  fstat(f, &s);
+  if (uint64_t(s.st_size) < dataOffset()) {  // new, or killed creating it
+    GeneralHeader g(BlockLoader::Type::appendblock, VERSION);
+    g.author_id = g.doc_id = 0;
+    g.num_sections = 0;
+    g.header_size = 0;
+    Header h{rowBytes, 0, 0, 0};
+    bool ok = ftruncate(f, 0) == 0 && writeAll(f, &g, sizeof(g), 0) &&
+              writeAll(f, &h, sizeof(h), sizeof(g)) && fsync(f) == 0;
+    ::close(f);
+    if (!ok) throw Ex2(Errcode::FILE_WRITE, filename);
+    syncDirectory(this->filename);
+  } else {
+    ::close(f);
+  }
+  open(true);
+  if (header->rowBytes != rowBytes) throw Ex2(Errcode::BAD_ARGUMENT, filename);
+}
+
+void AppendBlockWriter::append(const void* rows, uint64_t n) {
+  const uint64_t rowBytes = header->rowBytes;
+  const uint64_t committed = load(header->numRows);
+  if (!writeAll(fh, rows, n * rowBytes, dataOffset() + committed * rowBytes) ||
+      fdatasync(fh) != 0)
+    throw Ex2(Errcode::FILE_WRITE, filename);
+  mapRows(committed + n, true);
+  // the rows are on disk, so publish them
+  atomic_ref<uint64_t>(header->numRows)
+      .store(committed + n, memory_order_release);
+  if (msync(map, sizeof(GeneralHeader) + sizeof(Header), MS_SYNC) != 0)
+    throw Ex2(Errcode::FILE_WRITE, filename);
+}
+
+void AppendBlockWriter::compact() {
+  const uint64_t n = load(header->numRows), main = header->mainRows;
+  const uint32_t rowBytes = header->rowBytes;
+  if (main == n) return;
+  vector<uint64_t> order(n);
+  iota(order.begin(), order.end(), 0);
+  auto byTime = [&](uint64_t a, uint64_t b) {
+    return getTime(a) < getTime(b);
+  };
+  stable_sort(order.begin() + main, order.end(), byTime);
+  inplace_merge(order.begin(), order.begin() + main, order.end(), byTime);
+  vector<char> rows(n * rowBytes);
+  for (uint64_t i = 0; i < n; i++)
+    memcpy(&rows[i * rowBytes], getRow(order[i]), rowBytes);
+
+  const string compacted = filename + ".compact";
+  int f = ::open(compacted.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+                 0644);
+  if (f < 0) throw Ex2(Errcode::FILE_WRITE, compacted);
+  Header h{rowBytes, 0, n, n};
+  bool ok = writeAll(f, map, sizeof(GeneralHeader), 0) &&
+            writeAll(f, &h, sizeof(h), sizeof(GeneralHeader)) &&
+            writeAll(f, rows.data(), rows.size(), dataOffset()) &&
+            fsync(f) == 0;
+  ::close(f);
+  // the new file is complete on disk before it replaces the old one
+  if (!ok || rename(compacted.c_str(), filename.c_str()) != 0)
+    throw Ex2(Errcode::FILE_WRITE, compacted);
+  syncDirectory(filename);
+  atomic_ref<uint32_t>(header->superseded).store(1, memory_order_release);
+  close();
+  header = nullptr;
+  open(true);
+}
+
+AppendBlockReader::AppendBlockReader(const char filename[],
+                                     uint64_t reserveBytes)
+    : AppendBlockFile(filename, reserveBytes) {
+  open(false);
+}
+
+uint64_t AppendBlockReader::refresh() {
+  // the writer may have been killed after renaming but before marking
+  struct stat named, opened;
+  const bool replaced = stat(filename.c_str(), &named) == 0 &&
+                        fstat(fh, &opened) == 0 &&
+                        named.st_ino != opened.st_ino;
+  if (replaced ||
+      atomic_ref<uint32_t>(header->superseded).load(memory_order_acquire)) {
+    close();
+    header = nullptr;
+    open(false);
+  }
+  mapRows(load(header->numRows), false);
+  return getNumRows();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "data/BlockLoader2.hh"
+
+/*
+  An append only block file for live data such as daily quotes or sensor
+  readings. Rows are a fixed size and start with a double, their time.
+
+    GeneralHeader | Header | main block | tail
+
+  Crash safety comes from ordering. The writer writes new rows past the
+  committed end and syncs them, and only then stores the new row count in
+  the header and syncs that. Killed at any point, the file holds every row
+  whose append returned and the count never covers bytes that weren't
+  written; whatever lies past the count is overwritten by the next append.
+
+  The file is mapped shared with spare address space past its end, and the
+  count is read atomically, so a reader in another process sees rows as
+  they are appended without reloading.
+
+  Rows arrive in any order. Compaction merges the tail into the main block,
+  which is kept sorted by time, writes the result to a new file, syncs it
+  and renames it over the old one, then marks the old one superseded so
+  readers know to reopen it by name. Only one writer may have a file open.
+*/
+class AppendBlockFile {
+ public:
+  static constexpr uint16_t VERSION = 1;
+  struct Header {
+    uint32_t rowBytes;
+    uint32_t superseded;  // nonzero once compaction has replaced the file
+    uint64_t mainRows;    // rows [0, mainRows) are sorted by time
+    uint64_t numRows;     // committed rows, only ever stored atomically
+  };
+
+ protected:
+  std::string filename;
+  uint64_t reserveBytes;  // address space to map beyond the end
+  int fh;
+  char* map;
+  uint64_t mapBytes;
+  Header* header;
+
+  AppendBlockFile(const char filename[], uint64_t reserveBytes);
+  void open(bool writable);
+  void close();
+  // map enough of the file for numRows rows
+  void mapRows(uint64_t numRows, bool writable);
+  static uint64_t dataOffset() {
+    return sizeof(BlockLoader::GeneralHeader) + sizeof(Header);
+  }
+
+ public:
+  ~AppendBlockFile() { close(); }
+  AppendBlockFile(const AppendBlockFile& orig) = delete;
+  AppendBlockFile& operator=(const AppendBlockFile& orig) = delete;
+
+  uint32_t getRowBytes() const { return header->rowBytes; }
+  uint64_t getMainRows() const { return header->mainRows; }
+  // committed rows that are mapped, including any appended since last asked
+  uint64_t getNumRows() const;
+  const void* getRow(uint64_t i) const {
+    return map + dataOffset() + i * header->rowBytes;
+  }
+  double getTime(uint64_t i) const { return *(const double*)getRow(i); }
+};
+
+class AppendBlockWriter : public AppendBlockFile {
+ public:
+  // open filename for appending rows of rowBytes, creating it if missing
+  AppendBlockWriter(const char filename[], uint32_t rowBytes,
+                    uint64_t reserveBytes = 1ULL << 32);
+  // append n rows, durable when this returns
+  void append(const void* rows, uint64_t n);
+  // merge the tail into the main block, replacing the file
+  void compact();
+};
+
+class AppendBlockReader : public AppendBlockFile {
+ public:
+  AppendBlockReader(const char filename[], uint64_t reserveBytes = 1ULL << 32);
+  /*
+    Make every committed row readable, remapping if they have outgrown the
+    reserve and reopening the file if compaction replaced it. Returns the
+    number of rows.
+  */
+  uint64_t refresh();
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <iostream>
 #include <memory>
 
@@ -18,8 +19,10 @@ class BlockLoader {
     gapminder,  // a binary database of floating point variables, originally
                 // from gapminder this one could store any time series data by
                 // year
-    i32map  // a hashmap with 32-bit int keys, values are byte chunks defined by
-            // user
+    i32map,  // a hashmap with 32-bit int keys, values are byte chunks defined
+             // by user
+    timeseries,  // samples in time order with min/max/first/last/sum pyramids
+    appendblock  // fixed size rows appended live, see AppendBlockFile
   };
 
   // std::unique_ptr<uint64_t> mem;
@@ -75,8 +78,6 @@ class BlockLoader {
     uint32_t version;
   };
   BlockLoader(const Info& info);
-  uint64_t crc64(uint32_t start, uint32_t stride) const;
-  void hashThisDocument() const;
 
  public:
   BlockLoader(const char filename[]);
@@ -100,10 +101,26 @@ class BlockLoader {
     return (char*)mem + sizeof(GeneralHeader) + generalHeader->header_size;
   }  // TODO: do we need header_size at all? variable sized headers?
 
-  void registerDocument(uint64_t author_id) const;
+  /*
+    The hashes identifying a document, all of the bytes after the general
+    header, so registering (which sets author_id) doesn't change them.
+  */
+  struct DocumentHash {
+    // all bytes, even bytes, odd bytes, every 3rd from 0, every 3rd from 1
+    uint64_t crc[5];
+    // all bytes, even bytes, odd bytes, even 1k blocks, odd 1k blocks
+    uint8_t sha256[5][32];
+    bool operator==(const DocumentHash& b) const = default;
+  };
+  // CRC-64/XZ of bytes start, start + stride, ... after the general header
+  uint64_t crc64(uint32_t start, uint32_t stride) const;
+  // every hash in DocumentHash, reading the document once
+  DocumentHash hashThisDocument() const;
+
   // register this document with a server under author's id
-  bool authenticateDocument()
-      const;  // return true if this document is correctly signed on server
+  DocumentHash registerDocument(uint64_t author_id) const;
+  // return true if this document still matches the hashes it registered
+  bool authenticateDocument(const DocumentHash& registered) const;
 
   BlockLoader(uint64_t bytes, Type t, uint16_t version);
 };
@@ -0,0 +1,251 @@
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+#if defined(__SSE2__) || defined(__PCLMUL__)
+#include <immintrin.h>
+#endif
+
+#include "data/BlockLoader2.hh"
+#include "util/Ex.hh"
+using namespace std;
+
+/*
+  Document hashing. The CRCs are CRC-64/XZ (ECMA-182 reflected, as used by
+  xz), so they can be checked with any xz implementation.
+
+  hashThisDocument makes one pass over the document in chunks small enough
+  to stay in L2. Each chunk is split into its even, odd and every 3rd bytes,
+  then every CRC and SHA-256 runs over the cached chunk, so the document is
+  only read from memory once however many hashes are taken.
+*/
+namespace {
+constexpr uint64_t POLY = 0xC96C5795D7870F42ULL;  // reflected
+constexpr uint64_t CHUNK = 24 * 1024;  // a multiple of 6 and 2k, see above
+
+struct FreeDigest {
+  void operator()(EVP_MD_CTX* c) const { EVP_MD_CTX_free(c); }
+};
+using Sha256 = unique_ptr<EVP_MD_CTX, FreeDigest>;
+
+// slicing by 8: t[k][b] is the CRC of byte b followed by k zero bytes
+struct CRCTable {
+  uint64_t t[8][256];
+  constexpr CRCTable() : t() {
+    for (uint32_t b = 0; b < 256; b++) {
+      uint64_t c = b;
+      for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ POLY : c >> 1;
+      t[0][b] = c;
+    }
+    for (int k = 1; k < 8; k++)
+      for (uint32_t b = 0; b < 256; b++)
+        t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 255];
+  }
+};
+constexpr CRCTable table;
+
+uint64_t crcBytes(uint64_t crc, const uint8_t* p, uint64_t n) {
+  for (; n >= 8; n -= 8, p += 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    crc ^= w;
+    crc = table.t[7][crc & 255] ^ table.t[6][(crc >> 8) & 255] ^
+          table.t[5][(crc >> 16) & 255] ^ table.t[4][(crc >> 24) & 255] ^
+          table.t[3][(crc >> 32) & 255] ^ table.t[2][(crc >> 40) & 255] ^
+          table.t[1][(crc >> 48) & 255] ^ table.t[0][crc >> 56];
+  }
+  for (; n > 0; n--, p++) crc = table.t[0][(crc ^ *p) & 255] ^ (crc >> 8);
+  return crc;
+}
+
+#ifdef __PCLMUL__
+// x^e mod P, bit reversed to match the reflected CRC
+constexpr uint64_t reflectedPower(uint32_t e) {
+  uint64_t r = 1;
+  for (uint32_t i = 0; i < e; i++)
+    r = (r << 1) ^ (r >> 63 ? 0x42F0E1EBA9EA3693ULL : 0);  // POLY unreflected
+  uint64_t rev = 0;
+  for (int i = 0; i < 64; i++) rev |= (r >> i & 1) << (63 - i);
+  return rev;
+}
+
+/*
+  Multiplying the 16 bytes in a by this carries them d bytes further along
+  the message: the low half by x^(8d+63), the high half by x^(8d-1).
+*/
+__m128i foldConstant(uint32_t d) {
+  return _mm_set_epi64x(reflectedPower(8 * d - 1), reflectedPower(8 * d + 63));
+}
+
+__m128i fold(__m128i a, __m128i k) {
+  return _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x00),
+                       _mm_clmulepi64_si128(a, k, 0x11));
+}
+
+/*
+  Fold 64 bytes at a time in four independent lanes, so the multiplier
+  latency overlaps, then fold the lanes into 16 bytes whose CRC from zero
+  is the CRC of everything folded.
+*/
+uint64_t crcFold(uint64_t crc, const uint8_t* p, uint64_t n) {
+  if (n < 128) return crcBytes(crc, p, n);
+  static const __m128i k64 = foldConstant(64), k48 = foldConstant(48),
+                       k32 = foldConstant(32), k16 = foldConstant(16);
+  __m128i lane[4];
+  for (int i = 0; i < 4; i++)
+    lane[i] = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+  lane[0] = _mm_xor_si128(lane[0], _mm_cvtsi64_si128(crc));
+  for (p += 64, n -= 64; n >= 64; p += 64, n -= 64)
+    for (int i = 0; i < 4; i++)
+      lane[i] = _mm_xor_si128(fold(lane[i], k64),
+                              _mm_loadu_si128((const __m128i*)(p + 16 * i)));
+  __m128i all = _mm_xor_si128(
+      _mm_xor_si128(fold(lane[0], k48), fold(lane[1], k32)),
+      _mm_xor_si128(fold(lane[2], k16), lane[3]));
+  alignas(16) uint8_t last[16];
+  _mm_store_si128((__m128i*)last, all);
+  return crcBytes(crcBytes(0, last, 16), p, n);
+}
+#else
+uint64_t crcFold(uint64_t crc, const uint8_t* p, uint64_t n) {
+  return crcBytes(crc, p, n);
+}
+#endif
+
+class CRC64 {
+  uint64_t crc = ~0ULL;
+
+ public:
+  void update(const uint8_t* p, uint64_t n) { crc = crcFold(crc, p, n); }
+  uint64_t value() const { return ~crc; }
+};
+
+void deinterleave2(const uint8_t* p, uint64_t n, uint8_t* even, uint8_t* odd) {
+  uint64_t i = 0;
+#ifdef __SSE2__
+  const __m128i low = _mm_set1_epi16(0xFF);
+  for (; i + 32 <= n; i += 32) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(p + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(p + i + 16));
+    _mm_storeu_si128((__m128i*)(even + i / 2),
+                     _mm_packus_epi16(_mm_and_si128(a, low),
+                                      _mm_and_si128(b, low)));
+    _mm_storeu_si128((__m128i*)(odd + i / 2),
+                     _mm_packus_epi16(_mm_srli_epi16(a, 8),
+                                      _mm_srli_epi16(b, 8)));
+  }
+#endif
+  for (; i < n; i++) (i % 2 == 0 ? even : odd)[i / 2] = p[i];
+}
+
+// bytes 0, 3, 6, ... into third0 and 1, 4, 7, ... into third1
+void deinterleave3(const uint8_t* p, uint64_t n, uint8_t* third0,
+                   uint8_t* third1) {
+  uint64_t i = 0;
+#ifdef __SSSE3__
+  const __m128i s00 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1,
+                                    -1, -1, -1, -1, -1);
+  const __m128i s01 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14,
+                                    -1, -1, -1, -1, -1);
+  const __m128i s02 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                    -1, 1, 4, 7, 10, 13);
+  const __m128i s10 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1,
+                                    -1, -1, -1, -1, -1);
+  const __m128i s11 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15,
+                                    -1, -1, -1, -1, -1);
+  const __m128i s12 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                    -1, 2, 5, 8, 11, 14);
+  for (; i + 48 <= n; i += 48) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(p + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(p + i + 16));
+    __m128i c = _mm_loadu_si128((const __m128i*)(p + i + 32));
+    _mm_storeu_si128((__m128i*)(third0 + i / 3),
+                     _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, s00),
+                                               _mm_shuffle_epi8(b, s01)),
+                                  _mm_shuffle_epi8(c, s02)));
+    _mm_storeu_si128((__m128i*)(third1 + i / 3),
+                     _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, s10),
+                                               _mm_shuffle_epi8(b, s11)),
+                                  _mm_shuffle_epi8(c, s12)));
+  }
+#endif
+  for (; i < n; i++)
+    if (i % 3 == 0)
+      third0[i / 3] = p[i];
+    else if (i % 3 == 1)
+      third1[i / 3] = p[i];
+}
+}  // namespace
+
+uint64_t BlockLoader::crc64(uint32_t start, uint32_t stride) const {
+  if (stride == 0) throw Ex1(Errcode::BAD_ARGUMENT);
+  const uint8_t* doc = (const uint8_t*)mem + getHeaderSize();
+  const uint64_t n = size - getHeaderSize();
+  CRC64 crc;
+  if (stride == 1) {
+    crc.update(doc + min<uint64_t>(start, n), n - min<uint64_t>(start, n));
+    return crc.value();
+  }
+  vector<uint8_t> picked(CHUNK);
+  uint64_t i = start;
+  while (i < n) {
+    uint32_t count = 0;
+    for (; count < CHUNK && i < n; i += stride) picked[count++] = doc[i];
+    crc.update(picked.data(), count);
+  }
+  return crc.value();
+}
+
+/*
+** To prevent a collision attack where a document is designed to have the same
+** hash but be different, hash in multiple ways, including some the attacker
+** does not know in advance. This would make it much harder to forge a priori.
+**
+** TODO: add an author-defined parameter permuting the file before hashing.
+** Anyone designing a document that collides using the known crc and sha
+** hashes would also have to match the unknown one. This information is stored
+** encrypted and in the event of a dispute, the author can prove the hash was
+** valid.
+*/
+BlockLoader::DocumentHash BlockLoader::hashThisDocument() const {
+  const uint8_t* doc = (const uint8_t*)mem + getHeaderSize();
+  const uint64_t n = size - getHeaderSize();
+  CRC64 crc[5];
+  Sha256 sha[5];
+  for (Sha256& s : sha) {
+    s.reset(EVP_MD_CTX_new());
+    if (!s || !EVP_DigestInit_ex(s.get(), EVP_sha256(), nullptr))
+      throw Ex1(Errcode::OUTOF_MEMORY);
+  }
+  vector<uint8_t> split(CHUNK / 2 * 2 + CHUNK / 3 * 2);
+  uint8_t *even = split.data(), *odd = even + CHUNK / 2;
+  uint8_t *third0 = odd + CHUNK / 2, *third1 = third0 + CHUNK / 3;
+
+  // each chunk starts at a multiple of 6, so the splits line up across chunks
+  for (uint64_t offset = 0; offset < n; offset += CHUNK) {
+    const uint8_t* p = doc + offset;
+    const uint64_t len = min(CHUNK, n - offset);
+    deinterleave2(p, len, even, odd);
+    deinterleave3(p, len, third0, third1);
+    crc[0].update(p, len);
+    crc[1].update(even, (len + 1) / 2);
+    crc[2].update(odd, len / 2);
+    crc[3].update(third0, (len + 2) / 3);
+    crc[4].update(third1, (len + 1) / 3);
+    EVP_DigestUpdate(sha[0].get(), p, len);
+    EVP_DigestUpdate(sha[1].get(), even, (len + 1) / 2);
+    EVP_DigestUpdate(sha[2].get(), odd, len / 2);
+    for (uint64_t b = 0; b < len; b += 1024)
+      EVP_DigestUpdate(sha[3 + (offset + b) / 1024 % 2].get(), p + b,
+                       min<uint64_t>(1024, len - b));
+  }
+
+  DocumentHash h;
+  for (int i = 0; i < 5; i++) {
+    h.crc[i] = crc[i].value();
+    EVP_DigestFinal_ex(sha[i].get(), h.sha256[i], nullptr);
+  }
+  return h;
+}
@@ -4,16 +4,22 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 
+#include "data/CompressedBlockFile.hh"
 #include "util/Ex.hh"
 #include "util/PlatFlags.hh"
 
 using namespace std;
 
-BlockMapLoader BlockMapLoader::loadCompressed(const char lzmaFile[]) {
-  throw(Ex1(Errcode::UNIMPLEMENTED));
+// BlockLoader recognizes compressed files, see CompressedBlockFile
+BlockMapLoader BlockMapLoader::loadCompressed(const char filename[]) {
+  if (!CompressedBlockFile::isCompressed(filename))
+    throw Ex2(Errcode::COMPRESSED_CORRUPT, filename);
+  return BlockMapLoader(filename);
 }
 
 /*
@@ -24,10 +30,42 @@ BlockMapLoader BlockMapLoader::loadCompressed(const char lzmaFile[]) {
   float: b1 b2 b3 b4 uint32_t:   b1 b2 b3 b4   b4 b3 b2 b1 b4 b3 b2 b1
   uint64_t:   b1 b2 b3 b4 b5 b6 b7 b8 --> b8 b7 b6 b5 b4 b3 b2 b1
 */
-void BlockMapLoader::save(const char filename[]) {
+void BlockMapLoader::save(const char filename[], bool withSpatialIndex,
+                          bool withLOD, bool withFill) {
+  if (withSpatialIndex && spatialIndex == nullptr) buildSpatialIndex();
+  withLOD = withLOD && !blockMapHeader->deltaEncoded;  // needs real points
+  if (withLOD && lod == nullptr) buildLOD();
+  withFill = withFill && !blockMapHeader->deltaEncoded;
+  if (withFill && fill == nullptr) buildFill();
+  blockMapHeader->hasSpatialIndex = withSpatialIndex;
+  blockMapHeader->hasLOD = withLOD;
+  blockMapHeader->hasFill = withFill;
   int fh = open(filename, O_WRONLY | O_TRUNC | O_CREAT | O_BINARY, 0644);
-  int bytesWritten = write(fh, (char*)mem, size);
+  if (fh < 0) throw Ex2(Errcode::FILE_NOT_FOUND, filename);
+  blockMapHeader->quantized = packedPoints != nullptr;
+  // a loaded file may already hold sections past the points, so don't use size
+  const uint64_t zero = 0;
+  int64_t bytes = (char*)(segments + blockMapHeader->numSegments) - (char*)mem;
+  bool ok = write(fh, (char*)mem, bytes) == bytes;
+  // each section starts on an 8-byte boundary
+  auto writeSection = [&](const void* section, int64_t sectionBytes) {
+    const int64_t pad = -bytes & 7;
+    ok = ok && write(fh, &zero, pad) == pad &&
+         write(fh, section, sectionBytes) == sectionBytes;
+    bytes += pad + sectionBytes;
+  };
+  if (packedPoints != nullptr) {
+    writeSection(packedPoints, getPackedPointsBytes());
+  } else {  // raw points follow the segments directly
+    const int64_t pointBytes = blockMapHeader->numPoints * 2 * sizeof(float);
+    ok = ok && write(fh, points, pointBytes) == pointBytes;
+    bytes += pointBytes;
+  }
+  if (withSpatialIndex) writeSection(spatialIndex, getSpatialIndexBytes());
+  if (withLOD) writeSection(lod, getLODBytes());
+  if (withFill) writeSection(fill, getFillBytes());
   close(fh);
+  if (!ok) throw Ex2(Errcode::FILE_WRITE, filename);
 }
 
 BlockMapLoader::BlockMapLoader(const char filename[]) : BlockLoader(filename) {
@@ -41,8 +79,251 @@ BlockMapLoader::BlockMapLoader(const char filename[]) : BlockLoader(filename) {
   points =
       (float*)((char*)segments + blockMapHeader->numSegments * sizeof(Segment));
 
+  // sections start on 8-byte boundaries after the points
+  uint64_t offset = (char*)points - (char*)mem;
+  if (blockMapHeader->quantized) {
+    offset = (offset + 7) & ~uint64_t(7);
+    if (offset < size) attachPackedPoints(mem + offset / 8, size - offset);
+    if (packedPoints == nullptr) throw Ex2(Errcode::FILE_READ, filename);
+    decodedPoints.resize(2 * uint64_t(blockMapHeader->numPoints));
+    decodePoints(decodedPoints.data());
+    points = decodedPoints.data();
+    offset += getPackedPointsBytes();
+  } else {
+    offset += blockMapHeader->numPoints * 2 * sizeof(float);
+  }
+  offset = (offset + 7) & ~uint64_t(7);
+
   // floats are now completely loaded, ready to draw!
+  if (blockMapHeader->hasSpatialIndex && offset < size) {
+    attachSpatialIndex(mem + offset / 8, size - offset);
+    if (spatialIndex == nullptr) return;  // later sections can't be found
+    offset += (getSpatialIndexBytes() + 7) & ~uint64_t(7);
+  }
+  if (blockMapHeader->hasLOD && offset < size) {
+    attachLOD(mem + offset / 8, size - offset);
+    if (lod == nullptr) return;
+    offset += getLODBytes();
+  }
+  if (blockMapHeader->hasFill && offset < size)
+    attachFill(mem + offset / 8, size - offset);
+}
+
+/*
+  Check that the section is complete and consistent before trusting it.
+  An index that fails is ignored, and queries scan every region instead.
+*/
+void BlockMapLoader::attachSpatialIndex(const uint64_t* p, uint64_t bytes) {
+  spatialIndex = nullptr;
+  const SpatialIndexHeader* h = (const SpatialIndexHeader*)p;
+  if (bytes < sizeof(SpatialIndexHeader) ||
+      h->magic != SpatialIndexHeader::MAGIC || h->nodeSize < 2 ||
+      h->numLevels == 0 || h->numLevels > SpatialIndexHeader::MAX_LEVELS ||
+      h->numItems != blockMapHeader->numRegions ||
+      h->levelEnd[0] != h->numItems ||
+      h->levelEnd[h->numLevels - 1] != h->numNodes ||
+      bytes < sizeof(SpatialIndexHeader) +
+                  uint64_t(h->numNodes) * sizeof(BoundRect) +
+                  uint64_t(h->numItems) * sizeof(uint32_t)) {
+    std::cerr << "BlockMapLoader: ignoring invalid spatial index\n";
+    return;
+  }
+  for (uint32_t level = 1, count = h->numItems; level < h->numLevels; level++) {
+    count = (count + h->nodeSize - 1) / h->nodeSize;
+    if (h->levelEnd[level] - h->levelEnd[level - 1] != count) return;
+  }
+  indexBoxes = (const BoundRect*)(h + 1);
+  indexIds = (const uint32_t*)(indexBoxes + h->numNodes);
+  for (uint32_t i = 0; i < h->numItems; i++)
+    if (indexIds[i] >= h->numItems) return;
+  spatialIndex = h;
+}
+
+uint64_t BlockMapLoader::getSpatialIndexBytes() const {
+  return (char*)(indexIds + spatialIndex->numItems) - (char*)spatialIndex;
+}
+
+void BlockMapLoader::attachLOD(const uint64_t* p, uint64_t bytes) {
+  lod = nullptr;
+  const LODHeader* h = (const LODHeader*)p;
+  if (bytes < sizeof(LODHeader) || h->magic != LODHeader::MAGIC ||
+      h->numLevels > LODHeader::MAX_LEVELS) {
+    std::cerr << "BlockMapLoader: ignoring invalid LOD section\n";
+    return;
+  }
+  const uint32_t numSegments = blockMapHeader->numSegments;
+  const char* level = (const char*)(h + 1);
+  bytes -= sizeof(LODHeader);
+  for (uint32_t i = 0; i < h->numLevels; i++) {
+    const uint32_t numPoints = h->levels[i].numPoints;
+    const uint64_t levelBytes = getLODLevelBytes(numSegments, numPoints);
+    if (levelBytes > bytes) return;
+    lodSegments[i] = (const Segment*)level;
+    lodPoints[i] = (const float*)(lodSegments[i] + numSegments);
+    uint64_t count = 0;
+    for (uint32_t j = 0; j < numSegments; j++)
+      count += lodSegments[i][j].numPoints;
+    if (count != numPoints) return;
+    level += levelBytes;
+    bytes -= levelBytes;
+  }
+  lod = h;
+}
+
+uint64_t BlockMapLoader::getLODBytes() const {
+  uint64_t bytes = sizeof(LODHeader);
+  for (uint32_t i = 0; i < lod->numLevels; i++)
+    bytes += getLODLevelBytes(blockMapHeader->numSegments,
+                              lod->levels[i].numPoints);
+  return bytes;
+}
+
+// position of (x,y) along a Hilbert curve filling a 65536 x 65536 grid
+static uint32_t hilbert(uint32_t x, uint32_t y) {
+  constexpr uint32_t n = 1 << 16;
+  uint32_t d = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) != 0, ry = (y & s) != 0;
+    d += s * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) x = n - 1 - x, y = n - 1 - y;
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+void BlockMapLoader::buildSpatialIndex(uint32_t nodeSize) {
+  if (nodeSize < 4 || nodeSize > 0xFFFF) throw Ex1(Errcode::BAD_ARGUMENT);
+  const uint32_t n = blockMapHeader->numRegions;
+  SpatialIndexHeader h{};
+  h.magic = SpatialIndexHeader::MAGIC;
+  h.nodeSize = nodeSize;
+  h.numItems = n;
+  uint32_t count = n, total = n;
+  h.levelEnd[h.numLevels++] = n;
+  while (count > 1) {
+    count = (count + nodeSize - 1) / nodeSize;
+    total += count;
+    if (h.numLevels == SpatialIndexHeader::MAX_LEVELS)
+      throw Ex1(Errcode::ILLEGAL_SIZE);
+    h.levelEnd[h.numLevels++] = total;
+  }
+  h.numNodes = total;
+  uint64_t bytes = sizeof(SpatialIndexHeader) +
+                   uint64_t(total) * sizeof(BoundRect) + n * sizeof(uint32_t);
+  builtIndex.assign((bytes + 7) / 8, 0);
+  memcpy(builtIndex.data(), &h, sizeof(h));
+  BoundRect* boxes = (BoundRect*)((SpatialIndexHeader*)builtIndex.data() + 1);
+  uint32_t* ids = (uint32_t*)(boxes + total);
+
+  // sort regions along the curve by the centers of their bounds
+  if (n > 0) {
+    BoundRect all = regions[0].bounds;
+    for (uint32_t i = 1; i < n; i++)
+      all = BoundRect::merge(all, regions[i].bounds);
+    const float w = std::max(all.xMax - all.xMin, eps);
+    const float hgt = std::max(all.yMax - all.yMin, eps);
+    std::vector<std::pair<uint32_t, uint32_t>> order(n);
+    for (uint32_t i = 0; i < n; i++) {
+      const BoundRect& b = regions[i].bounds;
+      float cx = ((b.xMin + b.xMax) * 0.5f - all.xMin) / w;
+      float cy = ((b.yMin + b.yMax) * 0.5f - all.yMin) / hgt;
+      order[i] = {hilbert(uint32_t(std::clamp(cx, 0.0f, 1.0f) * 65535),
+                          uint32_t(std::clamp(cy, 0.0f, 1.0f) * 65535)),
+                  i};
+    }
+    std::sort(order.begin(), order.end());
+    for (uint32_t i = 0; i < n; i++) {
+      ids[i] = order[i].second;
+      boxes[i] = regions[ids[i]].bounds;
+    }
+  }
+  // each node of a level bounds nodeSize consecutive boxes of the one below
+  for (uint32_t level = 1, start = 0; level < h.numLevels; level++) {
+    uint32_t end = h.levelEnd[level - 1];
+    for (uint32_t i = start, parent = end; i < end; i += nodeSize, parent++) {
+      BoundRect b = boxes[i];
+      for (uint32_t j = i + 1; j < std::min(i + nodeSize, end); j++)
+        b = BoundRect::merge(b, boxes[j]);
+      boxes[parent] = b;
+    }
+    start = end;
+  }
+  attachSpatialIndex(builtIndex.data(), builtIndex.size() * 8);
+}
+
+void BlockMapLoader::query(const BoundRect& viewport,
+                           std::vector<Range>& regionRanges) const {
+  regionRanges.clear();
+  std::vector<uint32_t> found;
+  if (spatialIndex == nullptr) {
+    for (uint32_t i = 0; i < blockMapHeader->numRegions; i++)
+      if (viewport.intersects(regions[i].bounds)) found.push_back(i);
+  } else if (spatialIndex->numItems > 0) {
+    const SpatialIndexHeader* h = spatialIndex;
+    // depth first from the root, each entry a box and its level
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.push_back({h->numNodes - 1, h->numLevels - 1u});
+    while (!stack.empty()) {
+      auto [box, level] = stack.back();
+      stack.pop_back();
+      if (!viewport.intersects(indexBoxes[box])) continue;
+      if (level == 0) {
+        found.push_back(indexIds[box]);
+        continue;
+      }
+      uint32_t levelStart = h->levelEnd[level - 1];
+      if (viewport.contains(indexBoxes[box])) {
+        // every leaf below is visible, and they are consecutive
+        uint64_t leaves = 1;
+        for (uint32_t i = 0; i < level; i++) leaves *= h->nodeSize;
+        uint64_t first = (box - levelStart) * leaves;
+        uint64_t last = std::min<uint64_t>(first + leaves, h->numItems);
+        found.insert(found.end(), indexIds + first, indexIds + last);
+        continue;
+      }
+      uint32_t childStart = level > 1 ? h->levelEnd[level - 2] : 0;
+      uint32_t first = childStart + (box - levelStart) * h->nodeSize;
+      uint32_t last = std::min(first + h->nodeSize, levelStart);
+      for (uint32_t c = first; c < last; c++) stack.push_back({c, level - 1});
+    }
+    // ranges need region order; for a wide view marking beats sorting
+    if (found.size() * 8 < h->numItems) {
+      std::sort(found.begin(), found.end());
+    } else {
+      std::vector<bool> visible(h->numItems);
+      for (uint32_t r : found) visible[r] = true;
+      found.clear();
+      for (uint32_t r = 0; r < h->numItems; r++)
+        if (visible[r]) found.push_back(r);
+    }
+  }
+  for (uint32_t r : found)
+    if (!regionRanges.empty() && regionRanges.back().end == r)
+      regionRanges.back().end++;
+    else
+      regionRanges.push_back({r, r + 1});
+}
+
+void BlockMapLoader::querySegments(const BoundRect& viewport,
+                                   std::vector<Range>& segmentRanges) const {
+  query(viewport, segmentRanges);
+  const uint32_t numRegions = blockMapHeader->numRegions;
+  uint32_t out = 0;
+  for (const Range& r : segmentRanges) {
+    Range s{regions[r.start].segmentStart,
+            r.end < numRegions ? regions[r.end].segmentStart
+                               : blockMapHeader->numSegments};
+    if (s.start == s.end) continue;  // regions with no segments
+    if (out > 0 && segmentRanges[out - 1].end == s.start)
+      segmentRanges[out - 1].end = s.end;
+    else
+      segmentRanges[out++] = s;
+  }
+  segmentRanges.resize(out);
 }
+
 typedef void (BlockMapLoader::*Method)();
 // Method BlockMapLoader::methods[] = {&methodPolygon};
 
@@ -81,41 +362,55 @@ void BlockMapLoader::mean(float* meanx, float* meany) const {
   *meany = ysum / blockMapHeader->numPoints;
 }
 
-inline void delta(float& val, float& prevVal) {
-  float temp = val;
-  val -= prevVal;
-  prevVal = temp;
+/*
+  Each point becomes the difference from the one before, starting from the
+  region's base. The encoder follows the decoder's double precision sum so
+  rounding errors don't accumulate along a long border.
+*/
+void BlockMapLoader::deltaEncodeRun(double baseX, double baseY, float* xy,
+                                    uint32_t numPoints) {
+  double lastX = baseX, lastY = baseY;
+  for (uint32_t i = 0; i < numPoints; i++, xy += 2) {
+    xy[0] = float(xy[0] - lastX), xy[1] = float(xy[1] - lastY);
+    lastX += xy[0], lastY += xy[1];
+  }
 }
 
+void BlockMapLoader::deltaUnEncodeRun(double baseX, double baseY, float* xy,
+                                      uint32_t numPoints) {
+  double lastX = baseX, lastY = baseY;
+  for (uint32_t i = 0; i < numPoints; i++, xy += 2) {
+    lastX += xy[0], lastY += xy[1];
+    xy[0] = lastX, xy[1] = lastY;
+  }
+}
+
+// the points of each region are contiguous, starting at startPoints
 void BlockMapLoader::deltaEncode() {
-  uint32_t numSegments = blockMapHeader->numSegments;
-  float* xPoints = points;
-  float* yPoints = points + blockMapHeader->numPoints;
-
-  for (uint32_t i = 0; i < numSegments; i++) {
-    const uint32_t numPoints = segments[i].numPoints;
-    float lastX = regions[i].baseX;
-    float lastY = regions[i].baseY;
-    for (uint32_t j = 0; j < numPoints; j++) {
-      delta(xPoints[j], lastX);
-      delta(yPoints[j], lastY);
-    }
+  if (blockMapHeader->deltaEncoded) return;
+  if (packedPoints != nullptr) throw Ex1(Errcode::BAD_ARGUMENT);
+  const uint32_t numRegions = blockMapHeader->numRegions;
+  for (uint32_t i = 0; i < numRegions; i++) {
+    uint32_t end = i + 1 < numRegions ? regions[i + 1].startPoints
+                                      : blockMapHeader->numPoints;
+    deltaEncodeRun(regions[i].baseX, regions[i].baseY,
+                   points + 2 * regions[i].startPoints,
+                   end - regions[i].startPoints);
   }
+  blockMapHeader->deltaEncoded = 1;
 }
 
 void BlockMapLoader::deltaUnEncode() {
-  uint32_t numSegments = blockMapHeader->numSegments;
-  float* xPoints = points;
-  float* yPoints = points + blockMapHeader->numPoints;
-  for (uint32_t i = 0; i < numSegments; i++) {
-    const uint32_t numPoints = segments[i].numPoints;
-    double lastX = regions[i].baseX;
-    double lastY = regions[i].baseY;
-    for (uint32_t j = 0; j < numPoints; j++) {
-      lastX += xPoints[i], lastY += yPoints[i];
-      xPoints[i] = lastX, yPoints[i] = lastY;
-    }
+  if (!blockMapHeader->deltaEncoded) return;
+  const uint32_t numRegions = blockMapHeader->numRegions;
+  for (uint32_t i = 0; i < numRegions; i++) {
+    uint32_t end = i + 1 < numRegions ? regions[i + 1].startPoints
+                                      : blockMapHeader->numPoints;
+    deltaUnEncodeRun(regions[i].baseX, regions[i].baseY,
+                     points + 2 * regions[i].startPoints,
+                     end - regions[i].startPoints);
   }
+  blockMapHeader->deltaEncoded = 0;
 }
 
 void BlockMapLoader::dumpSegment(uint32_t seg) {
@@ -1,4 +1,6 @@
 #pragma once
+#include <vector>
+
 #include "data/BlockLoader2.hh"
 #include "data/BoundRect.hh"
 class BlockMapLoader : public BlockLoader {
@@ -10,6 +12,10 @@ class BlockMapLoader : public BlockLoader {
     uint32_t numSegments;
     uint32_t numPoints;
     uint32_t deltaEncoded : 1;
+    uint32_t hasSpatialIndex : 1;  // SpatialIndexHeader follows the points
+    uint32_t hasLOD : 1;           // LODHeader follows the spatial index
+    uint32_t quantized : 1;        // PackedPointsHeader replaces the points
+    uint32_t hasFill : 1;          // FillHeader follows the LOD
     BoundRect bounds;
   };
 
@@ -63,12 +69,109 @@ class BlockMapLoader : public BlockLoader {
   };
   void mean(float* meanx, float* meany) const;
 
+  /*
+    Optional section after the points: a packed Hilbert R-tree over the
+    region bounds. Regions are sorted by the Hilbert value of their center
+    and packed nodeSize to a node, so the tree is nothing but arrays of
+    BoundRect one level after another (leaves first, root last) and the
+    region number of each leaf. There are no pointers, so the section is
+    usable exactly as read or mapped from the file.
+  */
+  struct SpatialIndexHeader {
+    static constexpr uint32_t MAGIC = 0x21745248;  // HRt!
+    static constexpr uint32_t MAX_LEVELS = 14;
+    uint32_t magic;
+    uint16_t nodeSize;
+    uint16_t numLevels;
+    uint32_t numItems;  // same as numRegions
+    uint32_t numNodes;  // boxes in all levels together
+    uint32_t levelEnd[MAX_LEVELS];  // one past the last box of each level
+    // BoundRect boxes[numNodes], uint32_t ids[numItems]
+  };
+  struct Range {
+    uint32_t start, end;  // [start, end)
+  };
+
+  /*
+    Optional replacement for the float points. Each coordinate is an integer
+    number of quantum steps from its region's base. The x,y sequence of each
+    segment is delta and zigzag encoded, then bit-packed in blocks of 128
+    values, each block with its own width. Within a block, value j is in
+    lane j % 4, and each lane is its own stream of bits, so four values
+    come out of every shift and mask.
+  */
+  struct PackedPointsHeader {
+    static constexpr uint32_t MAGIC = 0x21745051;  // QPt!
+    static constexpr uint32_t BLOCK = 128;         // values per block
+    uint32_t magic;
+    uint32_t numBlocks;
+    double quantum;     // map units per step
+    uint64_t numWords;  // 32-bit words of packed values
+    // uint32_t segmentWord[numSegments + 1], padded to 8 bytes
+    // uint8_t widths[numBlocks], padded to 8 bytes
+    // uint32_t words[numWords]
+  };
+
+  /*
+    Optional section after the spatial index: coarser copies of the points
+    simplified at increasing tolerance. Every level has the same segments in
+    the same order, only with fewer points, so regions, segment ranges and
+    the spatial index apply to all of them. Level 0 is the original data and
+    is not repeated here.
+  */
+  struct LODHeader {
+    static constexpr uint32_t MAGIC = 0x21444F4C;  // LOD!
+    static constexpr uint32_t MAX_LEVELS = 8;
+    uint32_t magic;
+    uint32_t numLevels;  // levels stored, not counting level 0
+    struct Level {
+      float tolerance;  // farthest any dropped point is from the outline
+      uint32_t numPoints;
+    } levels[MAX_LEVELS];
+    // per level: Segment segments[numSegments], float points[2 * numPoints]
+    // padded to 8 bytes
+  };
+
+  /*
+    Optional section after the LOD: triangles filling the polygons of every
+    region, holes left open. Each triangle is three point numbers into the
+    full detail points, so the indices go to the GPU as they are, against
+    the same vertex buffer as the outlines. The triangles of each region are
+    together and in region order, so a run of regions is one draw.
+  */
+  struct FillHeader {
+    static constexpr uint32_t MAGIC = 0x216C6946;  // Fil!
+    uint32_t magic;
+    uint32_t numRegions;
+    uint64_t numIndices;  // three per triangle
+    // uint64_t regionStart[numRegions + 1], first index of each region
+    // uint32_t indices[numIndices], padded to 8 bytes
+  };
+
  private:
   BlockMapHeader* blockMapHeader;
   RegionContainer* regionContainers;
   Region* regions;
   Segment* segments;
   float* points;
+  const SpatialIndexHeader* spatialIndex = nullptr;
+  const BoundRect* indexBoxes;
+  const uint32_t* indexIds;
+  std::vector<uint64_t> builtIndex;  // index built in memory, not loaded
+  const LODHeader* lod = nullptr;
+  const Segment* lodSegments[LODHeader::MAX_LEVELS];
+  const float* lodPoints[LODHeader::MAX_LEVELS];
+  std::vector<uint64_t> builtLOD;
+  const FillHeader* fill = nullptr;
+  const uint64_t* fillStart;
+  const uint32_t* fillIndices;
+  std::vector<uint64_t> builtFill;
+  const PackedPointsHeader* packedPoints = nullptr;
+  const uint32_t* packedSegmentWord;
+  const uint8_t* packedWidths;
+  const uint32_t* packedWords;
+  std::vector<uint64_t> builtPackedPoints;
+  std::vector<float> decodedPoints;  // points of a quantized file
   static constexpr uint16_t version = 0x0401;  // 0.4.0.1
   typedef void (BlockMapLoader::*Method)();
   const static Method methods[];
@@ -80,6 +183,24 @@ class BlockMapLoader : public BlockLoader {
   static bool approxeqpt(float x1, float y1, float x2, float y2) {
     return std::abs(x2 - x1) < eps && std::abs(y2 - y1) < eps;
   }
+  void attachPackedPoints(const uint64_t* p, uint64_t bytes);
+  uint64_t getPackedPointsBytes() const;
+  void attachSpatialIndex(const uint64_t* p, uint64_t bytes);
+  uint64_t getSpatialIndexBytes() const;
+  static uint64_t getLODLevelBytes(uint32_t numSegments, uint32_t numPoints) {
+    return (numSegments * sizeof(Segment) + numPoints * 2 * sizeof(float) +
+            7) & ~uint64_t(7);
+  }
+  void attachLOD(const uint64_t* p, uint64_t bytes);
+  uint64_t getLODBytes() const;
+  void attachFill(const uint64_t* p, uint64_t bytes);
+  uint64_t getFillBytes() const {
+    return (char*)(fillIndices + fill->numIndices) - (char*)fill;
+  }
+  static void deltaEncodeRun(double baseX, double baseY, float* xy,
+                             uint32_t numPoints);
+  static void deltaUnEncodeRun(double baseX, double baseY, float* xy,
+                               uint32_t numPoints);
 
  public:
   // void init(const uint64_t* mem, uint64_t size);
@@ -107,14 +228,81 @@ class BlockMapLoader : public BlockLoader {
   // load and convert an ESRI .shp to BlockMap format
   BlockMapLoader(const char filename[], const char[]);
   static BlockMapLoader loadFromESRI(const char filename[]);
+  /*
+    Map the .shp and .shx files and decode records on numThreads threads
+    (0 for one per core), writing straight into the block. Produces the same
+    map as loadFromESRI without going through shapelib.
+  */
+  static BlockMapLoader loadFromESRIParallel(const char filename[],
+                                             uint32_t numThreads = 0,
+                                             bool deltaEncoded = false);
   static BlockMapLoader loadCompressed(const char filename[]);
   // TODO: const RegionContainers* getRegionContainers() const { return
   // regionContainers; }
 
   const Region* getRegions() const { return regions; }
   const Segment* getSegments() const { return segments; }
-  // save a fast blockmap file
-  void save(const char filename[]);
+  // save a fast blockmap file, building the optional sections if missing.
+  // Fill triangles are large, so they are only written when asked for
+  void save(const char filename[], bool withSpatialIndex = true,
+            bool withLOD = true, bool withFill = false);
+
+  void buildSpatialIndex(uint32_t nodeSize = 16);
+  bool hasSpatialIndex() const { return spatialIndex != nullptr; }
+  /*
+    Find the regions whose bounds intersect the viewport, as sorted ranges
+    of consecutive region numbers. Without an index every region is checked.
+  */
+  void query(const BoundRect& viewport, std::vector<Range>& regionRanges) const;
+  // the same, converted to ranges of segments for drawing
+  void querySegments(const BoundRect& viewport,
+                     std::vector<Range>& segmentRanges) const;
+
+  /*
+    Store points as packed integers, quantum map units apart (1e-6 degrees
+    is about 10cm). The points in memory become the decoded values, exactly
+    what will be loaded from the saved file.
+  */
+  void quantize(double quantum = 1e-6);
+  bool isQuantized() const { return packedPoints != nullptr; }
+  // decode all points as interleaved x,y floats, for example into a GL buffer
+  void decodePoints(float* xy) const;
+
+  // simplify into numLevels coarser levels, each ratio times the tolerance
+  void buildLOD(uint32_t numLevels = 4, float ratio = 4);
+  uint32_t getNumLevels() const {
+    return lod == nullptr ? 1 : 1 + lod->numLevels;
+  }
+  float getTolerance(uint32_t level) const {
+    return level == 0 ? 0 : lod->levels[level - 1].tolerance;
+  }
+  uint32_t getNumPoints(uint32_t level) const {
+    return level == 0 ? blockMapHeader->numPoints
+                      : lod->levels[level - 1].numPoints;
+  }
+  const Segment* getSegments(uint32_t level) const {
+    return level == 0 ? segments : lodSegments[level - 1];
+  }
+  const float* getPoints(uint32_t level) const {
+    return level == 0 ? points : lodPoints[level - 1];
+  }
+  // the coarsest level no farther than maxError from the original
+  uint32_t selectLevel(float maxError) const {
+    uint32_t level = getNumLevels() - 1;
+    while (level > 0 && getTolerance(level) > maxError) level--;
+    return level;
+  }
+
+  /*
+    Triangulate the polygons of each region on numThreads threads (0 for one
+    per core). Lines and points have no fill, so their regions are empty.
+  */
+  void buildFill(uint32_t numThreads = 0);
+  bool hasFill() const { return fill != nullptr; }
+  uint64_t getNumFillIndices() const { return fill->numIndices; }
+  const uint32_t* getFillIndices() const { return fillIndices; }
+  // the triangles of regions [a, b) are indices fillStart[a] to fillStart[b]
+  const uint64_t* getFillStart() const { return fillStart; }
 
   void filterX(double xMin, double xMax);
   void filterY(double yMin, double yMax);
@@ -1,9 +1,23 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "data/BlockMapLoader2.hh"
 #include "libshape/shapefil.h"
 #include "util/Ex.hh"
+#include "util/MappedFile.hh"
+#include "util/ParallelFor.hh"
+#include "util/PlatFlags.hh"
 using namespace std;
 
 // extra parameter calls loader from ESRI Shapefile
@@ -41,6 +55,7 @@ BlockMapLoader BlockMapLoader::loadFromESRI(const char filename[]) {
                      version);
   // first bytes past standard header is the header specific to this file format
   bml.blockMapHeader = (BlockMapHeader*)bml.getSpecificHeader();
+  memset((void*)bml.blockMapHeader, 0, sizeof(BlockMapHeader));
   // next, get the location of the segments
   bml.blockMapHeader->bounds.xMin = minBounds[0];
   bml.blockMapHeader->bounds.xMax = maxBounds[0];
@@ -76,8 +91,12 @@ BlockMapLoader BlockMapLoader::loadFromESRI(const char filename[]) {
     bounds.xMax = shapes[i]->dfXMax;
     bounds.yMin = shapes[i]->dfYMin;
     bounds.yMax = shapes[i]->dfYMax;
-    bml.regions[i].baseX = shapes[i]->padfX[0];
-    bml.regions[i].baseY = shapes[i]->padfY[0];
+    // a null shape has no points to take the base from
+    bool empty = shapes[i]->nVertices == 0;
+    bml.regions[i].baseX = empty ? 0 : shapes[i]->padfX[0];
+    bml.regions[i].baseY = empty ? 0 : shapes[i]->padfY[0];
+    bml.regions[i].segmentStart = segCount;
+    bml.regions[i].startPoints = pointOffset / 2;
     for (uint32_t j = 0; j < shapes[i]->nParts; j++, segCount++) {
       bml.segments[segCount].type = shapes[i]->nSHPType;
       uint32_t numPoints;
@@ -106,9 +125,9 @@ BlockMapLoader BlockMapLoader::loadFromESRI(const char filename[]) {
   }
 
   // cerr << "Removed " << numDups << " final points of polygons\n";
-  uint32_t numFloatsRemoved = numDups * 2;
-  bml.blockMapHeader->numPoints -= numFloatsRemoved;
-  bml.size -= numFloatsRemoved * sizeof(float);
+  // numPoints counts x,y pairs, the size counts both floats of each
+  bml.blockMapHeader->numPoints -= numDups;
+  bml.size -= numDups * 2 * sizeof(float);
   for (const auto& shape : shapes) SHPDestroyObject(shape);
   SHPClose(shapeHandle);
 
@@ -130,6 +149,164 @@ BlockMapLoader BlockMapLoader::loadFromESRI(const char filename[]) {
   return bml;
 }
 
+namespace {
+// shapefiles mix big endian record headers with little endian contents
+uint32_t bigEndian32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return __builtin_bswap32(v);
+}
+template <typename T>
+T little(const char* p) {
+  T v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/*
+  The parts of an ESRI polygon or polyline record, after the 8 byte record
+  header: type, bounding box, number of parts and points, the first point of
+  each part and then the points as pairs of doubles.
+*/
+struct ShapeRecord {
+  int32_t type;
+  uint32_t numParts, numPoints;
+  const char* box;
+  const char* parts;
+  const char* xy;
+  bool read(const char* shp, uint64_t shpSize, uint64_t offset) {
+    numParts = numPoints = 0;
+    if (offset + 12 > shpSize) return false;
+    const char* p = shp + offset + 8;
+    type = little<int32_t>(p);
+    if (type == 0) return true;  // null shape
+    if (offset + 52 > shpSize) return false;
+    box = p + 4;
+    numParts = little<uint32_t>(p + 36);
+    numPoints = little<uint32_t>(p + 40);
+    parts = p + 44;
+    xy = parts + 4 * uint64_t(numParts);
+    return xy + 16 * uint64_t(numPoints) <= shp + shpSize;
+  }
+  double x(uint32_t i) const { return little<double>(xy + 16 * i); }
+  double y(uint32_t i) const { return little<double>(xy + 16 * i + 8); }
+  uint32_t partStart(uint32_t j) const {
+    return j < numParts ? min(little<uint32_t>(parts + 4 * j), numPoints)
+                        : numPoints;
+  }
+};
+
+}  // namespace
+
+/*
+  Two passes over the records. The first counts segments and the points that
+  survive dropping each polygon's repeated last point. A prefix sum then
+  gives every record its place in the block, and the second pass writes
+  regions, segments and points there directly, with no shared state.
+*/
+BlockMapLoader BlockMapLoader::loadFromESRIParallel(const char filename[],
+                                                    uint32_t numThreads,
+                                                    bool deltaEncoded) {
+  string shpName(filename);
+  string shxName = shpName.substr(0, shpName.find_last_of('.')) + ".shx";
+  MappedFile shp(shpName), shx(shxName);
+  if (shp.getSize() < 100 || shx.getSize() < 100 ||
+      bigEndian32(shp.getData()) != 9994)
+    throw Ex2(Errcode::FILE_READ, filename);
+  if (numThreads == 0) numThreads = max(1u, thread::hardware_concurrency());
+  const uint32_t numRecords = (shx.getSize() - 100) / 8;
+  const char* index = shx.getData() + 100;
+  auto recordOffset = [=](uint32_t i) {
+    return uint64_t(bigEndian32(index + 8 * i)) * 2;  // in 16-bit words
+  };
+
+  // the points of part j, without a last point repeating the first
+  auto part = [](const ShapeRecord& r, uint32_t j, uint32_t& first,
+                 uint32_t& end) {
+    first = r.partStart(j);
+    end = max(first, r.partStart(j + 1));
+    if (end > first + 1 &&
+        approxeqpt(r.x(first), r.y(first), r.x(end - 1), r.y(end - 1)))
+      end--;
+  };
+
+  vector<uint32_t> segStart(numRecords + 1), pointStart(numRecords + 1);
+  atomic<bool> corrupt(false);
+  parallelFor(numRecords, numThreads, 64, [&](uint32_t i) {
+    ShapeRecord r;
+    if (!r.read(shp.getData(), shp.getSize(), recordOffset(i))) {
+      corrupt = true;
+      return;
+    }
+    uint32_t kept = 0;
+    for (uint32_t j = 0, first, end; j < r.numParts; j++) {
+      part(r, j, first, end);
+      kept += end - first;
+    }
+    segStart[i + 1] = r.numParts;
+    pointStart[i + 1] = kept;
+  });
+  if (corrupt) throw Ex2(Errcode::FILE_READ, filename);
+  for (uint32_t i = 0; i < numRecords; i++) {
+    segStart[i + 1] += segStart[i];
+    pointStart[i + 1] += pointStart[i];
+  }
+  const uint32_t numSegments = segStart[numRecords];
+  const uint32_t numPoints = pointStart[numRecords];
+
+  BlockMapLoader bml(sizeof(BlockMapHeader) + numRecords * sizeof(Region) +
+                         numSegments * sizeof(Segment) + numPoints * 8,
+                     version);
+  bml.blockMapHeader = (BlockMapHeader*)bml.getSpecificHeader();
+  memset((void*)bml.blockMapHeader, 0, sizeof(BlockMapHeader));
+  const char* bounds = shp.getData() + 36;  // xMin, yMin, xMax, yMax
+  bml.blockMapHeader->bounds =
+      BoundRect(little<double>(bounds), little<double>(bounds + 16),
+                little<double>(bounds + 8), little<double>(bounds + 24));
+  bml.blockMapHeader->numRegions = numRecords;
+  bml.blockMapHeader->numSegments = numSegments;
+  bml.blockMapHeader->numPoints = numPoints;
+  bml.blockMapHeader->deltaEncoded = deltaEncoded;
+  bml.regionContainers = nullptr;
+  bml.regions = (Region*)((char*)bml.blockMapHeader + sizeof(BlockMapHeader));
+  bml.segments = (Segment*)(bml.regions + numRecords);
+  bml.points = (float*)(bml.segments + numSegments);
+
+  parallelFor(numRecords, numThreads, 64, [&](uint32_t i) {
+    ShapeRecord r;
+    r.read(shp.getData(), shp.getSize(), recordOffset(i));
+    Region& region = bml.regions[i];
+    region.segmentStart = segStart[i];
+    region.startPoints = pointStart[i];
+    if (r.numPoints == 0) {
+      region.bounds = BoundRect(0, 0, 0, 0);
+      region.baseX = region.baseY = 0;
+      return;
+    }
+    region.bounds = BoundRect(little<double>(r.box), little<double>(r.box + 16),
+                              little<double>(r.box + 8),
+                              little<double>(r.box + 24));
+    region.baseX = r.x(0);
+    region.baseY = r.y(0);
+    float* out = bml.points + 2 * uint64_t(pointStart[i]);
+    for (uint32_t j = 0, first, end; j < r.numParts; j++) {
+      part(r, j, first, end);
+      Segment& seg = bml.segments[segStart[i] + j];
+      seg.type = r.type;
+      seg.numPoints = end - first;
+      for (uint32_t k = first; k < end; k++) {
+        *out++ = r.x(k);
+        *out++ = r.y(k);
+      }
+    }
+    if (deltaEncoded)
+      deltaEncodeRun(region.baseX, region.baseY,
+                     bml.points + 2 * uint64_t(pointStart[i]),
+                     pointStart[i + 1] - pointStart[i]);
+  });
+  return bml;
+}
+
 void BlockMapLoader::filterX(double xMin, double xMax) {
 #if 0
   int j = 0;
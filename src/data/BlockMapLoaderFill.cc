@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "data/BlockMapLoader2.hh"
+#include "util/Ex.hh"
+#include "util/ParallelFor.hh"
+using namespace std;
+
+/*
+  Triangles filling the polygons of each region, by ear clipping.
+
+  The rings of a region are its segments. Rings turning the same way as the
+  largest one are outlines, the rest are holes, each belonging to the
+  smallest outline around it. Every hole is joined to its outline by a
+  bridge, two coincident edges cut in from the hole's leftmost point, which
+  leaves a single ring to clip ears from.
+
+  Testing an ear means finding any reflex point inside it, which is O(n)
+  per ear if every point is tried. For big rings the points are also linked
+  in order of their position along a Z curve, so only points whose Z value
+  lies between the corners of the ear's bounding box are tried. The nodes
+  are one array per thread, linked by number rather than pointer, and reused
+  from region to region. When no ear can be found (self-touching or
+  degenerate outlines), duplicate and collinear points are dropped, then
+  small self intersections are cut off, and last the ring is split in two
+  along a diagonal and each half clipped.
+*/
+namespace {
+constexpr uint32_t NONE = ~0u;
+
+// ESRI polygon, polygonZ and polygonM; other segments are lines or points
+bool isPolygon(uint32_t type) { return type == 5 || type == 15 || type == 25; }
+
+// twice the signed area of a ring, positive counterclockwise
+double ringArea(const float* p, uint32_t count) {
+  double area = 0;
+  for (uint32_t k = 0, j = count - 1; k < count; j = k++)
+    area += double(p[2 * j]) * p[2 * k + 1] - double(p[2 * k]) * p[2 * j + 1];
+  return area;
+}
+
+struct Node {
+  double x, y;
+  uint32_t i;                // point number, what the triangles index
+  uint32_t prev, next;       // around the ring
+  uint32_t prevZ, nextZ, z;  // along the Z curve
+};
+
+class Triangulator {
+ private:
+  vector<Node> nodes;
+  vector<uint32_t> order;
+  vector<uint32_t>* out;
+  double minX, minY, invSize;  // maps coordinates to the 15-bit Z grid
+  bool hashed;
+
+  Node& n(uint32_t p) { return nodes[p]; }
+  // twice the signed area of pqr, positive turning left
+  double orient(uint32_t p, uint32_t q, uint32_t r) const {
+    const Node &a = nodes[p], &b = nodes[q], &c = nodes[r];
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  }
+  bool equals(uint32_t p, uint32_t q) const {
+    return nodes[p].x == nodes[q].x && nodes[p].y == nodes[q].y;
+  }
+  // abc counterclockwise, boundary counts as inside
+  static bool inTriangle(double ax, double ay, double bx, double by, double cx,
+                         double cy, double px, double py) {
+    return (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+           (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+           (bx - px) * (cy - py) >= (cx - px) * (by - py);
+  }
+  bool inTriangle(uint32_t a, uint32_t b, uint32_t c, uint32_t p) const {
+    const Node &na = nodes[a], &nb = nodes[b], &nc = nodes[c], &np = nodes[p];
+    return inTriangle(na.x, na.y, nb.x, nb.y, nc.x, nc.y, np.x, np.y);
+  }
+
+  uint32_t insert(double x, double y, uint32_t i, uint32_t last) {
+    const uint32_t p = nodes.size();
+    nodes.push_back(Node{x, y, i, p, p, NONE, NONE, 0});
+    if (last != NONE) {
+      Node& l = nodes[last];
+      nodes[p].next = l.next;
+      nodes[p].prev = last;
+      nodes[l.next].prev = p;
+      l.next = p;
+    }
+    return p;
+  }
+  void remove(uint32_t p) {
+    Node& a = nodes[p];
+    nodes[a.next].prev = a.prev;
+    nodes[a.prev].next = a.next;
+    if (a.prevZ != NONE) nodes[a.prevZ].nextZ = a.nextZ;
+    if (a.nextZ != NONE) nodes[a.nextZ].prevZ = a.prevZ;
+  }
+
+  uint32_t zOrder(double px, double py) const {
+    uint32_t x = uint32_t((px - minX) * invSize);
+    uint32_t y = uint32_t((py - minY) * invSize);
+    x = (x | (x << 8)) & 0x00FF00FF, y = (y | (y << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F, y = (y | (y << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333, y = (y | (y << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555, y = (y | (y << 1)) & 0x55555555;
+    return x | (y << 1);
+  }
+  // link the ring along the Z curve
+  void indexCurve(uint32_t start) {
+    order.clear();
+    uint32_t p = start;
+    do {
+      n(p).z = zOrder(n(p).x, n(p).y);
+      order.push_back(p);
+      p = n(p).next;
+    } while (p != start);
+    sort(order.begin(), order.end(),
+         [&](uint32_t a, uint32_t b) { return nodes[a].z < nodes[b].z; });
+    for (uint32_t k = 0; k < order.size(); k++) {
+      n(order[k]).prevZ = k > 0 ? order[k - 1] : NONE;
+      n(order[k]).nextZ = k + 1 < order.size() ? order[k + 1] : NONE;
+    }
+  }
+
+  // is point p a reflex point inside the ear a, ear, c
+  bool blocks(uint32_t a, uint32_t ear, uint32_t c, uint32_t p) const {
+    return p != a && p != c && !equals(p, a) && inTriangle(a, ear, c, p) &&
+           orient(nodes[p].prev, p, nodes[p].next) <= 0;
+  }
+  bool isEar(uint32_t ear) const {
+    const uint32_t a = nodes[ear].prev, c = nodes[ear].next;
+    if (orient(a, ear, c) <= 0) return false;  // reflex
+    for (uint32_t p = nodes[c].next; p != a; p = nodes[p].next)
+      if (blocks(a, ear, c, p)) return false;
+    return true;
+  }
+  bool isEarHashed(uint32_t ear) const {
+    const uint32_t a = nodes[ear].prev, c = nodes[ear].next;
+    if (orient(a, ear, c) <= 0) return false;
+    const Node &na = nodes[a], &nb = nodes[ear], &nc = nodes[c];
+    const uint32_t minZ = zOrder(min({na.x, nb.x, nc.x}),
+                                 min({na.y, nb.y, nc.y}));
+    const uint32_t maxZ = zOrder(max({na.x, nb.x, nc.x}),
+                                 max({na.y, nb.y, nc.y}));
+    for (uint32_t p = nb.prevZ; p != NONE && nodes[p].z >= minZ;
+         p = nodes[p].prevZ)
+      if (blocks(a, ear, c, p)) return false;
+    for (uint32_t p = nb.nextZ; p != NONE && nodes[p].z <= maxZ;
+         p = nodes[p].nextZ)
+      if (blocks(a, ear, c, p)) return false;
+    return true;
+  }
+
+  void emit(uint32_t a, uint32_t b, uint32_t c) {
+    out->push_back(nodes[a].i);
+    out->push_back(nodes[b].i);
+    out->push_back(nodes[c].i);
+  }
+
+  // drop duplicate and collinear points between start and end
+  uint32_t filter(uint32_t start, uint32_t end = NONE) {
+    if (end == NONE) end = start;
+    uint32_t p = start;
+    bool again;
+    do {
+      again = false;
+      if (equals(p, n(p).next) || orient(n(p).prev, p, n(p).next) == 0) {
+        remove(p);
+        p = end = n(p).prev;
+        if (p == n(p).next) break;
+        again = true;
+      } else {
+        p = n(p).next;
+      }
+    } while (again || p != end);
+    return end;
+  }
+
+  static int sign(double v) { return (v > 0) - (v < 0); }
+  // q on segment pr, given the three are collinear
+  bool onSegment(uint32_t p, uint32_t q, uint32_t r) const {
+    const Node &a = nodes[p], &b = nodes[q], &c = nodes[r];
+    return b.x <= max(a.x, c.x) && b.x >= min(a.x, c.x) &&
+           b.y <= max(a.y, c.y) && b.y >= min(a.y, c.y);
+  }
+  bool intersects(uint32_t p1, uint32_t q1, uint32_t p2, uint32_t q2) const {
+    const int o1 = sign(orient(p1, q1, p2)), o2 = sign(orient(p1, q1, q2));
+    const int o3 = sign(orient(p2, q2, p1)), o4 = sign(orient(p2, q2, q1));
+    return (o1 != o2 && o3 != o4) || (o1 == 0 && onSegment(p1, p2, q1)) ||
+           (o2 == 0 && onSegment(p1, q2, q1)) ||
+           (o3 == 0 && onSegment(p2, p1, q2)) ||
+           (o4 == 0 && onSegment(p2, q1, q2));
+  }
+  bool intersectsRing(uint32_t a, uint32_t b) const {
+    uint32_t p = a;
+    do {
+      const uint32_t q = nodes[p].next;
+      if (nodes[p].i != nodes[a].i && nodes[q].i != nodes[a].i &&
+          nodes[p].i != nodes[b].i && nodes[q].i != nodes[b].i &&
+          intersects(p, q, a, b))
+        return true;
+      p = q;
+    } while (p != a);
+    return false;
+  }
+  // does the diagonal ab leave a into the inside of the ring
+  bool locallyInside(uint32_t a, uint32_t b) const {
+    const uint32_t prev = nodes[a].prev, next = nodes[a].next;
+    return orient(prev, a, next) > 0
+               ? orient(a, b, next) <= 0 && orient(a, prev, b) <= 0
+               : orient(a, b, prev) > 0 || orient(a, next, b) > 0;
+  }
+  bool middleInside(uint32_t a, uint32_t b) const {
+    const double px = (nodes[a].x + nodes[b].x) / 2;
+    const double py = (nodes[a].y + nodes[b].y) / 2;
+    bool inside = false;
+    uint32_t p = a;
+    do {
+      const Node &s = nodes[p], &t = nodes[s.next];
+      if ((s.y > py) != (t.y > py) && t.y != s.y &&
+          px < (t.x - s.x) * (py - s.y) / (t.y - s.y) + s.x)
+        inside = !inside;
+      p = s.next;
+    } while (p != a);
+    return inside;
+  }
+  bool isValidDiagonal(uint32_t a, uint32_t b) const {
+    const Node &na = nodes[a], &nb = nodes[b];
+    if (nodes[na.next].i == nb.i || nodes[na.prev].i == nb.i ||
+        intersectsRing(a, b))
+      return false;
+    if (locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b))
+      return orient(na.prev, a, nb.prev) != 0 || orient(a, nb.prev, b) != 0;
+    return equals(a, b) && orient(na.prev, a, na.next) < 0 &&
+           orient(nb.prev, b, nb.next) < 0;
+  }
+
+  /*
+    Join a and b by two coincident edges, splitting the ring in two (or, if
+    they are on different rings, making them one). Returns the copy of b.
+  */
+  uint32_t split(uint32_t a, uint32_t b) {
+    const uint32_t a2 = nodes.size(), b2 = a2 + 1;
+    nodes.push_back(nodes[a]);
+    nodes.push_back(nodes[b]);
+    const uint32_t an = n(a).next, bp = n(b).prev;
+    n(a).next = b, n(b).prev = a;
+    n(a2).next = an, n(an).prev = a2;
+    n(b2).next = a2, n(a2).prev = b2;
+    n(bp).next = b2, n(b2).prev = bp;
+    // off the Z curve until clip() links the new rings afresh
+    n(a2).prevZ = n(a2).nextZ = n(b2).prevZ = n(b2).nextZ = NONE;
+    return b2;
+  }
+
+  // cut off triangles where the ring crosses itself across one point
+  uint32_t cureIntersections(uint32_t start) {
+    uint32_t p = start;
+    do {
+      const uint32_t a = n(p).prev, b = n(n(p).next).next;
+      if (!equals(a, b) && intersects(a, p, n(p).next, b) &&
+          locallyInside(a, b) && locallyInside(b, a)) {
+        emit(a, p, b);
+        remove(n(p).next);
+        remove(p);
+        p = start = b;
+      }
+      p = n(p).next;
+    } while (p != start);
+    return filter(p);
+  }
+
+  void splitClip(uint32_t start) {
+    uint32_t a = start;
+    do {
+      for (uint32_t b = n(n(a).next).next; b != n(a).prev; b = n(b).next) {
+        if (n(a).i != n(b).i && isValidDiagonal(a, b)) {
+          uint32_t c = split(a, b);
+          a = filter(a, n(a).next);
+          c = filter(c, n(c).next);
+          clip(a, 0);
+          clip(c, 0);
+          return;
+        }
+      }
+      a = n(a).next;
+    } while (a != start);
+  }
+
+  void clip(uint32_t ear, int pass) {
+    if (ear == NONE) return;
+    if (pass == 0 && hashed) indexCurve(ear);
+    uint32_t stop = ear;
+    while (n(ear).prev != n(ear).next) {
+      const uint32_t prev = n(ear).prev, next = n(ear).next;
+      if (hashed ? isEarHashed(ear) : isEar(ear)) {
+        emit(prev, ear, next);
+        remove(ear);
+        // skipping the next point makes fewer slivers
+        ear = stop = n(next).next;
+        continue;
+      }
+      ear = next;
+      if (ear == stop) {  // went all the way around without an ear
+        if (pass == 0)
+          clip(filter(ear), 1);
+        else if (pass == 1)
+          clip(cureIntersections(filter(ear)), 2);
+        else
+          splitClip(ear);
+        return;
+      }
+    }
+  }
+
+  // the bridge from a hole's leftmost point h to a point of the outline
+  uint32_t findBridge(uint32_t h, uint32_t outer) const {
+    const double hx = nodes[h].x, hy = nodes[h].y;
+    double qx = -numeric_limits<double>::infinity();
+    uint32_t m = NONE, p = outer;
+    // nearest edge crossed going left from h, on the inside of the outline
+    do {
+      const Node &s = nodes[p], &t = nodes[s.next];
+      if (hy <= s.y && hy >= t.y && t.y != s.y) {
+        const double x = s.x + (hy - s.y) * (t.x - s.x) / (t.y - s.y);
+        if (x <= hx && x > qx) {
+          qx = x;
+          m = s.x < t.x ? p : s.next;
+          if (x == hx) return m;  // the hole touches the edge
+        }
+      }
+      p = s.next;
+    } while (p != outer);
+    if (m == NONE) return NONE;
+
+    // m is visible from h unless a point is inside triangle h, crossing, m;
+    // then the one of those at the least angle from the ray is
+    const uint32_t stop = m;
+    const double mx = nodes[m].x, my = nodes[m].y;
+    double tanMin = numeric_limits<double>::infinity();
+    p = m;
+    do {
+      const Node& s = nodes[p];
+      if (hx >= s.x && s.x >= mx && hx != s.x &&
+          inTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, s.x,
+                     s.y)) {
+        const double tan = abs(hy - s.y) / (hx - s.x);
+        if (locallyInside(p, h) &&
+            (tan < tanMin ||
+             (tan == tanMin &&
+              (s.x > nodes[m].x ||
+               (s.x == nodes[m].x && sectorContains(m, p)))))) {
+          m = p;
+          tanMin = tan;
+        }
+      }
+      p = s.next;
+    } while (p != stop);
+    return m;
+  }
+  bool sectorContains(uint32_t m, uint32_t p) const {
+    return orient(nodes[m].prev, m, nodes[p].prev) > 0 &&
+           orient(nodes[p].next, m, nodes[m].next) > 0;
+  }
+
+ public:
+  /*
+    Link a ring of n points starting at point first, turning left (an
+    outline) or right (a hole). Returns NONE for a ring with no area.
+  */
+  uint32_t ring(const float* xy, uint32_t first, uint32_t count, bool left) {
+    const float* p = xy + 2 * uint64_t(first);
+    if (count > 1 && p[0] == p[2 * count - 2] && p[1] == p[2 * count - 1])
+      count--;  // the closing point repeats the first
+    if (count < 3) return NONE;
+    uint32_t last = NONE;
+    if (left == (ringArea(p, count) > 0))
+      for (uint32_t k = 0; k < count; k++)
+        last = insert(p[2 * k], p[2 * k + 1], first + k, last);
+    else
+      for (uint32_t k = count; k-- > 0;)
+        last = insert(p[2 * k], p[2 * k + 1], first + k, last);
+    if (equals(last, n(last).next)) {
+      const uint32_t next = n(last).next;
+      remove(last);
+      last = next;
+    }
+    return n(last).next == n(last).prev ? NONE : last;
+  }
+
+  void begin(vector<uint32_t>& triangles) {
+    nodes.clear();
+    out = &triangles;
+  }
+
+  // triangulate an outline and its holes, all made by ring()
+  void triangulate(uint32_t outer, const vector<uint32_t>& holes) {
+    if (outer == NONE) return;
+    vector<uint32_t> leftmost;
+    for (uint32_t h : holes) {
+      if (h == NONE) continue;
+      uint32_t l = h, p = h;
+      do {
+        if (n(p).x < n(l).x || (n(p).x == n(l).x && n(p).y < n(l).y)) l = p;
+        p = n(p).next;
+      } while (p != h);
+      leftmost.push_back(l);
+    }
+    sort(leftmost.begin(), leftmost.end(),
+         [&](uint32_t a, uint32_t b) { return nodes[a].x < nodes[b].x; });
+    for (uint32_t h : leftmost) {
+      const uint32_t bridge = findBridge(h, outer);
+      if (bridge == NONE) continue;
+      const uint32_t back = split(bridge, h);
+      filter(back, n(back).next);
+      outer = filter(bridge, n(bridge).next);
+    }
+
+    uint32_t count = 0, p = outer;
+    minX = minY = numeric_limits<double>::infinity();
+    double maxX = -minX, maxY = -minY;
+    do {
+      minX = min(minX, n(p).x), maxX = max(maxX, n(p).x);
+      minY = min(minY, n(p).y), maxY = max(maxY, n(p).y);
+      count++;
+      p = n(p).next;
+    } while (p != outer);
+    hashed = count > 80;
+    const double size = max(maxX - minX, maxY - minY);
+    invSize = size > 0 ? 32767 / size : 0;
+    clip(outer, 0);
+  }
+};
+
+bool ringContains(const float* p, uint32_t count, float x, float y) {
+  bool inside = false;
+  for (uint32_t k = 0, j = count - 1; k < count; j = k++)
+    if ((p[2 * k + 1] > y) != (p[2 * j + 1] > y) &&
+        x < (p[2 * j] - p[2 * k]) * (y - p[2 * k + 1]) /
+                    (p[2 * j + 1] - p[2 * k + 1]) +
+                p[2 * k])
+      inside = !inside;
+  return inside;
+}
+
+thread_local Triangulator triangulator;
+}  // namespace
+
+void BlockMapLoader::buildFill(uint32_t numThreads) {
+  if (blockMapHeader->deltaEncoded) throw Ex1(Errcode::BAD_ARGUMENT);
+  const uint32_t numRegions = blockMapHeader->numRegions;
+  const uint32_t numSegments = blockMapHeader->numSegments;
+  const float* xy = points;
+  vector<vector<uint32_t>> triangles(numRegions);
+
+  parallelFor(numRegions, numThreads, 16, [&](uint32_t r) {
+    const uint32_t segEnd =
+        r + 1 < numRegions ? regions[r + 1].segmentStart : numSegments;
+    struct Ring {
+      uint32_t first, count;
+      double area;
+      uint32_t outline;  // for a hole, the ring it is in
+    };
+    vector<Ring> rings;
+    uint32_t first = regions[r].startPoints, largest = 0;
+    for (uint32_t s = regions[r].segmentStart; s < segEnd; s++) {
+      const uint32_t count = segments[s].numPoints;
+      if (isPolygon(segments[s].type) && count >= 3) {
+        Ring g{first, count, ringArea(xy + 2 * uint64_t(first), count), NONE};
+        if (abs(g.area) > abs(rings.empty() ? 0 : rings[largest].area))
+          largest = rings.size();
+        rings.push_back(g);
+      }
+      first += count;
+    }
+    if (rings.empty()) return;
+
+    // the smallest outline containing each hole, none if it is in none
+    const bool outlineSign = rings[largest].area > 0;
+    for (Ring& h : rings) {
+      if ((h.area > 0) == outlineSign) continue;
+      const float* p = xy + 2 * uint64_t(h.first);
+      for (uint32_t k = 0; k < rings.size(); k++) {
+        const Ring& g = rings[k];
+        if ((g.area > 0) != outlineSign ||
+            (h.outline != NONE && abs(g.area) >= abs(rings[h.outline].area)))
+          continue;
+        if (ringContains(xy + 2 * uint64_t(g.first), g.count, p[0], p[1]))
+          h.outline = k;
+      }
+    }
+    Triangulator& t = triangulator;
+    t.begin(triangles[r]);
+    vector<uint32_t> holes;
+    for (uint32_t k = 0; k < rings.size(); k++) {
+      if ((rings[k].area > 0) != outlineSign) continue;
+      holes.clear();
+      for (const Ring& h : rings)
+        if (h.outline == k)
+          holes.push_back(t.ring(xy, h.first, h.count, false));
+      t.triangulate(t.ring(xy, rings[k].first, rings[k].count, true), holes);
+    }
+  });
+
+  FillHeader h{};
+  h.magic = FillHeader::MAGIC;
+  h.numRegions = numRegions;
+  vector<uint64_t> start(numRegions + 1);
+  for (uint32_t r = 0; r < numRegions; r++)
+    start[r + 1] = start[r] + triangles[r].size();
+  h.numIndices = start[numRegions];
+  const uint64_t bytes = sizeof(FillHeader) +
+                         (numRegions + 1) * sizeof(uint64_t) +
+                         h.numIndices * sizeof(uint32_t);
+  builtFill.assign((bytes + 7) / 8, 0);
+  memcpy(builtFill.data(), &h, sizeof(h));
+  uint64_t* regionStart = builtFill.data() + sizeof(FillHeader) / 8;
+  memcpy(regionStart, start.data(), start.size() * sizeof(uint64_t));
+  uint32_t* indices = (uint32_t*)(regionStart + numRegions + 1);
+  parallelFor(numRegions, numThreads, 64, [&](uint32_t r) {
+    memcpy(indices + start[r], triangles[r].data(),
+           triangles[r].size() * sizeof(uint32_t));
+  });
+  attachFill(builtFill.data(), builtFill.size() * 8);
+}
+
+void BlockMapLoader::attachFill(const uint64_t* p, uint64_t bytes) {
+  fill = nullptr;
+  const FillHeader* h = (const FillHeader*)p;
+  const uint32_t numRegions = blockMapHeader->numRegions;
+  if (bytes < sizeof(FillHeader) || h->magic != FillHeader::MAGIC ||
+      h->numRegions != numRegions ||
+      bytes < sizeof(FillHeader) + (numRegions + 1) * sizeof(uint64_t) +
+                  h->numIndices * sizeof(uint32_t)) {
+    std::cerr << "BlockMapLoader: ignoring invalid fill section\n";
+    return;
+  }
+  fillStart = (const uint64_t*)(h + 1);
+  fillIndices = (const uint32_t*)(fillStart + numRegions + 1);
+  if (fillStart[0] != 0 || fillStart[numRegions] != h->numIndices) return;
+  for (uint32_t r = 0; r < numRegions; r++)
+    if (fillStart[r + 1] < fillStart[r] || fillStart[r + 1] % 3 != 0) return;
+  for (uint64_t i = 0; i < h->numIndices; i++)
+    if (fillIndices[i] >= blockMapHeader->numPoints) return;
+  fill = h;
+}
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "data/BlockMapLoader2.hh"
+#include "util/Ex.hh"
+using namespace std;
+
+/*
+  Level of detail for maps. Simplifying each polygon on its own would open
+  gaps between neighbors, because a border shared by two counties would be
+  simplified twice and come out differently. Instead:
+
+  1. Every point gets a signature summing a hash of each segment using it.
+     A point whose signature differs from a neighbor's is where a shared
+     border begins or ends, and it is locked: it appears at every level.
+  2. Between locked points, each run (arc) is the same points in every
+     segment sharing it, perhaps backwards. Douglas-Peucker runs on the arc
+     from its lexicographically smaller end, so both sides get the same
+     answer.
+  3. Douglas-Peucker records for each point the largest tolerance at which
+     it is kept, so all levels come from one pass and are nested.
+*/
+namespace {
+uint64_t pointKey(const float* p) {
+  uint64_t k;
+  memcpy(&k, p, sizeof(k));
+  return k;
+}
+
+uint64_t mix(uint64_t x) {  // splitmix64 finalizer
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+bool lessXY(const float* a, const float* b) {
+  return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+}
+
+// squared distance from p to the line segment ab
+float distSq(const float* p, const float* a, const float* b) {
+  float dx = b[0] - a[0], dy = b[1] - a[1];
+  float px = p[0] - a[0], py = p[1] - a[1];
+  float len2 = dx * dx + dy * dy;
+  float t = len2 > 0 ? std::clamp((px * dx + py * dy) / len2, 0.0f, 1.0f) : 0;
+  px -= t * dx, py -= t * dy;
+  return px * px + py * py;
+}
+
+/*
+  Douglas-Peucker over xy[arc[0]], ..., xy[arc.back()], with both ends
+  already kept. A point is kept at any tolerance below its importance.
+*/
+void simplifyArc(const float* xy, const vector<uint32_t>& arc,
+                 vector<float>& importance) {
+  struct Span {
+    uint32_t lo, hi;
+    float limit;  // a point can't outlast the point that split its span
+  };
+  vector<Span> stack{{0, uint32_t(arc.size() - 1),
+                      numeric_limits<float>::infinity()}};
+  while (!stack.empty()) {
+    Span s = stack.back();
+    stack.pop_back();
+    if (s.hi - s.lo < 2) continue;
+    const float* a = xy + 2 * arc[s.lo];
+    const float* b = xy + 2 * arc[s.hi];
+    float worst = -1;
+    uint32_t split = s.lo + 1;
+    for (uint32_t i = s.lo + 1; i < s.hi; i++) {
+      float d = distSq(xy + 2 * arc[i], a, b);
+      if (d > worst) worst = d, split = i;
+    }
+    float imp = std::min(std::sqrt(worst), s.limit);
+    importance[arc[split]] = imp;
+    stack.push_back({s.lo, split, imp});
+    stack.push_back({split, s.hi, imp});
+  }
+}
+}  // namespace
+
+void BlockMapLoader::buildLOD(uint32_t numLevels, float ratio) {
+  if (numLevels > LODHeader::MAX_LEVELS || ratio <= 1 ||
+      blockMapHeader->deltaEncoded)
+    throw Ex1(Errcode::BAD_ARGUMENT);
+  const uint32_t numSegments = blockMapHeader->numSegments;
+  const uint32_t numPoints = blockMapHeader->numPoints;
+  const float* xy = points;
+  vector<uint32_t> segStart(numSegments + 1);
+  for (uint32_t i = 0; i < numSegments; i++)
+    segStart[i + 1] = segStart[i] + segments[i].numPoints;
+
+  unordered_map<uint64_t, uint64_t> signatures(numPoints);
+  for (uint32_t s = 0; s < numSegments; s++)
+    for (uint32_t i = segStart[s]; i < segStart[s + 1]; i++)
+      signatures[pointKey(xy + 2 * i)] += mix(s);
+
+  constexpr float locked = numeric_limits<float>::infinity();
+  vector<float> importance(numPoints, 0);
+  vector<uint64_t> sig;
+  vector<uint32_t> locks, arc;
+  for (uint32_t s = 0; s < numSegments; s++) {
+    const uint32_t start = segStart[s], n = segments[s].numPoints;
+    if (n <= 3) {  // nothing to remove from a triangle
+      std::fill_n(importance.begin() + start, n, locked);
+      continue;
+    }
+    sig.resize(n);
+    for (uint32_t i = 0; i < n; i++)
+      sig[i] = signatures[pointKey(xy + 2 * (start + i))];
+    locks.clear();
+    for (uint32_t i = 0; i < n; i++)
+      if (sig[i] != sig[(i + n - 1) % n] || sig[i] != sig[(i + 1) % n])
+        locks.push_back(i);
+    if (locks.size() < 2) {
+      // a ring shared whole, or not at all: anchor at the smallest point
+      // and the one farthest from it, which any sharer would also choose
+      uint32_t first = 0, far = 0;
+      for (uint32_t i = 1; i < n; i++)
+        if (lessXY(xy + 2 * (start + i), xy + 2 * (start + first))) first = i;
+      float farthest = -1;
+      for (uint32_t i = 0; i < n; i++) {
+        const float* p = xy + 2 * (start + i);
+        const float* f = xy + 2 * (start + first);
+        float d = (p[0] - f[0]) * (p[0] - f[0]) + (p[1] - f[1]) * (p[1] - f[1]);
+        if (d > farthest) farthest = d, far = i;
+      }
+      locks = {std::min(first, far), std::max(first, far)};
+    }
+    for (uint32_t i : locks) importance[start + i] = locked;
+    for (uint32_t k = 0; k < locks.size(); k++) {
+      uint32_t from = locks[k], to = locks[(k + 1) % locks.size()];
+      if (to <= from) to += n;  // the arc wrapping past the end of the ring
+      arc.clear();
+      for (uint32_t i = from; i <= to; i++) arc.push_back(start + i % n);
+      if (lessXY(xy + 2 * arc.back(), xy + 2 * arc.front()))
+        std::reverse(arc.begin(), arc.end());
+      simplifyArc(xy, arc, importance);
+    }
+  }
+
+  // tolerances start at 1/8192 of the map, about a pixel on a big screen
+  const BoundRect& b = blockMapHeader->bounds;
+  float tolerance = std::max(b.xMax - b.xMin, b.yMax - b.yMin) / 8192;
+  LODHeader h{};
+  h.magic = LODHeader::MAGIC;
+  h.numLevels = numLevels;
+  uint64_t bytes = sizeof(LODHeader);
+  for (uint32_t level = 0; level < numLevels; level++, tolerance *= ratio) {
+    h.levels[level].tolerance = tolerance;
+    h.levels[level].numPoints =
+        std::count_if(importance.begin(), importance.end(),
+                      [=](float imp) { return imp > tolerance; });
+    bytes += getLODLevelBytes(numSegments, h.levels[level].numPoints);
+  }
+  builtLOD.assign(bytes / 8, 0);
+  memcpy(builtLOD.data(), &h, sizeof(h));
+  char* level = (char*)builtLOD.data() + sizeof(LODHeader);
+  for (uint32_t i = 0; i < numLevels; i++) {
+    Segment* segs = (Segment*)level;
+    float* out = (float*)(segs + numSegments);
+    const float tol = h.levels[i].tolerance;
+    for (uint32_t s = 0; s < numSegments; s++) {
+      uint32_t kept = 0;
+      for (uint32_t j = segStart[s]; j < segStart[s + 1]; j++)
+        if (importance[j] > tol) {
+          *out++ = xy[2 * j];
+          *out++ = xy[2 * j + 1];
+          kept++;
+        }
+      segs[s].numPoints = kept;
+      segs[s].type = segments[s].type;
+    }
+    level += getLODLevelBytes(numSegments, h.levels[i].numPoints);
+  }
+  attachLOD(builtLOD.data(), bytes);
+}
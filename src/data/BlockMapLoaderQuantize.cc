@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "data/BlockMapLoader2.hh"
+#include "util/Ex.hh"
+using namespace std;
+
+/*
+  Quantized points: see PackedPointsHeader. A block of 128 values with width
+  w is 4w words, lane k of word i at words[4 * i + k], so lane k's value p
+  starts at bit p * w of its own stream. Every lane has the same bit offset
+  for the same p, which is what lets SSE2 unpack four values per shift.
+*/
+namespace {
+constexpr uint32_t BLOCK = BlockMapLoader::PackedPointsHeader::BLOCK;
+
+uint64_t align8(uint64_t bytes) { return (bytes + 7) & ~uint64_t(7); }
+
+uint32_t zigzag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+
+void packBlock(const uint32_t* values, uint32_t width, uint32_t* words) {
+  std::fill_n(words, 4 * width, 0);
+  for (uint32_t j = 0; j < BLOCK; j++) {
+    const uint32_t k = j % 4, bit = j / 4 * width, i = bit / 32, s = bit % 32;
+    words[4 * i + k] |= values[j] << s;
+    if (s + width > 32) words[4 * (i + 1) + k] |= values[j] >> (32 - s);
+  }
+}
+
+void unpackBlock(const uint32_t* words, uint32_t width, uint32_t* values) {
+  if (width == 0) {
+    std::fill_n(values, BLOCK, 0);
+    return;
+  }
+  const uint32_t mask = width == 32 ? ~0U : (1U << width) - 1;
+#ifdef __SSE2__
+  const __m128i m = _mm_set1_epi32(mask);
+  for (uint32_t p = 0; p < BLOCK / 4; p++) {
+    const uint32_t bit = p * width, i = bit / 32, s = bit % 32;
+    __m128i v = _mm_srl_epi32(_mm_loadu_si128((const __m128i*)(words + 4 * i)),
+                              _mm_cvtsi32_si128(s));
+    if (s + width > 32)
+      v = _mm_or_si128(
+          v, _mm_sll_epi32(
+                 _mm_loadu_si128((const __m128i*)(words + 4 * (i + 1))),
+                 _mm_cvtsi32_si128(32 - s)));
+    _mm_store_si128((__m128i*)(values + 4 * p), _mm_and_si128(v, m));
+  }
+#else
+  for (uint32_t j = 0; j < BLOCK; j++) {
+    const uint32_t k = j % 4, bit = j / 4 * width, i = bit / 32, s = bit % 32;
+    uint64_t v = words[4 * i + k] >> s;
+    if (s + width > 32) v |= uint64_t(words[4 * (i + 1) + k]) << (32 - s);
+    values[j] = v & mask;
+  }
+#endif
+}
+
+/*
+  Undo zigzag and delta for count values (count is even, x,y alternating),
+  carrying the running sums, and write base + q * quantum as floats.
+*/
+void undelta(const uint32_t* values, uint32_t count, int32_t& sumX,
+             int32_t& sumY, double baseX, double baseY, double quantum,
+             float* xy) {
+  uint32_t i = 0;
+#ifdef __SSE2__
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128d base = _mm_set_pd(baseY, baseX), q = _mm_set1_pd(quantum);
+  __m128i carry = _mm_set_epi32(sumY, sumX, sumY, sumX);
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_load_si128((const __m128i*)(values + i));
+    __m128i sign = _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one));
+    v = _mm_xor_si128(_mm_srli_epi32(v, 1), sign);
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));  // x0+x1, y0+y1 in 2,3
+    v = _mm_add_epi32(v, carry);
+    carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 2, 3, 2));
+    __m128d lo = _mm_add_pd(base, _mm_mul_pd(_mm_cvtepi32_pd(v), q));
+    __m128d hi = _mm_add_pd(
+        base, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)), q));
+    _mm_storeu_ps(xy + i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+  }
+  sumX = _mm_cvtsi128_si32(carry);
+  sumY = _mm_cvtsi128_si32(_mm_srli_si128(carry, 4));
+#endif
+  for (; i < count; i += 2) {
+    sumX += int32_t(values[i] >> 1) ^ -int32_t(values[i] & 1);
+    sumY += int32_t(values[i + 1] >> 1) ^ -int32_t(values[i + 1] & 1);
+    xy[i] = baseX + sumX * quantum;
+    xy[i + 1] = baseY + sumY * quantum;
+  }
+}
+}  // namespace
+
+uint64_t BlockMapLoader::getPackedPointsBytes() const {
+  return (char*)(packedWords + packedPoints->numWords) - (char*)packedPoints;
+}
+
+void BlockMapLoader::attachPackedPoints(const uint64_t* p, uint64_t bytes) {
+  packedPoints = nullptr;
+  const PackedPointsHeader* h = (const PackedPointsHeader*)p;
+  const uint32_t numSegments = blockMapHeader->numSegments;
+  if (bytes < sizeof(PackedPointsHeader) ||
+      h->magic != PackedPointsHeader::MAGIC || !(h->quantum > 0))
+    return;
+  const uint64_t tableBytes = align8(4 * (uint64_t(numSegments) + 1)) +
+                              align8(h->numBlocks) + 4 * h->numWords;
+  if (bytes - sizeof(PackedPointsHeader) < tableBytes) return;
+  packedSegmentWord = (const uint32_t*)(h + 1);
+  packedWidths = (const uint8_t*)h + sizeof(PackedPointsHeader) +
+                 align8(4 * (uint64_t(numSegments) + 1));
+  packedWords = (const uint32_t*)(packedWidths + align8(h->numBlocks));
+
+  // every block must lie inside the words
+  uint64_t block = 0, word = 0;
+  for (uint32_t s = 0; s < numSegments; s++) {
+    if (packedSegmentWord[s] != word) return;
+    uint64_t end = block + (2 * segments[s].numPoints + BLOCK - 1) / BLOCK;
+    if (end > h->numBlocks) return;
+    for (; block < end; block++) {
+      if (packedWidths[block] > 32) return;
+      word += 4 * packedWidths[block];
+    }
+  }
+  if (block != h->numBlocks || word != h->numWords ||
+      packedSegmentWord[numSegments] != word)
+    return;
+  packedPoints = h;
+}
+
+void BlockMapLoader::quantize(double quantum) {
+  if (!(quantum > 0) || blockMapHeader->deltaEncoded)
+    throw Ex1(Errcode::BAD_ARGUMENT);
+  const uint32_t numSegments = blockMapHeader->numSegments;
+  const uint32_t numRegions = blockMapHeader->numRegions;
+  vector<uint32_t> segmentWord(numSegments + 1), words, values;
+  vector<uint8_t> widths;
+  const float* xy = points;
+  for (uint32_t s = 0, r = 0; s < numSegments; s++) {
+    while (r + 1 < numRegions && regions[r + 1].segmentStart <= s) r++;
+    const double baseX = numRegions > 0 ? regions[r].baseX : 0;
+    const double baseY = numRegions > 0 ? regions[r].baseY : 0;
+    const uint32_t n = segments[s].numPoints;
+    values.assign((2 * n + BLOCK - 1) / BLOCK * BLOCK, 0);
+    int64_t lastX = 0, lastY = 0;
+    for (uint32_t i = 0; i < n; i++, xy += 2) {
+      const int64_t qx = llround((xy[0] - baseX) / quantum);
+      const int64_t qy = llround((xy[1] - baseY) / quantum);
+      const int64_t dx = qx - lastX, dy = qy - lastY;
+      if (qx != int32_t(qx) || qy != int32_t(qy) || dx != int32_t(dx) ||
+          dy != int32_t(dy))
+        throw Ex1(Errcode::BAD_ARGUMENT);  // quantum too small for this map
+      values[2 * i] = zigzag(dx);
+      values[2 * i + 1] = zigzag(dy);
+      lastX = qx, lastY = qy;
+    }
+    segmentWord[s] = words.size();
+    for (uint32_t b = 0; b < values.size(); b += BLOCK) {
+      uint32_t all = 0;
+      for (uint32_t j = b; j < b + BLOCK; j++) all |= values[j];
+      const uint32_t width = std::bit_width(all);
+      widths.push_back(width);
+      words.resize(words.size() + 4 * width);
+      packBlock(&values[b], width, words.data() + words.size() - 4 * width);
+    }
+  }
+  segmentWord[numSegments] = words.size();
+
+  PackedPointsHeader h{};
+  h.magic = PackedPointsHeader::MAGIC;
+  h.numBlocks = widths.size();
+  h.quantum = quantum;
+  h.numWords = words.size();
+  const uint64_t tableBytes = align8(4 * segmentWord.size());
+  const uint64_t bytes = sizeof(h) + tableBytes + align8(widths.size()) +
+                         4 * words.size();
+  builtPackedPoints.assign(align8(bytes) / 8, 0);
+  char* p = (char*)builtPackedPoints.data();
+  memcpy(p, &h, sizeof(h));
+  memcpy(p + sizeof(h), segmentWord.data(), 4 * segmentWord.size());
+  memcpy(p + sizeof(h) + tableBytes, widths.data(), widths.size());
+  memcpy(p + sizeof(h) + tableBytes + align8(widths.size()), words.data(),
+         4 * words.size());
+  attachPackedPoints(builtPackedPoints.data(), bytes);
+  decodePoints(points);  // what a load of the saved file will see
+}
+
+void BlockMapLoader::decodePoints(float* xy) const {
+  const uint32_t numSegments = blockMapHeader->numSegments;
+  const uint32_t numRegions = blockMapHeader->numRegions;
+  const double quantum = packedPoints->quantum;
+  alignas(16) uint32_t values[BLOCK];
+  const uint8_t* width = packedWidths;
+  for (uint32_t s = 0, r = 0; s < numSegments; s++) {
+    while (r + 1 < numRegions && regions[r + 1].segmentStart <= s) r++;
+    const double baseX = numRegions > 0 ? regions[r].baseX : 0;
+    const double baseY = numRegions > 0 ? regions[r].baseY : 0;
+    const uint32_t* words = packedWords + packedSegmentWord[s];
+    int32_t sumX = 0, sumY = 0;
+    const uint32_t numValues = 2 * segments[s].numPoints;
+    for (uint32_t done = 0; done < numValues; done += BLOCK, width++) {
+      unpackBlock(words, *width, values);
+      words += 4 * *width;
+      undelta(values, std::min(BLOCK, numValues - done), sumX, sumY, baseX,
+              baseY, quantum, xy);
+      xy += std::min(BLOCK, numValues - done);
+    }
+  }
+}
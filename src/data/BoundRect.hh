@@ -18,18 +18,16 @@ class BoundRect {
   }
 
   // returns true if a is completely contained within this BoundRect
-  bool contains(const BoundRect& a) {
+  bool contains(const BoundRect& a) const {
     return a.xMin >= xMin && a.xMin <= xMax && a.yMin >= yMin &&
            a.yMin <= yMax && a.xMax >= xMin && a.xMax <= xMax &&
            a.yMax >= yMin && a.yMax <= yMax;
   }
 
   // returns true if any part of a is within this BoundRect
-  bool intersects(const BoundRect& a) {
-    return (a.xMin >= xMin && a.xMin <= xMax ||
-            a.xMax >= xMin && a.xMax <= xMax) &&
-           (a.yMin >= yMin && a.yMin <= yMax ||
-            a.yMax >= yMin && a.yMax <= yMax);
+  bool intersects(const BoundRect& a) const {
+    return a.xMin <= xMax && a.xMax >= xMin && a.yMin <= yMax &&
+           a.yMax >= yMin;
   }
   friend std::ostream& operator<<(std::ostream& s, const BoundRect& b) {
     return s << '[' << b.xMin << ',' << b.xMax << " | " << b.yMin << ','
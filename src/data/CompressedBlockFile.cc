@@ -0,0 +1,260 @@
+#include "data/CompressedBlockFile.hh"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#ifdef GRAIL_ZSTD
+#include <zstd.h>
+#endif
+#ifdef GRAIL_LZMA
+#include <lzma.h>
+#endif
+
+#include "util/Ex.hh"
+#include "util/ParallelFor.hh"
+#include "util/PlatFlags.hh"
+using namespace std;
+
+namespace {
+using Codec = CompressedBlockFile::Codec;
+using Header = CompressedBlockFile::Header;
+
+// read the whole file in 8-byte words, so the header and index are aligned
+vector<uint64_t> readFile(const char filename[], uint64_t& size) {
+  int fh = open(filename, O_RDONLY | O_BINARY);
+  if (fh < 0) throw Ex2(Errcode::FILE_NOT_FOUND, filename);
+  struct stat s;
+  fstat(fh, &s);
+  size = s.st_size;
+  vector<uint64_t> words((size + 7) / 8);
+  char* p = (char*)words.data();
+  for (uint64_t done = 0; done < size;) {
+    int64_t n = read(fh, p + done, size - done);
+    if (n <= 0) {
+      close(fh);
+      throw Ex2(Errcode::FILE_READ, filename);
+    }
+    done += n;
+  }
+  close(fh);
+  return words;
+}
+
+void writeAll(int fh, const void* p, uint64_t bytes, const char filename[]) {
+  for (uint64_t done = 0; done < bytes;) {
+    int64_t n = write(fh, (const char*)p + done, bytes - done);
+    if (n <= 0) {
+      close(fh);
+      throw Ex2(Errcode::FILE_WRITE, filename);
+    }
+    done += n;
+  }
+}
+
+vector<char> compressChunk(Codec codec, [[maybe_unused]] int level,
+                           [[maybe_unused]] const char* in,
+                           [[maybe_unused]] uint64_t len) {
+  vector<char> out;
+  switch (codec) {
+#ifdef GRAIL_ZSTD
+    case Codec::zstd: {
+      out.resize(ZSTD_compressBound(len));
+      size_t n = ZSTD_compress(out.data(), out.size(), in, len,
+                               level < 0 ? 3 : level);
+      if (ZSTD_isError(n))
+        throw Ex2(Errcode::OUTOF_MEMORY, ZSTD_getErrorName(n));
+      out.resize(n);
+      return out;
+    }
+#endif
+#ifdef GRAIL_LZMA
+    case Codec::lzma: {
+      out.resize(lzma_stream_buffer_bound(len));
+      size_t n = 0;
+      if (lzma_easy_buffer_encode(level < 0 ? 6 : level, LZMA_CHECK_CRC32,
+                                  nullptr, (const uint8_t*)in, len,
+                                  (uint8_t*)out.data(), &n,
+                                  out.size()) != LZMA_OK)
+        throw Ex1(Errcode::OUTOF_MEMORY);
+      out.resize(n);
+      return out;
+    }
+#endif
+    default:
+      throw Ex1(Errcode::UNIMPLEMENTED);
+  }
+}
+
+// out must come back exactly outLen bytes, or the chunk is corrupt
+void decompressChunk(Codec codec, [[maybe_unused]] const char* in,
+                     [[maybe_unused]] uint64_t len, [[maybe_unused]] char* out,
+                     [[maybe_unused]] uint64_t outLen) {
+  switch (codec) {
+#ifdef GRAIL_ZSTD
+    case Codec::zstd: {
+      size_t n = ZSTD_decompress(out, outLen, in, len);
+      if (ZSTD_isError(n) || n != outLen)
+        throw Ex1(Errcode::COMPRESSED_CORRUPT);
+      return;
+    }
+#endif
+#ifdef GRAIL_LZMA
+    case Codec::lzma: {
+      uint64_t memLimit = UINT64_MAX;
+      size_t inPos = 0, outPos = 0;
+      if (lzma_stream_buffer_decode(&memLimit, 0, nullptr, (const uint8_t*)in,
+                                    &inPos, len, (uint8_t*)out, &outPos,
+                                    outLen) != LZMA_OK ||
+          outPos != outLen)
+        throw Ex1(Errcode::COMPRESSED_CORRUPT);
+      return;
+    }
+#endif
+    default:
+      throw Ex1(Errcode::UNIMPLEMENTED);
+  }
+}
+}  // namespace
+
+bool CompressedBlockFile::supports(Codec codec) {
+  switch (codec) {
+#ifdef GRAIL_ZSTD
+    case Codec::zstd:
+      return true;
+#endif
+#ifdef GRAIL_LZMA
+    case Codec::lzma:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+bool CompressedBlockFile::isCompressed(const char filename[]) {
+  int fh = open(filename, O_RDONLY | O_BINARY);
+  if (fh < 0) return false;
+  uint32_t magic = 0;
+  bool compressed = read(fh, &magic, sizeof(magic)) == sizeof(magic) &&
+                    magic == Header::MAGIC;
+  close(fh);
+  return compressed;
+}
+
+void CompressedBlockFile::compress(const char inFile[], const char outFile[],
+                                   Codec codec, uint32_t chunkSize, int level,
+                                   uint32_t numThreads) {
+  if (chunkSize == 0 || !supports(codec)) throw Ex1(Errcode::BAD_ARGUMENT);
+  uint64_t size;
+  vector<uint64_t> in = readFile(inFile, size);
+  const uint64_t numChunks = (size + chunkSize - 1) / chunkSize;
+  if (numChunks > UINT32_MAX) throw Ex2(Errcode::ILLEGAL_SIZE, inFile);
+
+  vector<vector<char>> chunks(numChunks);
+  atomic<bool> failed(false);
+  parallelFor(numChunks, numThreads, 1, [&](uint32_t i) {
+    const uint64_t start = uint64_t(i) * chunkSize;
+    try {
+      chunks[i] = compressChunk(codec, level, (const char*)in.data() + start,
+                                min<uint64_t>(chunkSize, size - start));
+    } catch (const Ex&) {
+      failed = true;
+    }
+  });
+  if (failed) throw Ex2(Errcode::OUTOF_MEMORY, inFile);
+
+  Header h{};
+  h.magic = Header::MAGIC;
+  h.codec = uint16_t(codec);
+  h.version = Header::VERSION;
+  h.size = size;
+  h.chunkSize = chunkSize;
+  h.numChunks = numChunks;
+  vector<uint64_t> chunkOffset(numChunks + 1);
+  chunkOffset[0] = sizeof(Header) + sizeof(uint64_t) * (numChunks + 1);
+  for (uint32_t i = 0; i < numChunks; i++)
+    chunkOffset[i + 1] = chunkOffset[i] + chunks[i].size();
+
+  int fh = open(outFile, O_WRONLY | O_TRUNC | O_CREAT | O_BINARY, 0644);
+  if (fh < 0) throw Ex2(Errcode::FILE_NOT_FOUND, outFile);
+  writeAll(fh, &h, sizeof(h), outFile);
+  writeAll(fh, chunkOffset.data(), sizeof(uint64_t) * chunkOffset.size(),
+           outFile);
+  for (const vector<char>& c : chunks)
+    writeAll(fh, c.data(), c.size(), outFile);
+  close(fh);
+}
+
+CompressedBlockFile::CompressedBlockFile(const char filename[])
+    : mem(nullptr), numLoaded(0) {
+  uint64_t bytes;
+  file = readFile(filename, bytes);
+  header = (const Header*)file.data();
+  chunkOffset = (const uint64_t*)(header + 1);
+  if (bytes < sizeof(Header) || header->magic != Header::MAGIC ||
+      header->version != Header::VERSION || header->chunkSize == 0 ||
+      header->numChunks != (header->size + header->chunkSize - 1) /
+                               header->chunkSize ||
+      (bytes - sizeof(Header)) / sizeof(uint64_t) <= header->numChunks)
+    throw Ex2(Errcode::COMPRESSED_CORRUPT, filename);
+  if (!supports(Codec(header->codec)))
+    throw Ex2(Errcode::UNIMPLEMENTED, filename);
+  // every chunk must lie inside the file, after the index
+  if (chunkOffset[0] != sizeof(Header) + 8 * (header->numChunks + 1) ||
+      chunkOffset[header->numChunks] != bytes)
+    throw Ex2(Errcode::COMPRESSED_CORRUPT, filename);
+  for (uint32_t i = 0; i < header->numChunks; i++)
+    if (chunkOffset[i + 1] < chunkOffset[i])
+      throw Ex2(Errcode::COMPRESSED_CORRUPT, filename);
+
+  // pages are only touched as chunks land in them
+  mem = new uint64_t[(header->size + 7) / 8];
+  loaded = make_unique<once_flag[]>(header->numChunks);
+}
+
+/*
+  call_once lets several threads ask for the same chunk: one decompresses,
+  the rest wait for it. If decompressing throws, the chunk stays unloaded.
+*/
+void CompressedBlockFile::loadChunk(uint32_t i) {
+  call_once(loaded[i], [&]() {
+    const uint64_t start = uint64_t(i) * header->chunkSize;
+    decompressChunk(Codec(header->codec),
+                    (const char*)file.data() + chunkOffset[i],
+                    chunkOffset[i + 1] - chunkOffset[i], (char*)mem + start,
+                    min<uint64_t>(header->chunkSize, header->size - start));
+    numLoaded++;
+  });
+}
+
+const char* CompressedBlockFile::load(uint64_t offset, uint64_t len) {
+  if (offset > header->size || len > header->size - offset)
+    throw Ex1(Errcode::BAD_ARGUMENT);
+  if (len > 0)
+    for (uint64_t i = offset / header->chunkSize;
+         i <= (offset + len - 1) / header->chunkSize; i++)
+      loadChunk(i);
+  return (const char*)mem;
+}
+
+void CompressedBlockFile::loadAll(uint32_t numThreads) {
+  atomic<bool> corrupt(false);
+  parallelFor(header->numChunks, numThreads, 1, [&](uint32_t i) {
+    try {
+      loadChunk(i);
+    } catch (const Ex&) {
+      corrupt = true;
+    }
+  });
+  if (corrupt) throw Ex1(Errcode::COMPRESSED_CORRUPT);
+}
+
+uint64_t* CompressedBlockFile::release() {
+  loadAll();
+  uint64_t* m = mem;
+  mem = nullptr;
+  return m;
+}
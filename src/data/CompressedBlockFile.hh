@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+  A BlockLoader file compressed so that any part of it can be read without
+  decompressing what comes before. The file is cut into chunks of chunkSize
+  bytes and each is compressed on its own, with zstd for load speed or LZMA
+  for size:
+
+    Header | uint64_t chunkOffset[numChunks + 1] | chunk 0 | chunk 1 | ...
+
+  chunkOffset[i] is where compressed chunk i starts in the file and
+  chunkOffset[numChunks] is the end of the file. Chunks decompress in
+  parallel with loadAll(), or one at a time on first touch with load().
+*/
+class CompressedBlockFile {
+ public:
+  enum class Codec : uint16_t { zstd = 1, lzma = 2 };
+  struct Header {
+    static constexpr uint32_t MAGIC = 0x7A4C4221;  // !BLz
+    static constexpr uint16_t VERSION = 1;
+    uint32_t magic;
+    uint16_t codec;
+    uint16_t version;
+    uint64_t size;       // bytes uncompressed
+    uint32_t chunkSize;  // bytes uncompressed per chunk, except the last
+    uint32_t numChunks;
+  };
+
+ private:
+  std::vector<uint64_t> file;  // the compressed file
+  const Header* header;
+  const uint64_t* chunkOffset;
+  uint64_t* mem;  // uncompressed, filled in as chunks load
+  std::unique_ptr<std::once_flag[]> loaded;
+  std::atomic<uint32_t> numLoaded;
+  void loadChunk(uint32_t i);
+
+ public:
+  // whether this build can read and write codec
+  static bool supports(Codec codec);
+  static bool isCompressed(const char filename[]);
+  /*
+    Compress inFile into outFile on numThreads threads (0 for one per core).
+    level < 0 is the codec's default: 3 for zstd, 6 for LZMA.
+  */
+  static void compress(const char inFile[], const char outFile[], Codec codec,
+                       uint32_t chunkSize = 1 << 20, int level = -1,
+                       uint32_t numThreads = 0);
+
+  CompressedBlockFile(const char filename[]);
+  ~CompressedBlockFile() { delete[] mem; }
+  CompressedBlockFile(const CompressedBlockFile& orig) = delete;
+  CompressedBlockFile& operator=(const CompressedBlockFile& orig) = delete;
+
+  const Header* getHeader() const { return header; }
+  uint64_t getSize() const { return header->size; }
+  uint32_t getNumLoadedChunks() const { return numLoaded; }
+
+  /*
+    Decompress the chunks holding [offset, offset + len) that have not been
+    already and return the uncompressed file. Safe to call from any thread.
+  */
+  const char* load(uint64_t offset, uint64_t len);
+  // decompress every chunk not yet loaded, on numThreads threads
+  void loadAll(uint32_t numThreads = 0);
+  /*
+    Load everything and hand the uncompressed file, allocated with new[], to
+    the caller. Used by BlockLoader to take over the memory without a copy.
+  */
+  uint64_t* release();
+};
@@ -1,33 +1,56 @@
+/*
+  Dataset represents one variable for all countries over a range of years.
+  The values are stored twice so that either slice is contiguous:
+
+    year-major:    data[yearMajor + (year - startYear) * numCountries + c]
+    country-major: data[countryMajor + c * numYears() + year - startYear]
+
+  Years a country has no value for are NaN.
+*/
 class Dataset {
  public:
-  char name[128];  // name of the data set (variable)
-  // this might be useful summary data, not required
-  uint32_t startYear;  // OPTIONAL starting year (earliest) for this dataset for
-                       // ALL countries
-  uint32_t completeStartYear;  // the latest start year in the database
-  uint32_t endYear;  // OPTIONAL end year (latest) for this dataset, ANY country
-  uint32_t startIndex;  // start index within data
-  uint32_t endIndex;    // end index within data (this variable between
-                        // startIndex,endIndex
-  uint32_t unused;
-  struct Country {        // Dataset::Country
-    uint32_t startIndex;  // start of the country's data within data
-    uint32_t startYear;  // year corresponding to first datapoint. TODO: ASSUMED
-                         // sequential
-  };
-  Country countries[249];
-  Dataset(uint32_t numCountries, const std::string& name) {
-    startYear = endYear = startIndex = endIndex = 0;
-    strcpy(this->name, name.c_str());
+  char name[128];         // name of the data set (variable)
+  uint32_t startYear;     // earliest year any country has a value
+  uint32_t endYear;       // latest year any country has a value
+  uint64_t yearMajor;     // offset in floats of the year-major copy
+  uint64_t countryMajor;  // offset in floats of the country-major copy
+
+  Dataset(const std::string& name, uint32_t startYear, uint32_t endYear,
+          uint64_t yearMajor, uint64_t countryMajor)
+      : name(),
+        startYear(startYear),
+        endYear(endYear),
+        yearMajor(yearMajor),
+        countryMajor(countryMajor) {
+    strncpy(this->name, name.c_str(), sizeof(this->name) - 1);
   }
 
-  friend std::ostream& operator<<(std::ostream& s, const Dataset& d) {
-    s << d.name << std::endl;
-    s << d.startYear << std::endl;
-    s << d.completeStartYear << std::endl;
-    s << d.startIndex << std::endl;
-    s << d.endIndex << std::endl;
+  uint32_t numYears() const { return endYear - startYear + 1; }
+
+  // every country's value in year, empty if the dataset doesn't cover it
+  std::span<const float> getYear(const float* data, uint32_t numCountries,
+                                 uint32_t year) const {
+    if (year < startYear || year > endYear) return {};
+    return {data + yearMajor + uint64_t(year - startYear) * numCountries,
+            numCountries};
+  }
 
-    return s;
+  // one country's values from startYear to endYear
+  std::span<const float> getCountry(const float* data, uint32_t numCountries,
+                                    uint32_t country) const {
+    if (country >= numCountries) return {};
+    return {data + countryMajor + uint64_t(country) * numYears(), numYears()};
+  }
+
+  float get(const float* data, uint32_t numCountries, uint32_t country,
+            uint32_t year) const {
+    if (country >= numCountries || year < startYear || year > endYear)
+      return std::numeric_limits<float>::quiet_NaN();
+    return data[countryMajor + uint64_t(country) * numYears() + year -
+                startYear];
+  }
+
+  friend std::ostream& operator<<(std::ostream& s, const Dataset& d) {
+    return s << d.name << ' ' << d.startYear << '-' << d.endYear;
   }
-};
\ No newline at end of file
+};
@@ -1,242 +1,219 @@
 #include "data/GapMinderBinaryDB.hh"
 
 #include <dirent.h>
-#include <unistd.h>
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 #include <fstream>
-#include <sstream>
+#include <limits>
 #include <string>
 #include <unordered_map>
 
 #include "data/BlockLoader2.hh"
+#include "util/Ex.hh"
+#include "util/MappedFile.hh"
+#include "util/ParallelFor.hh"
+#include "util/PerfectHash.hh"
 
 using namespace std;
 
-GapMinderBinaryDB::Index::Index() {}
-
-void GapMinderBinaryDB::Index::addDataSet(const GapMinderBinaryDB::Dataset &d) {
-  datasets.push_back(d);
+namespace {
+// index of a 3 letter lowercase code in the country table, or -1
+int codeIndex(const char c[]) {
+  int i = 0;
+  for (int k = 0; k < 3; k++) {
+    if (c[k] < 'a' || c[k] > 'z') return -1;
+    i = i * 26 + (c[k] - 'a');
+  }
+  return i;
 }
+}  // namespace
 
-GapMinderBinaryDB::GapMinderBinaryDB(const char filename[]) : data() {
-  debugLevel = 0;
-  data.reserve(2000000);
-  loadDir(filename);
+GapMinderBinaryDB::GapMinderBinaryDB(const char dirName[], uint32_t numThreads)
+    : debugLevel(0) {
+  loadDir(dirName, numThreads);
 }
 
-void GapMinderBinaryDB::loadDir(const char dirName[]) {
-  int status = chdir(dirName);
-
-  ifstream c("countryContinent.txt");
-
-  char buffer[4096];
-  char a[8];
-  char b[8];
-
-  unordered_map<string, uint8_t> continentNames = {
-      {"na", 0}, {"eu", 1}, {"as", 2}, {"sa", 3},
-      {"af", 4}, {"oc", 5}, {"an", 6}};
-
-  while (c.getline(buffer, sizeof(buffer))) {
-    istringstream line(buffer);
-    line >> a >> b;
-
-    continents.push_back(continentNames[b]);
-    countryCodes.push_back(a);
+/*
+  Parsing is the expensive part, so each thread takes whole files, maps
+  them and scans them into its own value list. Then one sequential pass
+  lays out the datasets in name order, the data is allocated once, and the
+  threads scatter their values into disjoint ranges of it.
+*/
+void GapMinderBinaryDB::loadDir(const char dirName[], uint32_t numThreads) {
+  const string dir(dirName);
+  loadCountryCodes((dir + "/countryContinent.txt").c_str());
+
+  // opendir, readdir, closedir
+  // https://man7.org/linux/man-pages/man3/opendir.3.html
+  const string allFiles = dir + "/allFiles/";
+  DIR* pDIR = opendir(allFiles.c_str());
+  if (pDIR == nullptr) throw Ex2(Errcode::DIR_NOT_FOUND, allFiles);
+  vector<string> files;
+  for (struct dirent* entry; (entry = readdir(pDIR)) != nullptr;) {
+    string name = entry->d_name;
+    if (name.ends_with(".csv")) files.push_back(allFiles + name);
   }
-
-  cout << countryCodes.size() << endl;
-  cout << continents.size() << endl;
-
-  DIR *pDIR;
-  struct dirent *entry;
-
-  status = chdir("allFiles");
-  if (pDIR = opendir(".")) {
-    while ((entry = readdir(pDIR)) != nullptr) {
-      if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
-        if (strcmp(entry->d_name, "gdp_per_capita.csv") == 0) {
-          cout << entry->d_name << endl;
-        }
-        cout << entry->d_name << endl;
-        loadOneFile(entry->d_name);
-      }
+  closedir(pDIR);
+  // the same database whatever order the directory lists files in
+  sort(files.begin(), files.end());
+
+  const uint32_t numFiles = files.size();
+  vector<vector<Value>> values(numFiles);
+  vector<uint8_t> unreadable(numFiles, false);
+  parallelFor(numFiles, numThreads, 1, [&](uint32_t i) {
+    try {
+      MappedFile f(files[i]);
+      scan(f.getData(), f.getData() + f.getSize(), values[i]);
+    } catch (const Ex&) {
+      unreadable[i] = true;
     }
+  });
+  for (uint32_t i = 0; i < numFiles; i++)
+    if (unreadable[i]) throw Ex2(Errcode::FILE_READ, files[i]);
+
+  vector<uint32_t> index(numFiles);
+  uint64_t size = data.size();
+  for (uint32_t i = 0; i < numFiles; i++) {
+    if (values[i].empty()) continue;
+    if (debugLevel >= 1) cout << "read " << files[i] << '\n';
+    index[i] = datasets.size();
+    size = add(files[i].c_str(), values[i], size);
   }
-  status = chdir("..");
-
-  saveBinary("GapMinderDBFile");
+  data.resize(size, numeric_limits<float>::quiet_NaN());
+  parallelFor(numFiles, numThreads, 1, [&](uint32_t i) {
+    if (!values[i].empty()) place(datasets[index[i]], values[i]);
+  });
 }
 
-// TODO: Commented out regions are using security header from the old
-// BlockLoader
-void GapMinderBinaryDB::loadOneFile(const char filename[]) {
-  Dataset d(countryCodes.size(), filename);
-
-  if (debugLevel >= 1) {
-    cout << "reading " << filename << endl;
+void GapMinderBinaryDB::loadCountryCodes(const char filename[]) {
+  ifstream c(filename);
+  if (!c) throw Ex2(Errcode::FILE_NOT_FOUND, filename);
+  unordered_map<string, uint8_t> continentNames = {
+      {"na", 0}, {"eu", 1}, {"as", 2}, {"sa", 3},
+      {"af", 4}, {"oc", 5}, {"an", 6}};
+  countryOfCode.assign(26 * 26 * 26, NO_COUNTRY);
+  string code, continent;
+  while (c >> code >> continent) {
+    int i = code.size() == 3 ? codeIndex(code.c_str()) : -1;
+    if (i >= 0) countryOfCode[i] = countryCodes.size();
+    countryCodes.push_back(code);
+    continents.push_back(continentNames[continent]);
   }
+  if (debugLevel >= 1) cout << countryCodes.size() << " countries\n";
+}
 
-  ifstream f(filename);
-  char buffer[4096];
-  char a[4096];
-  char b[4096];
-  char c[4096];
-
-  int lastYear = 0;
-  int currentCountry = 0;
-
-  constexpr uint32_t missing = 0xffffffff;
-  string lastName = "";
-
-  uint32_t index = data.size();
-  d.startIndex = index;
-  int relativeIndex = 0;
-  d.startYear = 3000;
-  d.completeStartYear = 0;
-  d.endYear = 0;
-
-  f.getline(buffer, sizeof(buffer));
-  while (f.getline(buffer, sizeof(buffer))) {
-    istringstream line(buffer);
-    line.getline(a, sizeof(a), ',');
-    line.getline(b, sizeof(b), ',');
-    line.getline(c, sizeof(c));
-
-    if (sizeof(a) != 3) {
-      // cerr << filename  << " " << relativeIndex << " country code size not 3
-      // " << a << endl;
-    }
-    if (sizeof(b) != 4) {
-      // cerr << filename  << " " << relativeIndex << " year size not 4 " << b
-      // << endl;
-    }
-
-    string name = a;
-    uint32_t year = atoi(b);
-    int dumb = 0;
-    if (name == "chn" && year == 2019) {
-      dumb++;
-    }
-    float val = atof(c);
-
-    if (name == lastName && year < lastYear) {
-      cout << "time discontinuity " << filename << " " << name << endl;
-
-    } else {
-      while (name == lastName && lastYear != year - 1) {
-        if (debugLevel >= 2) {
-          cerr << filename << " " << relativeIndex << " hole in data "
-               << lastYear << " - " << year << endl;
-        }
-        data.push_back(val);
-        lastYear++;
-      }
-    }
-
-    if (name != lastName) {
-      d.countries[currentCountry] = Dataset::Country({index, year});
-      currentCountry++;
-      if (d.startYear > year) {
-        d.startYear = year;
-      }
-      if (d.completeStartYear < year) {
-        d.completeStartYear = year;
-      }
-      if (debugLevel >= 1) {
-        cout << currentCountry << " " << index << "  " << year << endl;
-      }
-
-      lastName = name;
-    } else if (currentCountry < countryCodes.size() &&
-               name != countryCodes[currentCountry] && name != lastName) {
-      while (currentCountry < countryCodes.size() &&
-             name != countryCodes[currentCountry]) {
-        d.countries[currentCountry] = Dataset::Country({missing, missing});
-        if (debugLevel >= 1) {
-          cout << currentCountry << " missing " << countryCodes[currentCountry]
-               << " " << name << endl;
-        }
-        currentCountry++;
-      }
-    }
-
-    data.push_back(val);
-
-    lastYear = year;
-    index++;
-    relativeIndex++;
-
-    if (d.endYear < year) {
-      d.endYear = year;
-    }
+/*
+  A datapoints file has a header naming 3 columns, country, year and the
+  variable, then one line per value. Countries not in countryContinent.txt
+  are skipped, and a file with none of ours is not a dataset. The header
+  fails the country lookup like any other line that isn't ours, so a file
+  without one loses nothing. Nothing is allocated per line.
+*/
+void GapMinderBinaryDB::scan(const char* p, const char* end,
+                             vector<Value>& values) const {
+  values.clear();
+  const char* eol = find(p, end, '\n');
+  if (count(p, eol, ',') != 2) return;
+  for (; p < end; p = eol + 1) {
+    eol = find(p, end, '\n');
+    if (eol - p < 7 || p[3] != ',') continue;
+    const int code = codeIndex(p);
+    if (code < 0 || countryOfCode[code] == NO_COUNTRY) continue;
+    const char* q = p + 4;
+    uint32_t year = 0;
+    for (; q < eol && q < p + 13 && *q >= '0' && *q <= '9'; q++)
+      year = year * 10 + (*q - '0');
+    if (q == p + 4 || q == eol || *q != ',') continue;
+    float v;
+    if (from_chars(q + 1, eol, v).ec != errc()) continue;
+    values.push_back({countryOfCode[code], year, v});
   }
+}
 
-  d.endIndex = index;
-  f.close();
+uint64_t GapMinderBinaryDB::add(const char filename[],
+                                const vector<Value>& values,
+                                uint64_t offset) {
+  auto [first, last] = minmax_element(
+      values.begin(), values.end(),
+      [](const Value& a, const Value& b) { return a.year < b.year; });
+  const uint64_t n =
+      uint64_t(last->year - first->year + 1) * getNumCountries();
+  const char* slash = strrchr(filename, '/');
+  Dataset d(slash == nullptr ? filename : slash + 1, first->year, last->year,
+            offset, offset + n);
+  if (debugLevel >= 1) cout << d << '\n';
+  datasetIndex[d.name] = datasets.size();
+  datasets.push_back(d);
+  return offset + 2 * n;
+}
 
-  if (debugLevel >= 1) {
-    cout << d.endYear << " end year" << endl;
-    cout << d.startYear << " start year" << endl;
-    cout << d.completeStartYear << " complete start year" << endl;
+void GapMinderBinaryDB::place(const Dataset& d, const vector<Value>& values) {
+  const uint32_t numCountries = getNumCountries();
+  for (const Value& v : values) {
+    const uint32_t y = v.year - d.startYear;
+    data[d.yearMajor + uint64_t(y) * numCountries + v.country] = v.v;
+    data[d.countryMajor + uint64_t(v.country) * d.numYears() + y] = v.v;
   }
+}
 
-  this->index.addDataSet(d);
-}  // opendir, readdir, closedir
-   // https://man7.org/linux/man-pages/man3/opendir.3.html
+void GapMinderBinaryDB::loadOneFile(const char filename[]) {
+  if (debugLevel >= 1) cout << "reading " << filename << '\n';
+  MappedFile f(filename);
+  vector<Value> values;
+  scan(f.getData(), f.getData() + f.getSize(), values);
+  if (values.empty()) return;
+  data.resize(add(filename, values, data.size()),
+              numeric_limits<float>::quiet_NaN());
+  place(datasets.back(), values);
+}
 
-void GapMinderBinaryDB::fill(ofstream &f, uint32_t size) {
+void GapMinderBinaryDB::fill(ofstream& f, uint32_t size) {
   const static char filler[8] = {0};
   if (size % 8 != 0) {
     int mod = size % 8;
-    f.write((char *)&filler, 8 - mod);
+    f.write((char*)&filler, 8 - mod);
   }
 }
 
 void GapMinderBinaryDB::saveBinary(const char binaryData[]) {
   ofstream f(binaryData, ios::binary);
-
-  BlockLoader::GeneralHeader h(BlockLoader::Type::gapminder, 0x0000);
-  // BlockLoader::SecurityHeaderV0 sec = {0};
-
-  Header header;
-  header.numCountries = countryCodes.size();
-  header.numDataPoints = data.size();
-  header.numDatasets = this->index.size();
-
-  f.write((char *)&h, sizeof(BlockLoader::GeneralHeader));
-  // f.write((char*)&sec, sizeof(BlockLoader::SecurityHeaderV0));
-  f.write((char *)&header, sizeof(Header));
-
-  //    fill(f,
-  //    (sizeof(BlockLoader::GeneralHeader)+sizeof(BlockLoader::SecurityHeaderV0)+
-  //      sizeof(Header)));
-
-  for (int i = 0; i < countryCodes.size(); i++) {
-    f.write(countryCodes[i].c_str(), 3);
+  if (!f) throw Ex2(Errcode::FILE_NOT_FOUND, binaryData);
+
+  BlockLoader::GeneralHeader h(BlockLoader::Type::gapminder,
+                               GapMinderLoader::VERSION);
+  h.author_id = 0;
+  h.doc_id = 0;
+  h.num_sections = 0;
+  h.header_size = 0;
+  // datasets are written in the order the perfect hash puts them
+  vector<string_view> names;
+  for (const Dataset& d : datasets) names.push_back(d.name);
+  vector<uint32_t> displace;
+  const uint64_t seed = PerfectHash::build(names, displace);
+  Header header{getNumCountries(), getNumDatasets(), data.size(), seed};
+  f.write((char*)&h, sizeof(BlockLoader::GeneralHeader));
+  f.write((char*)&header, sizeof(Header));
+
+  for (const string& code : countryCodes) {
+    char c[3] = {0};
+    memcpy(c, code.c_str(), min<size_t>(3, code.size()));
+    f.write(c, 3);
   }
-
   fill(f, countryCodes.size() * 3);
-
-  f.write((char *)&continents[0], continents.size());
-
+  f.write((char*)continents.data(), continents.size());
   fill(f, continents.size());
 
-  // write the index information
-  for (int j = 0; j < index.size(); j++) {
-    const Dataset &d = index[j];
-
-    f.write((char *)&d, sizeof(d));
-    cout << d << endl;
-  }
-
-  fill(f, (index.size() * header.numCountries * sizeof(uint32_t)));
-
-  f.write((char *)&data[0],
-          data.size() * sizeof(float));  // write all the numbers
-
-  fill(f, (data.size() * sizeof(float)));
+  f.write((char*)displace.data(), displace.size() * sizeof(uint32_t));
+  fill(f, displace.size() * sizeof(uint32_t));
+  vector<const Dataset*> slots(datasets.size());
+  for (const Dataset& d : datasets)
+    slots[PerfectHash::slot(PerfectHash::hash(d.name, seed), displace.data(),
+                            datasets.size())] = &d;
+  for (const Dataset* d : slots) f.write((char*)d, sizeof(Dataset));
+
+  f.write((char*)data.data(), data.size() * sizeof(float));
+  fill(f, data.size() * sizeof(float));
+  if (!f) throw Ex2(Errcode::FILE_WRITE, binaryData);
 }
-
-void GapMinderBinaryDB::loadCountryCodes() {}
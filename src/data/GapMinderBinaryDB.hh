@@ -2,58 +2,59 @@
 
 #include <cstring>
 #include <iostream>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "data/BlockLoader2.hh"
+#include "data/GapMinderLoader.hh"
 
-constexpr float NaN = 0xffffffff;
-
+/*
+  Builds the GapMinder database from the csv files and saves it in the
+  binary form GapMinderLoader reads. The data is kept in memory in the same
+  layout as the file, so the accessors work on it the same way.
+*/
 class GapMinderBinaryDB {
  public:
-  constexpr static uint32_t numberCountries = 249;
-
-  struct Header {
-    uint32_t numCountries;
-    uint32_t numDatasets;
-    uint32_t numDataPoints;
-  };
+  using Header = GapMinderLoader::Header;
+  using Dataset = GapMinderLoader::Dataset;
 
  private:
   int debugLevel;
 
   std::vector<std::string> countryCodes;
   std::vector<uint8_t> continents;
-  /*
-    Dataset represents one variable for all countries
-
-   */
+  // country of each 3 letter lowercase code, a flat table so lookup
+  // needs no string
+  static constexpr uint16_t NO_COUNTRY = 0xFFFF;
+  std::vector<uint16_t> countryOfCode;
+  std::vector<Dataset> datasets;  // in the order they were loaded
+  std::unordered_map<std::string, uint32_t> datasetIndex;
 
-#include "Dataset.hh"
-
-  class Index {
-   private:
-    std::vector<Dataset> datasets;  // index to all variables
-   public:
-    Index();
-    void addDataSet(const Dataset& d);
-
-    uint32_t size() const { return datasets.size(); }
-
-    Dataset& get(uint32_t index) { return datasets[index]; }
+  std::vector<float> data;  // MASSIVE
 
-    Dataset& operator[](uint32_t index) { return datasets[index]; }
+  struct Value {
+    uint32_t country, year;
+    float v;
   };
+  // the values of one csv file, empty if it is not a datapoints file
+  void scan(const char* p, const char* end, std::vector<Value>& values) const;
+  // lay out a dataset for values at offset, returning the end of its data
+  uint64_t add(const char filename[], const std::vector<Value>& values,
+               uint64_t offset);
+  void place(const Dataset& d, const std::vector<Value>& values);
 
-  Index index;
-
-  std::vector<float> data;  // MASSIVE
  public:
-  GapMinderBinaryDB(const char filename[]);
-  void loadDir(
-      const char
-          filename[]);  // opendir, readdir, closedir
-                        // https://man7.org/linux/man-pages/man3/opendir.3.html
+  GapMinderBinaryDB(const char dirName[], uint32_t numThreads = 0);
+  /*
+    Read dirName/countryContinent.txt, then every csv file in
+    dirName/allFiles as a dataset named after its file. The files are
+    mapped and parsed on numThreads threads (0 for one per core), then
+    merged in name order, so the result doesn't depend on the thread count.
+  */
+  void loadDir(const char dirName[], uint32_t numThreads = 0);
+  void loadCountryCodes(const char filename[]);
   void loadOneFile(const char filename[]);
   /*
     save the file in binary so that it can be loaded in a single memory read
@@ -64,68 +65,26 @@ class GapMinderBinaryDB {
 
   void saveBinary(const char binaryData[]);
 
-  void loadCountryCodes();
+  uint32_t getNumCountries() const { return countryCodes.size(); }
+  uint32_t getNumDatasets() const { return datasets.size(); }
+  const Dataset* getDatasets() const { return datasets.data(); }
 
   const Dataset* getDataset(const char dataset[]) const {
-    Dataset* d;
-    // TODO
-    return d;
+    auto i = datasetIndex.find(dataset);
+    return i == datasetIndex.end() ? nullptr : &datasets[i->second];
   }
 
   float getData(uint32_t countryIndex, uint32_t year, const Dataset* d) const {
-    if (numberCountries < countryIndex) {
-      return NaN;
-    }
-    if (year < d->countries[countryIndex].startYear) {
-      return NaN;
-    }
-    uint32_t i = d->countries[countryIndex].startIndex + year -
-                 d->countries[countryIndex].startYear;
-    if (i >= d->countries[countryIndex + 1].startIndex) {
-      return NaN;
-    }
-    return data[i];
+    return d->get(data.data(), getNumCountries(), countryIndex, year);
   }
 
-  std::vector<float> getAllDataOneYear(uint32_t year, const Dataset* d) {
-    std::vector<float> vec;
-    if (year < d->startYear) {
-      vec = {NaN};
-      return vec;
-    }
-    if (year > d->endYear) {
-      vec = {NaN};
-      return vec;
-    }
-
-    for (int i = 0; i < numberCountries; i++) {
-      uint32_t index =
-          d->countries[i].startIndex + year - d->countries[i].startYear;
-      if (i >= d->countries[i + 1].startIndex) {
-        vec.push_back(0xffffffff);
-      } else if (year < d->countries[i].startYear) {
-        vec.push_back(0xffffffff);
-      } else {
-        vec.push_back(data[index]);
-      }
-    }
-
-    return vec;
+  std::span<const float> getAllDataOneYear(uint32_t year,
+                                           const Dataset* d) const {
+    return d->getYear(data.data(), getNumCountries(), year);
   }
 
-  std::vector<float> getAllDataOneCountry(uint32_t countryIndex,
-                                          const Dataset* d) {
-    std::vector<float> vec;
-    if (numberCountries < countryIndex) {
-      vec = {NaN};
-      return vec;
-    }
-
-    for (int i = d->countries[countryIndex].startYear;
-         i < d->countries[countryIndex + 1].startYear; i++) {
-      vec.push_back(data[i]);
-    }
-
-    return vec;
+  std::span<const float> getAllDataOneCountry(uint32_t countryIndex,
+                                              const Dataset* d) const {
+    return d->getCountry(data.data(), getNumCountries(), countryIndex);
   }
 };
@@ -1,126 +1,48 @@
 #include "data/GapMinderLoader.hh"
 
-#include <dirent.h>
-#include <unistd.h>
-
-#include <cstring>
-#include <fstream>
-#include <limits>
-#include <sstream>
-#include <string>
-
-#include "data/BlockLoader2.hh"
+#include "util/Ex.hh"
+#include "util/PerfectHash.hh"
 
 using namespace std;
 
-inline const char* align(const char* p) {
-  return (const char*)(((uint64_t)p + 7) & ~uint64_t(7));
-}
+inline uint64_t align(uint64_t bytes) { return (bytes + 7) & ~uint64_t(7); }
 
 GapMinderLoader::GapMinderLoader(const char binaryFile[])
     : BlockLoader(binaryFile) {
-  header = (Header*)((char*)mem + getHeaderSize());
-  // TODO: add RegionContainer and NamedEntities
-  countryCodes = (const char*)align((char*)header + sizeof(Header));
-  continents = (const uint8_t*)align(countryCodes + header->numCountries * 3);
-  indices =
-      (const Dataset*)align((const char*)continents + header->numCountries);
-  // for (int i = 0; i < header->numDatasets; i++){
-  // cout << "name: " << indices[i].name << endl;
-  //}
-  data = (const float*)align((char*)indices +
-                             sizeof(Dataset) * header->numDatasets);
+  if (size < getHeaderSize() + sizeof(Header) ||
+      generalHeader->type != uint16_t(Type::gapminder) ||
+      generalHeader->version != VERSION)
+    throw Ex2(Errcode::FILE_READ, binaryFile);
+  header = (const Header*)((char*)mem + getHeaderSize());
+  const uint32_t numCountries = header->numCountries;
+  const uint32_t numDatasets = header->numDatasets;
+  countryCodes = (const char*)header + sizeof(Header);
+  continents = (const uint8_t*)countryCodes + align(3 * numCountries);
+  displace = (const uint32_t*)(continents + align(numCountries));
+  const uint32_t numBuckets = PerfectHash::numBuckets(numDatasets);
+  datasets = (const Dataset*)((const char*)displace + align(4 * numBuckets));
+  data = (const float*)(datasets + numDatasets);
+  if ((char*)(data + header->numDataPoints) > (char*)mem + size)
+    throw Ex2(Errcode::FILE_READ, binaryFile);
+  for (uint32_t b = 0; b < numBuckets; b++)
+    if ((displace[b] & PerfectHash::DIRECT) &&
+        (displace[b] & ~PerfectHash::DIRECT) >= numDatasets)
+      throw Ex2(Errcode::FILE_READ, binaryFile);
+  for (uint32_t i = 0; i < numDatasets; i++) {
+    const Dataset& d = datasets[i];
+    const uint64_t n = uint64_t(d.numYears()) * numCountries;
+    if (d.name[sizeof(d.name) - 1] != '\0' || d.startYear > d.endYear ||
+        d.yearMajor + n > header->numDataPoints ||
+        d.countryMajor + n > header->numDataPoints)
+      throw Ex2(Errcode::FILE_READ, binaryFile);
+  }
 }
 
 const GapMinderLoader::Dataset* GapMinderLoader::getDataset(
     const char dataset[]) const {
-  for (int i = 0; i < header->numDatasets; i++) {
-    if (strcmp(indices[i].name, dataset) == 0) {
-      return (const Dataset*)&indices[i];
-    }
-  }
-  return nullptr;
-}
-
-// originally NaN used cmath's nan(char[]) function, but this proved not to be
-// constexpr under Clang. As such, I replaced it with a quiet NaN from numeric
-// limits. This should be functionally equivalent if we want to just skip NaN.
-// If you're looking to crash on NaN, replace quiet NaN with signaling NaN from
-// numeric limits.
-//     - ahuston-0
-constexpr float NaN = numeric_limits<float>::quiet_NaN();
-float GapMinderLoader::getData(uint32_t countryIndex, uint32_t year,
-                               const Dataset* d) const {
-  if (header->numCountries < countryIndex) {
-    return NaN;
-  }
-
-  const Dataset::Country& c = d->countries[countryIndex];
-  if (year < c.startYear) {
-    return NaN;
-  }
-
-  uint32_t i = c.startIndex + year - c.startYear;
-  if (i >= d->countries[countryIndex + 1].startIndex) {
-    return NaN;
-  }
-  return data[i];
-}
-
-#if 0
-class Result {
-  private:
-    const float* data;
-    uint32_t startPos;
-    //TODO: ignore stride for now, only sequetnial data? uint32_t stride;               //           x y r g b x y r g b x y r g b ...
-    uint32_t size;
-    //example: Afghanistan GDP          24.1 25.2  26.3  14.2  14.9 ...  Result(start, 1, 42)
-    //    abo: n n n n n n n n n n  afg: n n n n n n n n n 
-    // example: all data from one year  Result(start, 249 )
-  public:
-    Result(uint32_t start, uint32_t stride, uint32_t size) : startPos(start), stride(stride), size(size) {}
-    float operator [](uint32_t i) const { return data[startPos + i]; }
-
-};
-#endif
-vector<float> GapMinderLoader::getAllDataOneYear(uint32_t year,
-                                                 const Dataset* d) const {
-  vector<float> vec(header->numCountries);
-  if (year < d->startYear || year > d->endYear) {
-    vec = {NaN};
-    return vec;
-  }
-
-  for (int i = 0; i < header->numCountries; i++) {
-    uint32_t index =
-        d->countries[i].startIndex + year - d->countries[i].startYear;
-    if (i >= d->countries[i + 1].startIndex) {
-      vec[i] = (0xffffffff);
-    } else if (year < d->countries[i].startYear) {
-      vec[i] = (0xffffffff);
-    } else {
-      vec[i] = (data[index]);
-    }
-  }
-
-  return vec;
-}
-
-vector<float> GapMinderLoader::getAllDataOneCountry(uint32_t countryIndex,
-                                                    const Dataset* d) {
-  if (header->numCountries < countryIndex) {
-    vector<float> vecBad = {NaN};
-    return vecBad;
-  }
-
-  const int numYears = d->countries[countryIndex + 1].startYear -
-                       d->countries[countryIndex].startYear;
-  vector<float> vec(numYears);
-
-  for (int i = d->countries[countryIndex].startYear, j = 0;
-       i < d->countries[countryIndex + 1].startYear; i++, j++) {
-    vec[j] = (data[i]);
-  }
-
-  return vec;
+  if (header->numDatasets == 0) return nullptr;
+  const uint64_t h = PerfectHash::hash(dataset, header->hashSeed);
+  const Dataset& d =
+      datasets[PerfectHash::slot(h, displace, header->numDatasets)];
+  return strcmp(d.name, dataset) == 0 ? &d : nullptr;
 }
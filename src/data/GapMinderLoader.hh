@@ -2,19 +2,29 @@
 
 #include <cstring>
 #include <iostream>
+#include <limits>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "data/BlockLoader2.hh"
 
-// constexpr float NaN = 0xffffffff;
+/*
+  Reads the file GapMinderBinaryDB saves. Everything is used in place from
+  the single block read, so slices come back as spans into it and nothing
+  is allocated after loading. The file holds, each part padded to 8 bytes:
 
+    Header | country codes, 3 chars each | continents |
+    perfect hash displacements | datasets in hash slot order | data
+*/
 class GapMinderLoader : public BlockLoader {
  public:
+  static constexpr uint16_t VERSION = 2;
   struct Header {
     uint32_t numCountries;
     uint32_t numDatasets;
-    uint32_t numDataPoints;
+    uint64_t numDataPoints;  // floats in data
+    uint64_t hashSeed;       // PerfectHash seed for dataset names
   };
 
 #include "Dataset.hh"
@@ -22,15 +32,29 @@ class GapMinderLoader : public BlockLoader {
   const Header* header;
   const char* countryCodes;
   const uint8_t* continents;
-  const Dataset* indices;
+  const uint32_t* displace;  // PerfectHash, one per bucket
+  const Dataset* datasets;
   const float* data;
 
  public:
   GapMinderLoader(const char filename[]);
 
+  uint32_t getNumCountries() const { return header->numCountries; }
+  uint32_t getNumDatasets() const { return header->numDatasets; }
+  const Dataset* getDatasets() const { return datasets; }
+  // the dataset with this name, or nullptr
   const Dataset* getDataset(const char dataset[]) const;
-  float getData(uint32_t countryIndex, uint32_t year, const Dataset* d) const;
-  std::vector<float> getAllDataOneYear(uint32_t year, const Dataset* d) const;
-  std::vector<float> getAllDataOneCountry(uint32_t countryIndex,
-                                          const Dataset* d);
+  float getData(uint32_t countryIndex, uint32_t year, const Dataset* d) const {
+    return d->get(data, header->numCountries, countryIndex, year);
+  }
+  // every country in year, empty if d doesn't cover it
+  std::span<const float> getAllDataOneYear(uint32_t year,
+                                           const Dataset* d) const {
+    return d->getYear(data, header->numCountries, year);
+  }
+  // one country from d->startYear to d->endYear
+  std::span<const float> getAllDataOneCountry(uint32_t countryIndex,
+                                              const Dataset* d) const {
+    return d->getCountry(data, header->numCountries, countryIndex);
+  }
 };
@@ -0,0 +1,176 @@
+#include "data/TimeSeries.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "util/Ex.hh"
+
+using namespace std;
+
+namespace {
+constexpr double NaN = numeric_limits<double>::quiet_NaN();
+constexpr TimeSeries::Aggregate EMPTY = {numeric_limits<double>::infinity(),
+                                         -numeric_limits<double>::infinity(),
+                                         NaN, NaN, 0};
+
+TimeSeries::Aggregate sample(double v) { return {v, v, v, v, v}; }
+
+// a followed by b
+TimeSeries::Aggregate join(const TimeSeries::Aggregate& a,
+                           const TimeSeries::Aggregate& b) {
+  if (isnan(a.first)) return b;
+  if (isnan(b.first)) return a;
+  return {min(a.min, b.min), max(a.max, b.max), a.first, b.last,
+          a.sum + b.sum};
+}
+
+uint64_t levelSize(uint64_t numSamples, uint32_t level) {
+  uint64_t n = numSamples;
+  for (uint32_t l = 0; l < level; l++)
+    n = (n + TimeSeries::FANOUT - 1) / TimeSeries::FANOUT;
+  return n;
+}
+
+uint32_t numLevels(uint64_t numSamples) {
+  uint32_t l = 1;
+  while (levelSize(numSamples, l - 1) > 1) l++;
+  return l;
+}
+}  // namespace
+
+uint64_t TimeSeries::check(const vector<double>& v, uint64_t numTimes) {
+  if (v.empty()) throw Ex1(Errcode::VECTOR_ZERO_LENGTH);
+  if (numTimes != v.size()) throw Ex1(Errcode::VECTOR_MISMATCHED_LENGTHS);
+  return v.size();
+}
+
+uint64_t TimeSeries::bytes(uint64_t numSamples) {
+  uint64_t aggregates = 0;
+  for (uint32_t l = 1; l < numLevels(numSamples); l++)
+    aggregates += levelSize(numSamples, l);
+  return sizeof(Header) + 2 * numSamples * sizeof(double) +
+         aggregates * sizeof(Aggregate);
+}
+
+// point into mem, which must hold a header saying how big it is
+void TimeSeries::init() {
+  header = (const Header*)((char*)mem + getHeaderSize());
+  const uint64_t n = header->numSamples;
+  times = (const double*)(header + 1);
+  values = times + n;
+  levels[0] = nullptr;
+  const Aggregate* level = (const Aggregate*)(values + n);
+  for (uint32_t l = 1; l < header->numLevels; l++) {
+    levels[l] = level;
+    level += levelSize(n, l);
+  }
+}
+
+void TimeSeries::build(const double t[], const double v[]) {
+  const uint64_t n = header->numSamples;
+  memcpy((double*)times, t, n * sizeof(double));
+  memcpy((double*)values, v, n * sizeof(double));
+  for (uint32_t l = 1; l < header->numLevels; l++) {
+    Aggregate* level = (Aggregate*)levels[l];
+    const uint64_t below = levelSize(n, l - 1);
+    for (uint64_t i = 0; i < levelSize(n, l); i++) {
+      Aggregate a = EMPTY;
+      const uint64_t end = min<uint64_t>((i + 1) * FANOUT, below);
+      for (uint64_t j = i * FANOUT; j < end; j++)
+        a = join(a, l == 1 ? sample(v[j]) : levels[l - 1][j]);
+      level[i] = a;
+    }
+  }
+}
+
+TimeSeries::TimeSeries(const vector<double>& t, const vector<double>& v)
+    : BlockLoader(bytes(check(v, t.size())), Type::timeseries, VERSION) {
+  if (!is_sorted(t.begin(), t.end())) throw Ex1(Errcode::BAD_ARGUMENT);
+  Header* h = (Header*)((char*)mem + getHeaderSize());
+  *h = Header{v.size(), numLevels(v.size()), FANOUT};
+  init();
+  build(t.data(), v.data());
+}
+
+TimeSeries::TimeSeries(const vector<double>& v, double start, double step)
+    : BlockLoader(bytes(check(v, v.size())), Type::timeseries, VERSION) {
+  Header* h = (Header*)((char*)mem + getHeaderSize());
+  *h = Header{v.size(), numLevels(v.size()), FANOUT};
+  init();
+  double* t = (double*)times;
+  for (uint64_t i = 0; i < v.size(); i++) t[i] = start + i * step;
+  build(t, v.data());
+}
+
+TimeSeries::TimeSeries(const char filename[]) : BlockLoader(filename) {
+  const Header* h = (const Header*)((char*)mem + getHeaderSize());
+  if (size < getHeaderSize() + sizeof(Header) ||
+      generalHeader->type != uint16_t(Type::timeseries) ||
+      generalHeader->version != VERSION || h->fanout != FANOUT ||
+      h->numSamples == 0 || h->numLevels != numLevels(h->numSamples) ||
+      size < getHeaderSize() + bytes(h->numSamples))
+    throw Ex2(Errcode::FILE_READ, filename);
+  init();
+}
+
+void TimeSeries::save(const char filename[]) const {
+  ofstream f(filename, ios::binary);
+  f.write((const char*)mem, size);
+  if (!f) throw Ex2(Errcode::FILE_WRITE, filename);
+}
+
+uint64_t TimeSeries::lowerBound(double t, uint64_t from) const {
+  return lower_bound(times + from, times + header->numSamples, t) - times;
+}
+
+/*
+  Walk up the pyramid from both ends of the range: at each level take the
+  entries up to the next multiple of FANOUT on the left and back to the
+  previous one on the right, then what is between is whole entries of the
+  level above.
+*/
+TimeSeries::Bucket TimeSeries::summarize(uint64_t begin, uint64_t end) const {
+  Aggregate left = EMPTY, right = EMPTY;
+  uint64_t lo = begin, hi = end;
+  for (uint32_t l = 0; lo < hi; l++) {
+    auto at = [&](uint64_t i) {
+      return l == 0 ? sample(values[i]) : levels[l][i];
+    };
+    if (l + 1 == header->numLevels || hi - lo < FANOUT) {
+      for (; lo < hi; lo++) left = join(left, at(lo));
+      break;
+    }
+    for (; lo % FANOUT != 0; lo++) left = join(left, at(lo));
+    for (; hi % FANOUT != 0; hi--) right = join(at(hi - 1), right);
+    lo /= FANOUT;
+    hi /= FANOUT;
+  }
+  Bucket b;
+  static_cast<Aggregate&>(b) = join(left, right);
+  b.begin = begin;
+  b.end = end;
+  return b;
+}
+
+void TimeSeries::getBuckets(double t0, double t1, vector<Bucket>& out) const {
+  const uint32_t numBuckets = out.size();
+  const double dt = (t1 - t0) / numBuckets;
+  uint64_t begin = lowerBound(t0);
+  for (uint32_t i = 0; i < numBuckets; i++) {
+    const uint64_t end =
+        i + 1 == numBuckets
+            ? upper_bound(times + begin, times + header->numSamples, t1) -
+                  times
+            : lowerBound(t0 + (i + 1) * dt, begin);
+    if (begin < end) {
+      out[i] = summarize(begin, end);
+    } else {
+      static_cast<Aggregate&>(out[i]) = EMPTY;
+      out[i].begin = out[i].end = begin;
+    }
+    begin = end;
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "data/BlockLoader2.hh"
+
+/*
+  Samples (t, v) in time order with a pyramid of aggregates, so a chart can
+  ask for N buckets over any time range and do work proportional to N, not
+  to the number of samples. Each entry of level 1 summarises FANOUT samples,
+  each entry of level 2 FANOUT entries of level 1, and so on up to a single
+  entry. Any range of samples is then at most 2 * FANOUT entries per level.
+  It is built in one pass and is one block, saved and loaded like any other
+  BlockLoader:
+
+    Header | times | values | level 1 | level 2 | ...
+*/
+class TimeSeries : public BlockLoader {
+ public:
+  static constexpr uint16_t VERSION = 1;
+  static constexpr uint32_t FANOUT = 16;
+  struct Header {
+    uint64_t numSamples;
+    uint32_t numLevels;  // including the samples themselves
+    uint32_t fanout;
+  };
+  struct Aggregate {
+    double min, max, first, last, sum;  // first is NaN if empty
+  };
+  // the summary of samples [begin, end)
+  struct Bucket : Aggregate {
+    uint64_t begin, end;
+    bool empty() const { return begin == end; }
+    double mean() const { return sum / (end - begin); }
+  };
+
+ private:
+  static constexpr uint32_t MAX_LEVELS = 17;  // 16^16 samples
+  const Header* header;
+  const double* times;
+  const double* values;
+  const Aggregate* levels[MAX_LEVELS];  // levels[0] unused, it is values
+
+  // number of samples, if there are some and as many times
+  static uint64_t check(const std::vector<double>& v, uint64_t numTimes);
+  static uint64_t bytes(uint64_t numSamples);
+  void init();
+  void build(const double t[], const double v[]);
+
+ public:
+  // t must not decrease
+  TimeSeries(const std::vector<double>& t, const std::vector<double>& v);
+  // samples at start, start + step, ...
+  TimeSeries(const std::vector<double>& v, double start = 0, double step = 1);
+  TimeSeries(const char filename[]);
+  void save(const char filename[]) const;
+
+  uint64_t getNumSamples() const { return header->numSamples; }
+  const double* getTimes() const { return times; }
+  const double* getValues() const { return values; }
+  double getStartTime() const { return times[0]; }
+  double getEndTime() const { return times[header->numSamples - 1]; }
+  // index of the first sample at or after t, searching from sample from
+  uint64_t lowerBound(double t, uint64_t from = 0) const;
+
+  Bucket summarize(uint64_t begin, uint64_t end) const;
+  /*
+    Split [t0, t1] into out.size() buckets of equal time and summarise the
+    samples in each, empty where there are none.
+  */
+  void getBuckets(double t0, double t1, std::vector<Bucket>& out) const;
+};
@@ -1,6 +1,7 @@
 #include "opengl/CandlestickChartWidget.hh"
 
 #include <algorithm>
+#include <cmath>
 #include <numbers>
 
 #include "util/Ex.hh"
@@ -11,11 +12,25 @@ void CandlestickChartWidget::setData(const vector<double>& data) {
   this->data = data;
 }
 
+void CandlestickChartWidget::setSeries(const TimeSeries* series,
+                                       uint32_t numCandles) {
+  this->series = series;
+  this->numCandles = numCandles;
+}
+
 void CandlestickChartWidget::setNames(const vector<std::string>& names) {
   this->names = names;
 }
 
 void CandlestickChartWidget::init() {
+  if (series != nullptr) {
+    vector<TimeSeries::Bucket> candles(numCandles);
+    series->getBuckets(series->getStartTime(), series->getEndTime(), candles);
+    data.clear();
+    for (const TimeSeries::Bucket& b : candles)
+      if (!b.empty() && !isnan(b.first))
+        data.insert(data.end(), {b.min, b.first, b.last, b.max});
+  }
   xAxis->setTickLabels(names);
   if (data.size() < 4) {
     cerr << "the data vector must contain at least one data set (minimum 4 "
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "data/TimeSeries.hh"
 #include "opengl/GraphWidget.hh"
 
 class CandlestickChartWidget : public GraphWidget {
@@ -7,6 +8,8 @@ class CandlestickChartWidget : public GraphWidget {
   std::vector<std::string> names;
   std::vector<double> data;
   float boxWidth;
+  const TimeSeries* series;
+  uint32_t numCandles;
 
  public:
   CandlestickChartWidget(Canvas* c, double x, double y, double w, double h,
@@ -15,9 +18,17 @@ class CandlestickChartWidget : public GraphWidget {
       : GraphWidget(c, x, y, w, h, FUNCTIONS_PERMITTED, FUNCTIONS_PERMITTED,
                     xAxisType, yAxisType, s),
         data(std::vector<double>()),
-        boxWidth(3) {}
+        boxWidth(3),
+        series(nullptr),
+        numCandles(0) {}
   void setBoxWidth(double width);
   void setData(const std::vector<double>& data);
+  /*
+    Chart series as numCandles candles of equal time, each the first, last,
+    min and max of its samples read from the pyramid, so the work doesn't
+    grow with the number of samples. series must outlive init().
+  */
+  void setSeries(const TimeSeries* series, uint32_t numCandles);
   void setNames(const std::vector<std::string>& names);
   void init() override;
 };
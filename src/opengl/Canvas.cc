@@ -1,5 +1,7 @@
 #include "opengl/Canvas.hh"
 
+#include <typeinfo>
+
 #include "opengl/GLWin.hh"
 #include "opengl/Shader.hh"
 #include "opengl/Style.hh"
@@ -8,6 +10,7 @@
 //#include <GL/gl.h>
 #include "opengl/InteractiveWidget2D.hh"
 #include "opengl/MultiText.hh"
+#include "opengl/ShapeBatch.hh"
 #include "opengl/StyledMultiShape2D.hh"
 #include "opengl/util/Camera.hh"
 
@@ -18,6 +21,7 @@ Canvas::Canvas(Tab* tab) : Canvas(tab->getParentWin(), tab) {}
 Canvas::~Canvas() { cleanup(); }
 
 void Canvas::cleanup() {
+  clearRuns();
   for (uint32_t i = 0; i < layers.size(); i++) delete layers[i];
   layers.clear();
   if (!cam) {
@@ -31,7 +35,64 @@ void Canvas::render() {
   Shader::useShader(style->getShaderIndex())->setMat4("projection", projection);
   glViewport(vpX, w->height - vpH - vpY, vpW, vpH);
 
-  for (uint32_t i = 0; i < layers.size(); i++) layers[i]->render();
+  if (!batching) {
+    for (uint32_t i = 0; i < layers.size(); i++) layers[i]->render();
+    return;
+  }
+  if (plannedLayers != layers.size()) planRuns();
+  for (const Run& r : runs)
+    if (r.batch != nullptr)
+      r.batch->render(projection);
+    else
+      for (uint32_t i = r.begin; i < r.end; i++) layers[i]->render();
+}
+
+void Canvas::update() {
+  if (!batching) {
+    for (uint32_t i = 0; i < layers.size(); i++) layers[i]->update();
+    return;
+  }
+  if (plannedLayers != layers.size()) planRuns();
+  for (const Run& r : runs)
+    if (r.batch != nullptr)
+      r.batch->update();
+    else
+      for (uint32_t i = r.begin; i < r.end; i++) layers[i]->update();
+}
+
+void Canvas::setBatching(bool on) {
+  batching = on;
+  clearRuns();
+}
+
+/*
+  Subclasses of StyledMultiShape2D may draw more than their lists, so only
+  layers that are exactly StyledMultiShape2D are batched, and only where
+  two or more are next to each other.
+*/
+void Canvas::planRuns() {
+  clearRuns();
+  for (uint32_t i = 0; i < layers.size();) {
+    vector<StyledMultiShape2D*> run;
+    for (uint32_t j = i; j < layers.size() &&
+                         typeid(*layers[j]) == typeid(StyledMultiShape2D);
+         j++)
+      run.push_back(static_cast<StyledMultiShape2D*>(layers[j]));
+    if (run.size() > 1) {
+      runs.push_back(Run{i, uint32_t(i + run.size()), new ShapeBatch(run)});
+      i += run.size();
+    } else {
+      runs.push_back(Run{i, i + 1, nullptr});
+      i++;
+    }
+  }
+  plannedLayers = layers.size();
+}
+
+void Canvas::clearRuns() {
+  for (const Run& r : runs) delete r.batch;
+  runs.clear();
+  plannedLayers = 0;
 }
 
 Camera* Canvas::setLookAtProjection(float eyeX, float eyeY, float eyeZ,
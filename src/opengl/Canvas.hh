@@ -3,15 +3,29 @@
 //#include <cstring>
 
 #include <set>
+#include <vector>
 
 #include "opengl/GLWin.hh"
 #include "opengl/Shape.hh"
 #include "util/DynArray.hh"
 
 class Camera;
+class ShapeBatch;
 class Style;
 class Tab;
 class Canvas {
+ private:
+  // layers [begin, end) drawn one by one, or together by a batch
+  struct Run {
+    uint32_t begin, end;
+    ShapeBatch* batch;
+  };
+  bool batching;
+  std::vector<Run> runs;
+  uint32_t plannedLayers;  // number of layers when runs were planned
+  void planRuns();
+  void clearRuns();
+
  protected:
   GLWin* w;
   Tab* tab;
@@ -34,6 +48,8 @@ class Canvas {
          uint32_t vpW, uint32_t vpH, uint32_t pX,
          uint32_t pY)
       :  // viewport, projection
+        batching(false),
+        plannedLayers(0),
         w(w),
         tab(tab),
         layers(4),
@@ -97,11 +113,14 @@ class Canvas {
     }
   }
 
-  void update() {
-    for (int i = 0; i < layers.size(); i++) {
-      layers[i]->update();
-    }
-  }
+  void update();
+  /*
+    Draw consecutive StyledMultiShape2D layers as one ShapeBatch, which
+    takes fewer draw calls and state changes but draws the solids of
+    neighbouring layers with the same transform and line width before
+    their lines.
+  */
+  void setBatching(bool on);
 
   const Style* getStyle() const { return style; }
 
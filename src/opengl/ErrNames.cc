@@ -64,4 +64,6 @@ const char* Ex::errNames[] = {
     "NONEXISTENT_ACTION",
     "BAD_ARGUMENT",
     "UNIMPLEMENTED",
+    "SOCKET_STALLED",
+    "COMPRESSED_CORRUPT",
 };
\ No newline at end of file
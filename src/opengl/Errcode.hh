@@ -64,4 +64,6 @@ enum class Errcode {
   NONEXISTENT_ACTION,
   BAD_ARGUMENT,
   UNIMPLEMENTED,
+  SOCKET_STALLED,
+  COMPRESSED_CORRUPT,
 };
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <random>
 #include <string>
 #include <vector>
@@ -20,7 +21,8 @@
 // GLFW
 #include <GLFW/glfw3.h>
 
-#include "csp/IPV4Socket.hh"
+#include "csp/AsyncCSPClient.hh"
+#include "csp/Socket.hh"
 #include "csp/csp.hh"
 #include "util/Prefs.hh"
 
@@ -32,7 +34,6 @@
 #include "fmt/core.h"
 #include "opengl/Style.hh"
 #include "opengl/Tab.hh"
-#include "stb/stb_image_write.h"
 #include "xdl/XDLCompiler.hh"
 #include "xdl/std.hh"
 using namespace std;
@@ -157,25 +158,35 @@ inline glm::vec4 uint2vec4(uint32_t color) {
 
 GLWin::GLWin(uint32_t bgColor, uint32_t fgColor, const string &title,
              uint32_t exitAfter)
-    : bgColor(uint2vec4(bgColor)),
-      fgColor(uint2vec4(fgColor)),
-      title(title),
-      exitAfter(exitAfter),
+    : title(title),
+      frameNum(0),
       tabs(4),
-      faces(16),
-      dragMode(false),
+      client(nullptr),
+      headless(getenv("GRAIL_HEADLESS") != nullptr),
+      fbo(0),
+      headlessFrame(0),
+      capture(nullptr),
+      captureNum(0),
+      saveRequested(false),
       mousePressX(0),
-      mousePressY(0) {
-  glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+      mousePressY(0),
+      dragMode(false),
+      exitAfter(exitAfter),
+      bgColor(uint2vec4(bgColor)),
+      fgColor(uint2vec4(fgColor)),
+      faces(16) {
+  if (!headless) {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-  glfwWindowHint(
-      GLFW_OPENGL_FORWARD_COMPAT,
-      GL_TRUE);  // uncomment this statement to fix compilation on OS X
+    glfwWindowHint(
+        GLFW_OPENGL_FORWARD_COMPAT,
+        GL_TRUE);  // uncomment this statement to fix compilation on OS X
 #endif
+  }
   // all static library initializations go here
   if (!ranStaticInits) GLWin::classInit();
 }
@@ -192,28 +203,33 @@ void GLWin::setTitle(const std::string &title) {}
 MainCanvas *GLWin::getMainCanvas() { return currentTab()->getMainCanvas(); }
 
 void GLWin::startWindow() {
-  win = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
-  if (win == nullptr) {
-    glfwTerminate();
-    throw "Failed to open GLFW window";
-  }
-  winMap[win] = this;
-  //  cerr << winMap[win] << '\n';
-  //  winMap[win] = this;
-  glfwMakeContextCurrent(win);
-  glfwSetWindowSizeCallback(win, resize);
-  //	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    throw "Failed to initialize GLAD";
-  }
-  glfwSetCursorPosCallback(win, GLWin::cursorPositionCallback);
-  glfwSetMouseButtonCallback(win, GLWin::mouseButtonCallback);
-  glfwSetKeyCallback(win, keyCallback);
-  glfwSetScrollCallback(win, GLWin::scrollCallback);
-  glfwSetWindowRefreshCallback(win, GLWin::windowRefreshCallback);
+  if (headless) {
+    win = nullptr;
+    startHeadless();
+  } else {
+    win = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    if (win == nullptr) {
+      glfwTerminate();
+      throw "Failed to open GLFW window";
+    }
+    winMap[win] = this;
+    //  cerr << winMap[win] << '\n';
+    //  winMap[win] = this;
+    glfwMakeContextCurrent(win);
+    glfwSetWindowSizeCallback(win, resize);
+    //	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      throw "Failed to initialize GLAD";
+    }
+    glfwSetCursorPosCallback(win, GLWin::cursorPositionCallback);
+    glfwSetMouseButtonCallback(win, GLWin::mouseButtonCallback);
+    glfwSetKeyCallback(win, keyCallback);
+    glfwSetScrollCallback(win, GLWin::scrollCallback);
+    glfwSetWindowRefreshCallback(win, GLWin::windowRefreshCallback);
 
-  glfwSetInputMode(win, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    glfwSetInputMode(win, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+  }
   // glEnable(GL_CULL_FACE); I disable this because when we
   // change the projection to be normal screen pixels than it doesnt draw since
   // its drawing it in the opposite orientation i assume
@@ -250,6 +266,8 @@ void GLWin::startWindow() {
   tabs.add(new Tab(this));
   current = 0;
   hasBeenInitialized = true;
+  if (headless && getenv("GRAIL_CAPTURE") != nullptr)
+    startCapture(getenv("GRAIL_CAPTURE"));
 }
 void GLWin::baseInit() {
   glLineWidth(1);
@@ -257,13 +275,17 @@ void GLWin::baseInit() {
   Shader::load("solid.bin", "common.vert", "common.frag");  // Solid Color
   Shader::load("pervert.bin", "vColor.vert",
                "common.frag");                         // Color per vertex
-  Shader::load("text.bin", "text.vert", "text.frag");  // Texture for text
+  Shader::load("text.bin", "text.vert",
+               FontFace::isSdf() ? "textSdf.frag"
+                                 : "text.frag");  // Texture for text
   Shader::load("img.bin", "Texture.vert",
                "Texture.frag");  // Texture for images
   Shader::load("cursor.bin", "Cursor.vert",
                "common.frag");  // Texture for images
   Shader::load("multiText.bin", "MultiTexture.vert",
                "MultiTexture.frag");  // MultiTexture for shapes
+  Shader::load("instanced.bin", "Instanced.vert",
+               "common.frag");  // Instanced chart markers
 #if 0
   glEnable(GL_DEBUG_OUTPUT);
   glDebugMessageCallback(messageCallback, 0);
@@ -300,6 +322,8 @@ void GLWin::cleanup() {
     delete tabs[i];  // TODO:cw[i]->cleanup();
   }
   tabs.clear();
+  delete client;  // waits for requests in progress
+  client = nullptr;
   delete defaultStyle;
   defaultStyle = nullptr;
   Shader::cleanAll();
@@ -330,6 +354,10 @@ void GLWin::mainLoop() {
   needsRender = true;
   init();      // call the child class method to set up
   baseInit();  // call grails initialization for shaders
+  if (headless) {
+    headlessLoop();
+    return;
+  }
 
   float lastFrame = 0;
 
@@ -349,6 +377,7 @@ void GLWin::mainLoop() {
                    bgColor.a);  // Clear the colorbuffer and depth
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
       render();
+      captureFrame();  // before the swap, while the frame is still there
       renderTime += glfwGetTime() - startRender;
       glfwSwapBuffers(win);  // Swap buffer so the scene shows on screen
       if (frameCount >= 150) {
@@ -369,6 +398,8 @@ void GLWin::mainLoop() {
                            // simulation time
     needsUpdate = false;
     glfwPollEvents();  // Check and call events
+    // pages downloaded in the background are displayed on this thread
+    if (client != nullptr && client->drainCompletions() > 0) setUpdate();
     // note: any events needing a refresh should set dirty = true
     if (currentTab()->checkUpdate()) setUpdate();
     if (needsUpdate) {
@@ -378,6 +409,8 @@ void GLWin::mainLoop() {
       usleep(10);
     }
   }
+  delete capture;  // waits for the frames still being written
+  capture = nullptr;
   cleanup();
   glfwDestroyWindow(win);
   glfwTerminate();
@@ -402,21 +435,39 @@ void GLWin::quit() {
 
 void GLWin::refresh() { setUpdate(); }
 
+// the frame is read back when next rendered and written in the background
 void GLWin::saveFrame() {
-  if (saveBuffer != nullptr && saveW != width || saveH != height) {
-    delete[] saveBuffer;
-    saveBuffer = nullptr;
-  }
-  if (saveBuffer == nullptr) {
-    strncpy(frameName, "tmp/frame", sizeof(frameName));
-    saveW = width, saveH = height;
-    saveBuffer = new uint8_t[3 * saveW * saveH];
-  }
-  sprintf(frameName + 8, "%d.png", frameNum++);
-  glReadPixels(0, 0, saveW, saveH, GL_RGB, GL_UNSIGNED_BYTE, saveBuffer);
-  constexpr int CHANNELS = 3;
-  stbi_write_png(frameName, saveW, saveH, CHANNELS, saveBuffer,
-                 saveW * CHANNELS);  // TODO: Remove - debugging purposes
+  saveRequested = true;
+  setRender();
+}
+
+void GLWin::startCapture(const string &prefix, FrameCapture::Format format) {
+  capturePrefix = prefix;
+  captureFormat = format;
+  captureNum = 0;
+}
+
+void GLWin::stopCapture() {
+  capturePrefix.clear();
+  if (capture != nullptr) capture->finish();
+}
+
+void GLWin::captureFrame() {
+  if (!saveRequested && capturePrefix.empty()) return;
+  if (capture == nullptr) capture = new FrameCapture();
+  if (saveRequested)
+    capture->capture(width, height, fmt::format("tmp/frame{}.png", frameNum++));
+  saveRequested = false;
+  if (!capturePrefix.empty())
+    capture->capture(
+        width, height,
+        fmt::format("{}{:05}.{}", capturePrefix, captureNum++,
+                    captureFormat == FrameCapture::Format::png ? "png" : "pam"),
+        captureFormat);
+}
+
+double GLWin::getTime() const {
+  return headless ? headlessFrame / 60.0 : glfwGetTime();
 }
 
 /*
@@ -487,14 +538,32 @@ Tab *GLWin::addTab() {
 // TODO: write this, also consider writing a remove function for DynArray
 void GLWin::removeTab() {}
 
+AsyncCSPClient *GLWin::getClient() {
+  if (client == nullptr) client = new AsyncCSPClient();
+  return client;
+}
+
+/*
+  The download and decoding both run on a client worker thread, so the
+  window keeps rendering. mainLoop only hears how it went.
+*/
 void GLWin::goToLink(const char ipaddr[], uint16_t port, uint32_t requestID) {
-  IPV4Socket s(ipaddr, port);
-  s.send(requestID);
-  Buffer &in = s.getIn();
-  XDLCompiler compiler("");
-  SymbolTable *st = new SymbolTable(&compiler);
-  const XDLType *metadata = XDLType::readMeta(&compiler, in);
-  Buffer out("client.txt", 32768);
-
-  metadata->display(in, out);
+  getClient()->pageRequest(
+      ipaddr, port, requestID,
+      [](CSPResponse &r) -> string {
+        if (!r.ok()) return r.error;
+        Buffer in(r.data.size(), false);
+        in.load(r.data.data(), r.data.size());
+        XDLCompiler compiler("");
+        const XDLType *metadata = XDLType::readMeta(&compiler, in);
+        static mutex clientTxt;  // pages may arrive on two workers at once
+        lock_guard<mutex> g(clientTxt);
+        Buffer out("client.txt", 32768);
+        metadata->display(in, out);
+        return string();
+      },
+      [requestID](const string &error) {
+        if (!error.empty())
+          cerr << "request " << requestID << " failed: " << error << '\n';
+      });
 }
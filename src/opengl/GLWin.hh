@@ -11,6 +11,7 @@
 #include "opengl/Colors.hh"
 #include "opengl/GLWinFonts.hh"
 #include "opengl/Shader.hh"
+#include "opengl/util/FrameCapture.hh"
 #include "util/DynArray.hh"
 #include "util/HashMap.hh"
 class GLFWwindow;  // forward declaration, simplify: include file not needed
@@ -22,6 +23,7 @@ class Style;
 class Font;
 class XDLIterator;
 class MainCanvas;
+class AsyncCSPClient;
 
 class GLWin {
  protected:
@@ -41,21 +43,35 @@ class GLWin {
   constexpr static uint32_t TEXTURE_SHADER = 3;
   constexpr static uint32_t CURSOR_SHADER = 4;
   constexpr static uint32_t MULTI_TEXTURE_SHADER = 5;
+  constexpr static uint32_t INSTANCED_SHADER = 6;
 
  private:
   static bool ranStaticInits;
   static bool hasBeenInitialized;
   static std::unordered_map<GLFWwindow*, GLWin*> winMap;
   std::string title;
-  uint8_t* saveBuffer;  // buffer used to save screenshots
-  uint32_t saveW, saveH;
-  uint32_t frameNum;
+  uint32_t frameNum;      // screenshots saved
   double lastRenderTime;  // Stores last time of render
-  char frameName[32];
   DynArray<Tab*> tabs;  // list of web pages, ie tabs
   uint32_t current;     // current (active) tab
+  AsyncCSPClient* client;  // created by the first goToLink
   void checkUpdate();
 
+  // headless windows render through EGL, see GLWinHeadless.cc
+  bool headless;
+  void *eglDisplay, *eglContext, *eglSurface;
+  uint32_t fbo, renderbuffers[2];  // only if EGL has no pbuffers
+  uint32_t headlessFrame;
+  FrameCapture* capture;      // created by the first frame saved
+  std::string capturePrefix;  // while not empty, every frame is saved
+  FrameCapture::Format captureFormat;
+  uint32_t captureNum;
+  bool saveRequested;  // save the next frame rendered
+  void startHeadless();
+  void stopHeadless();
+  void headlessLoop();
+  void captureFrame();
+
  public:
   static std::string baseDir;
   double mouseX, mouseY;
@@ -112,6 +128,8 @@ class GLWin {
   // 0xRRGGBBaa = color (RGB, alpha = opacity) possible source of bugs
   //! need to call setSize, startWindow manually
   // exitAfter150Frames: for debugging/benchmarking purposes
+  // GRAIL_HEADLESS=n in the environment renders n frames with no window,
+  // and GRAIL_CAPTURE=prefix then saves each one
   GLWin(uint32_t w, uint32_t h, uint32_t bgColor, uint32_t fgColor,
         const std::string& title, uint32_t exitAfter = 0);
 
@@ -158,6 +176,14 @@ Shape* pick(int x, int y, Shape*); // click on (x,y), get Shape behind
 
 */
   void mainLoop();
+  bool isHeadless() const { return headless; }
+  // seconds since start, or 1/60 s per frame rendered when headless
+  double getTime() const;
+  // save every frame rendered as prefix00000.png, prefix00001.png, ...
+  void startCapture(const std::string& prefix,
+                    FrameCapture::Format format = FrameCapture::Format::png);
+  // stop saving frames and wait for the last ones to be written
+  void stopCapture();
   void setUpdate() { needsUpdate = true; }
   void setRender() { needsRender = true; }
   const Style* getDefaultStyle() const { return defaultStyle; }
@@ -187,5 +213,7 @@ Shape* pick(int x, int y, Shape*); // click on (x,y), get Shape behind
   void prevTab();
   Tab* addTab();
   void removeTab();
+  // request a page in the background, display it when it arrives
   void goToLink(const char ipaddr[], uint16_t port, uint32_t requestID);
+  AsyncCSPClient* getClient();
 };
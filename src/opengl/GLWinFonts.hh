@@ -12,8 +12,10 @@
 
 class GLWin;
 class Font;
+class GlyphAtlas;
 typedef struct FT_LibraryRec_* FT_Library;
 typedef struct FT_FaceRec_* FT_Face;
+typedef struct FT_SizeRec_* FT_Size;
 
 class FontFace {
  private:
@@ -25,7 +27,7 @@ class FontFace {
   uint32_t boldness : 5;
   uint32_t italics : 5;
   uint32_t fixed : 1;
-  uint32_t numGlyphs;  // the number of distinct glyphs rendered into this face
+  FT_Face ftFace;  // kept open to render glyphs the first time they are drawn
 
   // look up a font by size --> index into the fonts vector
   std::unordered_map<uint32_t, uint32_t> fontBySize;
@@ -35,37 +37,64 @@ class FontFace {
   void addFont(Font* f) { fonts.push_back(f); }
   uint32_t textureId;  // id of the texture in OpenGL for the ENTIRE FONT FACE
   static std::unordered_map<std::string, std::string> pathByName;
-
-  static void setTexture(const uint8_t bitmap[], uint32_t w, uint32_t h);
+  static GlyphAtlas* atlas;  // glyphs of every face and size drawn so far
+
+  /*
+    With signed distance fields each glyph is rendered once at sdfSize
+    pixels and stored as the distance to its outline, which the text shader
+    turns back into a sharp edge at any size or zoom. Every size of a face
+    shares the one copy in the atlas. sdfSize is 0 for bitmap glyphs
+    rendered separately at each size.
+  */
+  struct SdfGlyph {
+    float advance, bearingX, bearingY;  // at sdfSize
+    uint32_t sizeX, sizeY;              // of the field, padding included
+    std::vector<uint8_t> distances;     // empty if there is nothing to draw
+  };
+  static uint32_t sdfSize;
+  static uint32_t sdfSpread;  // pixels at sdfSize from the outline to 0 or 255
+  std::string facePath;
+  std::unordered_map<uint32_t, SdfGlyph> sdfGlyphs;
+  Font* reference;    // sdfSize glyphs, as placed in the atlas
+  FT_Size sdfFtSize;  // the size fields are rendered from, sdfSize oversampled
+  bool sdfChanged;    // glyphs were added since the cache was read
+
+  void startSdf();
+  // the field of c, rendered now if it is not in the cache
+  const SdfGlyph& getSdfGlyph(uint32_t c);
+  // face must be sized sdfSize * oversampling, false if c cannot be loaded
+  static bool renderSdfGlyph(FT_Face face, uint32_t c, SdfGlyph& g);
+  // render the Latin-1 fields no face has yet, in parallel, returns how many
+  static uint32_t renderSdfGlyphs();
 
   void save(std::ostream& s);  // save a single font face to binary file
-
+  // read one saved face, kept if its font file is unchanged
+  static bool load(std::istream& s);  // false if the file is cut short
   // save all font faces to a fast binary file for instant retrieval later
-  static void saveFonts(const uint8_t* combinedBitmap, uint32_t sizeX,
-                        uint32_t sizeY);
-  static bool combineFaces();
+  static void saveFonts();
+  static void loadSavedFonts();
 
  public:
   uint32_t maxWidthIndex;
   static void initAll();
   static void addFontName(std::string name, const std::string& path);
   uint32_t getTexture() const { return textureId; }
+  static GlyphAtlas* getAtlas() { return atlas; }
 
   /* Build a font face by
       opening a freetype face
-      generating each size
-      storing the rendered characters into a single large bitmap in row-major
-     scan order
+      creating a Font for each size
+     No glyph is rendered until it is drawn, see Font::getGlyph
   */
   FontFace(FT_Library ft, const std::string& faceName,
            const std::string& facePath, uint32_t minFontSize, uint32_t inc,
-           uint32_t maxFontSize, uint8_t bitmap[], uint32_t& sizeX,
-           uint32_t& sizeY, uint32_t& currX, uint32_t& currY,
-           uint32_t& rowSize);
+           uint32_t maxFontSize);
   static void emptyFaces();
   ~FontFace();
   static FT_Library ftLib;
-  const Font* getFont(uint32_t size, int weight) const;
+  // the font of this size, created the first time it is asked for
+  const Font* getFont(uint32_t size, int weight);
+  static bool isSdf() { return sdfSize != 0; }
 
   static const FontFace* getFace(int i) { return faces.at(i); }
   static const Font* get(const char faceName[], uint32_t size,
@@ -81,6 +110,7 @@ class FontFace {
 
 class Font {
   friend class FontFace;
+  friend class GlyphAtlas;
 
  public:
   class Glyph {
@@ -93,6 +123,12 @@ class Font {
     float v1;  // top edge of texture
     float v0;  // bottom edge of texture
     // NOTE the order!!! v1 is top, v0 is bottom
+    // u and v are in pixels of the GlyphAtlas, which can grow
+
+    static constexpr int32_t UNLOADED = -1;   // not rendered, or evicted
+    static constexpr int32_t NO_BITMAP = -2;  // nothing to draw, like a space
+    int32_t shelf = UNLOADED;  // shelf of the atlas holding the bitmap
+    uint32_t lastUse = 0;      // Font::useClock when last drawn
     Glyph(float advance, float bearingX, float bearingY, float sizeX,
           float sizeY, float u0, float u1, float v1, float v0)
         : advance(advance),
@@ -112,41 +148,49 @@ class Font {
   FontFace* parentFace;
   // TODO:uint32_t parentFace;   // offset of parent into the static fontface
   // table for ease of serialization to disk
+  FT_Size ftSize;   // this size of the parent's FreeType face
   uint16_t height;  // height of rectangle for each glyph of this font in pixels
   uint32_t
       startGlyph;  // first character to be written, 32 bits to handle any char
-  // uint32_t numGlyphs;    // number of glyphs supported, some might be the
-  // same
   uint32_t textureId;
-  std::vector<Glyph> glyphs;
+  // Glyphs are rendered into the atlas the first time they are asked for.
+  // Both containers keep their elements in place, so Glyph pointers last.
+  mutable std::vector<Glyph> latin;  // code points below 256
+  mutable std::unordered_map<uint32_t, Glyph> others;
+
+  void loadGlyph(uint32_t c, Glyph* g) const;
+  void loadSdfGlyph(uint32_t c, Glyph* g) const;
 
  public:
   uint32_t maxWidth;    // biggest width of any glyph
   uint16_t spaceWidth;  // width of a space character
-  Font(FontFace* Face, FT_Face ftFace, uint16_t height, uint8_t bitmap[],
-       uint32_t& sizeX, uint32_t& sizeY, uint32_t& currX, uint32_t& currY,
-       uint32_t& rowSize);
-  Font(std::istream&);
+  // advanced by each GlyphAtlas::flush, the atlas evicts by it
+  static inline uint32_t useClock = 1;
+
+  Font(FontFace* face, uint16_t height);
   ~Font();
 
   uint32_t getStartGlyph() const { return startGlyph; }
-  void addGlyph(FT_Face ftFace,
-                std::unordered_map<uint32_t, uint32_t>& glyphMap, uint8_t c,
-                uint8_t bitmap[], uint32_t& sizeX, uint32_t& sizeY,
-                uint32_t& currX, uint32_t& currY, uint32_t& rowSize);
-  const Glyph* getGlyph(uint32_t i) const { return &glyphs.at(i); }
+  // the glyph for code point c, rendered now if this is its first use
+  const Glyph* getGlyph(uint32_t c) const {
+    Glyph* g = c < latin.size() ? &latin[c] : &others[c];
+    if (g->shelf == Glyph::UNLOADED) loadGlyph(c, g);
+    g->lastUse = useClock;
+    return g;
+  }
   uint16_t getHeight() const { return height; }
   uint32_t getTexture() const {
     return textureId;
   }  // get the texture shared by all Fonts within the FontFace
+  // width of UTF-8 text
   float getWidth(const char text[], const uint32_t len) const;
   friend std::ostream& operator<<(std::ostream& s, const Font& f) {
-    return s << "Font height=" << f.height << " numGlyphs=" << f.glyphs.size();
+    return s << "Font height=" << f.height
+             << " numGlyphs=" << f.latin.size() + f.others.size();
     // return s << "Font " << f.parentFace->faceName << " height=" << f.height
     // << " numGlyphs=" << f.numGlyphs; // friend isn't working? what a pain
     // return s << "Font " << FontFace::faces[f.parentFace]->faceName << "
     // height=" << f.height << " numGlyphs=" << f.numGlyphs;
   }
-  void save(std::ostream& fastfont);
   static Font* getDefault();
 };
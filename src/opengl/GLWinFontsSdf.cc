@@ -0,0 +1,348 @@
+#include <sys/stat.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SIZES_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "opengl/GLWin.hh"
+#include "opengl/GLWinFonts.hh"
+#include "opengl/util/GlyphAtlas.hh"
+#include "util/ParallelFor.hh"
+
+using namespace std;
+
+uint32_t FontFace::sdfSize = 0;
+uint32_t FontFace::sdfSpread = 6;
+
+namespace {
+// outlines are rendered this many times finer than the field, so distances
+// are measured to the smooth edge rather than to the pixels of one render
+constexpr uint32_t OVERSAMPLE = 4;
+constexpr float FAR_AWAY = 1e20f;
+
+/*
+  Replace each of the n values of f, stride apart, by the least of
+  (q - p)^2 + f[p] over all p: the lower envelope of a parabola rooted at
+  each value, linear in n (Felzenszwalb and Huttenlocher). Starting from 0
+  at the pixels to measure to and FAR_AWAY elsewhere, a pass over columns then
+  rows leaves squared distances. d, v and z are scratch of n + 1.
+*/
+void distance1D(float* f, uint32_t n, uint32_t stride, vector<float>& d,
+                vector<int32_t>& v, vector<float>& z) {
+  int32_t k = 0;
+  v[0] = 0;
+  z[0] = -FAR_AWAY, z[1] = FAR_AWAY;
+  for (int32_t q = 1; q < int32_t(n); q++) {
+    const float fq = f[q * stride] + float(q) * q;
+    float s;
+    for (;;) {
+      const int32_t r = v[k];
+      s = (fq - (f[r * stride] + float(r) * r)) / (2.0f * (q - r));
+      if (s > z[k]) break;
+      k--;
+    }
+    k++;
+    v[k] = q, z[k] = s, z[k + 1] = FAR_AWAY;
+  }
+  k = 0;
+  for (uint32_t q = 0; q < n; q++) {
+    while (z[k + 1] < q) k++;
+    const float dq = float(q) - v[k];
+    d[q] = dq * dq + f[v[k] * stride];
+  }
+  for (uint32_t q = 0; q < n; q++) f[q * stride] = d[q];
+}
+
+void distance2D(vector<float>& f, uint32_t w, uint32_t h) {
+  const uint32_t n = max(w, h);
+  vector<float> d(n + 1), z(n + 1);
+  vector<int32_t> v(n + 1);
+  for (uint32_t x = 0; x < w; x++) distance1D(&f[x], h, w, d, v, z);
+  for (uint32_t y = 0; y < h; y++)
+    distance1D(&f[uint64_t(y) * w], w, 1, d, v, z);
+}
+
+template <typename T>
+void writeValue(ostream& s, const T& v) {
+  s.write((const char*)&v, sizeof(T));
+}
+
+template <typename T>
+bool readValue(istream& s, T& v) {
+  return bool(s.read((char*)&v, sizeof(T)));
+}
+
+// size and modification time of a font file, to tell when it changes
+void stamp(const string& path, uint64_t& size, int64_t& mtime) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    size = 0, mtime = 0;
+    return;
+  }
+  size = st.st_size, mtime = st.st_mtime;
+}
+
+/*
+  Format for header of the binary file to fastload fonts. It holds the
+  distance fields rendered so far, which are only good for the same size
+  and spread.
+*/
+struct FastFontHeader {
+  uint32_t magic;     // the magic number identifying this file
+  uint32_t version;   // version number of the implementation
+  uint32_t sdfSize;   // size the fields were rendered at
+  uint32_t sdfSpread;
+  uint32_t numFaces;  // number of individual font faces
+};
+constexpr uint32_t FAST_FONT_MAGIC = 0x544E4644;
+constexpr uint32_t FAST_FONT_VERSION = 2;
+}  // namespace
+
+/*
+  Each field pixel is the signed distance from its center to the outline,
+  positive inside, in pixels at sdfSize. 127.5 is the outline and sdfSpread
+  pixels either side are 255 and 0, so the field is padded by sdfSpread to
+  hold the whole falloff. The outline is thresholded at 4x the size and
+  each field pixel averages the 2x2 fine pixels around its center.
+*/
+bool FontFace::renderSdfGlyph(FT_Face face, uint32_t c, SdfGlyph& g) {
+  g = SdfGlyph{0, 0, 0, 0, 0, {}};
+  if (FT_Load_Char(face, c,
+                   FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP))
+    return false;
+  const FT_GlyphSlot slot = face->glyph;
+  const FT_Bitmap& b = slot->bitmap;
+  g.advance = slot->advance.x / 64.0f / OVERSAMPLE;
+  if (b.buffer == nullptr || b.width == 0 || b.rows == 0) return true;
+  if (b.pixel_mode != FT_PIXEL_MODE_GRAY) return false;
+  // the field starts on a whole pixel at sdfSize, the fine bitmap up to
+  // OVERSAMPLE - 1 fine pixels into it
+  const int32_t k = OVERSAMPLE;
+  const int32_t left = slot->bitmap_left >= 0
+                           ? slot->bitmap_left / k
+                           : -((k - 1 - slot->bitmap_left) / k);
+  const int32_t top = slot->bitmap_top >= 0 ? (slot->bitmap_top + k - 1) / k
+                                            : -(-slot->bitmap_top / k);
+  const int32_t offX = slot->bitmap_left - left * k,
+                offY = top * k - slot->bitmap_top;
+  g.sizeX = (offX + b.width + k - 1) / k + 2 * sdfSpread;
+  g.sizeY = (offY + b.rows + k - 1) / k + 2 * sdfSpread;
+  g.bearingX = left - int32_t(sdfSpread);
+  g.bearingY = top + int32_t(sdfSpread);
+
+  // squared distances to the nearest pixel inside the glyph, and outside
+  const uint32_t w = g.sizeX * OVERSAMPLE, h = g.sizeY * OVERSAMPLE;
+  const int32_t pad = sdfSpread * OVERSAMPLE;
+  vector<float> toInside(uint64_t(w) * h), toOutside(uint64_t(w) * h);
+  vector<bool> inside(uint64_t(w) * h);
+  for (uint32_t y = 0; y < h; y++)
+    for (uint32_t x = 0; x < w; x++) {
+      const int32_t bx = int32_t(x) - pad - offX,
+                    by = int32_t(y) - pad - offY;
+      const uint64_t i = uint64_t(y) * w + x;
+      inside[i] = bx >= 0 && by >= 0 && bx < int32_t(b.width) &&
+                  by < int32_t(b.rows) &&
+                  b.buffer[int64_t(by) * b.pitch + bx] >= 128;
+      toInside[i] = inside[i] ? 0 : FAR_AWAY;
+      toOutside[i] = inside[i] ? FAR_AWAY : 0;
+    }
+  distance2D(toInside, w, h);
+  distance2D(toOutside, w, h);
+
+  // the edge lies half a fine pixel past the centers either side of it
+  auto signedDistance = [&](uint32_t x, uint32_t y) {
+    const uint64_t i = uint64_t(y) * w + x;
+    return inside[i] ? sqrt(toOutside[i]) - 0.5f : 0.5f - sqrt(toInside[i]);
+  };
+  g.distances.resize(uint64_t(g.sizeX) * g.sizeY);
+  const float toByte = 127.5f / (OVERSAMPLE * sdfSpread);
+  for (uint32_t y = 0; y < g.sizeY; y++)
+    for (uint32_t x = 0; x < g.sizeX; x++) {
+      const uint32_t fx = x * OVERSAMPLE + OVERSAMPLE / 2,
+                     fy = y * OVERSAMPLE + OVERSAMPLE / 2;
+      const float d =
+          (signedDistance(fx - 1, fy - 1) + signedDistance(fx, fy - 1) +
+           signedDistance(fx - 1, fy) + signedDistance(fx, fy)) *
+          0.25f;
+      g.distances[uint64_t(y) * g.sizeX + x] =
+          uint8_t(lround(clamp(127.5f + d * toByte, 0.0f, 255.0f)));
+    }
+  return true;
+}
+
+void FontFace::startSdf() {
+  reference = new Font(this, sdfSize);
+  FT_New_Size(ftFace, &sdfFtSize);
+  FT_Activate_Size(sdfFtSize);
+  FT_Set_Pixel_Sizes(ftFace, 0, sdfSize * OVERSAMPLE);
+}
+
+const FontFace::SdfGlyph& FontFace::getSdfGlyph(uint32_t c) {
+  auto i = sdfGlyphs.find(c);
+  if (i != sdfGlyphs.end()) return i->second;
+  SdfGlyph& g = sdfGlyphs[c];
+  FT_Activate_Size(sdfFtSize);
+  if (!renderSdfGlyph(ftFace, c, g))
+    cerr << "Failed to load glyph for c=" << c << '\n';
+  sdfChanged = true;
+  return g;
+}
+
+/*
+  FreeType objects may only be used by one thread at a time, so each block
+  of glyphs opens the faces it needs in a library of its own.
+*/
+uint32_t FontFace::renderSdfGlyphs() {
+  struct Job {
+    FontFace* face;
+    uint32_t c;
+    SdfGlyph g;
+  };
+  vector<Job> jobs;
+  for (auto face : faces)
+    for (uint32_t c = 32; c < 256; c++)
+      if ((c < 127 || c >= 160) && face->sdfGlyphs.count(c) == 0)
+        jobs.push_back(Job{face, c, {}});
+  constexpr uint32_t BLOCK = 32;
+  parallelFor((jobs.size() + BLOCK - 1) / BLOCK, 0, 1, [&](uint32_t block) {
+    FT_Library ft;
+    if (FT_Init_FreeType(&ft)) return;
+    FT_Face ftFace = nullptr;
+    const FontFace* opened = nullptr;
+    const uint32_t end = min(uint32_t(jobs.size()), (block + 1) * BLOCK);
+    for (uint32_t i = block * BLOCK; i < end; i++) {
+      Job& j = jobs[i];
+      if (j.face != opened) {
+        if (ftFace != nullptr) FT_Done_Face(ftFace);
+        opened = j.face;
+        if (FT_New_Face(ft, j.face->facePath.c_str(), 0, &ftFace))
+          ftFace = nullptr;
+        else
+          FT_Set_Pixel_Sizes(ftFace, 0, sdfSize * OVERSAMPLE);
+      }
+      if (ftFace != nullptr) renderSdfGlyph(ftFace, j.c, j.g);
+    }
+    FT_Done_FreeType(ft);  // and the face still open
+  });
+  for (Job& j : jobs) {
+    j.face->sdfGlyphs[j.c] = std::move(j.g);
+    j.face->sdfChanged = true;
+  }
+  return jobs.size();
+}
+
+/*
+  With distance fields, a glyph of the reference size is placed in the
+  atlas from its field and every other size draws the same pixels scaled.
+*/
+void Font::loadSdfGlyph(uint32_t c, Glyph* g) const {
+  if (this == parentFace->reference) {
+    const FontFace::SdfGlyph& s = parentFace->getSdfGlyph(c);
+    *g = Glyph(s.advance, s.bearingX, s.bearingY, s.sizeX, s.sizeY, 0, 0, 0,
+               0);
+    if (s.distances.empty())
+      g->shelf = Glyph::NO_BITMAP;
+    else
+      parentFace->atlas->add(
+          g, s.distances.data(), s.sizeX, s.sizeY, s.sizeX,
+          (ftSize->metrics.height >> 6) + 2 * FontFace::sdfSpread);
+    return;
+  }
+  const Glyph* r = parentFace->reference->getGlyph(c);
+  const float scale = float(height) / FontFace::sdfSize;
+  *g = Glyph(r->advance * scale, r->bearingX * scale, r->bearingY * scale,
+             r->sizeX * scale, r->sizeY * scale, 0, 0, 0, 0);
+  if (r->shelf == Glyph::NO_BITMAP)
+    g->shelf = Glyph::NO_BITMAP;
+  else if (r->shelf >= 0)
+    parentFace->atlas->share(g, r);
+  // else the atlas is full this frame: blank, and looked up again next frame
+}
+
+void FontFace::save(ostream& fastfont) {
+  writeValue(fastfont, uint32_t(faceName.size()));
+  fastfont.write(faceName.data(), faceName.size());
+  uint64_t size;
+  int64_t mtime;
+  stamp(facePath, size, mtime);
+  writeValue(fastfont, size);
+  writeValue(fastfont, mtime);
+  writeValue(fastfont, uint32_t(sdfGlyphs.size()));
+  for (const auto& [c, g] : sdfGlyphs) {
+    writeValue(fastfont, c);
+    writeValue(fastfont, g.advance);
+    writeValue(fastfont, g.bearingX);
+    writeValue(fastfont, g.bearingY);
+    writeValue(fastfont, g.sizeX);
+    writeValue(fastfont, g.sizeY);
+    fastfont.write((const char*)g.distances.data(), g.distances.size());
+  }
+  sdfChanged = false;
+}
+
+bool FontFace::load(istream& fastfont) {
+  uint32_t nameLen;
+  if (!readValue(fastfont, nameLen) || nameLen > 4096) return false;
+  string name(nameLen, '\0');
+  uint64_t size;
+  int64_t mtime;
+  uint32_t numGlyphs;
+  if (!fastfont.read(name.data(), nameLen) || !readValue(fastfont, size) ||
+      !readValue(fastfont, mtime) || !readValue(fastfont, numGlyphs))
+    return false;
+  unordered_map<uint32_t, SdfGlyph> glyphs;
+  for (uint32_t i = 0; i < numGlyphs; i++) {
+    uint32_t c;
+    SdfGlyph g;
+    if (!readValue(fastfont, c) || !readValue(fastfont, g.advance) ||
+        !readValue(fastfont, g.bearingX) || !readValue(fastfont, g.bearingY) ||
+        !readValue(fastfont, g.sizeX) || !readValue(fastfont, g.sizeY) ||
+        uint64_t(g.sizeX) * g.sizeY > (1U << 24))
+      return false;
+    g.distances.resize(uint64_t(g.sizeX) * g.sizeY);
+    if (!fastfont.read((char*)g.distances.data(), g.distances.size()))
+      return false;
+    glyphs[c] = std::move(g);
+  }
+  auto index = faceByName.find(name);
+  if (index == faceByName.end()) return true;  // no longer in fonts.conf
+  FontFace* face = faces[index->second];
+  uint64_t nowSize;
+  int64_t nowMtime;
+  stamp(face->facePath, nowSize, nowMtime);
+  if (nowSize == size && nowMtime == mtime) face->sdfGlyphs = std::move(glyphs);
+  return true;
+}
+
+/*
+ save the distance fields of all faces into a single binary file that can
+ be rapidly loaded
+*/
+void FontFace::saveFonts() {
+  ofstream fastfont(GLWin::baseDir + "fast.glfont", ios::binary);
+  FastFontHeader header{FAST_FONT_MAGIC, FAST_FONT_VERSION, sdfSize,
+                        sdfSpread, uint32_t(faces.size())};
+  writeValue(fastfont, header);
+  for (auto face : faces) face->save(fastfont);  // save individual face
+  if (!fastfont)
+    cerr << "could not save fonts to " << GLWin::baseDir << "fast.glfont\n";
+}
+
+void FontFace::loadSavedFonts() {
+  ifstream fastfont(GLWin::baseDir + "fast.glfont", ios::binary);
+  FastFontHeader header;
+  if (!readValue(fastfont, header) || header.magic != FAST_FONT_MAGIC ||
+      header.version != FAST_FONT_VERSION || header.sdfSize != sdfSize ||
+      header.sdfSpread != sdfSpread)
+    return;
+  for (uint32_t i = 0; i < header.numFaces; i++)
+    if (!load(fastfont)) {
+      // cut short, render everything again rather than trust any of it
+      for (auto face : faces) face->sdfGlyphs.clear();
+      return;
+    }
+}
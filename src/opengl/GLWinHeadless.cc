@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "csp/AsyncCSPClient.hh"
+#include "glad/glad.h"
+#include "opengl/GLWin.hh"
+#include "opengl/Tab.hh"
+
+#ifdef GRAIL_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/*
+  Headless windows render through EGL with no display server, so charts can
+  be drawn on a server, frames captured for a movie, and pictures compared
+  in tests on machines with no GPU at all (Mesa's llvmpipe).
+
+  The display is Mesa's surfaceless platform where there is one, otherwise
+  the default display (NVIDIA's drivers are headless that way). Frames go
+  to a pbuffer the size of the window, so the default framebuffer works as
+  it does on screen. A driver with no pbuffers gets a surfaceless context
+  and a framebuffer object of the same size bound in its place.
+*/
+#ifdef GRAIL_EGL
+void GLWin::startHeadless() {
+  EGLDisplay display = EGL_NO_DISPLAY;
+  auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+      "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay != nullptr)
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, nullptr);
+  EGLint major, minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+      throw "Failed to initialize EGL";
+  }
+  eglDisplay = display;
+  if (!eglBindAPI(EGL_OPENGL_API)) throw "EGL has no desktop OpenGL";
+
+  const EGLint configAttribs[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RED_SIZE,   8,
+      EGL_GREEN_SIZE,   8,               EGL_BLUE_SIZE,  8,
+      EGL_ALPHA_SIZE,   8,               EGL_DEPTH_SIZE, 24,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint numConfigs = 0;
+  eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+
+  const EGLint contextAttribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE};
+  EGLContext context = eglCreateContext(
+      display, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+      contextAttribs);
+  if (context == EGL_NO_CONTEXT) throw "Failed to create EGL context";
+  eglContext = context;
+
+  EGLSurface surface = EGL_NO_SURFACE;
+  if (numConfigs > 0) {
+    const EGLint pbufferAttribs[] = {EGL_WIDTH, EGLint(width), EGL_HEIGHT,
+                                     EGLint(height), EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+  }
+  eglSurface = surface;
+  if (!eglMakeCurrent(display, surface, surface, context))
+    throw "Failed to make EGL context current";
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    throw "Failed to initialize GLAD";
+
+  if (surface == EGL_NO_SURFACE) {
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      throw "Failed to create headless framebuffer";
+  }
+  glViewport(0, 0, width, height);
+  std::cerr << "headless: EGL " << major << '.' << minor << ", "
+            << glGetString(GL_RENDERER) << '\n';
+}
+
+void GLWin::stopHeadless() {
+  if (fbo != 0) {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(2, renderbuffers);
+    fbo = 0;
+  }
+  eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (eglSurface != EGL_NO_SURFACE) eglDestroySurface(eglDisplay, eglSurface);
+  eglDestroyContext(eglDisplay, eglContext);
+  eglTerminate(eglDisplay);
+}
+#else
+void GLWin::startHeadless() {
+  throw "Headless windows need EGL, which was not found at build time";
+}
+
+void GLWin::stopHeadless() {}
+#endif
+
+/*
+  Headless frames follow one another as fast as they render, each 1/60 s
+  later by getTime(), so animations play at the same speed on any machine
+  and a given frame always looks the same.
+*/
+void GLWin::headlessLoop() {
+  uint32_t frames = exitAfter;
+  if (frames == 0) frames = std::max(1, atoi(getenv("GRAIL_HEADLESS")));
+  for (headlessFrame = 0; headlessFrame < frames; headlessFrame++) {
+    glClearColor(bgColor.r, bgColor.g, bgColor.b, bgColor.a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    render();
+    captureFrame();
+    currentTab()->tick();
+    if (client != nullptr && client->drainCompletions() > 0) setUpdate();
+    if (currentTab()->checkUpdate()) setUpdate();
+    if (needsUpdate) {
+      update();
+      needsUpdate = false;
+    }
+  }
+  delete capture;  // waits for the frames still being written
+  capture = nullptr;
+  cleanup();
+  stopHeadless();
+}
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <span>
 #include <string>
 
 #include "data/GapMinderLoader.hh"
@@ -52,8 +53,6 @@ void GapMinderWidget::chart(const vector<float>& yLocations,
     float xPoint = xAxis->transform(xLocations[i]);
     float yPoint = yAxis->transform(yLocations[i]);
 
-    cout << "hello indide draw" << endl;
-
     m->fillCircle(xPoint, yPoint, rad[i], 3, c[i]);
     m->drawCircle(xPoint, yPoint, rad[i], 3, grail::black);
   }
@@ -84,42 +83,39 @@ void GapMinderWidget::loadData(string sy, string sx, string ss, int startY,
 }
 
 void GapMinderWidget::animate(int rulerIntervalX, int rulerIntervalY) {
-  if (startYear == endYear) {
+  if (startYear == endYear || d == nullptr || d2 == nullptr || d3 == nullptr) {
     return;
   }
 
-  cout << "hello inside animate" << endl;
-
   // m->clear();
   // t->clear();
 
-  vector<float> x1 = gml->getAllDataOneYear(startYear, d);
-
-  vector<float> x2;
-
-  vector<float> y1 = gml->getAllDataOneYear(startYear, d2);
-
-  vector<float> y2;
-
-  vector<float> s1 = gml->getAllDataOneYear(startYear, d3);
-
-  vector<float> s2;
-
-  vector<glm::vec4> colorContinent = {grail::yellow, grail::blue, grail::cyan,
-                                      grail::green,  grail::pink, grail::red};
-
-  vector<glm::vec4> c2;
-
-  for (int i = 0; i < x1.size(); i++) {
-    if (x1[i] < 1000000 && y1[i] < 1000000 && s1[i] < 1000000) {
-      x2.push_back(x1[i]);
-      y2.push_back(y1[i]);
-      s2.push_back(s1[i]);
-      c2.push_back(colorContinent[gml->continents[i]]);
+  // spans into the loaded file, nothing is copied
+  span<const float> x1 = gml->getAllDataOneYear(startYear, d);
+  span<const float> y1 = gml->getAllDataOneYear(startYear, d2);
+  span<const float> s1 = gml->getAllDataOneYear(startYear, d3);
+
+  static const vector<glm::vec4> colorContinent = {
+      grail::yellow, grail::blue, grail::cyan, grail::green,
+      grail::pink,   grail::red,  grail::gray};
+
+  xs.clear();
+  ys.clear();
+  sizes.clear();
+  colors.clear();
+  if (!x1.empty() && !y1.empty() && !s1.empty()) {
+    for (uint32_t i = 0; i < x1.size(); i++) {
+      // NaN, for a country missing that year, fails these too
+      if (x1[i] < 1000000 && y1[i] < 1000000 && s1[i] < 1000000) {
+        xs.push_back(x1[i]);
+        ys.push_back(y1[i]);
+        sizes.push_back(s1[i]);
+        colors.push_back(colorContinent[gml->continents[i]]);
+      }
     }
   }
 
-  chart(y2, x2, s2, rulerIntervalX, rulerIntervalY, c2);
+  if (!xs.empty()) chart(ys, xs, sizes, rulerIntervalX, rulerIntervalY, colors);
 
   startYear++;
 }
@@ -34,6 +34,9 @@ class GapMinderWidget : public Widget2D {
   const GapMinderLoader::Dataset* d3;
   int startYear;
   int endYear;
+  // the points drawn each frame, kept so animating doesn't allocate
+  std::vector<float> xs, ys, sizes;
+  std::vector<glm::vec4> colors;
 
  public:
   GapMinderWidget(StyledMultiShape2D* m, MultiText* t, float x, float y,
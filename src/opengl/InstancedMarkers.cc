@@ -0,0 +1,131 @@
+#include "opengl/InstancedMarkers.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glad/glad.h"
+#include "opengl/Canvas.hh"
+#include "opengl/GLMath.hh"
+#include "opengl/Shader.hh"
+
+using namespace std;
+
+namespace {
+/*
+  A triangle fan of the center and points on the unit circle every angleInc
+  degrees, laid out the way StyledMultiShape2D::fillEllipse does it.
+*/
+void addFan(vector<float>& v, float angleInc) {
+  v.push_back(0);
+  v.push_back(0);
+  for (float a = 0; a <= 360; a += angleInc) {
+    v.push_back(cos(-a * DEG2RAD<float>));
+    v.push_back(sin(-a * DEG2RAD<float>));
+  }
+}
+
+// per instance attributes of markers starting offset bytes into the buffer
+void pointInstances(uint64_t offset) {
+  const uint32_t stride = 4 * sizeof(float);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride,
+                        (void*)(offset + 2 * sizeof(float)));
+  glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                        (void*)(offset + 3 * sizeof(float)));
+}
+}  // namespace
+
+uint32_t InstancedMarkers::pack(const glm::vec4& c) {
+  auto byte = [](float f) {
+    return uint32_t(clamp(f, 0.0f, 1.0f) * 255 + 0.5f);
+  };
+  return byte(c.r) | byte(c.g) << 8 | byte(c.b) << 16 | byte(c.a) << 24;
+}
+
+uint64_t InstancedMarkers::size() const {
+  uint64_t n = 0;
+  for (const auto& list : instances) n += list.size();
+  return n;
+}
+
+void InstancedMarkers::clear() {
+  for (auto& list : instances) list.clear();
+  changed = true;
+}
+
+void InstancedMarkers::init() {
+  vector<float> v;
+  auto fan = [&](Marker m, float angleInc) {
+    const uint32_t first = v.size() / 2;
+    addFan(v, angleInc);
+    templates[uint32_t(m)] =
+        Template{first, uint32_t(v.size() / 2 - first), GL_TRIANGLE_FAN};
+  };
+  fan(Marker::circle, 3);
+  fan(Marker::square, 90);
+  fan(Marker::hexagon, 60);
+  fan(Marker::triangle, 120);
+  fan(Marker::pentagon, 72);
+  templates[uint32_t(Marker::cross)] = Template{uint32_t(v.size() / 2), 4,
+                                                GL_LINES};
+  v.insert(v.end(), {0, 1, 0, -1, -1, 0, 1, 0});
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(float), v.data(),
+               GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+
+  glGenBuffers(1, &instanceBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  pointInstances(0);
+  for (uint32_t a = 1; a <= 3; a++) {
+    glEnableVertexAttribArray(a);
+    glVertexAttribDivisor(a, 1);
+  }
+  glBindVertexArray(0);
+  capacity = 0;
+  changed = true;
+  update();
+}
+
+// all the markers in one buffer, grouped by kind
+void InstancedMarkers::update() {
+  if (!changed) return;
+  const uint64_t n = size();
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  if (n > capacity) {
+    capacity = max<uint64_t>(n, 2 * capacity);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Instance), nullptr,
+                 GL_DYNAMIC_DRAW);
+  }
+  uint64_t offset = 0;
+  for (const auto& list : instances) {
+    if (list.empty()) continue;
+    glBufferSubData(GL_ARRAY_BUFFER, offset, list.size() * sizeof(Instance),
+                    list.data());
+    offset += list.size() * sizeof(Instance);
+  }
+  changed = false;
+}
+
+void InstancedMarkers::render() {
+  if (size() == 0) return;
+  Shader* shader = Shader::useShader(GLWin::INSTANCED_SHADER);
+  shader->setMat4("projection", *parentCanvas->getProjection());
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  uint64_t offset = 0;
+  for (uint32_t m = 0; m < NUM_MARKERS; m++) {
+    const uint32_t n = instances[m].size();
+    if (n == 0) continue;
+    pointInstances(offset);
+    glDrawArraysInstanced(templates[m].mode, templates[m].first,
+                          templates[m].count, n);
+    offset += n * sizeof(Instance);
+  }
+  glBindVertexArray(0);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "opengl/Shape.hh"
+
+/*
+  Chart markers drawn by instancing. Each kind of marker is one template
+  mesh of unit radius, made once, and each marker is 16 bytes of instance
+  data: its center, its size and its color. All the markers of one kind are
+  one draw call, so a million point scatter plot is 16MB to upload and a
+  handful of draws instead of tens of millions of vertices built on the CPU.
+
+  The templates match StyledMultiShape2D's drawCircleMarker and friends, so
+  size is the radius.
+*/
+class InstancedMarkers : public Shape {
+ public:
+  enum class Marker : uint8_t {
+    circle,
+    square,
+    hexagon,
+    triangle,
+    pentagon,
+    cross,
+  };
+  static constexpr uint32_t NUM_MARKERS = 6;
+
+ private:
+  struct Instance {
+    float x, y, size;
+    uint32_t color;  // RGBA, a byte each
+  };
+  // a range of the template buffer and how to draw it
+  struct Template {
+    uint32_t first, count, mode;
+  };
+  std::vector<Instance> instances[NUM_MARKERS];
+  Template templates[NUM_MARKERS];
+  uint32_t instanceBuffer;
+  uint32_t capacity;  // instances the buffer has room for
+  bool changed;
+
+  static uint32_t pack(const glm::vec4& c);
+
+ public:
+  InstancedMarkers(Canvas* parent)
+      : Shape(parent), capacity(0), changed(false) {}
+  InstancedMarkers(const InstancedMarkers& orig) = delete;
+  InstancedMarkers& operator=(const InstancedMarkers& orig) = delete;
+
+  void add(Marker m, float x, float y, float size, const glm::vec4& c) {
+    instances[uint32_t(m)].push_back(Instance{x, y, size, pack(c)});
+    changed = true;
+  }
+  uint64_t size() const;
+  void clear();
+
+  void init() override;
+  void update() override;
+  void render() override;
+};
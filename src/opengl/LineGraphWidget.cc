@@ -1,6 +1,7 @@
 #include "opengl/LineGraphWidget.hh"
 
 #include <algorithm>
+#include <cmath>
 #include <numbers>  // C++20 constants
 
 #include "util/Ex.hh"
@@ -9,7 +10,7 @@ using namespace std;
 
 void LineGraphWidget::setPointFormat(char pt, double size, glm::vec4& color) {
   pointSize = size;
-  markerFunction = marker_pointer_table[pt];
+  marker = marker_table[pt];
 }
 
 void LineGraphWidget::setXPoints(const std::vector<double>& xPoints) {
@@ -20,63 +21,101 @@ void LineGraphWidget::setYPoints(const std::vector<double>& yPoints) {
   this->yPoints = yPoints;
 }
 
-void LineGraphWidget::init() {
-  if (xPoints.size() < 1 || yPoints.size() < 1) {
-    cerr << "x and y vectors cannot be zero length";
-    throw(Ex1(Errcode::VECTOR_ZERO_LENGTH));
-  }
+void LineGraphWidget::setSeries(const TimeSeries* series) {
+  this->series = series;
+}
 
-  if (xPoints.size() != yPoints.size()) {
-    cerr << "x and y vectors must be the same length";
-    throw(Ex1(Errcode::VECTOR_MISMATCHED_LENGTHS));
+void LineGraphWidget::init() {
+  if (series == nullptr) {
+    if (xPoints.size() < 1 || yPoints.size() < 1) {
+      cerr << "x and y vectors cannot be zero length";
+      throw(Ex1(Errcode::VECTOR_ZERO_LENGTH));
+    }
+
+    if (xPoints.size() != yPoints.size()) {
+      cerr << "x and y vectors must be the same length";
+      throw(Ex1(Errcode::VECTOR_MISMATCHED_LENGTHS));
+    }
+    if (xPoints.size() > w && is_sorted(xPoints.begin(), xPoints.end())) {
+      ownSeries = make_unique<TimeSeries>(xPoints, yPoints);
+      series = ownSeries.get();
+    }
   }
 
   StyledMultiShape2D* m = c->addLayer(new StyledMultiShape2D(c, &s->dataStyle));
-
-  double xMin = xAxis->getMinBound();
-  double xMax = xAxis->getMaxBound();
-  double yMin = yAxis->getMinBound();
-  double yMax = yAxis->getMaxBound();
-
-  double xInterval = xAxis->getTickInterval();
-  double yInterval = yAxis->getTickInterval();
-
-  if (xAxisType == LOGARITHMIC) {
-    double base = 1 / log(xInterval);
-    double scale = w / abs(log(xMax) * base - log(xMin) * base);
-    transform(
-        xPoints.begin(), xPoints.end(), xPoints.begin(),
-        [=, this](double d) -> double { return x + scale * log(d) * base; });
-  } else {
-    double scale = w / abs(xMax - xMin);
-    transform(xPoints.begin(), xPoints.end(), xPoints.begin(),
-              [=, this](double d) -> double { return x + scale * d; });
-  }
-
-  if (yAxisType == LOGARITHMIC) {
-    double base = 1 / log(yInterval);
-    double scale = -h / abs(log(yMax) * base - log(yMin) * base);
-    transform(yPoints.begin(), yPoints.end(), yPoints.begin(),
-              [=, this](double d) -> double {
-                return y + h + scale * log(d) * base;
-              });
-  } else {
-    double scale = -h / abs(yMax - yMin);
-    transform(yPoints.begin(), yPoints.end(), yPoints.begin(),
-              [=, this](double d) -> double { return y + h + scale * d; });
+  InstancedMarkers* markers = c->addLayer(new InstancedMarkers(c));
+
+  const double xMin = xAxis->getMinBound();
+  const double xMax = xAxis->getMaxBound();
+  const double yMin = yAxis->getMinBound();
+  const double yMax = yAxis->getMaxBound();
+
+  const double xInterval = xAxis->getTickInterval();
+  const double yInterval = yAxis->getTickInterval();
+  const bool xLog = xAxisType == LOGARITHMIC, yLog = yAxisType == LOGARITHMIC;
+
+  // distance from the axis minimum, on log axes in powers of the interval
+  auto along = [](bool isLog, double d, double min, double interval) {
+    return isLog ? log(d / min) / log(interval) : d - min;
+  };
+  const double xScale = w / abs(along(xLog, xMax, xMin, xInterval));
+  const double yScale = -h / abs(along(yLog, yMax, yMin, yInterval));
+  auto toX = [&](double d) {
+    return x + xScale * along(xLog, d, xMin, xInterval);
+  };
+  auto toY = [&](double d) {
+    return y + h + yScale * along(yLog, d, yMin, yInterval);
+  };
+
+  if (series != nullptr) {
+    // the value at the left edge of pixel column px
+    auto fromX = [&](double px) {
+      return xLog ? xMin * pow(xInterval, (px - x) / xScale)
+                  : xMin + (px - x) / xScale;
+    };
+    const double* t = series->getTimes();
+    const uint32_t columns = max(1.0f, ceil(w));
+    uint64_t begin = series->lowerBound(fromX(x));
+    const uint64_t last =
+        upper_bound(t, t + series->getNumSamples(), xMax) - t;
+    bool started = false;
+    double xPrev = 0, yPrev = 0;
+    for (uint32_t i = 0; i < columns && begin < last; i++) {
+      const uint64_t end =
+          i + 1 == columns ? last
+                           : min(last, series->lowerBound(fromX(x + i + 1),
+                                                          begin));
+      if (begin == end) continue;
+      const TimeSeries::Bucket b = series->summarize(begin, end);
+      begin = end;
+      if (isnan(b.first)) continue;  // only missing values
+      const double xFirst = toX(t[b.begin]), xLast = toX(t[b.end - 1]);
+      if (started)
+        m->drawLine(xPrev, yPrev, xFirst, toY(b.first), s->lineColor);
+      if (b.end - b.begin == 1)
+        markers->add(marker, xFirst, toY(b.first), pointSize, s->pointColor);
+      else
+        m->drawLine((xFirst + xLast) / 2, toY(b.min), (xFirst + xLast) / 2,
+                    toY(b.max), s->lineColor);
+      xPrev = xLast;
+      yPrev = toY(b.last);
+      started = true;
+    }
+    commonRender();
+    return;
   }
 
-  double xPoint1 = xPoints[0];
-  double yPoint1 = yPoints[0];
+  double xPoint1 = toX(xPoints[0]);
+  double yPoint1 = toY(yPoints[0]);
 
-  (m->*markerFunction)(xPoint1, yPoint1, pointSize, s->pointColor);
+  markers->add(marker, xPoint1, yPoint1, pointSize, s->pointColor);
 
   for (int i = 1; i < xPoints.size(); i++) {
-    double xPoint2 = xPoints[i];
-    double yPoint2 = yPoints[i];
+    double xPoint2 = toX(xPoints[i]);
+    double yPoint2 = toY(yPoints[i]);
 
     m->drawLine(xPoint1, yPoint1, xPoint2, yPoint2, s->lineColor);
-    (m->*markerFunction)(xPoint2, yPoint2, pointSize, s->pointColor);
+    markers->add(marker, xPoint2, yPoint2, pointSize, s->pointColor);
 
     xPoint1 = xPoint2;
     yPoint1 = yPoint2;
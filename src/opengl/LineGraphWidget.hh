@@ -1,17 +1,25 @@
 #pragma once
 
+#include <memory>
+
+#include "data/TimeSeries.hh"
 #include "opengl/GraphWidget.hh"
+#include "opengl/InstancedMarkers.hh"
 
 class LineGraphWidget : public GraphWidget {
  private:
   std::vector<double> xPoints;
   std::vector<double> yPoints;
   double pointSize;
-  // floats used here because its what StyledMultiShape wants
-  typedef void (StyledMultiShape2D::*MarkerFunction)(float, float, float,
-                                                     const glm::vec4&);
-  MarkerFunction markerFunction;
-  std::unordered_map<char, MarkerFunction> marker_pointer_table;
+  // markers are instanced, one template each and 16 bytes per point
+  InstancedMarkers::Marker marker;
+  std::unordered_map<char, InstancedMarkers::Marker> marker_table;
+  /*
+    With more points than pixels the series is drawn from its pyramid, one
+    min to max line per pixel column, so the work is bounded by the width.
+  */
+  const TimeSeries* series;
+  std::unique_ptr<TimeSeries> ownSeries;  // built from the points if many
 
  public:
   LineGraphWidget(Canvas* c, double x, double y, double w, double h,
@@ -20,17 +28,20 @@ class LineGraphWidget : public GraphWidget {
                     xAxisType, yAxisType, s),
         xPoints(),
         yPoints(),
-        markerFunction(&StyledMultiShape2D::drawCircleMarker) {
-    marker_pointer_table['o'] = &StyledMultiShape2D::drawCircleMarker;
-    marker_pointer_table['s'] = &StyledMultiShape2D::drawSquareMarker;
-    marker_pointer_table['h'] = &StyledMultiShape2D::drawHexagonMarker;
-    marker_pointer_table['t'] = &StyledMultiShape2D::drawTriangleMarker;
-    marker_pointer_table['p'] = &StyledMultiShape2D::drawPentagonMarker;
-    marker_pointer_table['c'] = &StyledMultiShape2D::drawCrossMarker;
+        marker(InstancedMarkers::Marker::circle),
+        series(nullptr) {
+    marker_table['o'] = InstancedMarkers::Marker::circle;
+    marker_table['s'] = InstancedMarkers::Marker::square;
+    marker_table['h'] = InstancedMarkers::Marker::hexagon;
+    marker_table['t'] = InstancedMarkers::Marker::triangle;
+    marker_table['p'] = InstancedMarkers::Marker::pentagon;
+    marker_table['c'] = InstancedMarkers::Marker::cross;
   }
 
   void setPointFormat(char pt, double size, glm::vec4& color);
   void setXPoints(const std::vector<double>& xPoints);
   void setYPoints(const std::vector<double>& yPoints);
+  // draw series, which must outlive the widget, instead of the points
+  void setSeries(const TimeSeries* series);
   void init() override;
 };
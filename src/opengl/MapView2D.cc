@@ -7,30 +7,45 @@
 using namespace std;
 
 void MapView2D::init() {
-  uint32_t numPoints = bml->getNumPoints();
+  const uint32_t numLevels = bml->getNumLevels();
+  uint32_t numPoints = 0;
+  for (uint32_t l = 0; l < numLevels; l++) numPoints += bml->getNumPoints(l);
 
   glGenVertexArrays(1, &vao);  // Create the container for all vbo objects
   glBindVertexArray(vao);
 
-  // push points up to graphics card as two separate vbo for x and y
+  // push points of every level up to graphics card one after another
   glGenBuffers(1, &vbo);
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, numPoints * (2 * sizeof(float)),
-               bml->getXPoints(), GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, numPoints * (2 * sizeof(float)), nullptr,
+               GL_STATIC_DRAW);
+  for (uint32_t l = 0, offset = 0; l < numLevels; l++) {
+    glBufferSubData(GL_ARRAY_BUFFER, offset * (2 * sizeof(float)),
+                    bml->getNumPoints(l) * (2 * sizeof(float)),
+                    bml->getPoints(l));
+    offset += bml->getNumPoints(l);
+  }
   // Describe how information is received in shaders
   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
 
   // Create a buffer object for indices of lines
   uint32_t numSegments = bml->getNumSegments();
   constexpr uint32_t endIndex = 0xFFFFFFFF;
-  numIndicesToDraw = numPoints + numSegments;
+  // every segment is its points, the first point again, and a restart
+  numIndicesToDraw = numPoints + 2 * numSegments * numLevels;
   uint32_t* lineIndices = new uint32_t[numIndicesToDraw];
-  for (uint32_t i = 0, j = 0, c = 0; i < numSegments; i++) {
-    uint32_t startSegment = j;
-    for (uint32_t k = 0; k < bml->getSegment(i).numPoints; k++)
-      lineIndices[c++] = j++;
-    lineIndices[c++] = startSegment;
-    lineIndices[c++] = endIndex;
+  segmentIndexStart.resize(numLevels * (numSegments + 1));
+  for (uint32_t l = 0, j = 0, c = 0, s = 0; l < numLevels; l++) {
+    const BlockMapLoader::Segment* segments = bml->getSegments(l);
+    for (uint32_t i = 0; i < numSegments; i++) {
+      segmentIndexStart[s++] = c;
+      uint32_t startSegment = j;
+      for (uint32_t k = 0; k < segments[i].numPoints; k++)
+        lineIndices[c++] = j++;
+      lineIndices[c++] = startSegment;
+      lineIndices[c++] = endIndex;
+    }
+    segmentIndexStart[s++] = c;
   }
   glGenBuffers(1, &lbo);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
@@ -38,6 +53,16 @@ void MapView2D::init() {
                lineIndices, GL_STATIC_DRAW);
 
   delete[] lineIndices;
+
+  // fill triangles index the full detail points, which come first in vbo,
+  // so they go up straight from the loaded file
+  if (bml->hasFill()) {
+    glGenBuffers(1, &sbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sizeof(GLuint) * bml->getNumFillIndices(),
+                 bml->getFillIndices(), GL_STATIC_DRAW);
+  }
 }
 
 void debug(const glm::mat4& m, float x, float y, float z) {
@@ -82,9 +107,35 @@ void MapView2D::render() {
   glEnableVertexAttribArray(1);
   glLineWidth(style->getLineWidth());
 
-  // Draw Lines
+  // Draw fill first, the triangles of each run of regions in view
+  if (filled && bml->hasFill()) {
+    shader->setVec4("solidColor", fillColor);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sbo);
+    const uint64_t* fillStart = bml->getFillStart();
+    bml->query(getViewport(), visibleRegions);
+    for (const BlockMapLoader::Range& r : visibleRegions) {
+      uint64_t first = fillStart[r.start], count = fillStart[r.end] - first;
+      if (count > 0)
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT,
+                       (void*)(first * sizeof(GLuint)));
+    }
+    shader->setVec4("solidColor", style->getFgColor());
+  }
+
+  // Draw Lines, only the segments of regions in view, at the coarsest level
+  // whose error is under a pixel
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glDrawElements(GL_LINE_LOOP, numIndicesToDraw, GL_UNSIGNED_INT, 0);
+  level = bml->selectLevel(2 * std::abs(scaleX) / parentCanvas->getWidth());
+  const uint32_t* indexStart =
+      &segmentIndexStart[level * (bml->getNumSegments() + 1)];
+  bml->querySegments(getViewport(), visibleSegments);
+  pointsDrawn = 0;
+  for (const BlockMapLoader::Range& r : visibleSegments) {
+    uint32_t first = indexStart[r.start], count = indexStart[r.end] - first;
+    glDrawElements(GL_LINE_LOOP, count, GL_UNSIGNED_INT,
+                   (void*)(first * sizeof(GLuint)));
+    pointsDrawn += count - 2 * (r.end - r.start);
+  }
 
   // Unbind
   glDisableVertexAttribArray(1);
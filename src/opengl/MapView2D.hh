@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <vector>
 
 #include "data/BlockMapLoader2.hh"
 #include "opengl/Canvas.hh"
@@ -17,6 +18,15 @@ class MapView2D : public Shape {
   // and we can have a null map and draw nothing, and change maps
   BlockMapLoader* bml;
   uint32_t numIndicesToDraw;
+  // first index of each segment of each level of detail in lbo, so any run
+  // of segments is one draw
+  std::vector<uint32_t> segmentIndexStart;
+  std::vector<BlockMapLoader::Range> visibleSegments;
+  std::vector<BlockMapLoader::Range> visibleRegions;
+  glm::vec4 fillColor;
+  bool filled;  // draw the fill section of the map under the outlines
+  uint32_t level;        // level of detail drawn in the last frame
+  uint32_t pointsDrawn;  // vertices submitted in the last frame
 
  public:
   // TODO: Check if this should be setRender or setUpdate
@@ -31,7 +41,14 @@ class MapView2D : public Shape {
   }
   void uniformZoom(float s) { scaleX *= s, scaleY *= s; }
   MapView2D(Canvas* parent, const Style* s, BlockMapLoader* bml = nullptr)
-      : Shape(parent), style(s), bml(bml), transform(1.0f) {
+      : Shape(parent),
+        style(s),
+        bml(bml),
+        transform(1.0f),
+        fillColor(0.0f),
+        filled(false),
+        level(0),
+        pointsDrawn(0) {
     const BoundRect& bounds = bml->getBlockMapHeader()->bounds;
     float centerX = (bounds.xMin + bounds.xMax) * 0.5;
     float centerY = (bounds.yMin + bounds.yMax) * 0.5;
@@ -56,6 +73,17 @@ class MapView2D : public Shape {
     setProjection();
   }
   glm::mat4& getTransform() { return transform; }
+  // fill regions in c, if the map was saved with its fill section
+  void setFillColor(const glm::vec4& c) {
+    fillColor = c;
+    filled = true;
+  }
+  uint32_t getLevel() const { return level; }
+  uint32_t getPointsDrawn() const { return pointsDrawn; }
+  BoundRect getViewport() const {
+    return BoundRect(centerX - std::abs(scaleX), centerX + std::abs(scaleX),
+                     centerY - std::abs(scaleY), centerY + std::abs(scaleY));
+  }
   void init() override;
   void render() override;
   void update() override;
@@ -11,26 +11,64 @@ void MultiShape::update() {
   updatePointIndices();
 }
 
+/*
+  Send the buffer what it lacks of list: the changed span plus anything
+  appended, in one glBufferSubData. Growing past the buffer reallocates it
+  at double the size so appending one primitive at a time does not copy
+  everything every frame.
+*/
+template <typename T>
+void MultiShape::upload(uint32_t target, uint32_t buffer,
+                        const std::vector<T>& list, Uploaded& u) {
+  const uint32_t n = list.size();
+  glBindBuffer(target, buffer);
+  uint32_t begin, end;
+  if (u.buffer != buffer || n > u.capacity) {
+    u.buffer = buffer;
+    u.capacity = std::max(n, 2 * u.capacity);
+    glBufferData(target, u.capacity * sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+    begin = 0;
+    end = n;
+  } else {
+    u.span(n, begin, end);
+  }
+  if (begin < end) {
+    glBufferSubData(target, begin * sizeof(T), (end - begin) * sizeof(T),
+                    &list[begin]);
+    bytesUploaded.add((end - begin) * sizeof(T));
+  }
+  u.sent(n);
+}
+
 void MultiShape::updatePoints() {
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0],
-               GL_DYNAMIC_DRAW);
+  upload(GL_ARRAY_BUFFER, vbo, vertices, vertexUpload);
 }
 
 void MultiShape::updateSolidIndices() {
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * solidIndices.size(),
-               &solidIndices[0], GL_DYNAMIC_DRAW);
+  upload(GL_ELEMENT_ARRAY_BUFFER, sbo, solidIndices, solidUpload);
 }
 
 void MultiShape::updateLineIndices() {
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * lineIndices.size(),
-               &lineIndices[0], GL_DYNAMIC_DRAW);
+  upload(GL_ELEMENT_ARRAY_BUFFER, lbo, lineIndices, lineUpload);
 }
 
 void MultiShape::updatePointIndices() {
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * pointIndices.size(),
-               &pointIndices[0], GL_DYNAMIC_DRAW);
+  upload(GL_ELEMENT_ARRAY_BUFFER, pbo, pointIndices, pointUpload);
+}
+
+void MultiShape::drawElements(uint32_t mode, uint32_t buffer,
+                              const std::vector<uint32_t>& indices) {
+  if (indices.empty()) return;
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+  glDrawElements(mode, indices.size(), GL_UNSIGNED_INT, 0);
+  drawCalls.add();
+}
+
+void MultiShape::clear() {
+  vertices.clear();
+  solidIndices.clear();
+  lineIndices.clear();
+  pointIndices.clear();
+  vertexUpload.size = solidUpload.size = 0;
+  lineUpload.size = pointUpload.size = 0;
 }
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include "opengl/Shape_impl.hh"
+#include "util/StatCounter.hh"
 
 class MultiShape : public Shape {
+  friend class ShapeBatch;
+
  protected:
   std::vector<float> vertices;
   std::vector<uint32_t> solidIndices;
@@ -12,7 +16,54 @@ class MultiShape : public Shape {
   std::vector<uint32_t> pointIndices;
   std::vector<float> colorIndices;
 
+  /*
+    What a buffer holds of its list. Anything appended to the list past size
+    is uploaded on the next update, anything changed before it only if it is
+    marked. Lists only shrink through clear(). The buffer is reallocated only
+    when the list outgrows it, or when it is a new buffer (init was called
+    again).
+  */
+  struct Uploaded {
+    uint32_t buffer;
+    uint32_t size;      // elements uploaded
+    uint32_t capacity;  // elements the buffer has room for
+    uint32_t dirtyBegin, dirtyEnd;
+    Uploaded()
+        : buffer(0), size(0), capacity(0), dirtyBegin(~0U), dirtyEnd(0) {}
+    void mark(uint32_t begin, uint32_t end) {
+      if (begin < dirtyBegin) dirtyBegin = begin;
+      if (end > dirtyEnd) dirtyEnd = end;
+    }
+    // what to send of a list now n long: changes plus anything appended
+    void span(uint32_t n, uint32_t& begin, uint32_t& end) const {
+      begin = std::min(dirtyBegin, size);
+      end = std::max(std::min(dirtyEnd, n), n > size ? n : 0);
+    }
+    void sent(uint32_t n) {
+      size = n;
+      dirtyBegin = ~0U;
+      dirtyEnd = 0;
+    }
+  };
+  Uploaded vertexUpload, solidUpload, lineUpload, pointUpload;
+  template <typename T>
+  static void upload(uint32_t target, uint32_t buffer,
+                     const std::vector<T>& list, Uploaded& u);
+  // draw a list of indices unless it is empty
+  void drawElements(uint32_t mode, uint32_t buffer,
+                    const std::vector<uint32_t>& indices);
+  // vertices[begin, end) have been changed in place
+  void changedVertices(uint32_t begin, uint32_t end) {
+    vertexUpload.mark(begin, end);
+  }
+
  public:
+  // totals over every MultiShape, for counting per frame
+  static inline StatCounter bytesUploaded{"gl.multishape.bytes_uploaded"};
+  static inline StatCounter drawCalls{"gl.multishape.draw_calls"};
+  // shader, VAO, uniform and line width changes made to draw
+  static inline StatCounter stateChanges{"gl.multishape.state_changes"};
+
   MultiShape(Canvas* parent, uint32_t vertCount = 1024,
              uint32_t solidIndCount = 1024, uint32_t lineIndCount = 1024,
              uint32_t pointIndCount = 1024, uint32_t colorIndCount = 1024)
@@ -25,11 +76,14 @@ class MultiShape : public Shape {
   }
   ~MultiShape();
   void process_input(Inputs* in, float dt) override;
+  // upload whatever changed since the last update
   void update() override;
   void updatePoints();
   void updateSolidIndices();
   void updateLineIndices();
   void updatePointIndices();
+  // remove everything, the next update uploads whatever is drawn after
+  void clear();
 
   void addPoint(float x, float y) {
     vertices.push_back(x);
@@ -18,9 +18,7 @@ void MultiShape2D::init() {
   // Create VBO for vertices
   // Create an object in the VAO to store all the vertex values
   glGenBuffers(1, &vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertices.size(), &vertices[0],
-               GL_STATIC_DRAW);
+  updatePoints();
   // Desctribe how information is recieved in shaders
   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
 
@@ -28,29 +26,25 @@ void MultiShape2D::init() {
   // Create an object to hold the order at which the vertices are drawn(from
   // indices) in order to draw it as a solid(filled)
   glGenBuffers(1, &sbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * solidIndices.size(),
-               &solidIndices[0], GL_STATIC_DRAW);
+  updateSolidIndices();
 
   // Create LBO
   // Create an object to hold the order at which the vertices are drawn(from
   // indices) in order to draw it as lines(wireframe)
   glGenBuffers(1, &lbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * lineIndices.size(),
-               &lineIndices[0], GL_STATIC_DRAW);
+  updateLineIndices();
 
   // Create PBO
   // Create an object to hold the order at which the vertices are drawn(from
   // indices) in order to draw it as points.
   glGenBuffers(1, &pbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * pointIndices.size(),
-               &pointIndices[0], GL_STATIC_DRAW);
+  updatePointIndices();
 }
 
 // Shape2D
 void MultiShape2D::render() {
+  if (solidIndices.empty() && lineIndices.empty() && pointIndices.empty())
+    return;
   // Get Shader based on style
   const Shader* shader = Shader::useShader(style->getShaderIndex());
   // If color buffer exists
@@ -63,18 +57,11 @@ void MultiShape2D::render() {
   glEnableVertexAttribArray(0);
 
   glLineWidth(style->getLineWidth());
+  stateChanges.add(5);
 
-  // Draw Solids
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sbo);
-  glDrawElements(GL_TRIANGLES, solidIndices.size(), GL_UNSIGNED_INT, 0);
-
-  // Draw Lines
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glDrawElements(GL_LINES, lineIndices.size(), GL_UNSIGNED_INT, 0);
-
-  // Draw Points
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pbo);
-  glDrawElements(GL_POINTS, pointIndices.size(), GL_UNSIGNED_INT, 0);
+  drawElements(GL_TRIANGLES, sbo, solidIndices);
+  drawElements(GL_LINES, lbo, lineIndices);
+  drawElements(GL_POINTS, pbo, pointIndices);
 
   // Unbind
   glDisableVertexAttribArray(0);
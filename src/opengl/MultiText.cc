@@ -9,6 +9,8 @@
 #include "opengl/GLWinFonts.hh"
 #include "opengl/Shader.hh"
 #include "opengl/Style.hh"
+#include "opengl/util/GlyphAtlas.hh"
+#include "util/Utf8.hh"
 
 using namespace std;
 // todo: fix render to pass everything in the text vert to draw it
@@ -20,9 +22,10 @@ using namespace std;
   text to hold the coordinates for texturing
 */
 MultiText::MultiText(Canvas* c, const Style* style, uint32_t size)
-    : Shape(c), style(style), transform(1.0f) {
+    : Shape(c), style(style), transform(1.0f), atlasEvictions(0) {
   // if !once, once = !once was a thing
   vert.reserve(size * 24);
+  glyphRefs.reserve(size);
   const Font* f = style->f;  // FontFace::getFace(1)->getFont(0);
 }
 
@@ -77,30 +80,21 @@ void MultiText::addChar(float x, float y, const Font* f, unsigned char c) {
   float x0 = x + glyph->bearingX, x1 = x0 + glyph->sizeX;
   float y0 = y - glyph->bearingY, y1 = y0 + glyph->sizeY;
   // cout << "x=" << x << ", y=" << y << '\n';
-  addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-  addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
-  addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-  addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-  addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-  addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+  addGlyph(x0, y0, x1, y1, f, c, glyph);
 
   x += glyph->advance;
 }
 
 inline float MultiText::internalAdd(float x, float y, const Font* f,
                                     const char s[], uint32_t len) {
-  for (uint32_t i = 0; i < len; i++) {
-    const Font::Glyph* glyph = f->getGlyph(s[i]);
+  for (const char *p = s, *end = s + len; p < end;) {
+    const uint32_t c = utf8Next(p, end);
+    const Font::Glyph* glyph = f->getGlyph(c);
     float x0 = x + glyph->bearingX,
           x1 = x0 + glyph->sizeX;  // TODO: Not maxwidth, should be less for
                                    // proportional fonts?
     float y0 = y - glyph->bearingY, y1 = y0 + glyph->sizeY;
-    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-    addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
-    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-    addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+    addGlyph(x0, y0, x1, y1, f, c, glyph);
 
     x += glyph->advance;
   }
@@ -111,8 +105,9 @@ inline float MultiText::internalAddBox(float x, float y, float w, float h,
                                        const Font* f, const char s[],
                                        uint32_t len) {
   float leftMargin = x, rightMargin = x + w;
-  for (uint32_t i = 0; i < len; i++) {
-    const Font::Glyph* glyph = f->getGlyph(s[i]);
+  for (const char *p = s, *end = s + len; p < end;) {
+    const uint32_t c = utf8Next(p, end);
+    const Font::Glyph* glyph = f->getGlyph(c);
     float x0 = x + glyph->bearingX,
           x1 = x0 + glyph->sizeX;  // TODO: Not maxwidth, should be less for
     if (x1 >= rightMargin) {
@@ -123,12 +118,7 @@ inline float MultiText::internalAddBox(float x, float y, float w, float h,
     }
     // proportional fonts?
     float y0 = y - glyph->bearingY, y1 = y0 + glyph->sizeY;
-    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-    addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
-    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-    addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+    addGlyph(x0, y0, x1, y1, f, c, glyph);
 
     x += glyph->advance;
   }
@@ -300,8 +290,9 @@ float MultiText::add(float x, float y, float space, float ang, const Font* f,
   // t = glm::translate(t, glm::vec3(-x,-y,0));
   // t = glm::rotate(t, ang, glm::vec3(0,0,1));
   // t = glm::translate(t, glm::vec3(x,y,0.0f));
-  for (uint32_t i = 0; i < len; i++) {
-    const Font::Glyph* glyph = f->getGlyph(s[i]);
+  for (const char *p = s, *end = s + len; p < end;) {
+    const uint32_t c = utf8Next(p, end);
+    const Font::Glyph* glyph = f->getGlyph(c);
     float x0 = x + glyph->bearingX,
           x1 = x0 + glyph->sizeX;  // TODO: Not maxwidth, should be less for
                                    // proportional fonts?
@@ -332,11 +323,12 @@ float MultiText::add(float x, float y, float space, float ang, const Font* f,
 
     xt = x1, yt = y1;
     rotateAround(startx, starty, cosa, sina, xt, yt);
-    addPoint(xt, yt, /* fontLeft */ glyph->u0, glyph->v1);
+    addPoint(xt, yt, /* fontRight */ glyph->u1, glyph->v0);
 
     xt = x1, yt = y0;
     rotateAround(startx, starty, cosa, sina, xt, yt);
     addPoint(xt, yt, /* fontRight */ glyph->u1, glyph->v1);
+    glyphRefs.push_back(GlyphRef{f, c});
 
     x += glyph->advance;
   }
@@ -363,17 +355,18 @@ float MultiText::add(float x, float y, const char s[], uint32_t len) {
 // find the index of the first character over the margin with this font
 uint32_t MultiText::findFirstOverMargin(float x, const Font* f, const char s[],
                                         uint32_t len, float rightMargin) {
-  uint32_t i = 0;
-  while (true) {
-    const Font::Glyph* g = f->getGlyph(s[i]);
+  const char *p = s, *end = s + len;
+  while (p < end) {
+    const char* start = p;
+    const Font::Glyph* g = f->getGlyph(utf8Next(p, end));
     if (x + g->advance < rightMargin) {
       x += g->advance;
-      i++;
     } else {
-      if (x + g->bearingX + g->sizeX > rightMargin) return i;
-      return i + 1;
+      if (x + g->bearingX + g->sizeX > rightMargin) return start - s;
+      return p - s;
     }
   }
+  return len;
 }
 
 void MultiText::checkAdd(float& x, float& y, const Font* f,
@@ -389,9 +382,33 @@ void MultiText::checkAdd(float& x, float& y, const Font* f,
 
 const Style* MultiText::getStyle() { return style; }
 
+/*
+  Point every glyph at its place in the atlas again, rendering those that
+  were evicted since the text was added
+*/
+void MultiText::refreshGlyphs() {
+  for (uint32_t i = 0; i < glyphRefs.size(); i++) {
+    const Font::Glyph* g = glyphRefs[i].f->getGlyph(glyphRefs[i].c);
+    float* v = &vert[i * 24];
+    v[2] = g->u0, v[3] = g->v1;
+    v[6] = g->u0, v[7] = g->v0;
+    v[10] = g->u1, v[11] = g->v0;
+    v[14] = g->u0, v[15] = g->v1;
+    v[18] = g->u1, v[19] = g->v0;
+    v[22] = g->u1, v[23] = g->v1;
+  }
+}
+
 void MultiText::update() {}
 
 void MultiText::render() {
+  GlyphAtlas* atlas = FontFace::getAtlas();
+  if (atlas->getEvictions() != atlasEvictions) {
+    refreshGlyphs();
+    atlasEvictions = atlas->getEvictions();
+  }
+  atlas->flush();  // glyphs rendered since the last frame
+
   glBindVertexArray(vao);
   glEnableVertexAttribArray(0);
   glEnableVertexAttribArray(1);
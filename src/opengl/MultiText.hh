@@ -20,7 +20,27 @@ class MultiText : public Shape {
     vert.push_back(u);
     vert.push_back(v);
   }
+  // the glyph drawn by each 24 floats of vert, to look it up again if the
+  // atlas evicts it
+  struct GlyphRef {
+    const Font* f;
+    uint32_t c;
+  };
+  std::vector<GlyphRef> glyphRefs;
+  uint64_t atlasEvictions;  // GlyphAtlas::getEvictions() when last drawn
+  void addGlyph(float x0, float y0, float x1, float y1, const Font* f,
+                uint32_t c, const Font::Glyph* glyph) {
+    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
+    addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
+    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
+    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
+    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
+    addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+    glyphRefs.push_back(GlyphRef{f, c});
+  }
+  void refreshGlyphs();
   float velX = 1, velY = 1;
+  // s is UTF-8, len in bytes
   float internalAdd(float x, float y, const Font* f, const char s[],
                     uint32_t len);
   float internalAddBox(float x, float y, float w, float h, const Font* f,
@@ -224,7 +244,10 @@ class MultiText : public Shape {
 
   // BUG: testDisplayBook should clear on the last page of Annatest, but instead
   // the bottom half of the page doesnt clear.
-  void clear() { vert.clear(); }
+  void clear() {
+    vert.clear();
+    glyphRefs.clear();
+  }
   void init() override;
 
   void process_input(Inputs* in, float dt) override {
@@ -9,6 +9,8 @@
 #include "opengl/GLWinFonts.hh"
 #include "opengl/Shader.hh"
 #include "opengl/Style.hh"
+#include "opengl/util/GlyphAtlas.hh"
+#include "util/Utf8.hh"
 
 using namespace std;
 // todo: fix render to pass everything in the text vert to draw it
@@ -53,25 +55,20 @@ void MultiText2::addChar(float x, float y, const Font* f, unsigned char c) {
   float x0 = x + glyph->bearingX, x1 = x0 + glyph->sizeX;
   float y0 = y - glyph->bearingY, y1 = y0 + glyph->sizeY;
   // cout << "x=" << x << ", y=" << y << '\n';
-  addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-  addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
-  addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-  addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+  addGlyph(x0, y0, x1, y1, f, c, glyph);
 
   x += glyph->advance;
 }
 
 inline void MultiText2::internalAdd(float x, float y, const Font* f,
                                     const char s[], uint32_t len) {
-  for (uint32_t i = 0; i < len; i++) {
-    const Font::Glyph* glyph = f->getGlyph(s[i]);
+  for (const char *p = s, *end = s + len; p < end;) {
+    const uint32_t c = utf8Next(p, end);
+    const Font::Glyph* glyph = f->getGlyph(c);
     float x0 = x + glyph->bearingX, x1 = x0 + glyph->sizeX;
     // TODO: Not maxwidth, should be less for proportional fonts?
     float y0 = y - glyph->bearingY, y1 = y0 + glyph->sizeY;
-    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-    addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
-    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-    addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+    addGlyph(x0, y0, x1, y1, f, c, glyph);
 
     x += glyph->advance;
   }
@@ -88,8 +85,9 @@ void MultiText2::add(float x, float y, float ang, const Font* f, const char s[],
                      uint32_t len) {
   float startx = x, starty = y;
   double cosa = cos(ang), sina = sin(ang);
-  for (uint32_t i = 0; i < len; i++) {
-    const Font::Glyph* glyph = f->getGlyph(s[i]);
+  for (const char *p = s, *end = s + len; p < end;) {
+    const uint32_t c = utf8Next(p, end);
+    const Font::Glyph* glyph = f->getGlyph(c);
     float x0 = x + glyph->bearingX,
           x1 = x0 + glyph->sizeX;  // TODO: Not maxwidth, should be less for
                                    // proportional fonts?
@@ -97,10 +95,7 @@ void MultiText2::add(float x, float y, float ang, const Font* f, const char s[],
     rotateAround(startx, starty, cosa, sina, x0, y0);
     rotateAround(startx, starty, cosa, sina, x1, y1);
 
-    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
-    addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
-    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
-    addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+    addGlyph(x0, y0, x1, y1, f, c, glyph);
 
     x += glyph->advance;
   }
@@ -235,6 +230,21 @@ void MultiText2::checkAdd(float& x, float& y, const Font* f,
 
 const Style* MultiText2::getStyle() { return style; }
 
+/*
+  Point every glyph at its place in the atlas again, rendering those that
+  were evicted since the text was added
+*/
+void MultiText2::refreshGlyphs() {
+  for (uint32_t i = 0; i < glyphRefs.size(); i++) {
+    const Font::Glyph* g = glyphRefs[i].f->getGlyph(glyphRefs[i].c);
+    float* v = &vert[i * 16];
+    v[2] = g->u0, v[3] = g->v1;
+    v[6] = g->u0, v[7] = g->v0;
+    v[10] = g->u1, v[11] = g->v0;
+    v[14] = g->u1, v[15] = g->v1;
+  }
+}
+
 void MultiText2::update() {}
 
 void MultiText2::init() {
@@ -281,6 +291,12 @@ static uint32_t pow10arr[10] = {
     0, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
 
 void MultiText2::render() {
+  GlyphAtlas* atlas = FontFace::getAtlas();
+  if (atlas->getEvictions() != atlasEvictions) {
+    refreshGlyphs();
+    atlasEvictions = atlas->getEvictions();
+  }
+  atlas->flush();  // glyphs rendered since the last frame
   glBindVertexArray(vao);
   glEnableVertexAttribArray(0);
   glEnableVertexAttribArray(1);
@@ -23,6 +23,23 @@ class MultiText2 : public Shape {
     vert.push_back(u);
     vert.push_back(v);
   }
+  // the glyph drawn by each 16 floats of vert, to look it up again if the
+  // atlas evicts it
+  struct GlyphRef {
+    const Font* f;
+    uint32_t c;
+  };
+  std::vector<GlyphRef> glyphRefs;
+  uint64_t atlasEvictions = 0;  // GlyphAtlas::getEvictions() when last drawn
+  void addGlyph(float x0, float y0, float x1, float y1, const Font* f,
+                uint32_t c, const Font::Glyph* glyph) {
+    addPoint(x0, y0, /* fontLeft */ glyph->u0, glyph->v1);
+    addPoint(x0, y1, /* fontLeft */ glyph->u0, glyph->v0);
+    addPoint(x1, y1, /* fontRight */ glyph->u1, glyph->v0);
+    addPoint(x1, y0, /* fontRight */ glyph->u1, glyph->v1);
+    glyphRefs.push_back(GlyphRef{f, c});
+  }
+  void refreshGlyphs();
   float velX = 1, velY = 1;
   void internalAdd(float x, float y, const Font* f, const char s[],
                    uint32_t len);
@@ -159,7 +176,10 @@ class MultiText2 : public Shape {
                 float endMargin, float rowSize, float startOverMargin);
   uint32_t findFirstOverMargin(float x, const Font* f, const char s[],
                                uint32_t len, float rightMargin);
-  void clear() { vert.clear(); }
+  void clear() {
+    vert.clear();
+    glyphRefs.clear();
+  }
   void init() override;
   const Style* getStyle();
   void update() override;
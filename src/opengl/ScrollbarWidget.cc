@@ -34,7 +34,5 @@ void ScrollbarWidget::render() { StyledMultiShape2D::render(); }
 void ScrollbarWidget::update() {
   clear();
   draw();
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0],
-               GL_DYNAMIC_DRAW);
+  StyledMultiShape2D::update();
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "opengl/ShapeBatch.hh"
+
+#include <algorithm>
+
+#include "glad/glad.h"
+#include "opengl/GLWin.hh"
+#include "opengl/Shader.hh"
+#include "opengl/Style.hh"
+
+using namespace std;
+
+namespace {
+constexpr uint32_t FLOATS_PER_VERTEX = 5;
+
+// room for a list now n long to grow before the batch is rebuilt
+uint32_t room(uint32_t n) { return n + n / 4 + 64; }
+
+// a and b can be drawn with the same shader setup
+bool sameState(StyledMultiShape2D* a, StyledMultiShape2D* b) {
+  const float* ta = &a->getTransform()[0][0];
+  const float* tb = &b->getTransform()[0][0];
+  return equal(ta, ta + 16, tb) &&
+         a->getStyle()->getLineWidth() == b->getStyle()->getLineWidth();
+}
+}  // namespace
+
+ShapeBatch::ShapeBatch(const vector<StyledMultiShape2D*>& shapes)
+    : built(false) {
+  // layers stay in their order, a group ends where the state changes
+  for (uint32_t i = 0; i < shapes.size(); i++) {
+    if (i == 0 || !sameState(shapes[i - 1], shapes[i])) groups.push_back(i);
+    entries.push_back(Entry{shapes[i], {}});
+  }
+  groups.push_back(entries.size());
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glGenBuffers(1, &ebo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+                        (void*)(2 * sizeof(float)));
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glBindVertexArray(0);
+}
+
+ShapeBatch::~ShapeBatch() {
+  glDeleteBuffers(1, &ebo);
+  glDeleteBuffers(1, &vbo);
+  glDeleteVertexArrays(1, &vao);
+}
+
+MultiShape::Uploaded& ShapeBatch::uploaded(StyledMultiShape2D* s, List l) {
+  switch (l) {
+    case VERTICES:
+      return s->vertexUpload;
+    case SOLIDS:
+      return s->solidUpload;
+    case LINES:
+      return s->lineUpload;
+    default:
+      return s->pointUpload;
+  }
+}
+
+const vector<uint32_t>& ShapeBatch::indices(StyledMultiShape2D* s, List l) {
+  return l == SOLIDS ? s->solidIndices
+                     : l == LINES ? s->lineIndices : s->pointIndices;
+}
+
+uint32_t ShapeBatch::size(StyledMultiShape2D* s, List l) {
+  return l == VERTICES ? s->vertices.size() : indices(s, l).size();
+}
+
+// copy elements [begin, end) of one list of a layer to its region
+void ShapeBatch::send(Entry& e, List l, uint32_t begin, uint32_t end) {
+  const uint32_t target =
+      l == VERTICES ? GL_ARRAY_BUFFER : GL_ELEMENT_ARRAY_BUFFER;
+  const void* p = l == VERTICES ? (const void*)&e.shape->vertices[begin]
+                                : (const void*)&indices(e.shape, l)[begin];
+  // floats and indices are both 4 bytes
+  glBufferSubData(target, (e.regions[l].offset + begin) * 4,
+                  (end - begin) * 4, p);
+  MultiShape::bytesUploaded.add((end - begin) * 4);
+}
+
+void ShapeBatch::build() {
+  uint32_t vertexEnd = 0, indexEnd = 0;
+  for (Entry& e : entries) {
+    const uint32_t numVertices = size(e.shape, VERTICES) / FLOATS_PER_VERTEX;
+    e.regions[VERTICES] = {vertexEnd, room(numVertices) * FLOATS_PER_VERTEX};
+    vertexEnd += e.regions[VERTICES].capacity;
+    for (List l : {SOLIDS, LINES, POINTS}) {
+      e.regions[l] = {indexEnd, room(size(e.shape, l))};
+      indexEnd += e.regions[l].capacity;
+    }
+  }
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertexEnd * sizeof(float), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexEnd * sizeof(uint32_t), nullptr,
+               GL_DYNAMIC_DRAW);
+  for (Entry& e : entries)
+    for (List l : {VERTICES, SOLIDS, LINES, POINTS}) {
+      const uint32_t n = size(e.shape, l);
+      if (n > 0) send(e, l, 0, n);
+      MultiShape::Uploaded& u = uploaded(e.shape, l);
+      u.sent(n);
+      u.buffer = 0;  // the layer's own buffer is out of date from now on
+    }
+  glBindVertexArray(0);
+  built = true;
+}
+
+void ShapeBatch::update() {
+  for (const Entry& e : entries)
+    for (List l : {VERTICES, SOLIDS, LINES, POINTS})
+      if (size(e.shape, l) > e.regions[l].capacity) built = false;
+  if (!built) {
+    build();
+    return;
+  }
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  for (Entry& e : entries)
+    for (List l : {VERTICES, SOLIDS, LINES, POINTS}) {
+      MultiShape::Uploaded& u = uploaded(e.shape, l);
+      const uint32_t n = size(e.shape, l);
+      uint32_t begin, end;
+      u.span(n, begin, end);
+      if (begin < end) send(e, l, begin, end);
+      u.sent(n);
+    }
+  glBindVertexArray(0);
+}
+
+void ShapeBatch::draw(uint32_t mode, uint32_t group, List l) {
+  counts.clear();
+  offsets.clear();
+  baseVertices.clear();
+  for (uint32_t i = groups[group]; i < groups[group + 1]; i++) {
+    const Entry& e = entries[i];
+    const uint32_t n = size(e.shape, l);
+    if (n == 0) continue;
+    counts.push_back(n);
+    offsets.push_back((const void*)(uintptr_t(e.regions[l].offset) * 4));
+    baseVertices.push_back(e.regions[VERTICES].offset / FLOATS_PER_VERTEX);
+  }
+  if (counts.empty()) return;
+  glMultiDrawElementsBaseVertex(mode, counts.data(), GL_UNSIGNED_INT,
+                                offsets.data(), counts.size(),
+                                baseVertices.data());
+  MultiShape::drawCalls.add();
+}
+
+void ShapeBatch::render(const glm::mat4& projection) {
+  if (!built) build();
+  Shader* shader = Shader::useShader(GLWin::PER_VERTEX_SHADER);
+  glBindVertexArray(vao);
+  MultiShape::stateChanges.add(2);
+  for (uint32_t g = 0; g + 1 < groups.size(); g++) {
+    StyledMultiShape2D* s = entries[groups[g]].shape;
+    shader->setMat4("projection", projection * s->getTransform());
+    glLineWidth(s->getStyle()->getLineWidth());
+    MultiShape::stateChanges.add(2);
+    draw(GL_TRIANGLES, g, SOLIDS);
+    draw(GL_LINES, g, LINES);
+    draw(GL_POINTS, g, POINTS);
+  }
+  glBindVertexArray(0);
+}
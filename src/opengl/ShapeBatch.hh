@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "opengl/StyledMultiShape2D.hh"
+
+/*
+  Draws a run of StyledMultiShape2D layers from one vertex buffer and one
+  index buffer. The layers are drawn in order, in groups of neighbours that
+  need the same state (transform and line width), and each group takes one
+  shader setup and at most one glMultiDrawElementsBaseVertex per primitive
+  type, skipping empty lists.
+
+  Within a group all the solids are drawn, then all the lines, then all the
+  points, so a later layer's solids can cover an earlier layer's lines.
+  Nothing moves across a change of state. That is why a Canvas only batches
+  when asked to.
+
+  The batch takes over uploading for its layers: each layer has a region of
+  each buffer with room to grow, and what changed in it (see
+  MultiShape::Uploaded) is copied there on update. A layer outgrowing its
+  region rebuilds the whole batch.
+*/
+class ShapeBatch {
+ private:
+  enum List { VERTICES, SOLIDS, LINES, POINTS, NUM_LISTS };
+  struct Region {
+    uint32_t offset, capacity;  // in floats or indices
+  };
+  struct Entry {
+    StyledMultiShape2D* shape;
+    Region regions[NUM_LISTS];
+  };
+  std::vector<Entry> entries;
+  std::vector<uint32_t> groups;  // first entry of each group, then the end
+  uint32_t vao, vbo, ebo;
+  bool built;
+  // arguments to glMultiDrawElementsBaseVertex
+  std::vector<int32_t> counts;
+  std::vector<const void*> offsets;
+  std::vector<int32_t> baseVertices;
+
+  static MultiShape::Uploaded& uploaded(StyledMultiShape2D* s, List l);
+  static const std::vector<uint32_t>& indices(StyledMultiShape2D* s, List l);
+  static uint32_t size(StyledMultiShape2D* s, List l);
+  void send(Entry& e, List l, uint32_t begin, uint32_t end);
+  void build();
+  void draw(uint32_t mode, uint32_t group, List l);
+
+ public:
+  ShapeBatch(const std::vector<StyledMultiShape2D*>& shapes);
+  ~ShapeBatch();
+  ShapeBatch(const ShapeBatch& orig) = delete;
+  ShapeBatch& operator=(const ShapeBatch& orig) = delete;
+
+  // copy whatever the layers changed into the shared buffers
+  void update();
+  void render(const glm::mat4& projection);
+};
@@ -1,6 +1,7 @@
 #include "opengl/SparklineWidget.hh"
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <string>
 
@@ -35,4 +36,28 @@ void SparklineWidget::chart(const vector<float>& yLocations,
     xPoint1 = xPoint2;
     yPoint1 = yPoint2;
   }
-}
\ No newline at end of file
+}
+
+void SparklineWidget::chart(const TimeSeries& series, glm::vec4& c) {
+  yAxis->init(minY, maxY, y + h, -h, 0);
+  xAxis->init(minX, maxX, x, w, 0);
+
+  buckets.resize(max(1.0f, ceil(w)));
+  series.getBuckets(minX, maxX, buckets);
+  const double* t = series.getTimes();
+  bool started = false;
+  float xPrev = 0, yPrev = 0;
+  for (const TimeSeries::Bucket& b : buckets) {
+    if (b.empty() || isnan(b.first)) continue;
+    const float xFirst = xAxis->transform(t[b.begin]);
+    const float xLast = xAxis->transform(t[b.end - 1]);
+    if (started)
+      m->drawLine(xPrev, yPrev, xFirst, yAxis->transform(b.first), c);
+    if (b.min != b.max)
+      m->drawLine((xFirst + xLast) / 2, yAxis->transform(b.min),
+                  (xFirst + xLast) / 2, yAxis->transform(b.max), c);
+    xPrev = xLast;
+    yPrev = yAxis->transform(b.last);
+    started = true;
+  }
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 
+#include "data/TimeSeries.hh"
 #include "opengl/Scale.hh"
 #include "opengl/Widget2D.hh"
 
@@ -26,6 +27,7 @@ class SparklineWidget : public Widget2D {
   Scale* yAxis;
   Scale* xAxis;
   float minMultiplier;
+  std::vector<TimeSeries::Bucket> buckets;  // one per pixel column
 
  public:
   SparklineWidget(StyledMultiShape2D* m, MultiText* t, float x, float y,
@@ -72,6 +74,8 @@ class SparklineWidget : public Widget2D {
   void setTitleStyle(const Style* s) { titleStyle = s; }
   void chart(const std::vector<float>& yLocations,
              const std::vector<float>& xLocations, glm::vec4& c);
+  // chart series from minX to maxX at one min to max line per pixel column
+  void chart(const TimeSeries& series, glm::vec4& c);
   // void chartLog(const float b[], int size, float relativeSpace, const
   // std::string barNames[], int logBase);
   void setTitle(const std::string& s);
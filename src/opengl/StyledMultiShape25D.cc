@@ -109,17 +109,9 @@ void StyledMultiShape25D::init() {
   // glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,(void*)0);
 }
 
-void StyledMultiShape25D::updatePoints() {
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0],
-               GL_DYNAMIC_DRAW);
-}
+void StyledMultiShape25D::updatePoints() { MultiShape::updatePoints(); }
 
-void StyledMultiShape25D::updateIndices() {
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * lineIndices.size(),
-               &lineIndices[0], GL_DYNAMIC_DRAW);
-}
+void StyledMultiShape25D::updateIndices() { updateLineIndices(); }
 
 // Solid Primitives
 void StyledMultiShape25D::fillRectangle(float x, float y, float z, float w,
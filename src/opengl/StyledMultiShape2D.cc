@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 
+#include <cmath>
 #include <iomanip>
 #include <vector>
 
@@ -29,6 +30,8 @@ StyledMultiShape2D::~StyledMultiShape2D() {}
 // TODO: Maybe add a different render calls that loops through array of either
 // the render of style or the super render Shape2D
 void StyledMultiShape2D::render() {
+  if (solidIndices.empty() && lineIndices.empty() && pointIndices.empty())
+    return;
   // Get Shader based on style
   Shader* shader = Shader::useShader(GLWin::PER_VERTEX_SHADER);
   shader->setMat4("projection", *parentCanvas->getProjection() * transform);
@@ -37,18 +40,11 @@ void StyledMultiShape2D::render() {
   glEnableVertexAttribArray(1);
 
   glLineWidth(style->getLineWidth());
+  stateChanges.add(4);
 
-  // Draw Solids
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sbo);
-  glDrawElements(GL_TRIANGLES, solidIndices.size(), GL_UNSIGNED_INT, 0);
-
-  // Draw Lines
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glDrawElements(GL_LINES, lineIndices.size(), GL_UNSIGNED_INT, 0);
-
-  // Draw Points
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pbo);
-  glDrawElements(GL_POINTS, pointIndices.size(), GL_UNSIGNED_INT, 0);
+  drawElements(GL_TRIANGLES, sbo, solidIndices);
+  drawElements(GL_LINES, lbo, lineIndices);
+  drawElements(GL_POINTS, pbo, pointIndices);
 
   // Unbind
   glDisableVertexAttribArray(1);
@@ -64,9 +60,7 @@ void StyledMultiShape2D::init() {
   // Create VBO for vertices
   // Create an object in the VAO to store all the vertex values
   glGenBuffers(1, &vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0],
-               GL_DYNAMIC_DRAW);
+  updatePoints();
   // Describe how information is received in shaders
   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
   glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
@@ -76,17 +70,13 @@ void StyledMultiShape2D::init() {
   // Create an object to hold the order at which the vertices are drawn(from
   // indices) in order to draw it as a solid(filled)
   glGenBuffers(1, &sbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * solidIndices.size(),
-               &solidIndices[0], GL_DYNAMIC_DRAW);
+  updateSolidIndices();
 
   // Create LBO
   // Create an object to hold the order at which the vertices are drawn(from
   // indices) in order to draw it as lines(wireframe)
   glGenBuffers(1, &lbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * lineIndices.size(),
-               &lineIndices[0], GL_DYNAMIC_DRAW);
+  updateLineIndices();
 
   // temporary bind point size
   // TODO: set input for point size.
@@ -97,9 +87,7 @@ void StyledMultiShape2D::init() {
   // Create an object to hold the order at which the vertices are drawn(from
   // indices) in order to draw it as points.
   glGenBuffers(1, &pbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * pointIndices.size(),
-               &pointIndices[0], GL_DYNAMIC_DRAW);
+  updatePointIndices();
 
   // glGenBuffers(1,&cbo);
   // glBindBuffer(GL_ARRAY_BUFFER,cbo);
@@ -108,16 +96,10 @@ void StyledMultiShape2D::init() {
   // glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,(void*)0);
 }
 
-void StyledMultiShape2D::updatePoints() {
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0],
-               GL_DYNAMIC_DRAW);
-}
-
 void StyledMultiShape2D::updateIndices() {
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * lineIndices.size(),
-               &lineIndices[0], GL_DYNAMIC_DRAW);
+  updateSolidIndices();
+  updateLineIndices();
+  updatePointIndices();
 }
 
 // Solid Primitives
@@ -223,6 +205,22 @@ void StyledMultiShape2D::fillEllipse(float x, float y, float xRad, float yRad,
   startIndices.push_back(currentIndex);
 }
 
+void StyledMultiShape2D::fillEllipses(const Tessellation::Ellipse e[],
+                                      uint32_t n, uint32_t numThreads) {
+  Tessellation::fillEllipses(e, n, vertices, solidIndices, numThreads);
+  float angleInc = NAN;
+  uint32_t points = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    if (e[i].angleInc != angleInc) {
+      angleInc = e[i].angleInc;
+      points = 1 + Tessellation::sectorPoints(angleInc);
+    }
+    numIndices.push_back(points);
+    currentIndex += points;
+    startIndices.push_back(currentIndex);
+  }
+}
+
 // Line Primitives
 void StyledMultiShape2D::drawRectangle(float x, float y, float w, float h,
                                        const glm::vec4& c) {
@@ -600,16 +598,44 @@ void StyledMultiShape2D::ellipsePoints(float x, float y, float xRad, float yRad,
   startIndices.push_back(currentIndex);
 }
 
+void StyledMultiShape2D::setColor(Handle h, const glm::vec4& c) {
+  for (uint32_t i = h.first; i < h.first + h.count; i++) {
+    vertices[i * 5 + 2] = c.r;
+    vertices[i * 5 + 3] = c.g;
+    vertices[i * 5 + 4] = c.b;
+  }
+  changedVertices(h.first * 5, (h.first + h.count) * 5);
+}
+
+void StyledMultiShape2D::setPoint(Handle h, uint32_t i, float x, float y) {
+  const uint32_t v = (h.first + i) * 5;
+  vertices[v] = x;
+  vertices[v + 1] = y;
+  changedVertices(v, v + 2);
+}
+
+void StyledMultiShape2D::translate(Handle h, float dx, float dy) {
+  for (uint32_t i = h.first; i < h.first + h.count; i++) {
+    vertices[i * 5] += dx;
+    vertices[i * 5 + 1] += dy;
+  }
+  changedVertices(h.first * 5, (h.first + h.count) * 5);
+}
+
+// in the order fillRectangle adds them
+void StyledMultiShape2D::setRectangle(Handle h, float x, float y, float w,
+                                      float ht) {
+  setPoint(h, 0, x, y);
+  setPoint(h, 1, x, y + ht);
+  setPoint(h, 2, x + w, y + ht);
+  setPoint(h, 3, x + w, y);
+}
+
 void StyledMultiShape2D::updateColors(const uint64_t pos, const float r,
                                       const float g, const float b) {
-  for (uint32_t i = 0; i < numIndices[pos]; ++i) {
-    vertices[startIndices[pos] * 5 + 5 * i + 2] = r;
-    vertices[startIndices[pos] * 5 + 5 * i + 3] = g;
-    vertices[startIndices[pos] * 5 + 5 * i + 4] = b;
-  }
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float),
-                  &vertices[0]);
+  setColor(Handle{uint32_t(startIndices[pos]), uint32_t(numIndices[pos])},
+           glm::vec4(r, g, b, 1));
+  updatePoints();
 }
 
 void StyledMultiShape2D::bezierSegment(const Bezier* b) {
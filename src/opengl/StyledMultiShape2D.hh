@@ -4,6 +4,7 @@
 
 #include "opengl/Canvas.hh"
 #include "opengl/MultiShape2D.hh"
+#include "opengl/util/Tessellation.hh"
 
 class StyledMultiShape2D : public MultiShape2D {
  private:
@@ -49,20 +50,46 @@ class StyledMultiShape2D : public MultiShape2D {
   // override Shape methods to draw us
   ~StyledMultiShape2D() override;
   void clear() {
-    vertices.clear();
+    MultiShape::clear();
     colors.clear();
-    lineIndices.clear();
-    pointIndices.clear();
+    startIndices.assign(1, 0);
+    numIndices.clear();
+    currentIndex = 0;
   }
   void init() override;
   void render() override;
+  const glm::mat4& getTransform() const { return transform; }
+
+  /*
+    The vertices of one primitive, so a live chart can change a few bars in
+    place and upload only them on the next update instead of clearing and
+    drawing everything again. Valid until clear().
+
+      uint32_t first = m->getNumVertices();
+      m->fillRectangle(x, y, w, h, c);
+      Handle bar = m->handleSince(first);
+      ...
+      m->setRectangle(bar, x, y, w, newHeight);
+  */
+  struct Handle {
+    uint32_t first, count;
+  };
+  uint32_t getNumVertices() const { return getPointIndex(); }
+  // everything drawn since getNumVertices() returned first
+  Handle handleSince(uint32_t first) const {
+    return Handle{first, getPointIndex() - first};
+  }
+  void setColor(Handle h, const glm::vec4& c);
+  void setPoint(Handle h, uint32_t i, float x, float y);
+  void translate(Handle h, float dx, float dy);
+  // a primitive drawn by fillRectangle or drawRectangle
+  void setRectangle(Handle h, float x, float y, float w, float ht);
 
-  // Update Methods (in progress)
+  // change the color of the pos'th primitive and upload it now
   void updateColors(const uint64_t pos, const float r, const float g,
                     const float b);
 
   // Update buffers
-  void updatePoints();
   void updateIndices();
   // Solid Primitives
   void fillRectangle(float x, float y, float w, float h, const glm::vec4& c);
@@ -76,6 +103,9 @@ class StyledMultiShape2D : public MultiShape2D {
                   const glm::vec4& c);
   void fillEllipse(float x, float y, float xRad, float yRad, float angleInc,
                    const glm::vec4& c);
+  // the same as fillEllipse on each, tessellated in parallel
+  void fillEllipses(const Tessellation::Ellipse e[], uint32_t n,
+                    uint32_t numThreads = 0);
 
   // Line Primitives
   void drawRectangle(float x, float y, float w, float h, const glm::vec4& c);
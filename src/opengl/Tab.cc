@@ -52,8 +52,8 @@ void Tab::init() {
 // now.
 bool Tab::checkUpdate() {
   if (updateTime == 0 ||
-      (updateTime > 0 && glfwGetTime() > lastUpdateTime + updateTime)) {
-    lastUpdateTime = glfwGetTime();
+      (updateTime > 0 && parent->getTime() > lastUpdateTime + updateTime)) {
+    lastUpdateTime = parent->getTime();
     return true;
   }
   return false;
@@ -124,7 +124,7 @@ void Tab::resetTimeDilation() { dt = defaultDt; }
 
 void Tab::tick() { t += dt; }
 
-double Tab::getTime() const { return glfwGetTime(); }
+double Tab::getTime() const { return parent->getTime(); }
 
 /*
   actions for a 2d environment
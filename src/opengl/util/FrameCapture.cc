@@ -0,0 +1,173 @@
+#include "opengl/util/FrameCapture.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "glad/glad.h"
+#include "stb/stb_image_write.h"
+
+using namespace std;
+
+FrameCapture::FrameCapture(uint32_t numBuffers, uint32_t numThreads)
+    : slots(max(numBuffers, 1u)),
+      oldest(0),
+      inFlight(0),
+      busy(0),
+      stopping(false),
+      frames("gl.capture.frames"),
+      stalls("gl.capture.stalls") {
+  if (numThreads == 0)
+    numThreads = max(2u, std::thread::hardware_concurrency()) - 1;
+  maxQueued = 2 * numThreads;
+  // stb tries all five PNG filters on every row and keeps the best; the
+  // first alone is twice as fast for a few percent more bytes
+  stbi_write_force_png_filter = 0;
+  for (Slot& s : slots) {
+    glGenBuffers(1, &s.pbo);
+    s.fence = nullptr;
+    s.width = s.height = 0;
+  }
+  for (uint32_t i = 0; i < numThreads; i++)
+    workers.emplace_back(&FrameCapture::work, this);
+}
+
+FrameCapture::~FrameCapture() {
+  finish();
+  {
+    lock_guard<mutex> g(jobLock);
+    stopping = true;
+  }
+  jobReady.notify_all();
+  for (auto& t : workers) t.join();
+  for (Slot& s : slots) glDeleteBuffers(1, &s.pbo);
+}
+
+void FrameCapture::capture(uint32_t width, uint32_t height,
+                           const string& filename, Format format) {
+  retire(false);
+  if (inFlight == slots.size()) retire(true);
+  Slot& s = slots[(oldest + inFlight) % slots.size()];
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+  if (s.width != width || s.height != height) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, uint64_t(width) * height * 4, nullptr,
+                 GL_STREAM_READ);
+    s.width = width, s.height = height;
+  }
+  // RGBA rows are always 4 byte aligned, the format GPUs copy fastest
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  s.filename = filename;
+  s.format = format;
+  inFlight++;
+  frames.add();
+}
+
+/*
+  Hand finished readbacks to the encoders, oldest first, so frames are
+  queued in order. With wait, the oldest is finished even if the GPU has
+  to be waited for.
+*/
+void FrameCapture::retire(bool wait) {
+  while (inFlight > 0) {
+    Slot& s = slots[oldest];
+    const GLenum status =
+        glClientWaitSync((GLsync)s.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                         wait ? 1000000000ULL : 0);
+    if (status == GL_TIMEOUT_EXPIRED && !wait) return;
+    glDeleteSync((GLsync)s.fence);
+    s.fence = nullptr;
+
+    Job j;
+    {
+      unique_lock<mutex> g(jobLock);
+      if (jobs.size() >= maxQueued) {
+        stalls.add();
+        jobDone.wait(g, [this]() { return jobs.size() < maxQueued; });
+      }
+      if (!freeBuffers.empty()) {
+        j.pixels = std::move(freeBuffers.back());
+        freeBuffers.pop_back();
+      }
+    }
+    const uint64_t rowBytes = uint64_t(s.width) * 4;
+    j.pixels.resize(rowBytes * s.height);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+    const uint8_t* p = (const uint8_t*)glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, rowBytes * s.height, GL_MAP_READ_BIT);
+    if (p != nullptr) {
+      // GL's first row is the bottom one
+      for (uint32_t y = 0; y < s.height; y++)
+        memcpy(&j.pixels[(s.height - 1 - y) * rowBytes], p + y * rowBytes,
+               rowBytes);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    j.width = s.width, j.height = s.height;
+    j.filename = std::move(s.filename);
+    j.format = s.format;
+    oldest = (oldest + 1) % slots.size();
+    inFlight--;
+    if (p == nullptr) {
+      cerr << "FrameCapture: could not map frame " << j.filename << '\n';
+      continue;
+    }
+    {
+      lock_guard<mutex> g(jobLock);
+      jobs.push_back(std::move(j));
+    }
+    jobReady.notify_one();
+    wait = false;  // only the oldest had to be waited for
+  }
+}
+
+void FrameCapture::finish() {
+  while (inFlight > 0) retire(true);
+  unique_lock<mutex> g(jobLock);
+  jobDone.wait(g, [this]() { return jobs.empty() && busy == 0; });
+}
+
+void FrameCapture::work() {
+  for (;;) {
+    Job j;
+    {
+      unique_lock<mutex> g(jobLock);
+      jobReady.wait(g, [this]() { return stopping || !jobs.empty(); });
+      if (jobs.empty()) return;  // stopping, and nothing left to write
+      j = std::move(jobs.front());
+      jobs.pop_front();
+      busy++;
+    }
+    jobDone.notify_all();  // a place in the queue is free
+    write(j);
+    {
+      lock_guard<mutex> g(jobLock);
+      freeBuffers.push_back(std::move(j.pixels));
+      busy--;
+    }
+    jobDone.notify_all();
+  }
+}
+
+void FrameCapture::write(const Job& j) {
+  bool ok;
+  if (j.format == Format::png) {
+    ok = stbi_write_png(j.filename.c_str(), j.width, j.height, 4,
+                        j.pixels.data(), j.width * 4) != 0;
+  } else {
+    FILE* f = fopen(j.filename.c_str(), "wb");
+    ok = f != nullptr;
+    if (ok) {
+      fprintf(f,
+              "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\n"
+              "TUPLTYPE RGB_ALPHA\nENDHDR\n",
+              j.width, j.height);
+      ok = fwrite(j.pixels.data(), 1, j.pixels.size(), f) == j.pixels.size();
+      ok = fclose(f) == 0 && ok;
+    }
+  }
+  if (!ok) cerr << "FrameCapture: could not write " << j.filename << '\n';
+}
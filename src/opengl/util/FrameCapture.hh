@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/StatCounter.hh"
+
+/*
+  Save frames without stalling the render thread.
+
+  glReadPixels into a pixel pack buffer returns at once, and the copy
+  happens on the GPU after the frame's drawing. Each frame gets the next
+  buffer of a small ring along with a fence. A buffer is mapped only once
+  its fence has passed, normally a frame or two later, so the render
+  thread never waits on the GPU unless the whole ring is in flight.
+
+  Mapped pixels are copied, top row first, into a buffer taken from a
+  free list and handed to encoder threads, which write PNG or raw files.
+  If the encoders fall behind, capture() waits for a free place in the
+  queue rather than drop frames or use unbounded memory, and counts the
+  stall.
+
+  The constructor, capture(), finish() and the destructor use GL, so they
+  belong on the thread that renders.
+*/
+class FrameCapture {
+ public:
+  enum class Format {
+    png,
+    pam,  // raw RGBA with a PAM header, cheap to write and to diff
+  };
+
+ private:
+  struct Slot {
+    uint32_t pbo;
+    void* fence;  // GLsync
+    uint32_t width, height;
+    std::string filename;
+    Format format;
+  };
+  struct Job {
+    std::vector<uint8_t> pixels;  // RGBA, top row first
+    uint32_t width, height;
+    std::string filename;
+    Format format;
+  };
+
+  std::vector<Slot> slots;
+  uint32_t oldest;    // slot of the oldest readback in flight
+  uint32_t inFlight;  // readbacks not yet handed to the encoders
+
+  std::mutex jobLock;
+  std::condition_variable jobReady, jobDone;
+  std::deque<Job> jobs;
+  std::vector<std::vector<uint8_t>> freeBuffers;
+  uint32_t maxQueued;
+  uint32_t busy;  // jobs being encoded right now
+  bool stopping;
+  std::vector<std::thread> workers;
+  StatCounter frames, stalls;
+
+  void work();
+  void retire(bool wait);
+  static void write(const Job& j);
+
+ public:
+  /*
+    numBuffers pixel buffers in the ring, numThreads encoders (0 for one
+    per core but one)
+  */
+  FrameCapture(uint32_t numBuffers = 3, uint32_t numThreads = 0);
+  ~FrameCapture();
+  FrameCapture(const FrameCapture& orig) = delete;
+  FrameCapture& operator=(const FrameCapture& orig) = delete;
+
+  // read back the bound framebuffer, to be written to filename later
+  void capture(uint32_t width, uint32_t height, const std::string& filename,
+               Format format = Format::png);
+  // wait for every frame captured so far to be written
+  void finish();
+  uint64_t getFrames() const { return frames.get(); }
+  uint64_t getStalls() const { return stalls.get(); }
+};
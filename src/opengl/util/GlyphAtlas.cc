@@ -0,0 +1,201 @@
+#include "opengl/util/GlyphAtlas.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "glad/glad.h"
+
+using namespace std;
+
+GlyphAtlas::GlyphAtlas(uint32_t width, uint32_t maxHeight)
+    : top(1),
+      uploadedHeight(0),
+      evictions(0),
+      rendered("gl.font.rendered"),
+      evicted("gl.font.evicted"),
+      uploaded("gl.font.uploadBytes"),
+      dropped("gl.font.dropped") {
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  this->width = min(width, uint32_t(maxSize));
+  this->maxHeight = min(maxHeight, uint32_t(maxSize));
+  height = min(256u, this->maxHeight);
+  pixels.resize(uint64_t(this->width) * height);
+  dirtyX0 = this->width, dirtyY0 = height, dirtyX1 = dirtyY1 = 0;
+
+  glGenTextures(1, &textureId);
+  glBindTexture(GL_TEXTURE_2D, textureId);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+GlyphAtlas::~GlyphAtlas() { glDeleteTextures(1, &textureId); }
+
+/*
+  The shortest shelf with room for a w x h glyph, but no taller than a line
+  of its font so small glyphs do not fill up tall shelves. Failing that a
+  new shelf, growing the texture if need be. -1 if the texture is full.
+*/
+int32_t GlyphAtlas::findShelf(uint32_t w, uint32_t h, uint32_t lineHeight) {
+  const uint32_t tallest = max(h, lineHeight);
+  int32_t best = -1;
+  for (uint32_t i = 0; i < shelves.size(); i++) {
+    const Shelf& s = shelves[i];
+    if (s.height >= h && s.height <= tallest && s.x + w <= width &&
+        (best < 0 || s.height < shelves[best].height))
+      best = i;
+  }
+  if (best >= 0) return best;
+  while (top + tallest > height && height < maxHeight) {
+    height = min(height * 2, maxHeight);
+    pixels.resize(uint64_t(width) * height);
+  }
+  if (top + tallest > height) return -1;
+  shelves.push_back(Shelf{top, tallest, 0, {}});
+  top += tallest;
+  return shelves.size() - 1;
+}
+
+void GlyphAtlas::evict(uint32_t s) {
+  Shelf& shelf = shelves[s];
+  for (Font::Glyph* g : shelf.glyphs) g->shelf = Font::Glyph::UNLOADED;
+  evicted.add(shelf.glyphs.size());
+  shelf.glyphs.clear();
+  // clear what the glyphs left, the padding between new ones must be blank
+  for (uint32_t y = shelf.y; y < shelf.y + shelf.height; y++)
+    memset(&pixels[uint64_t(y) * width], 0, shelf.x);
+  dirtyX0 = 0, dirtyX1 = max(dirtyX1, shelf.x);
+  dirtyY0 = min(dirtyY0, shelf.y);
+  dirtyY1 = max(dirtyY1, shelf.y + shelf.height);
+  shelf.x = 0;
+  evictions++;
+}
+
+void GlyphAtlas::evictAll() {
+  for (Shelf& shelf : shelves) {
+    for (Font::Glyph* g : shelf.glyphs) g->shelf = Font::Glyph::UNLOADED;
+    evicted.add(shelf.glyphs.size());
+  }
+  shelves.clear();
+  top = 1;
+  memset(pixels.data(), 0, pixels.size());
+  dirtyX0 = dirtyY0 = 0, dirtyX1 = width, dirtyY1 = height;
+  evictions++;
+}
+
+/*
+  The texture is full, so empty the shelf whose glyphs were looked up least
+  recently, one of the right height if there is one, else any tall enough.
+  Glyphs looked up for the frame being drawn are never evicted, but if
+  they hold every such shelf, one of theirs with room is used however tall
+  it is. If no shelf is tall enough and none is in use, all are emptied.
+  -1 if the glyphs of this frame leave no room.
+*/
+int32_t GlyphAtlas::reuseShelf(uint32_t w, uint32_t h, uint32_t lineHeight) {
+  int32_t best = -1, taller = -1, roomy = -1;
+  uint32_t oldest = Font::useClock, oldestTaller = Font::useClock;
+  bool inUse = false;
+  for (uint32_t i = 0; i < shelves.size(); i++) {
+    const Shelf& shelf = shelves[i];
+    uint32_t lastUse = 0;
+    for (const Font::Glyph* sg : shelf.glyphs)
+      lastUse = max(lastUse, sg->lastUse);
+    if (lastUse == Font::useClock) {
+      inUse = true;
+      if (roomy < 0 && shelf.height >= h && shelf.x + w <= width) roomy = i;
+      continue;
+    }
+    if (shelf.height < h) continue;
+    if (shelf.height <= max(h, lineHeight)) {
+      if (lastUse < oldest) oldest = lastUse, best = i;
+    } else if (lastUse < oldestTaller) {
+      oldestTaller = lastUse, taller = i;
+    }
+  }
+  if (best < 0) best = taller;
+  if (best >= 0) {
+    evict(best);
+    return best;
+  }
+  if (roomy >= 0) return roomy;
+  if (inUse) return -1;
+  evictAll();
+  return findShelf(w, h, lineHeight);
+}
+
+void GlyphAtlas::add(Font::Glyph* g, const uint8_t bitmap[], uint32_t w,
+                     uint32_t h, int32_t pitch, uint32_t lineHeight) {
+  // one blank column and row after each glyph, so filtering at its edges
+  // never picks up a neighbor
+  const uint32_t wp = w + 1, hp = h + 1;
+  if (wp > width || hp > maxHeight) {
+    cerr << "GlyphAtlas: " << w << 'x' << h << " glyph does not fit\n";
+    g->shelf = Font::Glyph::NO_BITMAP;
+    g->sizeX = g->sizeY = 0;
+    return;
+  }
+  int32_t s = findShelf(wp, hp, lineHeight + 1);
+  if (s < 0) s = reuseShelf(wp, hp, lineHeight + 1);
+  if (s < 0) {
+    // drawn blank from row 0 this frame, and text holding it looks it up
+    // again for the next
+    g->shelf = Font::Glyph::UNLOADED;
+    g->u0 = g->u1 = g->v1 = g->v0 = 0;
+    evictions++;
+    dropped.add();
+    return;
+  }
+  Shelf& shelf = shelves[s];
+  const uint32_t x = shelf.x, y = shelf.y;
+  for (uint32_t row = 0; row < h; row++) {
+    // a negative pitch means the bitmap is stored bottom row first
+    const uint8_t* src = pitch >= 0 ? bitmap + uint64_t(row) * pitch
+                                    : bitmap + uint64_t(h - 1 - row) * -pitch;
+    memcpy(&pixels[uint64_t(y + row) * width + x], src, w);
+  }
+  shelf.x += wp;
+  shelf.glyphs.push_back(g);
+  g->shelf = s;
+  g->u0 = x, g->u1 = x + w;
+  g->v1 = y, g->v0 = y + h;
+  dirtyX0 = min(dirtyX0, x), dirtyX1 = max(dirtyX1, x + w);
+  dirtyY0 = min(dirtyY0, y), dirtyY1 = max(dirtyY1, y + h);
+  rendered.add();
+}
+
+void GlyphAtlas::share(Font::Glyph* g, const Font::Glyph* placed) {
+  g->shelf = placed->shelf;
+  g->u0 = placed->u0, g->u1 = placed->u1;
+  g->v1 = placed->v1, g->v0 = placed->v0;
+  shelves[placed->shelf].glyphs.push_back(g);
+}
+
+uint64_t GlyphAtlas::getUsed() const {
+  uint64_t used = 0;
+  for (const Shelf& s : shelves) used += uint64_t(s.x) * s.height;
+  return used;
+}
+
+void GlyphAtlas::flush() {
+  Font::useClock++;
+  if (uploadedHeight == height && dirtyX0 >= dirtyX1) return;
+  glBindTexture(GL_TEXTURE_2D, textureId);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (uploadedHeight != height) {  // new or grown, send all of it
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED,
+                 GL_UNSIGNED_BYTE, pixels.data());
+    uploadedHeight = height;
+    uploaded.add(pixels.size());
+  } else {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, dirtyX0, dirtyY0, dirtyX1 - dirtyX0,
+                    dirtyY1 - dirtyY0, GL_RED, GL_UNSIGNED_BYTE,
+                    &pixels[uint64_t(dirtyY0) * width + dirtyX0]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    uploaded.add(uint64_t(dirtyX1 - dirtyX0) * (dirtyY1 - dirtyY0));
+  }
+  dirtyX0 = width, dirtyY0 = height, dirtyX1 = dirtyY1 = 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "opengl/GLWinFonts.hh"
+#include "util/StatCounter.hh"
+
+/*
+  One single channel texture holding the glyphs of every face and size,
+  filled as glyphs are first drawn rather than all at startup.
+
+  Glyphs are packed on shelves: rows of the texture as tall as a line of
+  the font that opened them, filled left to right. A glyph goes on the
+  shortest shelf tall enough with room left, or a new shelf under the
+  last. When the texture is full it doubles in height up to the maximum,
+  then the shelf whose glyphs were looked up least recently is emptied and
+  reused. Evicted glyphs are rendered again the next time they are asked
+  for, and getEvictions() changes so text still holding their old place
+  knows to look them up again. Glyphs looked up for the frame being drawn
+  are never evicted; if they fill the atlas, a glyph that does not fit is
+  pointed at row 0, which is kept blank, for that frame.
+
+  Texture coordinates are in pixels, so growing the texture moves nothing.
+  Glyphs are copied into a copy of the texture kept here, and flush()
+  sends only the rectangle changed since the last flush.
+*/
+class GlyphAtlas {
+ private:
+  struct Shelf {
+    uint32_t y, height;  // rows of the texture
+    uint32_t x;          // first free column
+    std::vector<Font::Glyph*> glyphs;
+  };
+  std::vector<Shelf> shelves;
+  std::vector<uint8_t> pixels;  // the texture, row by row
+  uint32_t width, height, maxHeight;
+  uint32_t top;  // first row below the last shelf, row 0 stays blank
+  uint32_t textureId;
+  uint32_t uploadedHeight;  // height of the texture on the GPU
+  uint32_t dirtyX0, dirtyY0, dirtyX1, dirtyY1;  // changed since the flush
+  uint64_t evictions;
+  StatCounter rendered, evicted, uploaded;
+  StatCounter dropped;  // glyphs left out of a frame, the atlas was full
+
+  int32_t findShelf(uint32_t w, uint32_t h, uint32_t lineHeight);
+  int32_t reuseShelf(uint32_t w, uint32_t h, uint32_t lineHeight);
+  void evict(uint32_t s);
+  void evictAll();
+
+ public:
+  /*
+    The atlas starts small and grows to width x maxHeight, both limited to
+    the largest texture the GPU supports
+  */
+  GlyphAtlas(uint32_t width, uint32_t maxHeight);
+  ~GlyphAtlas();
+  GlyphAtlas(const GlyphAtlas& orig) = delete;
+  GlyphAtlas& operator=(const GlyphAtlas& orig) = delete;
+
+  /*
+    Copy a w x h bitmap, rows pitch bytes apart, into the atlas and set the
+    texture coordinates of g to it. lineHeight is the height of a line of
+    the font, the height of a new shelf.
+  */
+  void add(Font::Glyph* g, const uint8_t bitmap[], uint32_t w, uint32_t h,
+           int32_t pitch, uint32_t lineHeight);
+  /*
+    Point g at the bitmap of placed, a glyph already in the atlas. g is
+    evicted along with it.
+  */
+  void share(Font::Glyph* g, const Font::Glyph* placed);
+  // send the glyphs added since the last flush to the GPU, before drawing
+  void flush();
+
+  uint32_t getTexture() const { return textureId; }
+  uint32_t getWidth() const { return width; }
+  uint32_t getHeight() const { return height; }
+  uint64_t getEvictions() const { return evictions; }
+  // pixels taken by glyphs so far, padding included
+  uint64_t getUsed() const;
+};
@@ -0,0 +1,99 @@
+#include "opengl/util/Tessellation.hh"
+
+#include <cmath>
+
+#include "opengl/GLMath.hh"
+#include "util/ParallelFor.hh"
+
+using namespace std;
+
+namespace {
+constexpr uint32_t CHUNK = 4096;  // ellipses counted and written together
+
+// cos and sin of the angles StyledMultiShape2D::addSector steps through
+struct SectorTable {
+  float angleInc;
+  vector<float> c, s;
+  SectorTable(float angleInc) : angleInc(angleInc) {
+    for (float i = 0; i <= 360; i += angleInc) {
+      c.push_back(cos(-i * DEG2RAD<float>));
+      s.push_back(sin(-i * DEG2RAD<float>));
+    }
+  }
+};
+
+const SectorTable* find(const vector<SectorTable>& tables, float angleInc) {
+  for (const SectorTable& t : tables)
+    if (t.angleInc == angleInc) return &t;
+  return nullptr;
+}
+}  // namespace
+
+uint32_t Tessellation::sectorPoints(float angleInc) {
+  return SectorTable(angleInc).c.size();
+}
+
+void Tessellation::fillEllipses(const Ellipse e[], uint32_t n,
+                                vector<float>& vertices,
+                                vector<uint32_t>& indices,
+                                uint32_t numThreads) {
+  if (n == 0) return;
+  vector<SectorTable> tables;
+  for (uint32_t i = 0; i < n; i++)
+    if (find(tables, e[i].angleInc) == nullptr)
+      tables.emplace_back(e[i].angleInc);
+
+  // vertices and indices of each chunk, then where each chunk starts
+  const uint32_t numChunks = (n + CHUNK - 1) / CHUNK;
+  vector<uint64_t> chunkVertices(numChunks + 1), chunkIndices(numChunks + 1);
+  parallelFor(numChunks, numThreads, 1, [&](uint32_t c) {
+    const SectorTable* t = &tables[0];
+    uint64_t v = 0, ind = 0;
+    for (uint32_t i = c * CHUNK; i < min(n, (c + 1) * CHUNK); i++) {
+      if (e[i].angleInc != t->angleInc) t = find(tables, e[i].angleInc);
+      const uint32_t k = t->c.size();
+      v += 1 + k;
+      ind += k > 0 ? 3 * (k - 1) : 0;
+    }
+    chunkVertices[c + 1] = v;
+    chunkIndices[c + 1] = ind;
+  });
+  chunkVertices[0] = vertices.size() / FLOATS_PER_VERTEX;
+  chunkIndices[0] = indices.size();
+  for (uint32_t c = 0; c < numChunks; c++) {
+    chunkVertices[c + 1] += chunkVertices[c];
+    chunkIndices[c + 1] += chunkIndices[c];
+  }
+  vertices.resize(chunkVertices[numChunks] * FLOATS_PER_VERTEX);
+  indices.resize(chunkIndices[numChunks]);
+
+  parallelFor(numChunks, numThreads, 1, [&](uint32_t c) {
+    const SectorTable* t = &tables[0];
+    uint32_t vertex = chunkVertices[c];
+    float* v = &vertices[uint64_t(vertex) * FLOATS_PER_VERTEX];
+    uint32_t* ind = indices.data() + chunkIndices[c];
+    for (uint32_t i = c * CHUNK; i < min(n, (c + 1) * CHUNK); i++) {
+      const Ellipse& p = e[i];
+      if (p.angleInc != t->angleInc) t = find(tables, p.angleInc);
+      const uint32_t k = t->c.size(), center = vertex;
+      *v++ = p.x;
+      *v++ = p.y;
+      *v++ = p.r;
+      *v++ = p.g;
+      *v++ = p.b;
+      for (uint32_t j = 0; j < k; j++) {
+        *v++ = p.x + p.xRad * t->c[j];
+        *v++ = p.y + p.yRad * t->s[j];
+        *v++ = p.r;
+        *v++ = p.g;
+        *v++ = p.b;
+      }
+      for (uint32_t j = 1; j < k; j++) {
+        *ind++ = center;
+        *ind++ = center + j;
+        *ind++ = center + j + 1;
+      }
+      vertex += 1 + k;
+    }
+  });
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+  Bulk tessellation of filled ellipses, circles and regular polygons, with
+  the same vertices and triangles as StyledMultiShape2D::fillEllipse makes
+  one at a time.
+
+  The unit circle points for an angle step are computed once into a table,
+  since every ellipse with the same step has the same angles, which leaves
+  a multiply-add per coordinate. The ellipses are split into chunks counted
+  in parallel; prefix sums of the counts give each chunk its place in the
+  output, which is sized once and then filled in parallel, so there is no
+  push_back and no merging copy.
+*/
+class Tessellation {
+ public:
+  struct Ellipse {
+    float x, y, xRad, yRad;
+    float angleInc;  // degrees between points, 360 / sides for a polygon
+    float r, g, b;
+  };
+  static constexpr uint32_t FLOATS_PER_VERTEX = 5;  // x, y, r, g, b
+
+  // points around the edge for this step, not counting the center
+  static uint32_t sectorPoints(float angleInc);
+  // append n filled ellipses to vertices and triangle indices
+  static void fillEllipses(const Ellipse e[], uint32_t n,
+                           std::vector<float>& vertices,
+                           std::vector<uint32_t>& indices,
+                           uint32_t numThreads = 0);
+};
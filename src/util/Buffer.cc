@@ -17,6 +17,7 @@ Buffer::Buffer(size_t initialSize, bool writing)
   preBuffer = new char[size + extra * 2];
   buffer = extra + preBuffer;
   p = buffer;
+  received = buffer;
   memset(preBuffer, '\0', size + extra * 2);
   fd = -1;
   isSockBuf = true;
@@ -48,12 +49,118 @@ Buffer::Buffer(const char filename[], size_t initialSize, const char*)
 void Buffer::readNext() {
   int32_t bytesRead = SocketIO::recv(fd, buffer, size, 0);
   if (bytesRead > 0) availSize -= bytesRead;
+  received = buffer + (bytesRead > 0 ? bytesRead : 0);
   // TODO: do we set p????
   // read really shouldn't return negative but it is, at least on windows...
   // check why This is occurring when there are no bytes to read -- possible
   // they're returning -1 when most return 0?
 }
 
+bool Buffer::receiveMore() {
+  if (p > buffer) {
+    memmove(buffer, p, received - p);
+    received -= p - buffer;
+    p = buffer;
+  }
+  int32_t space = buffer + size - received;
+  if (space <= 0) return false;
+  int32_t bytesRead = SocketIO::recv(fd, received, space, 0);
+  if (bytesRead <= 0) return false;
+  received += bytesRead;
+  return true;
+}
+
+void Buffer::enableFlowControl(uint32_t highWater, uint32_t lowWater,
+                               function<void(bool)> onPause,
+                               int stallMillis) {
+  this->highWater = highWater;
+  this->lowWater = lowWater;
+  this->onPause = std::move(onPause);
+  this->stallMillis = stallMillis;
+  pending.clear();
+  pendingStart = maxQueued = 0;
+  paused = false;
+}
+
+void Buffer::sendToSocket(const char* data, uint32_t len) {
+  if (highWater == 0) {
+    while (len > 0) {
+      int sent = SocketIO::send(fd, data, len, 0);
+      if (sent < 0) return;  // socket already closed, warning printed
+      if (sent == 0 && !SocketIO::waitWritable(fd, stallMillis))
+        throw Ex1(Errcode::SOCKET_STALLED);
+      data += sent;
+      len -= sent;
+    }
+    return;
+  }
+
+  // anything already queued has to go first
+  if (getQueuedBytes() == 0) {
+    int sent = SocketIO::trySend(fd, data, len);
+    if (sent < 0) return;  // socket already closed, warning printed
+    data += sent;
+    len -= sent;
+  }
+  // queue at most 2 * highWater, a producer that ignored the pause waits
+  // here for the reader
+  while (len > 0) {
+    uint32_t limit = 2 * highWater;
+    uint32_t room = getQueuedBytes() < limit ? limit - getQueuedBytes() : 0;
+    uint32_t n = min(len, room);
+    pending.insert(pending.end(), data, data + n);
+    data += n;
+    len -= n;
+    if (getQueuedBytes() > maxQueued) maxQueued = getQueuedBytes();
+    if (!paused && getQueuedBytes() > highWater) {
+      paused = true;
+      if (onPause) onPause(true);
+    }
+    if (len > 0) {
+      if (!SocketIO::waitWritable(fd, stallMillis))
+        throw Ex1(Errcode::SOCKET_STALLED);
+      drainOutput();
+    }
+  }
+}
+
+bool Buffer::drainOutput() {
+  while (getQueuedBytes() > 0) {
+    int sent =
+        SocketIO::trySend(fd, pending.data() + pendingStart, getQueuedBytes());
+    if (sent <= 0) break;
+    pendingStart += sent;
+  }
+  if (getQueuedBytes() == 0) {
+    pending.clear();
+    pendingStart = 0;
+  } else if (pendingStart > pending.size() / 2) {
+    // compact so pending does not grow with everything ever sent
+    pending.erase(pending.begin(), pending.begin() + pendingStart);
+    pendingStart = 0;
+  }
+  if (paused && getQueuedBytes() <= lowWater) {
+    paused = false;
+    if (onPause) onPause(false);
+  }
+  return getQueuedBytes() == 0;
+}
+
+bool Buffer::waitForResume(int timeoutMillis) {
+  while (paused) {
+    if (!SocketIO::waitWritable(fd, timeoutMillis)) return false;
+    drainOutput();
+  }
+  return true;
+}
+
+bool Buffer::finishOutput(int timeoutMillis) {
+  flush();
+  while (!drainOutput())
+    if (!SocketIO::waitWritable(fd, timeoutMillis)) return false;
+  return true;
+}
+
 // TODO: This string does nto check if there is available buffer for it!! BUG
 // TODO: For now, we are only using String8. We have to encode what kind of
 // string is coming if we support variable sizes
@@ -85,7 +192,12 @@ void Buffer::write(const char* s, uint32_t len) {
 
 void Buffer::write(const XDLRaw& v) {
   if (p != buffer) flush();
-  ::write(fd, v.data, v.len);
+  if (capture != nullptr)
+    capture->insert(capture->end(), v.data, v.data + v.len);
+  else if (isSockBuf)
+    sendToSocket(v.data, v.len);
+  else
+    ::write(fd, v.data, v.len);
 }
 
 #if 0
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <regex>
 #include <string>
@@ -54,14 +55,75 @@ class Buffer {
 
   void flush() {  // TODO: this will fail if we overflow slightly
     uint32_t writeSize = (p - buffer >= size) ? size : (p - buffer);
-    if (isSockBuf)
-      SocketIO::send(fd, buffer, writeSize, 0);
+    if (writeSize == 0) {
+      // nothing pending, do not touch a socket the peer may have closed
+    } else if (capture != nullptr)
+      capture->insert(capture->end(), buffer, buffer + writeSize);
+    else if (isSockBuf)
+      sendToSocket(buffer, writeSize);
     else {
       if (::write(fd, buffer, writeSize) < 0) throw Ex1(Errcode::FILE_WRITE);
     }
     p = buffer;
     availSize = size;
   }
+  /*
+    While a capture vector is set, flush() appends to it instead of writing
+    to the file or socket (ResponseCache records servlet output this way).
+    Pass nullptr to stop capturing.
+  */
+  void setCapture(std::vector<char>* sink) { capture = sink; }
+
+  /*
+    Flow control for socket output, so a slow reader cannot block the
+    server or make it buffer without limit.
+
+    Once enabled, flush() sends only what the kernel accepts right away and
+    queues the rest. When more than highWater bytes are queued the buffer
+    pauses: onPause(true) is called, and producers should stop writing
+    until onPause(false), which comes once drainOutput() has brought the
+    queue down to lowWater. Call drainOutput() when the socket is writable,
+    or waitForResume() to block until then.
+
+    A producer that keeps writing while paused is held in flush() while the
+    queue is at 2 * highWater, so memory stays bounded. If the reader takes
+    nothing for stallMillis, flush() throws SOCKET_STALLED.
+    Without flow control flush() blocks until everything is sent.
+    Enabling starts a new connection with nothing queued.
+  */
+  static constexpr int STALL_MILLIS = 10000;
+  void enableFlowControl(uint32_t highWater, uint32_t lowWater,
+                         std::function<void(bool paused)> onPause = nullptr,
+                         int stallMillis = STALL_MILLIS);
+  bool isPaused() const { return paused; }
+  /*
+    For producers writing many items: send each block as it fills and,
+    while paused, wait for the reader before writing more.
+  */
+  void waitIfPaused() {
+    checkAvailableWrite();
+    if (paused && !waitForResume(stallMillis))
+      throw Ex1(Errcode::SOCKET_STALLED);
+  }
+  // send queued bytes without blocking, true if none are left
+  bool drainOutput();
+  // block until not paused, false if the reader stalled for timeoutMillis
+  bool waitForResume(int timeoutMillis);
+  // send everything queued before the connection is closed
+  bool finishOutput(int timeoutMillis);
+  uint32_t getQueuedBytes() const { return pending.size() - pendingStart; }
+  uint32_t getMaxQueuedBytes() const { return maxQueued; }
+  /*
+    Read from bytes already in memory, such as a response downloaded by
+    AsyncCSPClient. len must fit in the buffer.
+  */
+  void load(const char* data, uint32_t len) {
+    if (len > size) throw Ex1(Errcode::ILLEGAL_SIZE);
+    memcpy(buffer, data, len);
+    p = buffer;
+    received = buffer + len;
+    availSize = len;
+  }
   void readNext();
   // write is binary
   void write(const std::string& s);
@@ -109,6 +171,21 @@ class Buffer {
   bool getHTTPVersion(const char*& ptr, uint32_t& len);
   bool getHost(const char*& ptr, uint32_t& len);
   void pointToStart();
+
+  /*
+    In-place access for parsers that work on the raw bytes (HTTPParser).
+    getReadPtr()..getReadPtr()+getReadLen() has been received but not yet
+    consumed.
+  */
+  const char* getReadPtr() const { return p; }
+  uint32_t getReadLen() const { return received - p; }
+  void advanceRead(uint32_t n) { p += n; }
+  /*
+    Receive more bytes after the ones already in the buffer, moving the
+    unconsumed bytes to the front first. Returns false if the buffer is
+    full or nothing more arrives.
+  */
+  bool receiveMore();
   /**
      extract the next space-delimited value from the buffer
      if return true, this means ptr is pointing to the text, len = the length of
@@ -154,10 +231,15 @@ class Buffer {
   void write(const XDLRaw& v);
 
   // for writing big objects, don't copy into the buffer, write it to the socket
-  // directly
+  // directly (or to the capture, so a cached response is complete)
   void specialWrite(const char* buf, const uint32_t len) {
     flush();
-    ::write(fd, buf, len);
+    if (capture != nullptr)
+      capture->insert(capture->end(), buf, buf + len);
+    else if (isSockBuf)
+      sendToSocket(buf, len);
+    else if (::write(fd, buf, len) < 0)
+      throw Ex1(Errcode::FILE_WRITE);
   }
 
   template <typename T>
@@ -166,6 +248,7 @@ class Buffer {
     list.write(p);
     p += list.serializeSize();
     availSize -= list.serializeSize();
+    waitIfPaused();
   }
 
   void writeStudent(Student v) {
@@ -180,6 +263,7 @@ class Buffer {
     write(list.getUsed());
     for (uint32_t i = 0; i < list.getUsed(); i++) {
       writeStudent(list.getData(i));
+      waitIfPaused();
     }
   }
 
@@ -430,6 +514,17 @@ class Buffer {
   char* buffer;       // pointer to the buffer
   int32_t availSize;  // how much space is left in the buffer
   char* p;            // cursor to current byte for reading/writing
+  char* received;     // end of the bytes received by the last read
+  std::vector<char>* capture = nullptr;  // see setCapture
+  // flow control (see enableFlowControl), off while highWater == 0
+  std::vector<char> pending;  // bytes the socket has not taken yet
+  uint32_t pendingStart = 0;  // first unsent byte in pending
+  uint32_t highWater = 0, lowWater = 0;
+  uint32_t maxQueued = 0;
+  int stallMillis = STALL_MILLIS;
+  bool paused = false;
+  std::function<void(bool paused)> onPause;
+  void sendToSocket(const char* data, uint32_t len);
   int fd;  // file descriptor for file backing this buffer (read or write)
   uint32_t blockSize;  // Max block size for output
   void checkAvailableRead(size_t sz) {
@@ -0,0 +1,110 @@
+#include "util/CSVScanner.hh"
+
+#include <bit>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+struct Masks {
+  uint64_t quote, comma, newline;
+};
+
+// one bit per byte of p[0, 64) equal to each structural character
+Masks classify(const char* p) {
+#ifdef __AVX2__
+  const __m256i lo = _mm256_loadu_si256((const __m256i*)p),
+                hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+  auto equal = [&](char c) {
+    const __m256i v = _mm256_set1_epi8(c);
+    return uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v)))) |
+           uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v))))
+               << 32;
+  };
+#elif defined(__SSE2__)
+  __m128i in[4];
+  for (int i = 0; i < 4; i++) in[i] = _mm_loadu_si128((const __m128i*)p + i);
+  auto equal = [&](char c) {
+    const __m128i v = _mm_set1_epi8(c);
+    uint64_t m = 0;
+    for (int i = 0; i < 4; i++)
+      m |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(in[i], v))))
+           << (16 * i);
+    return m;
+  };
+#else
+  auto equal = [&](char c) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i++) m |= uint64_t(p[i] == c) << i;
+    return m;
+  };
+#endif
+  return Masks{equal('"'), equal(','), equal('\n')};
+}
+
+// bit i is the xor of bits 0..i, so set from an opening quote to before
+// the closing one
+uint64_t prefixXor(uint64_t x) {
+#ifdef __PCLMUL__
+  return _mm_cvtsi128_si64(_mm_clmulepi64_si128(
+      _mm_set_epi64x(0, x), _mm_set1_epi8(char(0xFF)), 0));
+#else
+  for (int shift = 1; shift < 64; shift *= 2) x ^= x << shift;
+  return x;
+#endif
+}
+
+// days from 1970-01-01 to a proleptic Gregorian date
+int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  const int32_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yearOfEra = y - era * 400;
+  const uint32_t dayOfYear = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const uint32_t dayOfEra =
+      yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + int32_t(dayOfEra) - 719468;
+}
+}  // namespace
+
+uint32_t CSVScanner::findFieldEnds(const char* p, uint32_t len,
+                                   uint64_t& inQuote) {
+  uint32_t n = 0;
+  for (uint32_t b = 0; b < len; b += 64) {
+    Masks m;
+    if (len - b >= 64) {
+      m = classify(p + b);
+    } else {  // the last block is padded with spaces, which end nothing
+      char tail[64];
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, p + b, len - b);
+      m = classify(tail);
+    }
+    const uint64_t quoted = prefixXor(m.quote) ^ inQuote;
+    inQuote = uint64_t(int64_t(quoted) >> 63);
+    for (uint64_t ends = (m.comma | m.newline) & ~quoted; ends != 0;
+         ends &= ends - 1)
+      index[n++] = b + countr_zero(ends);
+  }
+  return n;
+}
+
+bool CSVScanner::parseDate(const char* p, const char* end, int32_t& days) {
+  if (end - p != 10 || p[4] != '-' || p[7] != '-') return false;
+  uint32_t digits[8];
+  for (int i = 0, j = 0; i < 10; i++) {
+    if (i == 4 || i == 7) continue;
+    digits[j] = uint32_t(p[i] - '0');
+    if (digits[j++] > 9) return false;
+  }
+  const int32_t year =
+      digits[0] * 1000 + digits[1] * 100 + digits[2] * 10 + digits[3];
+  const uint32_t month = digits[4] * 10 + digits[5],
+                 day = digits[6] * 10 + digits[7];
+  if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+  days = daysFromCivil(year, month, day) - daysFromCivil(2000, 1, 1);
+  return true;
+}
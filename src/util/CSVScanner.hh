@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "util/MappedFile.hh"
+
+/*
+  Zero allocation CSV reader, Excel dialect like CSVParser, that converts
+  each field to the type of its column and hands it straight to a sink
+  instead of building strings.
+
+  It works in two stages, as simdcsv does. The first finds the commas and
+  newlines that end fields 64 bytes at a time: SIMD compares make a bitmask
+  of quotes, commas and newlines, the prefix xor of the quote mask (a carry
+  less multiply by all ones) marks the bytes inside quotes, and what is
+  left of the commas and newlines are written to an index. The second walks
+  the index converting fields. The input is done in chunks so the index
+  stays small and in cache.
+
+  A sink derives from CSVScanner::Sink and hides the calls for the column
+  types it uses, which are resolved at compile time. Rows count from 0
+  after the header, dates are yyyy-mm-dd in days since January 1, 2000
+  like Date, and text is the field without its enclosing quotes, with any
+  "" left doubled. Fields that
+  don't parse as the type of their column are not delivered, so a sink
+  fills its arrays with its own missing value first.
+*/
+class CSVScanner {
+ public:
+  enum class Type : uint8_t { skip, f64, i64, date, text };
+
+  struct Sink {
+    void onF64(uint32_t, uint32_t, double) {}
+    void onI64(uint32_t, uint32_t, int64_t) {}
+    void onDate(uint32_t, uint32_t, int32_t) {}
+    void onText(uint32_t, uint32_t, std::string_view) {}
+  };
+
+ private:
+  static constexpr uint32_t CHUNK = 64 * 1024;
+  std::vector<Type> types;
+  uint32_t headerRows;
+  std::vector<uint32_t> index;  // field ends in the current chunk
+
+  /*
+    Write the offsets of the field ending commas and newlines in p[0, len)
+    to index, returning how many. inQuote is all ones if the previous
+    chunk ended inside quotes, and is updated for the next.
+  */
+  uint32_t findFieldEnds(const char* p, uint32_t len, uint64_t& inQuote);
+
+  static bool parseDate(const char* p, const char* end, int32_t& days);
+
+  template <typename Sink>
+  void field(const char* p, const char* end, uint32_t col, uint32_t row,
+             Sink& sink) const {
+    if (col >= types.size()) return;
+    if (end > p && end[-1] == '\r') end--;
+    if (end - p >= 2 && *p == '"' && end[-1] == '"') p++, end--;
+    switch (types[col]) {
+      case Type::f64: {
+        double v;
+        if (std::from_chars(p, end, v).ptr == end && p != end)
+          sink.onF64(col, row, v);
+        break;
+      }
+      case Type::i64: {
+        int64_t v;
+        if (std::from_chars(p, end, v).ptr == end && p != end)
+          sink.onI64(col, row, v);
+        break;
+      }
+      case Type::date: {
+        int32_t days;
+        if (parseDate(p, end, days)) sink.onDate(col, row, days);
+        break;
+      }
+      case Type::text:
+        sink.onText(col, row, std::string_view(p, end - p));
+        break;
+      case Type::skip:
+        break;
+    }
+  }
+
+ public:
+  /*
+    types of the columns, any columns past the end are skipped, and the
+    number of header rows to skip
+  */
+  CSVScanner(const std::vector<Type>& types, uint32_t headerRows = 1)
+      : types(types), headerRows(headerRows), index(CHUNK + 1) {}
+
+  // scan text in memory, returning the number of rows after the header
+  template <typename Sink>
+  uint32_t scan(const char* data, uint64_t size, Sink& sink) {
+    uint64_t inQuote = 0, start = 0;
+    uint32_t col = 0, row = 0;
+    for (uint64_t base = 0; base < size; base += CHUNK) {
+      const uint32_t len = std::min<uint64_t>(CHUNK, size - base);
+      const uint32_t n = findFieldEnds(data + base, len, inQuote);
+      for (uint32_t i = 0; i < n; i++) {
+        const uint64_t end = base + index[i];
+        if (row >= headerRows)
+          field(data + start, data + end, col, row - headerRows, sink);
+        if (data[end] == '\n')
+          col = 0, row++;
+        else
+          col++;
+        start = end + 1;
+      }
+    }
+    if (start < size) {  // no newline after the last row
+      if (row >= headerRows)
+        field(data + start, data + size, col, row - headerRows, sink);
+      row++;
+    }
+    return row < headerRows ? 0 : row - headerRows;
+  }
+
+  template <typename Sink>
+  uint32_t scanFile(const char filename[], Sink& sink) {
+    MappedFile f(filename);
+    return scan(f.getData(), f.getSize(), sink);
+  }
+};
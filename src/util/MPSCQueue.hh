@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/*
+  Unbounded multiple producer, single consumer queue without locks
+  (Vyukov's node-based design). push() is one atomic exchange so worker
+  threads never block, and the consumer, typically the render thread,
+  never waits on a mutex a producer might be holding.
+
+  tail always points to a dummy node whose value has already been taken.
+  pop() can report empty for an instant while a producer is between its
+  exchange and linking the node; the item shows up on the next call.
+*/
+template <typename T>
+class MPSCQueue {
+ private:
+  struct Node {
+    std::atomic<Node*> next;
+    T value;
+    Node() : next(nullptr), value() {}
+    Node(T&& v) : next(nullptr), value(std::move(v)) {}
+  };
+  alignas(64) std::atomic<Node*> head;  // producers append here
+  alignas(64) Node* tail;               // consumer removes here
+
+ public:
+  MPSCQueue() : head(new Node()), tail(head.load()) {}
+  ~MPSCQueue() {
+    T discard;
+    while (pop(discard))
+      ;
+    delete tail;
+  }
+  MPSCQueue(const MPSCQueue& orig) = delete;
+  MPSCQueue& operator=(const MPSCQueue& orig) = delete;
+
+  // any thread
+  void push(T v) {
+    Node* n = new Node(std::move(v));
+    Node* prev = head.exchange(n, std::memory_order_acq_rel);
+    prev->next.store(n, std::memory_order_release);
+  }
+
+  // consumer thread only
+  bool pop(T& v) {
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) return false;
+    v = std::move(next->value);
+    delete tail;
+    tail = next;
+    return true;
+  }
+
+  // consumer thread only
+  bool empty() const {
+    return tail->next.load(std::memory_order_acquire) == nullptr;
+  }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "util/Ex.hh"
+#include "util/PlatFlags.hh"
+
+// a whole file mapped read only, or read in where there is no mmap
+class MappedFile {
+ private:
+  const char* data;
+  uint64_t size;
+#ifdef _WIN32
+  std::vector<char> contents;
+#endif
+
+ public:
+  MappedFile(const std::string& filename) : data(nullptr) {
+    int fh = open(filename.c_str(), O_RDONLY | O_BINARY);
+    if (fh < 0) throw Ex2(Errcode::FILE_NOT_FOUND, filename);
+    struct stat s;
+    fstat(fh, &s);
+    size = s.st_size;
+    bool ok = true;
+    if (size > 0) {  // mapping nothing is an error
+#ifdef _WIN32
+      contents.resize(size);
+      ok = read(fh, contents.data(), size) == size;
+      data = contents.data();
+#else
+      void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fh, 0);
+      ok = p != MAP_FAILED;
+      data = ok ? (const char*)p : nullptr;
+      if (ok) madvise(p, size, MADV_WILLNEED);
+#endif
+    }
+    close(fh);
+    if (!ok) throw Ex2(Errcode::FILE_READ, filename);
+  }
+  ~MappedFile() {
+#ifndef _WIN32
+    if (data != nullptr) munmap((void*)data, size);
+#endif
+  }
+  MappedFile(const MappedFile& orig) = delete;
+  MappedFile& operator=(const MappedFile& orig) = delete;
+  const char* getData() const { return data; }
+  uint64_t getSize() const { return size; }
+};
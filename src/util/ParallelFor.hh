@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/*
+  Run body(i) for i in [0, n) on numThreads threads, the caller being one of
+  them. Threads take runs of block consecutive i from a shared counter, so
+  uneven work balances itself without a scheduler. 0 threads means one per
+  core.
+  body must not throw.
+*/
+template <typename Func>
+void parallelFor(uint32_t n, uint32_t numThreads, uint32_t block, Func body) {
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, (n + block - 1) / block);
+  std::atomic<uint32_t> next(0);
+  auto worker = [&]() {
+    for (uint32_t start; (start = next.fetch_add(block)) < n;)
+      for (uint32_t i = start; i < std::min(start + block, n); i++) body(i);
+  };
+  std::vector<std::thread> threads;
+  for (uint32_t t = 1; t < numThreads; t++) threads.emplace_back(worker);
+  worker();
+  for (auto& t : threads) t.join();
+}
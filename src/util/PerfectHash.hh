@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/Ex.hh"
+
+/*
+  Minimal perfect hash over a fixed set of n distinct strings, by CHD
+  ("compress, hash and displace"). One hash of a key with a seed puts it
+  in a bucket, about 4 keys to a bucket, and the same hash moved by the
+  bucket's displacement puts it in a slot 0..n-1 no other key uses. A
+  bucket of one key stores its slot directly, with the top bit set. Only
+  the seed and one displacement per bucket are stored, so the table can be
+  saved in a file and used in place. Lookup is one hash and one probe,
+  then the caller compares the key in that slot to reject strings that
+  were never in the set.
+*/
+class PerfectHash {
+ public:
+  static constexpr uint32_t DIRECT = 0x80000000U;
+
+  static uint64_t fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // 8 bytes at a time; keys are short so this is a handful of multiplies
+  static uint64_t hash(const char* s, uint32_t len, uint64_t seed) {
+    uint64_t h = seed ^ (len * 0x9E3779B97F4A7C15ULL);
+    for (; len >= 8; s += 8, len -= 8) {
+      uint64_t v;
+      memcpy(&v, s, 8);
+      h = rotl(h ^ (v * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+    }
+    uint64_t tail = 0;
+    for (uint32_t i = 0; i < len; i++)  // memcpy here is a library call
+      tail |= uint64_t(uint8_t(s[i])) << (i * 8);
+    h ^= tail * 0x87c37b91114253d5ULL;
+    return fmix(h);
+  }
+  static uint64_t hash(std::string_view key, uint64_t seed) {
+    return hash(key.data(), key.size(), seed);
+  }
+
+  static uint32_t numBuckets(uint32_t n) {
+    return std::max<uint32_t>(1, (n + 3) / 4);
+  }
+
+  // slot 0..n-1 of the key with hash h
+  static uint32_t slot(uint64_t h, const uint32_t displace[], uint32_t n) {
+    const uint32_t d = displace[range(uint32_t(h), numBuckets(n))];
+    return (d & DIRECT) ? d & ~DIRECT : displaced(h, d, n);
+  }
+
+  /*
+    The seed to hash keys with, and in displace one entry per bucket.
+    Equal keys can't be separated and are an error.
+  */
+  static uint64_t build(const std::vector<std::string_view>& keys,
+                        std::vector<uint32_t>& displace) {
+    uint64_t seed = 0x5bd1e9955bd1e995ULL;
+    while (!tryBuild(keys, seed, displace)) seed = fmix(seed + 1);
+    return seed;
+  }
+
+ private:
+  static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+  // map x onto [0, n) with a multiply instead of a divide
+  static uint32_t range(uint32_t x, uint32_t n) {
+    return (uint64_t(x) * n) >> 32;
+  }
+
+  static uint32_t displaced(uint64_t h, uint32_t d, uint32_t n) {
+    return range(uint32_t(fmix(h + d * 0x9E3779B97F4A7C15ULL) >> 32), n);
+  }
+
+  /*
+    Buckets are placed largest first, searching for a displacement that
+    puts every key of the bucket into a free slot. Singleton buckets are
+    placed last, directly into the next free slot. False if some bucket
+    cannot be placed with this seed.
+  */
+  static bool tryBuild(const std::vector<std::string_view>& keys,
+                       uint64_t seed, std::vector<uint32_t>& displace) {
+    const uint32_t n = keys.size(), numB = numBuckets(n);
+    displace.assign(numB, 0);
+    std::vector<uint64_t> hashes(n);
+    std::vector<std::vector<uint32_t>> buckets(numB);
+    for (uint32_t i = 0; i < n; i++) {
+      hashes[i] = hash(keys[i], seed);
+      buckets[range(uint32_t(hashes[i]), numB)].push_back(i);
+    }
+    std::vector<uint32_t> order(numB);
+    for (uint32_t b = 0; b < numB; b++) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<bool> taken(n);
+    std::vector<uint32_t> candidate;
+    uint32_t nextFree = 0;
+    constexpr uint32_t MAX_DISPLACE = 1U << 20;
+    for (uint32_t b : order) {
+      const std::vector<uint32_t>& bucket = buckets[b];
+      if (bucket.empty()) break;
+      if (bucket.size() == 1) {
+        while (taken[nextFree]) nextFree++;
+        displace[b] = DIRECT | nextFree;
+        taken[nextFree] = true;
+        continue;
+      }
+      bool placed = false;
+      for (uint32_t d = 0; d < MAX_DISPLACE && !placed; d++) {
+        candidate.clear();
+        for (uint32_t k : bucket) {
+          uint32_t pos = displaced(hashes[k], d, n);
+          if (taken[pos] || std::find(candidate.begin(), candidate.end(),
+                                      pos) != candidate.end())
+            break;
+          candidate.push_back(pos);
+        }
+        if (candidate.size() == bucket.size()) {
+          for (uint32_t pos : candidate) taken[pos] = true;
+          displace[b] = d;
+          placed = true;
+        }
+      }
+      if (!placed) {
+        for (uint32_t i = 0; i < bucket.size(); i++)
+          for (uint32_t j = i + 1; j < bucket.size(); j++)
+            if (keys[bucket[i]] == keys[bucket[j]])
+              throw Ex2(Errcode::MULTIPLY_DEFINED,
+                        std::string(keys[bucket[i]]));
+        return false;
+      }
+    }
+    return true;
+  }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+   Named counters for instrumentation.
+
+   A subsystem declares StatCounter objects (usually as members or statics)
+   and bumps them as it runs. Every live counter is linked into one list, so
+   StatCounter::report() can print all of them, for example at the end of a
+   benchmark or from a debug key in a window. Updating a counter is a
+   relaxed atomic add; nothing is allocated.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+class StatCounter {
+ private:
+  const char* name;
+  std::atomic<uint64_t> value;
+  StatCounter* next;
+  StatCounter* prev;
+
+  static inline StatCounter* head = nullptr;
+  static inline std::mutex listLock;
+
+ public:
+  StatCounter(const char name[]) : name(name), value(0), prev(nullptr) {
+    std::lock_guard<std::mutex> lock(listLock);
+    next = head;
+    if (head != nullptr) head->prev = this;
+    head = this;
+  }
+  ~StatCounter() {
+    std::lock_guard<std::mutex> lock(listLock);
+    if (prev != nullptr)
+      prev->next = next;
+    else
+      head = next;
+    if (next != nullptr) next->prev = prev;
+  }
+  StatCounter(const StatCounter& orig) = delete;
+  StatCounter& operator=(const StatCounter& orig) = delete;
+
+  void add(uint64_t v = 1) { value.fetch_add(v, std::memory_order_relaxed); }
+  void set(uint64_t v) { value.store(v, std::memory_order_relaxed); }
+  uint64_t get() const { return value.load(std::memory_order_relaxed); }
+  void reset() { set(0); }
+  const char* getName() const { return name; }
+
+  // the first counter with this name, nullptr if there is none
+  static StatCounter* find(const char name[]) {
+    std::lock_guard<std::mutex> lock(listLock);
+    for (StatCounter* c = head; c != nullptr; c = c->next)
+      if (strcmp(c->name, name) == 0) return c;
+    return nullptr;
+  }
+
+  static void resetAll() {
+    std::lock_guard<std::mutex> lock(listLock);
+    for (StatCounter* c = head; c != nullptr; c = c->next) c->reset();
+  }
+
+  // one "name value" line per counter
+  static void report(std::ostream& s) {
+    std::lock_guard<std::mutex> lock(listLock);
+    for (StatCounter* c = head; c != nullptr; c = c->next)
+      s << c->name << ' ' << c->get() << '\n';
+  }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+  Decode the code point starting at p and advance p past it, never past end.
+  A byte that does not start a well formed sequence (overlong, truncated,
+  surrogate or above U+10FFFF) is taken as a Latin-1 character by itself,
+  so text written in Latin-1 still comes out as before.
+*/
+inline uint32_t utf8Next(const char*& p, const char* end) {
+  const uint8_t* s = (const uint8_t*)p;
+  const uint32_t c = s[0];
+  p++;
+  if (c < 0x80) return c;
+  int n;
+  uint32_t cp, min;
+  if ((c & 0xE0) == 0xC0)
+    n = 1, cp = c & 0x1F, min = 0x80;
+  else if ((c & 0xF0) == 0xE0)
+    n = 2, cp = c & 0x0F, min = 0x800;
+  else if ((c & 0xF8) == 0xF0)
+    n = 3, cp = c & 0x07, min = 0x10000;
+  else
+    return c;
+  if (end - p < n) return c;
+  for (int i = 1; i <= n; i++) {
+    if ((s[i] & 0xC0) != 0x80) return c;
+    cp = (cp << 6) | (s[i] & 0x3F);
+  }
+  if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp < 0xE000)) return c;
+  p += n;
+  return cp;
+}
@@ -112,6 +112,8 @@ void write(Buffer& buf, const List<T>& list) {
   buf.write(uint16_t(list.size()));
   for (uint32_t i = 0; i < list.size(); i++) {
     write(buf, (list[i]));
+    // slow reader: stop producing rather than queue the rest of the list
+    buf.waitIfPaused();
   }
 }
 
@@ -4,146 +4,96 @@
 */
 #include <errno.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "xp/lzmautil.hh"
 
 using namespace std;
 /*
-** Initialize the decoder and allocate the maximum 65Mb RAM to handle any
-*incoming stream
+** Decompress .xz files, either to a file or into a buffer in RAM that grows
+*as needed
 */
 class Decompressor {
  private:
   constexpr static size_t BUFSIZE = 1 << 16;
   lzma_stream strm;
-  uint8_t inbuf[BUFSIZE];
 
-  unique_ptr<uint8_t[]> decomp_mem;
-  uint64_t cur_ind;
+  vector<uint8_t> decomp_mem;  // what decompressFileToRAM produced
+  uint64_t cur_ind;            // bytes of decomp_mem in use
+  // grow by doubling, so appending stays linear in the size of the file
   void check_resize(size_t write_size) {
-    uint8_t* cur_arr = decomp_mem.get();
-    if (cur_ind + write_size >= sizeof(cur_arr) / sizeof(*cur_arr)) {
-      uint8_t* ptr_new = (uint8_t*)realloc(cur_arr, sizeof(cur_arr) * 2);
-      if (!ptr_new) {
-        // throw memory error with Ex1
-      }
-
-      decomp_mem.release();
-      decomp_mem.reset(ptr_new);
-    }
-  }
-
- public:
-  Decompressor() : decomp_mem(make_unique<uint8_t[]>(BUFSIZE)) {
-    // TODO: perhaps load non-concatenated?
-    strm = LZMA_STREAM_INIT;
-
-    lzma_ret ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED);
-    if (ret != LZMA_OK) throw ret;  // TODO: throw Ex1(  );
-    // Errs: LZMA_MEM_ERROR: Mem alloc, LZMA_OPTIONS_ERROR: bad flags
-    // default, probably LZMA_PROG_ERROR
+    if (cur_ind + write_size > decomp_mem.size())
+      decomp_mem.resize(max(2 * decomp_mem.size(), cur_ind + write_size));
   }
 
-  ~Decompressor() { lzma_end(&strm); }
-
   /*
-  ** Load one file and decompress it into a BlockLoader?
+  ** Decode the whole file, handing each full output buffer to out. The
+  *decoder is set up once per file, not once per buffer, or it loses its state
   */
-  void decompressFileToRAM(const char compressedFile[]) {
-    lzma_action action = LZMA_RUN;
+  template <typename Func>
+  void decode(const char compressedFile[], Func out) {
     ifstream in(compressedFile, ios::binary);
-
     if (!in.good()) {
-      throw Ex1(Errcode::FILE_NOT_FOUND);
+      throw Ex2(Errcode::FILE_NOT_FOUND, compressedFile);
     }
+    // LZMA_MEM_ERROR or LZMA_OPTIONS_ERROR, neither of which we can fix here
+    lzma_ret ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED);
+    if (ret != LZMA_OK) throw Ex2(Errcode::OUTOF_MEMORY, compressedFile);
 
     uint8_t inbuf[BUFSIZE];
     uint8_t outbuf[BUFSIZE];
-
-    // call lzma stream decoder again?
+    lzma_action action = LZMA_RUN;
     strm.next_in = nullptr;
     strm.avail_in = 0;
     strm.next_out = outbuf;
     strm.avail_out = sizeof(outbuf);
-
-    while (true) {
-      if (strm.avail_in == 0 && in.peek() != EOF) {
+    do {
+      if (strm.avail_in == 0 && action == LZMA_RUN) {
         strm.next_in = inbuf;
         strm.avail_in = in.read((char*)inbuf, BUFSIZE).gcount();
+        if (in.eof()) action = LZMA_FINISH;  // tell lzma no more input
       }
-      lzma_ret ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED);
-      if (ret != LZMA_OK) throw ret;  // TODO: throw Ex1(  );
-
       ret = lzma_code(&strm, action);
-
-      if (ret != LZMA_OK) throw ret;  // TODO: throw Ex1(  );
       if (strm.avail_out == 0 || ret == LZMA_STREAM_END) {
-        // Resize pointer if needed
-        size_t write_size = sizeof(outbuf) - strm.avail_out;
-        check_resize(write_size);
-
-        // Write to buffer
-        copy(outbuf, outbuf + write_size, decomp_mem.get());
-        cur_ind += write_size;
+        out(outbuf, sizeof(outbuf) - strm.avail_out);
         strm.next_out = outbuf;
         strm.avail_out = sizeof(outbuf);
       }
-
-      lzma_err(ret);
-    }
-    // The uncompressed size is shown when running xz --list <file>. By taking a
-    // closer look, this is calculated by running the
-    // lzma_index_uncompressed_size() function on a lzma_quite index populated
-    // by a parse big_indexes() function from the xz command line tool.
+      if (ret != LZMA_OK && ret != LZMA_STREAM_END)
+        throw Ex2(Errcode::COMPRESSED_CORRUPT, compressedFile);
+    } while (ret != LZMA_STREAM_END);
   }
-  void decompressFile(const char compressedFile[], const char outFile[]) {
-    lzma_action action = LZMA_RUN;
-    ifstream in(compressedFile, ios::binary);
-    ofstream out(outFile, ios::binary);
-
-    if (!in.good()) {
-      throw Ex1(Errcode::FILE_NOT_FOUND);
-    }
 
-    uint8_t inbuf[BUFSIZE];
-    uint8_t outbuf[BUFSIZE];
-
-    // call lzma stream decoder again?
-    strm.next_in = nullptr;
-    strm.avail_in = 0;
-    strm.next_out = outbuf;
-    strm.avail_out = sizeof(outbuf);
-
-    while (true) {
-      if (strm.avail_in == 0 && in.peek() != EOF) {
-        strm.next_in = inbuf;
-        strm.avail_in = in.read((char*)inbuf, BUFSIZE).gcount();
-      }
-
-      if (in.peek() == EOF) {
-        action = LZMA_FINISH;
-      }
-
-      lzma_ret ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED);
-      if (ret != LZMA_OK) throw ret;  // TODO: throw Ex1(  );
+ public:
+  Decompressor() : decomp_mem(BUFSIZE), cur_ind(0) { strm = LZMA_STREAM_INIT; }
 
-      ret = lzma_code(&strm, action);
+  ~Decompressor() { lzma_end(&strm); }
 
-      if (strm.avail_out == 0 || ret == LZMA_STREAM_END) {
-        size_t write_size = sizeof(outbuf) - strm.avail_out;
-        out.write((char*)outbuf, write_size);
-        strm.next_out = outbuf;
-        strm.avail_out = sizeof(outbuf);
-        return;
-      }
+  const uint8_t* data() const { return decomp_mem.data(); }
+  uint64_t size() const { return cur_ind; }
 
-      lzma_err(ret);
-    }
+  /*
+  ** Load one file and decompress it into RAM, see data() and size()
+  */
+  void decompressFileToRAM(const char compressedFile[]) {
+    cur_ind = 0;
+    decode(compressedFile, [&](const uint8_t* buf, size_t write_size) {
+      check_resize(write_size);
+      copy(buf, buf + write_size, decomp_mem.begin() + cur_ind);
+      cur_ind += write_size;
+    });
+  }
+  void decompressFile(const char compressedFile[], const char outFile[]) {
+    ofstream out(outFile, ios::binary);
+    decode(compressedFile, [&](const uint8_t* buf, size_t write_size) {
+      out.write((const char*)buf, write_size);
+    });
   }
 };
 
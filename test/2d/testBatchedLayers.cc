@@ -0,0 +1,51 @@
+#include <cstring>
+#include <iostream>
+
+#include "opengl/GrailGUI.hh"
+
+using namespace std;
+using namespace grail;
+
+/*
+  Many small StyledMultiShape2D layers, the way widgets pile them up, drawn
+  one by one or batched ("testBatchedLayers batch"). Prints the draw calls
+  and state changes per frame, which batching should cut from several per
+  layer to a few per canvas. Run under Mesa llvmpipe
+  (LIBGL_ALWAYS_SOFTWARE=1) to check without a GPU.
+*/
+class TestBatchedLayers : public Member {
+ private:
+  static constexpr uint32_t numLayers = 100;
+  uint64_t frames, lastDraws, lastStates;
+
+ public:
+  TestBatchedLayers(Tab* tab, bool batch)
+      : Member(tab, 0), frames(0), lastDraws(0), lastStates(0) {
+    MainCanvas* c = tab->getMainCanvas();
+    const Style* s = tab->getDefaultStyle();
+    for (uint32_t i = 0; i < numLayers; i++) {
+      StyledMultiShape2D* m = c->addLayer(new StyledMultiShape2D(c, s));
+      const float x = (i % 10) * 100, y = (i / 10) * 80;
+      m->fillRectangle(x, y, 90, 70, i % 2 ? red : blue);
+      if (i % 3 == 0) m->drawRectangle(x, y, 90, 70, black);
+      if (i % 5 == 0) m->fillCircle(x + 45, y + 35, 20, 10, yellow);
+    }
+    c->setBatching(batch);
+  }
+
+  void update() override {
+    const uint64_t draws = StyledMultiShape2D::drawCalls.get();
+    const uint64_t states = StyledMultiShape2D::stateChanges.get();
+    if (++frames % 100 == 0)
+      cout << "frame " << frames << ": " << draws - lastDraws
+           << " draw calls, " << states - lastStates << " state changes\n";
+    lastDraws = draws;
+    lastStates = states;
+  }
+};
+
+void grailmain(int argc, char* argv[], GLWin* w, Tab* defaultTab) {
+  const bool batch = argc > 1 && strcmp(argv[1], "batch") == 0;
+  w->setTitle(batch ? "Test batched layers" : "Test unbatched layers");
+  new TestBatchedLayers(defaultTab, batch);
+}
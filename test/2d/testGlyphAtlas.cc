@@ -0,0 +1,77 @@
+#include <iostream>
+#include <string>
+
+#include "opengl/GrailGUI.hh"
+#include "opengl/util/GlyphAtlas.hh"
+#include "util/StatCounter.hh"
+
+using namespace std;
+using namespace grail;
+
+/*
+  Glyphs are rendered into the atlas the first time they are drawn. The top
+  half is UTF-8 text that never changes; the bottom is redrawn with new
+  CJK characters every frame, so the atlas grows to its limit and then
+  evicts. The static text must come out the same throughout. Prints the
+  size of the atlas and how many glyphs were rendered and evicted.
+*/
+class TestGlyphAtlas : public Member {
+ private:
+  MultiText* changing;
+  const Font* cjk;
+  uint32_t next;  // next code point to draw
+  uint32_t frames;
+
+  static void append(string& s, uint32_t c) {
+    if (c < 0x80) {
+      s += char(c);
+    } else if (c < 0x800) {
+      s += char(0xC0 | (c >> 6));
+      s += char(0x80 | (c & 0x3F));
+    } else {
+      s += char(0xE0 | (c >> 12));
+      s += char(0x80 | ((c >> 6) & 0x3F));
+      s += char(0x80 | (c & 0x3F));
+    }
+  }
+
+ public:
+  TestGlyphAtlas(Tab* tab) : Member(tab, 0), next(0x4E00), frames(0) {
+    MainCanvas* c = tab->getMainCanvas();
+    const Style* s = tab->getDefaultStyle();
+    MultiText* fixed = c->addLayer(new MultiText(c, s, 1000));
+    const Font* times = FontFace::get("TIMES", 30, FontFace::BOLD);
+    const Font* math = FontFace::get("MATH", 30, FontFace::BOLD);
+    cjk = FontFace::get("SANS", 30, FontFace::BOLD);
+    fixed->add(20, 50, times, string("Grüße, déjà vu, naïve façade, Ærø"));
+    fixed->add(20, 100, math, string("∀ε>0 ∃δ: |x−a|<δ ⇒ |f(x)−L|<ε, ∑ ∫ √π"));
+    fixed->add(20, 150, cjk, string("漢字のテキスト, 한국어, Ελληνικά"));
+    // a truncated sequence and a stray Latin-1 byte draw as Latin-1
+    fixed->add(20, 200, times, string("caf\xE9 \xE2\x82"));
+    changing = c->addLayer(new MultiText(c, s, 1000));
+  }
+
+  void update() override {
+    changing->clear();
+    for (uint32_t row = 0; row < 4; row++) {
+      string line;
+      for (uint32_t i = 0; i < 30; i++) append(line, next++);
+      changing->add(20, 300 + row * 40, cjk, line);
+    }
+    if (next >= 0x9FFF) next = 0x4E00;
+    if (++frames % 60 == 0) {
+      const GlyphAtlas* atlas = FontFace::getAtlas();
+      cout << "frame " << frames << ": atlas " << atlas->getWidth() << 'x'
+           << atlas->getHeight() << ", "
+           << StatCounter::find("gl.font.rendered")->get() << " rendered, "
+           << StatCounter::find("gl.font.evicted")->get() << " evicted, "
+           << StatCounter::find("gl.font.uploadBytes")->get()
+           << " bytes uploaded\n";
+    }
+  }
+};
+
+void grailmain(int argc, char* argv[], GLWin* w, Tab* defaultTab) {
+  w->setTitle("Test glyph atlas");
+  new TestGlyphAtlas(defaultTab);
+}
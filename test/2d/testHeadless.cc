@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "glad/glad.h"
+#include "opengl/GrailGUI.hh"
+
+using namespace std;
+using namespace grail;
+
+/*
+  Draw a few known shapes and check the pixels that come out. On screen it
+  is just a picture; headless, with no display server or GPU needed:
+
+    GRAIL_HEADLESS=120 GRAIL_CAPTURE=tmp/headless ./testHeadless
+
+  renders 120 frames, checks them and saves them as
+  tmp/headless00000.png and on. Frames are 1/60 s apart however long they
+  take to draw, so the same frame always comes out the same.
+*/
+class TestHeadless : public Member {
+ private:
+  GLWin* w;
+  uint32_t frames, wrong;
+
+  // the pixel at (x, y) from the top left, as 0xRRGGBB
+  uint32_t pixel(uint32_t x, uint32_t y) {
+    uint8_t p[4];
+    glReadPixels(x, w->getHeight() - 1 - y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                 p);
+    return (p[0] << 16) | (p[1] << 8) | p[2];
+  }
+
+ public:
+  TestHeadless(GLWin* w, Tab* tab)
+      : Member(tab, 0), w(w), frames(0), wrong(0) {
+    MainCanvas* c = tab->getMainCanvas();
+    StyledMultiShape2D* m = c->getGui();
+    m->fillRectangle(0, 0, 100, 100, red);
+    m->fillRectangle(100, 0, 100, 100, green);
+    m->fillRectangle(200, 0, 100, 100, blue);
+    m->fillCircle(150, 250, 50, 2, yellow);
+  }
+
+  void update() override {
+    if (!w->isHeadless()) return;
+    frames++;
+    if (pixel(50, 50) != 0xFF0000 || pixel(150, 50) != 0x00FF00 ||
+        pixel(250, 50) != 0x0000FF || pixel(150, 250) != 0xFFFF00) {
+      cerr << "frame " << frames << ": wrong pixels at t=" << w->getTime()
+           << '\n';
+      wrong++;
+    }
+    if (frames % 60 == 0)
+      cout << frames << " frames checked, " << wrong << " wrong\n";
+  }
+};
+
+void grailmain(int argc, char* argv[], GLWin* w, Tab* defaultTab) {
+  w->setTitle("Test headless");
+  new TestHeadless(w, defaultTab);
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "opengl/GrailGUI.hh"
+
+using namespace std;
+using namespace grail;
+
+/*
+  A live bar chart: every frame a handful of the bars change height and
+  color in place. Prints the bytes uploaded per frame, which should be a few
+  bars' worth, not the whole chart. Run under Mesa llvmpipe
+  (LIBGL_ALWAYS_SOFTWARE=1) to check without a GPU.
+*/
+class TestLiveBars : public Member {
+ private:
+  static constexpr uint32_t numBars = 2000;
+  static constexpr uint32_t changesPerFrame = 5;
+  StyledMultiShape2D* m;
+  vector<StyledMultiShape2D::Handle> bars;
+  mt19937 random;
+  uint64_t frames, lastBytes;
+  const float barWidth = 0.5f;
+
+ public:
+  TestLiveBars(Tab* tab) : Member(tab, 0), frames(0), lastBytes(0) {
+    MainCanvas* c = tab->getMainCanvas();
+    m = c->addLayer(new StyledMultiShape2D(c, tab->getDefaultStyle()));
+    for (uint32_t i = 0; i < numBars; i++) {
+      const uint32_t first = m->getNumVertices();
+      m->fillRectangle(i * barWidth, 0, barWidth, random() % 800, blue);
+      bars.push_back(m->handleSince(first));
+    }
+  }
+
+  void update() override {
+    const uint64_t bytes = StyledMultiShape2D::bytesUploaded.get();
+    if (++frames % 100 == 0)
+      cout << "frame " << frames << ": " << bytes - lastBytes
+           << " bytes uploaded, the whole chart is "
+           << numBars * 4 * 5 * sizeof(float) << '\n';
+    lastBytes = bytes;
+    for (uint32_t i = 0; i < changesPerFrame; i++) {
+      const uint32_t b = random() % numBars;
+      m->setRectangle(bars[b], b * barWidth, 0, barWidth, random() % 800);
+      m->setColor(bars[b], i % 2 ? red : green);
+    }
+  }
+};
+
+void grailmain(int argc, char* argv[], GLWin* w, Tab* defaultTab) {
+  w->setTitle("Test live bars");
+  new TestLiveBars(defaultTab);
+}
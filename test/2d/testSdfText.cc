@@ -0,0 +1,46 @@
+#include <iostream>
+#include <string>
+
+#include "opengl/GrailGUI.hh"
+#include "opengl/util/GlyphAtlas.hh"
+#include "util/StatCounter.hh"
+
+using namespace std;
+using namespace grail;
+
+/*
+  The same line at every size from 6 to 72 pixels, most of them not in
+  fonts.conf. With "sdf 48 6" in fonts.conf each glyph is in the atlas once
+  for all sizes; without it, once per size. Prints the atlas pixels used and
+  how many glyphs were rendered, to compare the two.
+*/
+class TestSdfText : public Member {
+ private:
+  uint32_t frames;
+
+ public:
+  TestSdfText(Tab* tab) : Member(tab, 0), frames(0) {
+    MainCanvas* c = tab->getMainCanvas();
+    MultiText* m = c->addLayer(new MultiText(c, tab->getDefaultStyle(), 8000));
+    float y = 10;
+    for (uint32_t size = 6; size <= 72; size += 3) {
+      y += size + 2;
+      m->add(20, y, FontFace::get("TIMES", size, FontFace::NORMAL),
+             to_string(size) + " Sphinx of black quartz, judge my vow");
+    }
+  }
+
+  void update() override {
+    if (++frames != 2) return;  // once the first frame has been drawn
+    const GlyphAtlas* atlas = FontFace::getAtlas();
+    cout << (FontFace::isSdf() ? "distance field" : "bitmap") << " glyphs: "
+         << atlas->getUsed() << " atlas pixels used of " << atlas->getWidth()
+         << 'x' << atlas->getHeight() << ", "
+         << StatCounter::find("gl.font.rendered")->get() << " rendered\n";
+  }
+};
+
+void grailmain(int argc, char* argv[], GLWin* w, Tab* defaultTab) {
+  w->setTitle("Test distance field text");
+  new TestSdfText(defaultTab);
+}
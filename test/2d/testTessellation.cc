@@ -0,0 +1,62 @@
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "opengl/StyledMultiShape2D.hh"
+using namespace std;
+
+/*
+  Check fillEllipses makes the same vertices and triangles as fillEllipse
+  one at a time, then time building a million circles both ways. Nothing
+  is drawn, so no window is needed.
+*/
+class Shapes : public StyledMultiShape2D {
+ public:
+  Shapes() : StyledMultiShape2D(nullptr, nullptr) {}
+  bool operator==(const Shapes& b) const {
+    return vertices == b.vertices && solidIndices == b.solidIndices;
+  }
+};
+
+template <typename Func>
+double seconds(Func f) {
+  auto t0 = chrono::steady_clock::now();
+  f();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+  return elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+  mt19937 random(1);
+  uniform_real_distribution<float> coord(0, 1000);
+  const float steps[] = {3, 30, 72, 360 / 7.0f};
+  vector<Tessellation::Ellipse> e(20000);
+  for (uint32_t i = 0; i < e.size(); i++)
+    e[i] = {coord(random), coord(random), coord(random) / 10,
+            coord(random) / 10, steps[i / 1000 % 4], 0.2f, 0.4f, 0.6f};
+  Shapes serial, bulk;
+  serial.fillRectangle(0, 0, 10, 10, glm::vec4(1, 0, 0, 1));
+  bulk.fillRectangle(0, 0, 10, 10, glm::vec4(1, 0, 0, 1));
+  for (const auto& p : e)
+    serial.fillEllipse(p.x, p.y, p.xRad, p.yRad, p.angleInc,
+                       glm::vec4(p.r, p.g, p.b, 1));
+  bulk.fillEllipses(e.data(), e.size(), 3);
+  assert(serial == bulk);
+
+  const uint32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+  vector<Tessellation::Ellipse> circles(n);
+  for (auto& c : circles)
+    c = {coord(random), coord(random), 5, 5, 30, 1, 0, 0};
+  Shapes one, many;
+  cout << "fillCircle: " << seconds([&]() {
+    for (const auto& c : circles)
+      one.fillCircle(c.x, c.y, c.xRad, c.angleInc, glm::vec4(1, 0, 0, 1));
+  }) << "s\n";
+  cout << "fillEllipses: "
+       << seconds([&]() { many.fillEllipses(circles.data(), n); }) << "s\n";
+  assert(one == many);
+  return 0;
+}
@@ -0,0 +1,227 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "csp/AsyncCSPClient.hh"
+#include "csp/XDLRequest.hh"
+
+using namespace std;
+using namespace std::chrono_literals;
+
+/*
+  A stand-in server speaking the framed protocol of XDLRequest: page i is
+  i MB of bytes (i + offset) & 0xFF. Each connection gets its own thread
+  and stays open KEEP_ALIVE_MILLIS after every response.
+*/
+atomic<uint32_t> accepted(0);
+constexpr uint32_t NUM_PAGES = 8;
+
+bool readAll(int fd, char* p, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::read(fd, p, len);
+    if (n <= 0) return false;
+    p += n, len -= n;
+  }
+  return true;
+}
+
+void serveConnection(int fd) {
+  vector<char> page;
+  for (;;) {
+    pollfd p{fd, POLLIN, 0};
+    if (poll(&p, 1, XDLRequest::KEEP_ALIVE_MILLIS) <= 0) break;
+    uint32_t id;
+    if (!readAll(fd, (char*)&id, sizeof(id))) break;
+    assert(id & XDLRequest::FRAMED);
+    id &= ~XDLRequest::FRAMED;
+    uint64_t len = id < NUM_PAGES ? uint64_t(id) << 20 : 0;
+    page.resize(sizeof(len) + len);
+    memcpy(page.data(), &len, sizeof(len));
+    for (uint64_t i = 0; i < len; i++) page[sizeof(len) + i] = char(i + id);
+    for (size_t sent = 0; sent < page.size();) {
+      ssize_t n = ::write(fd, page.data() + sent, page.size() - sent);
+      if (n <= 0) break;
+      sent += n;
+    }
+  }
+  close(fd);
+}
+
+uint16_t startServer() {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  assert(::bind(s, (sockaddr*)&addr, sizeof(addr)) == 0);
+  assert(listen(s, 20) == 0);
+  socklen_t len = sizeof(addr);
+  getsockname(s, (sockaddr*)&addr, &len);
+  thread([s]() {
+    for (;;) {
+      int fd = accept(s, nullptr, nullptr);
+      if (fd < 0) return;
+      accepted++;
+      thread(serveConnection, fd).detach();
+    }
+  }).detach();
+  return ntohs(addr.sin_port);
+}
+
+void checkPage(const CSPResponse& r) {
+  assert(r.ok());
+  assert(r.data.size() == size_t(r.requestID) << 20);
+  for (size_t i = 0; i < r.data.size(); i += 4093)
+    assert(r.data[i] == char(i + r.requestID));
+}
+
+void testFutures(AsyncCSPClient& client, uint16_t port) {
+  vector<future<CSPResponse>> pages;
+  for (uint32_t i = 1; i < NUM_PAGES; i++)
+    pages.push_back(client.pageRequest("127.0.0.1", port, i));
+  for (auto& f : pages) checkPage(f.get());
+
+  CSPResponse bad = client.pageRequest("127.0.0.1", port, 999).get();
+  assert(!bad.ok());
+  CSPResponse refused = client.pageRequest("127.0.0.1", 1, 1).get();
+  assert(!refused.ok());
+  cout << "refused connection reports: " << refused.error << '\n';
+}
+
+/*
+  Pretend to be GLWin::mainLoop: draw a "frame" every millisecond and drain
+  completions between frames. No frame may wait for a download.
+*/
+void testRenderLoop(AsyncCSPClient& client, uint16_t port) {
+  const thread::id renderThread = this_thread::get_id();
+  uint32_t done = 0, requested = 0;
+  for (int round = 0; round < 3; round++)
+    for (uint32_t i = 1; i < NUM_PAGES; i++, requested++)
+      client.pageRequest("127.0.0.1", port, i, [&](CSPResponse& r) {
+        assert(this_thread::get_id() == renderThread);
+        checkPage(r);
+        done++;
+      });
+
+  auto worst = 0us;
+  uint32_t frames = 0;
+  auto start = chrono::steady_clock::now();
+  while (done < requested) {
+    auto t0 = chrono::steady_clock::now();
+    client.drainCompletions();
+    this_thread::sleep_for(1ms);  // render
+    frames++;
+    auto frame = chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - t0);
+    if (frame > worst) worst = frame;
+  }
+  auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start);
+  cout << requested << " pages (" << 3 * 28 << " MB) in " << elapsed.count()
+       << "ms over " << frames << " frames, longest frame " << worst.count()
+       << "us\n";
+  // checking pages is the only work on this thread, far under a 60Hz frame
+  assert(worst < 16ms);
+}
+
+/*
+  Decode on the worker: only the decoded result reaches the render thread,
+  and a decode that throws is reported without reaching it.
+*/
+void testDecode(AsyncCSPClient& client, uint16_t port) {
+  const thread::id renderThread = this_thread::get_id();
+  uint32_t done = 0;
+  for (uint32_t i = 1; i < NUM_PAGES; i++)
+    client.pageRequest(
+        "127.0.0.1", port, i,
+        [&](CSPResponse& r) {
+          assert(this_thread::get_id() != renderThread);
+          checkPage(r);
+          return r.data.size();
+        },
+        [&, i](size_t& bytes) {
+          assert(this_thread::get_id() == renderThread);
+          assert(bytes == size_t(i) << 20);
+          done++;
+        });
+  client.pageRequest(
+      "127.0.0.1", port, 1,
+      [](CSPResponse&) -> int { throw Ex1(Errcode::FILE_READ); },
+      [](int&) { assert(false); });
+  client.pageRequest(
+      "127.0.0.1", port, 1,
+      [](CSPResponse&) -> int { throw runtime_error("not an Ex"); },
+      [](int&) { assert(false); });
+  while (done < NUM_PAGES - 1) {
+    client.drainCompletions();
+    this_thread::sleep_for(1ms);
+  }
+  this_thread::sleep_for(100ms);
+  client.drainCompletions();
+}
+
+void testReuse(AsyncCSPClient& client, uint16_t port) {
+  uint32_t before = accepted;
+  for (int i = 0; i < 20; i++)
+    checkPage(client.pageRequest("127.0.0.1", port, 1).get());
+  // one after another, so one pooled connection serves them all
+  cout << "20 sequential requests opened " << accepted - before
+       << " connections\n";
+  assert(accepted - before <= 1);
+  assert(client.idleConnections("127.0.0.1", port) >= 1);
+
+  // past the keep-alive, the pool connects again instead of failing
+  this_thread::sleep_for(chrono::milliseconds(XDLRequest::KEEP_ALIVE_MILLIS));
+  checkPage(client.pageRequest("127.0.0.1", port, 2).get());
+}
+
+/*
+  Requests still queued when the client is destroyed are answered with an
+  error: futures become ready and callbacks run in the destructor.
+*/
+void testShutdown(uint16_t port) {
+  vector<future<CSPResponse>> pages;
+  uint32_t callbacks = 0, failed = 0;
+  {
+    AsyncCSPClient client(1);
+    for (uint32_t i = 0; i < 20; i++) {
+      pages.push_back(client.pageRequest("127.0.0.1", port, NUM_PAGES - 1));
+      client.pageRequest("127.0.0.1", port, NUM_PAGES - 1,
+                         [&](CSPResponse& r) {
+                           callbacks++;
+                           if (!r.ok()) failed++;
+                         });
+    }
+  }
+  assert(callbacks == 20 && failed > 0);
+  for (auto& f : pages) {
+    CSPResponse r = f.get();  // would throw broken_promise if dropped
+    if (!r.ok()) assert(r.error == "client shut down");
+  }
+  cout << failed << " of 20 queued callbacks failed at shutdown\n";
+}
+
+int main() {
+  uint16_t port = startServer();
+  {
+    AsyncCSPClient client(4);
+    testFutures(client, port);
+    testRenderLoop(client, port);
+    testDecode(client, port);
+    testReuse(client, port);
+    StatCounter::report(cout);
+  }
+  testShutdown(port);
+  return 0;
+}
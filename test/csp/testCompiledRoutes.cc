@@ -0,0 +1,97 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "csp/CompiledRoutes.hh"
+#include "util/Benchmark.hh"
+
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Check the compiled router against the routes it was built from, then time
+  lookups over 10k routes. Handlers are just route numbers here, the real
+  server uses CompiledServletMap (HttpServlet*).
+*/
+
+constexpr uint32_t NUM_ROUTES = 10000;
+constexpr uint64_t NUM_LOOKUPS = 10000000;
+
+vector<string> makeRoutes(uint32_t n) {
+  vector<string> urls;
+  urls.reserve(n);
+  char buf[64];
+  for (uint32_t i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "/app%u/page%u.hsp", i % 97, i);
+    urls.push_back(buf);
+  }
+  return urls;
+}
+
+void testExact(const vector<string>& urls, CompiledRoutes<uint32_t>& r) {
+  for (uint32_t i = 0; i < urls.size(); i++)
+    assert(r.get(urls[i].c_str(), urls[i].size()) == i + 1);
+  assert(r.get("/nothere.hsp", 12) == 0);
+  assert(r.get("", 0) == 0);
+}
+
+void testPatterns() {
+  CompiledRoutes<uint32_t> r;
+  r.add("/stock/IBM/quote", 1);
+  r.addPattern("/stock/:symbol/quote", 2);
+  r.addPattern("/stock/:symbol/history/:year", 3);
+  r.addPattern("/static/*", 4);
+  r.addPattern("/static/favicon.ico", 5);
+  r.compile();
+
+  CompiledRoutes<uint32_t>::Match m;
+  // a request line as it sits in the receive buffer, not null terminated
+  const char req[] = "GET /stock/AAPL/history/2021 HTTP/1.1\r\n";
+  const char* url = req + 4;
+  uint32_t len = strchr(url, ' ') - url;
+  assert(r.match(url, len, m) && m.h == 3 && m.numParams == 2);
+  assert(string(m.params[0].ptr, m.params[0].len) == "AAPL");
+  assert(string(m.params[1].ptr, m.params[1].len) == "2021");
+  assert(m.params[0].ptr == url + 7);  // views into the buffer, no copies
+
+  assert(r.match("/stock/IBM/quote", 16, m) && m.h == 1);
+  assert(r.match("/stock/GME/quote", 16, m) && m.h == 2 && m.numParams == 1);
+  assert(r.match("/static/favicon.ico", 19, m) && m.h == 5);
+  assert(r.match("/static/css/grail.css", 21, m) && m.h == 4);
+  assert(string(m.params[0].ptr, m.params[0].len) == "css/grail.css");
+  assert(!r.match("/stock/GME", 10, m));
+  assert(!r.match("/stock//quote", 13, m));
+  assert(!r.match("/stock/GME/quote/", 17, m));  // an empty last segment
+}
+
+int main() {
+  vector<string> urls = makeRoutes(NUM_ROUTES);
+  CompiledRoutes<uint32_t> r;
+  for (uint32_t i = 0; i < urls.size(); i++) r.add(urls[i], i + 1);
+
+  CBenchmark<>::benchmark("compile 10k routes", 1, [&]() { r.compile(); });
+  cout << "routes: " << r.size() << " bytes: " << r.memoryUsed() << '\n';
+  testExact(urls, r);
+  testPatterns();
+
+  // std::unordered_map, for comparison
+  unordered_map<string, uint32_t> baseline;
+  for (uint32_t i = 0; i < urls.size(); i++) baseline[urls[i]] = i + 1;
+
+  uint64_t sum = 0, i = 0;
+  CBenchmark<std::nano>::benchmark("perfect hash lookup", NUM_LOOKUPS, [&]() {
+    const string& u = urls[i++ % NUM_ROUTES];
+    sum += r.get(u.c_str(), u.size());
+  });
+  i = 0;
+  CBenchmark<std::nano>::benchmark("unordered_map lookup", NUM_LOOKUPS, [&]() {
+    const string& u = urls[i++ % NUM_ROUTES];
+    sum += baseline.find(u)->second;
+  });
+  cout << "checksum " << sum << '\n';
+  return 0;
+}
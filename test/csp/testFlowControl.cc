@@ -0,0 +1,119 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "util/Buffer.hh"
+
+using namespace std;
+using namespace std::chrono_literals;
+
+/*
+  Stream numbers through a Buffer to a reader that is much slower than the
+  writer, over a socketpair with a small kernel buffer. The writer's queue
+  must stay within its bounds whether or not it honours the pause signal,
+  every number must arrive in order, and a reader that stops entirely must
+  make the writer fail instead of hang.
+*/
+constexpr uint32_t HIGH_WATER = 64 * 1024, LOW_WATER = 16 * 1024;
+constexpr uint64_t COUNT = 2'000'000;  // 16MB of uint64_t
+
+void makePair(int fds[2]) {
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  int small = 16 * 1024;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+  setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+}
+
+// read in small pieces with pauses, checking the sequence
+void slowReader(int fd, uint64_t count) {
+  char buf[4096];
+  uint64_t expected = 0, have = 0, value = 0;
+  while (expected < count) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    assert(n > 0);
+    for (ssize_t i = 0; i < n; i++) {
+      value |= uint64_t(uint8_t(buf[i])) << (8 * have);
+      if (++have == 8) {
+        assert(value == expected);
+        expected++;
+        have = value = 0;
+      }
+    }
+    if (expected % 64 == 0) this_thread::sleep_for(20us);
+  }
+}
+
+void produce(bool honourPause) {
+  int fds[2];
+  makePair(fds);
+  thread reader(slowReader, fds[1], COUNT);
+
+  uint32_t pauses = 0, resumes = 0;
+  Buffer out(32768, true);
+  out.attachWrite(fds[0]);
+  out.enableFlowControl(HIGH_WATER, LOW_WATER, [&](bool paused) {
+    if (paused)
+      pauses++;
+    else
+      resumes++;
+  });
+  auto start = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < COUNT; i++) {
+    out.write(i);
+    out.checkAvailableWrite();
+    if (honourPause && out.isPaused()) assert(out.waitForResume(5000));
+  }
+  assert(out.finishOutput(5000));
+  reader.join();
+  auto ms = chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - start)
+                .count();
+  cout << (honourPause ? "producer pauses:  " : "producer ignores: ")
+       << COUNT * 8 / (1 << 20) << "MB in " << ms << "ms, " << pauses
+       << " pauses, " << resumes << " resumes, max queued "
+       << out.getMaxQueuedBytes() << " bytes\n";
+  assert(pauses > 0 && pauses == resumes);
+  assert(out.getQueuedBytes() == 0);
+  if (honourPause)
+    assert(out.getMaxQueuedBytes() <= HIGH_WATER + 32768);
+  else
+    assert(out.getMaxQueuedBytes() <= 2 * HIGH_WATER);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// a reader that never reads must not hang the writer
+void stalledReader() {
+  int fds[2];
+  makePair(fds);
+  Buffer out(32768, true);
+  out.attachWrite(fds[0]);
+  out.enableFlowControl(HIGH_WATER, LOW_WATER, nullptr, 200);
+  bool threw = false;
+  try {
+    for (uint64_t i = 0; i < COUNT; i++) {
+      out.write(i);
+      out.checkAvailableWrite();
+    }
+  } catch (const Ex& e) {
+    threw = true;
+  }
+  assert(threw);
+  assert(out.getMaxQueuedBytes() <= 2 * HIGH_WATER);
+  cout << "stalled reader detected with " << out.getQueuedBytes()
+       << " bytes queued\n";
+  close(fds[0]);
+  close(fds[1]);
+}
+
+int main() {
+  produce(true);
+  produce(false);
+  stalledReader();
+  return 0;
+}
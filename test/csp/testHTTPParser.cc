@@ -0,0 +1,190 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "csp/HTTPParser.hh"
+#include "util/Benchmark.hh"
+
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Check HTTPParser on requests captured from browsers and curl, including
+  split reads and pipelining, then measure requests parsed per second.
+  Usage: testHTTPParser [capturefile]
+  where capturefile holds raw requests back to back (for example the output
+  of tcpflow on port 8002).
+*/
+
+const char* corpus[] = {
+    "GET /test1.hsp HTTP/1.1\r\n"
+    "Host: localhost:8002\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:92.0) Gecko/20100101 "
+    "Firefox/92.0\r\n"
+    "Accept: "
+    "text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/"
+    "*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "\r\n",
+
+    "GET /benchmark3.hsp?rows=100&sort=name HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8002\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"94\", \"Google Chrome\";v=\"94\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, "
+    "like Gecko) Chrome/94.0.4606.61 Safari/537.36\r\n"
+    "Accept: image/avif,image/webp,image/apng,image/*,*/*;q=0.8\r\n"
+    "Referer: http://127.0.0.1:8002/test1.hsp\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Cookie: session=8f2c1d0e9b7a; theme=dark\r\n"
+    "\r\n",
+
+    "GET /test2.hsp HTTP/1.1\r\n"
+    "Host: localhost:8002\r\n"
+    "User-Agent: curl/7.74.0\r\n"
+    "Accept: */*\r\n"
+    "\r\n",
+
+    "POST /test7.hsp HTTP/1.1\r\n"
+    "Host: localhost:8002\r\n"
+    "User-Agent: curl/7.74.0\r\n"
+    "Accept: */*\r\n"
+    "Content-Length: 27\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "\r\n"
+    "symbol=AAPL&from=2021-01-04",
+
+    "GET /stock/GME/quote HTTP/1.0\r\n"
+    "Host: localhost\r\n"
+    "\r\n",
+};
+
+void testFields() {
+  HTTPParsedRequest r;
+  const char* req = corpus[3];
+  int len = HTTPParser::parse(req, strlen(req), r);
+  assert(len > 0 && size_t(len) + r.contentLength == strlen(req));
+  assert(r.method == "POST");
+  assert(r.path == "/test7.hsp");
+  assert(r.minorVersion == 1 && r.keepAlive);
+  assert(r.host == "localhost:8002");
+  assert(r.numHeaders == 5);
+  assert(*r.getHeader("content-type") == "application/x-www-form-urlencoded");
+  assert(r.getHeader("cookie") == nullptr);
+  assert(r.path.ptr == req + 5);  // a view, not a copy
+
+  req = corpus[4];
+  assert(HTTPParser::parse(req, strlen(req), r) == int(strlen(req)));
+  assert(r.minorVersion == 0 && !r.keepAlive);
+
+  const char* bad[] = {"GET /x\r\n\r\n", "GET /x HTTP/2.0\r\n\r\n",
+                       "GET /x HTTP/1.1\r\n folded\r\n\r\n",
+                       "GET /x HTTP/1.1\r\nNoColon\r\n\r\n",
+                       "GET /x HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+                       "GET /x HTTP/1.1\r\nContent-Length:\r\n\r\n",
+                       // 2^64, which would wrap around to 0
+                       "GET /x HTTP/1.1\r\n"
+                       "Content-Length: 18446744073709551616\r\n\r\n"};
+  for (const char* b : bad)
+    assert(HTTPParser::parse(b, strlen(b), r) == HTTPParser::ERROR);
+
+  req = "GET /x HTTP/1.1\r\nContent-Length: 18446744073709551615\r\n\r\n";
+  assert(HTTPParser::parse(req, strlen(req), r) == int(strlen(req)));
+  assert(r.contentLength == UINT64_MAX);
+
+  // blank lines before a request are skipped, not an empty head
+  req = "\r\n\r\nGET /x HTTP/1.1\r\n\r\n";
+  assert(HTTPParser::parse(req, strlen(req), r) == int(strlen(req)));
+  assert(r.path == "/x");
+  req = "\r\n\r\n\n";
+  assert(HTTPParser::parse(req, strlen(req), r) == HTTPParser::INCOMPLETE);
+}
+
+// feed a request one byte at a time, as a very slow client would
+void testPartial() {
+  HTTPParsedRequest r;
+  for (const char* req : corpus) {
+    size_t total = strlen(req), lastLen = 0;
+    int result = HTTPParser::INCOMPLETE;
+    size_t len;
+    for (len = 1; len <= total; len++) {
+      result = HTTPParser::parse(req, len, r, lastLen);
+      if (result != HTTPParser::INCOMPLETE) break;
+      lastLen = len;
+    }
+    assert(result > 0 && size_t(result) == len);
+  }
+}
+
+// all requests back to back in one read
+void testPipelined(const string& all, uint32_t expected) {
+  HTTPParsedRequest r;
+  const char* p = all.data();
+  const char* end = p + all.size();
+  uint32_t count = 0;
+  while (p < end) {
+    int len = HTTPParser::parse(p, end - p, r);
+    assert(len > 0);
+    p += len + r.contentLength;
+    count++;
+  }
+  assert(p == end && count == expected);
+}
+
+int main(int argc, char* argv[]) {
+  string all;
+  uint32_t numRequests = 0;
+  if (argc > 1) {
+    ifstream f(argv[1], ios::binary);
+    stringstream s;
+    s << f.rdbuf();
+    all = s.str();
+    HTTPParsedRequest r;
+    for (const char* p = all.data(); p < all.data() + all.size();) {
+      int len = HTTPParser::parse(p, all.data() + all.size() - p, r);
+      if (len < 0) break;
+      p += len + r.contentLength;
+      numRequests++;
+    }
+  } else {
+    testFields();
+    testPartial();
+    for (const char* req : corpus) all += req;
+    numRequests = sizeof(corpus) / sizeof(corpus[0]);
+    testPipelined(all, numRequests);
+  }
+
+  constexpr uint64_t REPEAT = 200000;
+  HTTPParsedRequest r;
+  uint64_t headers = 0;
+  CBenchmark<> b("parse corpus");
+  b.start();
+  for (uint64_t i = 0; i < REPEAT; i++) {
+    const char* p = all.data();
+    const char* end = p + all.size();
+    while (p < end) {
+      int len = HTTPParser::parse(p, end - p, r);
+      if (len < 0) break;
+      headers += r.numHeaders;
+      p += len + r.contentLength;
+    }
+  }
+  b.end();
+  double seconds = b.elapsed().count() * 1e-3;
+  fmt::print("{} requests, {:.0f} requests/s, {:.1f} MB/s ({} headers)\n",
+             numRequests * REPEAT, numRequests * REPEAT / seconds,
+             all.size() * REPEAT / seconds * 1e-6, headers);
+  return 0;
+}
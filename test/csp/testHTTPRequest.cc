@@ -0,0 +1,66 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "csp/HTTPRequest.hh"
+#include "csp/HttpServlet.hh"
+
+using namespace std;
+
+/*
+  Drive HTTPRequest::handle over a socketpair: pipelined requests routed to
+  an exact url and to a parameterized one, and an unknown url, checking
+  the responses come back in order.
+*/
+class Hello : public HttpServlet {
+ public:
+  void request(Buffer& out) override { out.append("hello servlet\n"); }
+};
+
+class Quote : public HttpServlet {
+ public:
+  void request(Buffer& out) override { out.append("quote servlet\n"); }
+};
+
+string serve(HTTPRequest& r, const string& requests) {
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  assert(write(fds[0], requests.data(), requests.size()) ==
+         ssize_t(requests.size()));
+  shutdown(fds[0], SHUT_WR);
+  r.handle(fds[1]);
+  close(fds[1]);
+  string response;
+  char buf[4096];
+  for (ssize_t n; (n = read(fds[0], buf, sizeof(buf))) > 0;)
+    response.append(buf, n);
+  close(fds[0]);
+  return response;
+}
+
+int main() {
+  Hello hello;
+  Quote quote;
+  HTTPRequest r("SERVER");
+  r.addServlet("hello.hsp", &hello);
+  r.addServletPattern("/stock/:symbol/quote", &quote);
+
+  string response = serve(r,
+                          "GET /hello.hsp HTTP/1.1\r\nHost: a\r\n\r\n"
+                          "GET /stock/IBM/quote HTTP/1.1\r\nHost: a\r\n\r\n"
+                          "GET /missing.hsp HTTP/1.1\r\nHost: a\r\n"
+                          "Connection: close\r\n\r\n");
+  size_t helloAt = response.find("hello servlet"),
+         quoteAt = response.find("quote servlet"),
+         missingAt = response.find("404 NOT FOUND");
+  assert(helloAt != string::npos && quoteAt != string::npos &&
+         missingAt != string::npos);
+  assert(helloAt < quoteAt && quoteAt < missingAt);
+
+  cout << "HTTPRequest routes pipelined requests\n";
+  return 0;
+}
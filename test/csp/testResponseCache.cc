@@ -0,0 +1,154 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "csp/ResponseCache.hh"
+#include "util/Buffer.hh"
+
+using namespace std;
+using namespace std::chrono_literals;
+
+/*
+  Exercise ResponseCache with servlet output written to files so the bytes
+  can be checked: hits must be byte-identical to the computed response,
+  concurrent misses must compute once, and ttl/invalidate must force a
+  recompute.
+*/
+
+atomic<uint32_t> computed(0);
+
+// stand-in for a slow servlet: echo the parameters a few times
+void slowServlet(Buffer& out, const char* params, uint32_t len,
+                 chrono::milliseconds delay) {
+  computed++;
+  this_thread::sleep_for(delay);
+  for (int i = 0; i < 3; i++) out.append(params, len);
+}
+
+string contents(const char filename[]) {
+  ifstream f(filename, ios::binary);
+  stringstream s;
+  s << f.rdbuf();
+  return s.str();
+}
+
+void serveTo(ResponseCache& cache, const char filename[], uint32_t id,
+             const char params[], chrono::milliseconds delay = 0ms) {
+  Buffer out(filename, 32768);
+  uint32_t len = strlen(params);
+  cache.serve(id, params, len, out,
+              [&]() { slowServlet(out, params, len, delay); });
+}
+
+void testHitsAndTTL() {
+  ResponseCache cache;
+  cache.enable(1, 50ms);
+  computed = 0;
+  serveTo(cache, "cache1.dat", 1, "AAPL");
+  serveTo(cache, "cache2.dat", 1, "AAPL");
+  serveTo(cache, "cache3.dat", 1, "GME");
+  assert(computed == 2);
+  assert(contents("cache1.dat") == "AAPLAAPLAAPL");
+  assert(contents("cache2.dat") == "AAPLAAPLAAPL");
+  assert(contents("cache3.dat") == "GMEGMEGME");
+
+  this_thread::sleep_for(60ms);  // expired
+  serveTo(cache, "cache2.dat", 1, "AAPL");
+  assert(computed == 3);
+
+  cache.invalidate(1);
+  serveTo(cache, "cache2.dat", 1, "AAPL");
+  serveTo(cache, "cache3.dat", 1, "GME");
+  assert(computed == 5);
+  cache.invalidate(1, "AAPL", 4);
+  serveTo(cache, "cache3.dat", 1, "GME");
+  serveTo(cache, "cache2.dat", 1, "AAPL");
+  assert(computed == 6);
+
+  // servlets that did not opt in always run
+  serveTo(cache, "cache2.dat", 2, "AAPL");
+  serveTo(cache, "cache2.dat", 2, "AAPL");
+  assert(computed == 8);
+  cache.report(cout);
+}
+
+/*
+  A key stored again after it expired, into a cache too full to take it
+  until the expired entries are purged, the key's own among them.
+*/
+void testExpiredOverBudget() {
+  ResponseCache cache(32, false);
+  cache.enable(1, 20ms);
+  computed = 0;
+  serveTo(cache, "cache1.dat", 1, "AAPL");    // 12 bytes
+  serveTo(cache, "cache2.dat", 1, "BRKBRK");  // 18 bytes
+  this_thread::sleep_for(30ms);
+  serveTo(cache, "cache1.dat", 1, "AAPL");  // 30 + 12 > 32, purge first
+  assert(computed == 3);
+  assert(contents("cache1.dat") == "AAPLAAPLAAPL");
+  serveTo(cache, "cache3.dat", 1, "AAPL");  // stored after the purge
+  assert(computed == 3);
+  assert(contents("cache3.dat") == "AAPLAAPLAAPL");
+}
+
+// a servlet that writes a large block past the buffer must be cached whole
+void testSpecialWrite() {
+  ResponseCache cache;
+  cache.enable(1, 10s);
+  computed = 0;
+  const string block(100000, 'x');
+  for (const char* filename : {"cache1.dat", "cache2.dat"}) {
+    Buffer out(filename, 32768);
+    cache.serve(1, "big", 3, out, [&]() {
+      computed++;
+      out.append("head", 4);
+      out.specialWrite(block.data(), block.size());
+    });
+  }
+  assert(computed == 1);
+  assert(contents("cache1.dat") == "head" + block);
+  assert(contents("cache2.dat") == "head" + block);
+}
+
+void testStampede(bool protect) {
+  ResponseCache cache(1 << 20, protect);
+  cache.enable(1, 10s);
+  computed = 0;
+  vector<thread> threads;
+  for (int i = 0; i < 8; i++)
+    threads.emplace_back([&cache, i]() {
+      string filename = "stampede" + to_string(i) + ".dat";
+      serveTo(cache, filename.c_str(), 1, "DOW", 100ms);
+    });
+  for (auto& t : threads) t.join();
+  for (int i = 0; i < 8; i++) {
+    string filename = "stampede" + to_string(i) + ".dat";
+    assert(contents(filename.c_str()) == "DOWDOWDOW");
+    unlink(filename.c_str());
+  }
+  cout << "stampede protection " << (protect ? "on" : "off") << ": "
+       << computed << " computes for 8 concurrent misses\n";
+  if (protect) assert(computed == 1);
+  cache.report(cout);
+}
+
+int main() {
+  testHitsAndTTL();
+  testExpiredOverBudget();
+  testSpecialWrite();
+  testStampede(true);
+  testStampede(false);
+  unlink("cache1.dat");
+  unlink("cache2.dat");
+  unlink("cache3.dat");
+  return 0;
+}
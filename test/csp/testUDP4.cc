@@ -0,0 +1,89 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "csp/UDP4Connection.hh"
+
+using namespace std;
+
+/*
+  Client and server on loopback, each dropping 20% of what it sends.
+  Every reliable message must arrive exactly once and in order, and the
+  latest-value channel must never go backwards.
+*/
+
+constexpr uint32_t NUM_MESSAGES = 10000;
+
+void testReliable(UDP4Socket& serverSock, UDP4Socket& clientSock) {
+  UDP4Connection server(serverSock);
+  UDP4Connection client(clientSock);
+
+  uint32_t nextToSend = 0, nextExpected = 0;
+  vector<char> msg;
+  while (nextExpected < NUM_MESSAGES) {
+    while (nextToSend < NUM_MESSAGES) {
+      char buf[64];
+      int len = snprintf(buf, sizeof(buf), "message %u", nextToSend);
+      if (!client.send(buf, len)) break;
+      nextToSend++;
+    }
+    client.poll(0);
+    server.poll(1);
+    while (server.receive(msg)) {
+      char expected[64];
+      int len = snprintf(expected, sizeof(expected), "message %u",
+                         nextExpected);
+      assert(msg.size() == uint32_t(len));
+      assert(memcmp(msg.data(), expected, len) == 0);
+      nextExpected++;
+    }
+  }
+  // let the last acks through so the sender's window drains
+  for (int i = 0; i < 1000 && client.inFlight() > 0; i++) {
+    client.poll(1);
+    server.poll(1);
+  }
+  assert(client.inFlight() == 0);
+  assert(!server.receive(msg));
+  cout << NUM_MESSAGES << " messages delivered in order, "
+       << client.getRetransmits() << " retransmits, "
+       << server.getDuplicates() << " duplicates, rto="
+       << chrono::duration_cast<chrono::microseconds>(client.getRTO()).count()
+       << "us\n";
+}
+
+void testLatest(UDP4Socket& serverSock, UDP4Socket& clientSock) {
+  UDP4Connection server(serverSock);
+  UDP4Connection client(clientSock);
+  uint32_t last = 0, updates = 0;
+  vector<char> value;
+  for (uint32_t i = 1; i <= 1000; i++) {
+    client.publish((const char*)&i, sizeof(i));
+    client.flush();
+    server.poll(0);
+    if (server.latest(value)) {
+      uint32_t v;
+      assert(value.size() == sizeof(v));
+      memcpy(&v, value.data(), sizeof(v));
+      assert(v > last);
+      last = v;
+      updates++;
+    }
+  }
+  cout << updates << " of 1000 telemetry values seen, newest " << last
+       << ", " << server.getStaleDropped() << " stale dropped\n";
+  assert(updates > 0);
+}
+
+int main() {
+  UDP4Socket serverSock(0);
+  UDP4Socket clientSock("127.0.0.1", serverSock.getLocalPort());
+  serverSock.setLossRate(0.2);
+  clientSock.setLossRate(0.2);
+  testReliable(serverSock, clientSock);
+  testLatest(serverSock, clientSock);
+  cout << clientSock.getDropped() + serverSock.getDropped()
+       << " datagrams dropped in total\n";
+  return 0;
+}
@@ -1,13 +1,110 @@
-#include <stdlib.h>
-
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <new>
 #include <string>
 
 #include "data/GapMinderBinaryDB.hh"
+#include "data/GapMinderLoader.hh"
+#include "util/Benchmark.hh"
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Build the GapMinder database from the csv files, on one thread and on
+  all of them, check both builds agree, save it, load it back and check
+  every dataset is found by name with the same values both ways, then check
+  stepping through the years of three datasets, as GapMinderWidget
+  animates, allocates nothing.
+
+  testGapMinder [subdir [binary]] saves to binary, or to a temporary file
+  removed afterwards. The checked in test/res/GapMinder/GapMinderDBFile,
+  which GapMinderWidget reads, is saved this way from the csv files in
+  allFiles2.
+*/
+uint64_t allocations = 0;
+void* operator new(size_t bytes) {
+  allocations++;
+  if (void* p = malloc(bytes)) return p;
+  throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+bool same(span<const float> a, span<const float> b) {
+  return a.size() == b.size() &&
+         memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
 
 int main(int argc, char* argv[]) {
-  std::string grail = getenv("GRAIL");
-  grail += "/test/res/GapMinder/";
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/GapMinder/";
+  dir += argc > 1 ? argv[1] : "";
+  const bool keep = argc > 2;
+  string binary =
+      keep ? argv[2] : filesystem::temp_directory_path().string();
+  if (!keep) binary += "/GapMinderDBFile";
+
+  GapMinderBinaryDB db(dir.c_str()), serial(dir.c_str(), 1);
+  assert(db.getNumDatasets() == serial.getNumDatasets());
+  for (uint32_t i = 0; i < db.getNumDatasets(); i++) {
+    const GapMinderBinaryDB::Dataset *a = &db.getDatasets()[i],
+                                     *b = &serial.getDatasets()[i];
+    assert(strcmp(a->name, b->name) == 0 && a->startYear == b->startYear &&
+           a->endYear == b->endYear);
+    for (uint32_t c = 0; c < db.getNumCountries(); c++)
+      assert(same(db.getAllDataOneCountry(c, a),
+                  serial.getAllDataOneCountry(c, b)));
+  }
+  CBenchmark<>::benchmark("build from csv, 1 thread", 3,
+                          [&]() { GapMinderBinaryDB d(dir.c_str(), 1); });
+  CBenchmark<>::benchmark("build from csv, all threads", 3,
+                          [&]() { GapMinderBinaryDB d(dir.c_str()); });
+  db.saveBinary(binary.c_str());
+  GapMinderLoader gml(binary.c_str());
+  cout << gml.getNumDatasets() << " datasets, " << gml.getNumCountries()
+       << " countries\n";
+  assert(gml.getNumDatasets() == db.getNumDatasets());
+  assert(gml.getDataset("no such dataset.csv") == nullptr);
+
+  for (uint32_t i = 0; i < db.getNumDatasets(); i++) {
+    const GapMinderBinaryDB::Dataset* a = &db.getDatasets()[i];
+    const GapMinderLoader::Dataset* b = gml.getDataset(a->name);
+    assert(b != nullptr && strcmp(a->name, b->name) == 0);
+    assert(a->startYear == b->startYear && a->endYear == b->endYear);
+    for (uint32_t year = a->startYear; year <= a->endYear; year++)
+      assert(same(db.getAllDataOneYear(year, a),
+                  gml.getAllDataOneYear(year, b)));
+    for (uint32_t c = 0; c < gml.getNumCountries(); c++) {
+      span<const float> country = gml.getAllDataOneCountry(c, b);
+      assert(same(db.getAllDataOneCountry(c, a), country));
+      for (uint32_t year = b->startYear; year <= b->endYear; year++) {
+        float v = gml.getAllDataOneYear(year, b)[c];
+        assert(memcmp(&v, &country[year - b->startYear], sizeof(v)) == 0);
+      }
+    }
+  }
 
-  grail += argc > 1 ? (argv[1]) : "";
-  GapMinderBinaryDB db(grail.c_str());
+  const char* names[] = {"gdp_per_capita.csv",
+                         "ddf--datapoints--vacc_rate--by--country--time.csv",
+                         "ddf--datapoints--poisonings_deaths_per_100000_"
+                         "people.csv"};
+  double sum = 0;
+  auto animate = [&]() {
+    for (uint32_t year = 1800; year <= 2020; year++)
+      for (const char* name : names) {
+        const GapMinderLoader::Dataset* d = gml.getDataset(name);
+        if (d == nullptr) continue;
+        for (float v : gml.getAllDataOneYear(year, d))
+          if (v == v) sum += v;
+      }
+  };
+  uint64_t before = allocations;
+  animate();
+  assert(allocations == before);
+  CBenchmark<>::benchmark("221 years of 3 datasets", 1000, animate);
+  if (!keep) filesystem::remove(binary);
+  return sum > 0 ? 0 : 1;
 }
@@ -0,0 +1,39 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "opengl/GrailGUI.hh"
+#include "opengl/InstancedMarkers.hh"
+
+using namespace std;
+using namespace grail;
+
+/*
+  A million point scatter plot as instanced markers: 16 bytes a point and
+  one draw call per kind of marker, where drawing them with
+  StyledMultiShape2D::drawCircleMarker would build over 120 million
+  vertices. Run under Mesa llvmpipe (LIBGL_ALWAYS_SOFTWARE=1) without a GPU.
+*/
+class TestScatterMarkers : public Member {
+ public:
+  TestScatterMarkers(Tab* tab, uint32_t n) : Member(tab) {
+    MainCanvas* c = tab->getMainCanvas();
+    InstancedMarkers* markers = c->addLayer(new InstancedMarkers(c));
+    mt19937 random(1);
+    normal_distribution<float> x(c->getWidth() / 2.0f, c->getWidth() / 6.0f);
+    normal_distribution<float> y(c->getHeight() / 2.0f, c->getHeight() / 6.0f);
+    const InstancedMarkers::Marker kinds[] = {
+        InstancedMarkers::Marker::circle, InstancedMarkers::Marker::square,
+        InstancedMarkers::Marker::triangle, InstancedMarkers::Marker::cross};
+    const glm::vec4 colors[] = {red, blue, green, black};
+    for (uint32_t i = 0; i < n; i++)
+      markers->add(kinds[i % 4], x(random), y(random), 2, colors[i % 4]);
+    cout << markers->size() << " markers, " << markers->size() * 16
+         << " bytes of instance data\n";
+  }
+};
+
+void grailmain(int argc, char* argv[], GLWin* w, Tab* defaultTab) {
+  w->setTitle("Test instanced markers");
+  new TestScatterMarkers(defaultTab, argc > 1 ? atoi(argv[1]) : 1000000);
+}
@@ -0,0 +1,94 @@
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "data/TimeSeries.hh"
+using namespace std;
+
+/*
+  Check the pyramid summaries of random ranges and equal time buckets
+  against adding up the samples, save and load, then time building a
+  10M sample series and asking it for a screen's width of buckets.
+*/
+TimeSeries::Aggregate bruteForce(const double v[], uint64_t begin,
+                                 uint64_t end) {
+  TimeSeries::Aggregate a{v[begin], v[begin], v[begin], v[end - 1], 0};
+  for (uint64_t i = begin; i < end; i++) {
+    a.min = min(a.min, v[i]);
+    a.max = max(a.max, v[i]);
+    a.sum += v[i];
+  }
+  return a;
+}
+
+void check(const TimeSeries::Aggregate& a, const TimeSeries::Aggregate& b) {
+  assert(a.min == b.min && a.max == b.max && a.first == b.first &&
+         a.last == b.last);
+  assert(abs(a.sum - b.sum) <= 1e-9 * (abs(b.sum) + 1));
+}
+
+template <typename Func>
+double milliseconds(Func f) {
+  auto t0 = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t0)
+      .count();
+}
+
+int main() {
+  mt19937_64 random(1);
+  uniform_real_distribution<double> step(0, 2);
+  for (uint64_t n : {1, 2, 15, 16, 17, 255, 256, 257, 5000, 70000}) {
+    vector<double> t(n), v(n);
+    for (uint64_t i = 0; i < n; i++) {
+      t[i] = i == 0 ? 0 : t[i - 1] + step(random);  // some steps are tiny
+      v[i] = step(random) - 1;
+    }
+    TimeSeries ts(t, v);
+    for (int k = 0; k < 200; k++) {
+      uint64_t a = random() % n, b = random() % n;
+      if (a > b) swap(a, b);
+      check(ts.summarize(a, b + 1), bruteForce(v.data(), a, b + 1));
+    }
+    vector<TimeSeries::Bucket> buckets(37);
+    ts.getBuckets(t[0], t[n - 1], buckets);
+    uint64_t covered = 0;
+    for (uint32_t i = 0; i < buckets.size(); i++) {
+      const TimeSeries::Bucket& b = buckets[i];
+      assert(b.begin == covered);
+      covered = b.end;
+      if (b.empty()) continue;
+      check(b, bruteForce(v.data(), b.begin, b.end));
+      const double t0 = t[0] + (t[n - 1] - t[0]) * i / buckets.size();
+      assert(t[b.begin] >= t0 - 1e-9 && (b.begin == 0 || t[b.begin - 1] < t0));
+    }
+    assert(covered == n);
+  }
+
+  const uint64_t n = 10'000'000;
+  vector<double> v(n);
+  double walk = 0;
+  for (double& x : v) x = walk += step(random) - 1;
+  unique_ptr<TimeSeries> big;
+  cout << "build 10M samples: "
+       << milliseconds([&]() { big = make_unique<TimeSeries>(v); }) << "ms\n";
+  const char* filename = "/tmp/testTimeSeries.bts";
+  big->save(filename);
+  TimeSeries loaded(filename);
+  assert(loaded.getNumSamples() == n);
+  check(loaded.summarize(12345, n - 678), bruteForce(v.data(), 12345, n - 678));
+
+  vector<TimeSeries::Bucket> pixels(1920);
+  const uint32_t times = 100;
+  double ms = milliseconds([&]() {
+    for (uint32_t i = 0; i < times; i++)
+      big->getBuckets(i * 1000.0, n - 1 - i * 1000.0, pixels);
+  });
+  cout << pixels.size() << " buckets of 10M samples: " << ms / times
+       << "ms\n";
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "data/AppendBlockFile.hh"
+using namespace std;
+
+/*
+  Check a reader sees rows appended after it opened the file and follows
+  compaction to the new file, then kill -9 a writer appending and
+  compacting at random moments, over and over, and check every row whose
+  append returned survives and nothing half written is ever counted.
+*/
+struct Quote {
+  double time;
+  uint64_t seq;
+  double price;
+  uint64_t check;
+};
+
+// late rows, every 7th, make compaction reorder
+Quote quote(uint64_t seq) {
+  double time = seq % 7 == 0 ? seq - 3.5 : seq;
+  double price = 100 + seq % 97;
+  return Quote{time, seq, price, seq * 0x9E3779B97F4A7C15ULL ^ 0xFEED};
+}
+
+// every row is intact, the seqs are 0..n-1 and the main block is sorted
+void checkFile(const AppendBlockFile& f, uint64_t n) {
+  vector<bool> seen(n);
+  for (uint64_t i = 0; i < n; i++) {
+    const Quote& q = *(const Quote*)f.getRow(i);
+    const Quote expected = quote(q.seq);
+    assert(q.seq < n && !seen[q.seq]);
+    assert(q.time == expected.time && q.price == expected.price &&
+           q.check == expected.check);
+    seen[q.seq] = true;
+    assert(i == 0 || i >= f.getMainRows() || f.getTime(i - 1) <= q.time);
+  }
+}
+
+void appendFrom(AppendBlockWriter& w, uint64_t seq, uint64_t n) {
+  vector<Quote> rows;
+  for (uint64_t i = 0; i < n; i++) rows.push_back(quote(seq + i));
+  w.append(rows.data(), n);
+}
+
+int main() {
+  const char* filename = "/tmp/testAppendBlock.abf";
+  unlink(filename);
+  {
+    AppendBlockWriter w(filename, sizeof(Quote));
+    appendFrom(w, 0, 10);
+    AppendBlockReader r(filename);
+    assert(r.getNumRows() == 10);
+    appendFrom(w, 10, 5);
+    assert(r.getNumRows() == 15);  // no reload needed
+    w.compact();
+    assert(w.getMainRows() == 15 && w.getNumRows() == 15);
+    appendFrom(w, 15, 5);
+    assert(r.refresh() == 20 && r.getMainRows() == 15);
+    checkFile(r, 20);
+  }
+
+  unlink(filename);
+  mt19937 random(1);
+  uint64_t lastDurable = 0;
+  for (int round = 0; round < 40; round++) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    pid_t child = fork();
+    if (child == 0) {
+      ::close(fds[0]);
+      AppendBlockWriter w(filename, sizeof(Quote));
+      for (uint64_t batch = 1;; batch++) {
+        const uint64_t n = w.getNumRows();
+        appendFrom(w, n, batch % 50 + 1);
+        const uint64_t durable = w.getNumRows();
+        if (write(fds[1], &durable, sizeof(durable)) != sizeof(durable))
+          _exit(1);
+        if (batch % 40 == 0) w.compact();
+      }
+    }
+    ::close(fds[1]);
+    this_thread::sleep_for(chrono::microseconds(1000 + random() % 20000));
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    for (uint64_t durable;
+         read(fds[0], &durable, sizeof(durable)) == sizeof(durable);)
+      lastDurable = durable;
+    ::close(fds[0]);
+
+    AppendBlockReader r(filename);
+    const uint64_t n = r.getNumRows();
+    assert(n >= lastDurable);
+    checkFile(r, n);
+  }
+  AppendBlockReader r(filename);
+  cout << r.getNumRows() << " rows survived 40 kills, "
+       << r.getNumRows() - r.getMainRows() << " not yet compacted\n";
+
+  AppendBlockWriter w(filename, sizeof(Quote));
+  const uint64_t start = w.getNumRows(), appends = 200;
+  auto t0 = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < appends; i++) appendFrom(w, start + i, 1);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+  cout << appends / elapsed.count() << " durable appends/s\n";
+  return 0;
+}
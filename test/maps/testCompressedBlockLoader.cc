@@ -0,0 +1,99 @@
+#include <sys/stat.h>
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "data/BlockMapLoader2.hh"
+#include "data/CompressedBlockFile.hh"
+#include "util/Benchmark.hh"
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Compress the counties map with each codec this build supports, check it
+  loads back byte for byte, that load() only decompresses the chunks it
+  needs, and compare load times against the uncompressed .bml. Pass "cold"
+  after the map name to also time loads with the page cache dropped, which
+  needs root.
+*/
+uint64_t fileSize(const string& filename) {
+  struct stat s;
+  assert(stat(filename.c_str(), &s) == 0);
+  return s.st_size;
+}
+
+int main(int argc, char* argv[]) {
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/maps/";
+  string filename = dir + (argc > 1 ? argv[1] : "uscounties.bml");
+  const bool cold = argc > 2 && string(argv[2]) == "cold";
+  constexpr uint32_t chunkSize = 1 << 18;
+
+  BlockMapLoader raw(filename.c_str());
+  CBenchmark<>::benchmark("load .bml", 100,
+                          [&]() { BlockMapLoader bml(filename.c_str()); });
+  if (cold)
+    CBenchmark<>::benchmarkNoCache(
+        "load .bml, cold", 10,
+        [&]() { BlockMapLoader bml(filename.c_str()); }, true);
+
+  using Codec = CompressedBlockFile::Codec;
+  for (auto [codec, name] :
+       {pair(Codec::zstd, "zstd"), pair(Codec::lzma, "lzma")}) {
+    if (!CompressedBlockFile::supports(codec)) {
+      cout << name << " not built in\n";
+      continue;
+    }
+    string compressed = dir + "uscounties_" + name + ".bmlz";
+    CBenchmark<>::benchmark(string("compress ") + name, 1, [&]() {
+      CompressedBlockFile::compress(filename.c_str(), compressed.c_str(), codec,
+                                    chunkSize);
+    });
+    cout << name << ": " << fileSize(filename) << " bytes to "
+         << fileSize(compressed) << '\n';
+
+    BlockMapLoader bml = BlockMapLoader::loadCompressed(compressed.c_str());
+    assert(bml.size == raw.size);
+    assert(memcmp(bml.mem, raw.mem, raw.size) == 0);
+    assert(bml.getNumPoints() == raw.getNumPoints());
+
+    // the header is in the first chunk, the last bytes in the last chunk
+    CompressedBlockFile lazy(compressed.c_str());
+    const uint32_t numChunks = lazy.getHeader()->numChunks;
+    const char* mem = lazy.load(0, 64);
+    assert(lazy.getNumLoadedChunks() == 1);
+    assert(memcmp(mem, raw.mem, 64) == 0);
+    lazy.load(raw.size - 8, 8);
+    assert(lazy.getNumLoadedChunks() == min(numChunks, 2u));
+    assert(memcmp(mem + raw.size - 8, (char*)raw.mem + raw.size - 8, 8) == 0);
+    lazy.loadAll();
+    assert(lazy.getNumLoadedChunks() == numChunks);
+    assert(memcmp(mem, raw.mem, raw.size) == 0);
+
+    for (uint32_t threads = 1; threads <= thread::hardware_concurrency();
+         threads *= 2)
+      CBenchmark<>::benchmark(
+          string("decompress ") + name + " on " + to_string(threads) +
+              " threads",
+          10, [&]() {
+            CompressedBlockFile f(compressed.c_str());
+            f.loadAll(threads);
+          });
+    CBenchmark<>::benchmark(string("load ") + name, 10, [&]() {
+      BlockMapLoader b = BlockMapLoader::loadCompressed(compressed.c_str());
+    });
+    if (cold)
+      CBenchmark<>::benchmarkNoCache(
+          string("load ") + name + ", cold", 10,
+          [&]() {
+            BlockMapLoader b =
+                BlockMapLoader::loadCompressed(compressed.c_str());
+          },
+          true);
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include <openssl/evp.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "data/BlockLoader2.hh"
+using namespace std;
+
+/*
+  Check the single pass document hashes against a bitwise CRC and separate
+  SHA-256 runs, check registering and authenticating a document, and
+  compare GB/s hashing everything in one pass against one hash at a time.
+*/
+uint64_t slowCRC(const vector<uint8_t>& bytes) {
+  uint64_t crc = ~0ULL;
+  for (uint8_t b : bytes) {
+    crc ^= b;
+    for (int k = 0; k < 8; k++)
+      crc = crc & 1 ? (crc >> 1) ^ 0xC96C5795D7870F42ULL : crc >> 1;
+  }
+  return ~crc;
+}
+
+// every stride-th byte of the document starting at start
+vector<uint8_t> pick(const BlockLoader& bl, uint32_t start, uint32_t stride) {
+  const uint8_t* doc = (const uint8_t*)bl.mem + bl.getHeaderSize();
+  vector<uint8_t> picked;
+  for (uint64_t i = start; i < bl.size - bl.getHeaderSize(); i += stride)
+    picked.push_back(doc[i]);
+  return picked;
+}
+
+// 1k blocks start, start + 2, ... of the document
+vector<uint8_t> pickBlocks(const BlockLoader& bl, uint32_t start) {
+  const uint8_t* doc = (const uint8_t*)bl.mem + bl.getHeaderSize();
+  const uint64_t n = bl.size - bl.getHeaderSize();
+  vector<uint8_t> picked;
+  for (uint64_t b = start * 1024; b < n; b += 2048)
+    picked.insert(picked.end(), doc + b, doc + min(b + 1024, n));
+  return picked;
+}
+
+void sha256(const uint8_t* p, uint64_t n, uint8_t digest[32]) {
+  EVP_Digest(p, n, digest, nullptr, EVP_sha256(), nullptr);
+}
+
+const uint32_t starts[5] = {0, 0, 1, 0, 1}, strides[5] = {1, 2, 2, 3, 3};
+
+void checkHashes(const BlockLoader& bl) {
+  BlockLoader::DocumentHash h = bl.hashThisDocument();
+  uint8_t digest[32];
+  for (int i = 0; i < 5; i++) {
+    vector<uint8_t> picked = pick(bl, starts[i], strides[i]);
+    assert(h.crc[i] == slowCRC(picked));
+    assert(h.crc[i] == bl.crc64(starts[i], strides[i]));
+    if (i < 3) {
+      sha256(picked.data(), picked.size(), digest);
+      assert(memcmp(digest, h.sha256[i], 32) == 0);
+    }
+  }
+  for (int i = 0; i < 2; i++) {
+    vector<uint8_t> blocks = pickBlocks(bl, i);
+    sha256(blocks.data(), blocks.size(), digest);
+    assert(memcmp(digest, h.sha256[3 + i], 32) == 0);
+  }
+}
+
+template <typename Func>
+double gigabytesPerSecond(uint64_t bytes, uint32_t times, Func hash) {
+  auto t0 = chrono::steady_clock::now();
+  for (uint32_t i = 0; i < times; i++) hash();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+  return bytes * times / elapsed.count() / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+  BlockLoader check(9, BlockLoader::Type::gismap, 0);
+  memcpy((char*)check.mem + check.getHeaderSize(), "123456789", 9);
+  assert(check.crc64(0, 1) == 0x995DC9BBDF1939FAULL);  // CRC-64/XZ check
+
+  // every length around the SIMD and chunk boundaries
+  mt19937_64 random(1);
+  for (uint64_t n : {0, 1, 5, 31, 47, 64, 127, 128, 129, 200, 1000, 5000,
+                     24 * 1024 - 1, 24 * 1024 + 7, 100000}) {
+    BlockLoader bl(n, BlockLoader::Type::gismap, 0);
+    uint8_t* doc = (uint8_t*)bl.mem + bl.getHeaderSize();
+    for (uint64_t i = 0; i < n; i++) doc[i] = random();
+    checkHashes(bl);
+  }
+
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/maps/";
+  string filename = dir + (argc > 1 ? argv[1] : "uscounties.bml");
+  BlockLoader bml(filename.c_str());
+  checkHashes(bml);
+
+  BlockLoader::DocumentHash registered = bml.registerDocument(42);
+  assert(bml.generalHeader->author_id == 42);
+  assert(bml.authenticateDocument(registered));
+  ((char*)bml.mem)[bml.size - 1] ^= 1;
+  assert(!bml.authenticateDocument(registered));
+  ((char*)bml.mem)[bml.size - 1] ^= 1;
+
+  cout << "one pass: " << gigabytesPerSecond(bml.size, 10, [&]() {
+    bml.hashThisDocument();
+  }) << " GB/s\n";
+  cout << "separately: " << gigabytesPerSecond(bml.size, 10, [&]() {
+    for (int i = 0; i < 5; i++) bml.crc64(starts[i], strides[i]);
+    uint8_t digest[32];
+    for (int i = 0; i < 3; i++) {
+      vector<uint8_t> picked = pick(bml, starts[i], strides[i]);
+      sha256(picked.data(), picked.size(), digest);
+    }
+    for (int i = 0; i < 2; i++) {
+      vector<uint8_t> blocks = pickBlocks(bml, i);
+      sha256(blocks.data(), blocks.size(), digest);
+    }
+  }) << " GB/s\n";
+  cout << "crc64 of all bytes: " << gigabytesPerSecond(bml.size, 10, [&]() {
+    bml.crc64(0, 1);
+  }) << " GB/s\n";
+  return 0;
+}
@@ -23,6 +23,7 @@ class TestDrawBlockMap : public Member {
     // new ButtonWidget(c, 0, 0, 200, 100, "Click Me!", "mapZoomIn"));
     BlockMapLoader* bml = new BlockMapLoader(filename);
     mv = c->addLayer(new MapView2D(c, s2, bml));
+    mv->setFillColor(grail::lightblue);  // if saved with its fill section
     cout << "num points loaded: " << bml->getNumPoints() << '\n';
 
     tab->bindEvent(Tab::Inputs::WHEELUP, &TestDrawBlockMap::mapZoomIn, this);
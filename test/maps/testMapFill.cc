@@ -0,0 +1,82 @@
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "data/BlockMapLoader2.hh"
+#include "util/Benchmark.hh"
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Triangulate the counties map, check the fill section survives a save and
+  load, and check each county's triangles cover exactly its area: outlines
+  less holes. Every triangle must also face the same way, or it overlaps
+  its neighbors.
+*/
+double area2(const float* xy, uint32_t a, uint32_t b, uint32_t c) {
+  const float *p = xy + 2 * a, *q = xy + 2 * b, *r = xy + 2 * c;
+  return (double(q[0]) - p[0]) * (double(r[1]) - p[1]) -
+         (double(q[1]) - p[1]) * (double(r[0]) - p[0]);
+}
+
+// area inside the rings of a region, counting holes as negative
+double regionArea(const BlockMapLoader& bml, uint32_t r) {
+  const BlockMapLoader::Region* regions = bml.getRegions();
+  const BlockMapLoader::Segment* segments = bml.getSegments();
+  const uint32_t end = r + 1 < bml.getNumRegions() ? regions[r + 1].segmentStart
+                                                   : bml.getNumSegments();
+  const float* p = bml.getPoints(0) + 2 * uint64_t(regions[r].startPoints);
+  double outline = 0, total = 0, largest = 0;
+  for (uint32_t s = regions[r].segmentStart; s < end; s++) {
+    const uint32_t n = segments[s].numPoints;
+    double a = 0;
+    for (uint32_t k = 0, j = n - 1; k < n; j = k++)
+      a += double(p[2 * j]) * p[2 * k + 1] - double(p[2 * k]) * p[2 * j + 1];
+    if (abs(a) > largest) largest = abs(a), outline = a;
+    total += a;
+    p += 2 * n;
+  }
+  return outline < 0 ? -total / 2 : total / 2;
+}
+
+int main(int argc, char* argv[]) {
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/maps/";
+  string filename = dir + (argc > 1 ? argv[1] : "uscounties.bml");
+  string withFill = dir + "uscounties_fill.bml";
+
+  BlockMapLoader original(filename.c_str());
+  CBenchmark<>::benchmark("build fill", 1, [&]() { original.buildFill(); });
+  original.save(withFill.c_str(), true, true, true);
+  BlockMapLoader bml(withFill.c_str());
+  assert(bml.hasFill());
+  assert(bml.getNumFillIndices() == original.getNumFillIndices());
+  for (uint64_t i = 0; i < bml.getNumFillIndices(); i++)
+    assert(bml.getFillIndices()[i] == original.getFillIndices()[i]);
+
+  const float* xy = bml.getPoints(0);
+  const uint32_t* indices = bml.getFillIndices();
+  const uint64_t* start = bml.getFillStart();
+  uint32_t mismatched = 0;
+  for (uint32_t r = 0; r < bml.getNumRegions(); r++) {
+    double filled = 0;
+    for (uint64_t i = start[r]; i < start[r + 1]; i += 3) {
+      const double a = area2(xy, indices[i], indices[i + 1], indices[i + 2]);
+      assert(a >= 0);
+      filled += a / 2;
+    }
+    const double expected = regionArea(bml, r);
+    if (abs(filled - expected) > 1e-6 * expected + 1e-9) {
+      cerr << "region " << r << " filled " << filled << " of " << expected
+           << '\n';
+      mismatched++;
+    }
+  }
+  cout << bml.getNumFillIndices() / 3 << " triangles for "
+       << bml.getNumPoints() << " points, " << mismatched
+       << " regions not covered exactly\n";
+  assert(mismatched == 0);
+  return 0;
+}
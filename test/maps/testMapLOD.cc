@@ -0,0 +1,68 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+#include "data/BlockMapLoader2.hh"
+#include "util/Benchmark.hh"
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Build the level of detail pyramid for the counties map, check it survives
+  a save and load, and check that neighbors stay watertight: a point kept at
+  some level in one county must be kept in every county sharing it.
+*/
+uint64_t key(const float* p) { return *(const uint64_t*)p; }
+
+void checkWatertight(const BlockMapLoader& bml, uint32_t level) {
+  unordered_set<uint64_t> kept;
+  const float* xy = bml.getPoints(level);
+  for (uint32_t i = 0; i < bml.getNumPoints(level); i++)
+    kept.insert(key(xy + 2 * i));
+
+  const BlockMapLoader::Segment* base = bml.getSegments(0);
+  const BlockMapLoader::Segment* coarse = bml.getSegments(level);
+  const float* p = bml.getPoints(0);
+  for (uint32_t s = 0; s < bml.getNumSegments(); s++) {
+    uint32_t shouldKeep = 0;
+    for (uint32_t i = 0; i < base[s].numPoints; i++, p += 2)
+      shouldKeep += kept.count(key(p));
+    assert(coarse[s].numPoints == shouldKeep);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/maps/";
+  string filename = dir + (argc > 1 ? argv[1] : "uscounties.bml");
+  string withLOD = dir + "uscounties_lod.bml";
+
+  BlockMapLoader original(filename.c_str());
+  CBenchmark<>::benchmark("build LOD", 1, [&]() { original.buildLOD(); });
+  original.save(withLOD.c_str());
+  BlockMapLoader bml(withLOD.c_str());
+  assert(bml.getNumLevels() == original.getNumLevels());
+  assert(bml.hasSpatialIndex());
+
+  for (uint32_t level = 0; level < bml.getNumLevels(); level++) {
+    assert(bml.getNumPoints(level) == original.getNumPoints(level));
+    if (level > 0) {
+      assert(bml.getNumPoints(level) <= bml.getNumPoints(level - 1));
+      checkWatertight(bml, level);
+    }
+    cout << "level " << level << " tolerance " << bml.getTolerance(level)
+         << ": " << bml.getNumPoints(level) << " points\n";
+  }
+
+  // the whole country in a window 1000 pixels wide
+  const BoundRect& b = bml.getBlockMapHeader()->bounds;
+  uint32_t level = bml.selectLevel((b.xMax - b.xMin) / 1000);
+  cout << "zoomed out draws level " << level << ", "
+       << bml.getNumPoints(level) << " of " << bml.getNumPoints(0)
+       << " points\n";
+  assert(bml.selectLevel(0) == 0);
+  assert(bml.selectLevel(b.xMax - b.xMin) == bml.getNumLevels() - 1);
+  return 0;
+}
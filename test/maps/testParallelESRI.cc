@@ -0,0 +1,76 @@
+#include <sys/stat.h>
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "data/BlockMapLoader2.hh"
+using namespace std;
+
+/*
+  Convert a shapefile with shapelib and with the parallel mapped converter,
+  check both produce the same map, and report conversion speed in MB/s of
+  .shp for different numbers of threads.
+*/
+void same(const BlockMapLoader& a, const BlockMapLoader& b) {
+  assert(a.getNumRegions() == b.getNumRegions());
+  assert(a.getNumSegments() == b.getNumSegments());
+  assert(a.getNumPoints() == b.getNumPoints());
+  for (uint32_t i = 0; i < a.getNumRegions(); i++) {
+    const BlockMapLoader::Region &ra = a.getRegions()[i],
+                                 &rb = b.getRegions()[i];
+    assert(ra.segmentStart == rb.segmentStart);
+    assert(ra.startPoints == rb.startPoints);
+    assert(ra.baseX == rb.baseX && ra.baseY == rb.baseY);
+  }
+  for (uint32_t i = 0; i < a.getNumSegments(); i++)
+    assert(a.getSegments()[i].numPoints == b.getSegments()[i].numPoints);
+  const float *pa = a.getXPoints(), *pb = b.getXPoints();
+  for (uint32_t i = 0; i < 2 * a.getNumPoints(); i++) assert(pa[i] == pb[i]);
+}
+
+template <typename Func>
+double megabytesPerSecond(uint64_t bytes, Func convert) {
+  auto t0 = chrono::steady_clock::now();
+  convert();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+  return bytes / elapsed.count() / (1 << 20);
+}
+
+int main(int argc, char* argv[]) {
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/maps/";
+  string shapefile = dir + (argc > 1 ? argv[1] : "USA_Counties.shp");
+  struct stat s;
+  assert(stat(shapefile.c_str(), &s) == 0);
+
+  BlockMapLoader serial = BlockMapLoader::loadFromESRI(shapefile.c_str());
+  BlockMapLoader parallel =
+      BlockMapLoader::loadFromESRIParallel(shapefile.c_str());
+  same(serial, parallel);
+
+  // delta encoding while converting must decode to the same points
+  BlockMapLoader delta =
+      BlockMapLoader::loadFromESRIParallel(shapefile.c_str(), 0, true);
+  assert(delta.getBlockMapHeader()->deltaEncoded);
+  delta.deltaUnEncode();
+  const float *p = parallel.getXPoints(), *q = delta.getXPoints();
+  for (uint32_t i = 0; i < 2 * parallel.getNumPoints(); i++)
+    assert(std::abs(p[i] - q[i]) <= 1e-4f * (1 + std::abs(p[i])));
+
+  cout << s.st_size / (1 << 20) << "MB of .shp, " << parallel.getNumPoints()
+       << " points\n";
+  cout << "shapelib: " << megabytesPerSecond(s.st_size, [&]() {
+    BlockMapLoader::loadFromESRI(shapefile.c_str());
+  }) << " MB/s\n";
+  for (uint32_t threads = 1; threads <= thread::hardware_concurrency();
+       threads *= 2)
+    cout << threads << " threads: " << megabytesPerSecond(s.st_size, [&]() {
+      BlockMapLoader::loadFromESRIParallel(shapefile.c_str(), threads);
+    }) << " MB/s\n";
+  return 0;
+}
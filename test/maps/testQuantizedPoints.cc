@@ -0,0 +1,66 @@
+#include <sys/stat.h>
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data/BlockMapLoader2.hh"
+#include "util/Benchmark.hh"
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Save the counties map with float points and with quantized points, check
+  the quantized points are within half a step of the originals and that
+  the file shrinks, and compare load times.
+*/
+uint64_t fileSize(const string& filename) {
+  struct stat s;
+  assert(stat(filename.c_str(), &s) == 0);
+  return s.st_size;
+}
+
+int main(int argc, char* argv[]) {
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/maps/";
+  string filename = dir + (argc > 1 ? argv[1] : "uscounties.bml");
+  string raw = dir + "uscounties_raw.bml", packed = dir + "uscounties_q.bml";
+  constexpr double quantum = 1e-6;  // degrees, about 10cm
+
+  BlockMapLoader original(filename.c_str());
+  const uint32_t numPoints = original.getNumPoints();
+  vector<float> before(original.getXPoints(),
+                       original.getXPoints() + 2 * numPoints);
+  original.save(raw.c_str(), false, false);
+  original.quantize(quantum);
+  original.save(packed.c_str(), false, false);
+
+  BlockMapLoader loaded(packed.c_str());
+  assert(loaded.isQuantized());
+  assert(loaded.getNumPoints() == numPoints);
+  double worst = 0;
+  for (uint32_t i = 0; i < 2 * numPoints; i++) {
+    // loading gives exactly what quantize() left in memory
+    assert(loaded.getXPoints()[i] == original.getXPoints()[i]);
+    double err = std::abs(double(loaded.getXPoints()[i]) - before[i]);
+    // half a step, plus rounding to float
+    assert(err <= quantum / 2 + std::abs(before[i]) * 1e-7);
+    worst = std::max(worst, err);
+  }
+  cout << "worst error " << worst * 111e3 << "m\n";
+  cout << "float points: " << fileSize(raw) << " bytes, quantized: "
+       << fileSize(packed) << " bytes\n";
+  assert(fileSize(packed) < fileSize(raw));
+
+  vector<float> xy(2 * numPoints);
+  CBenchmark<>::benchmark("decode", 100,
+                          [&]() { loaded.decodePoints(xy.data()); });
+  CBenchmark<>::benchmark("load float points", 100,
+                          [&]() { BlockMapLoader bml(raw.c_str()); });
+  CBenchmark<>::benchmark("load quantized", 100,
+                          [&]() { BlockMapLoader bml(packed.c_str()); });
+  return 0;
+}
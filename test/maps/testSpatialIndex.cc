@@ -0,0 +1,95 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "data/BlockMapLoader2.hh"
+#include "util/Benchmark.hh"
+using namespace std;
+using namespace grail::utils;
+
+/*
+  Compare viewport queries through the Hilbert R-tree section against a
+  scan of every region. The counties map converted by
+  convertESRItoBlockLoader is the default: zoomed in, a view holds a few
+  dozen of more than 3000 counties.
+*/
+BoundRect randomView(mt19937& gen, const BoundRect& all, float zoom) {
+  const float w = (all.xMax - all.xMin) * zoom;
+  const float h = (all.yMax - all.yMin) * zoom;
+  uniform_real_distribution<float> x(all.xMin, all.xMax - w),
+      y(all.yMin, all.yMax - h);
+  float x0 = x(gen), y0 = y(gen);
+  return BoundRect(x0, x0 + w, y0, y0 + h);
+}
+
+// the regions in view, checking every one
+vector<uint32_t> scan(const BlockMapLoader& bml, const BoundRect& view) {
+  vector<uint32_t> found;
+  const BlockMapLoader::Region* regions = bml.getRegions();
+  for (uint32_t i = 0; i < bml.getNumRegions(); i++)
+    if (view.intersects(regions[i].bounds)) found.push_back(i);
+  return found;
+}
+
+vector<uint32_t> expand(const vector<BlockMapLoader::Range>& ranges) {
+  vector<uint32_t> found;
+  for (auto r : ranges)
+    for (uint32_t i = r.start; i < r.end; i++) found.push_back(i);
+  return found;
+}
+
+int main(int argc, char* argv[]) {
+  const char* grail = getenv("GRAIL");
+  string dir = string(grail == nullptr ? "." : grail) + "/test/res/maps/";
+  string filename = dir + (argc > 1 ? argv[1] : "uscounties.bml");
+  string indexed = dir + "uscounties_indexed.bml";
+
+  BlockMapLoader original(filename.c_str());
+  original.save(indexed.c_str());  // builds the index if the file has none
+  BlockMapLoader bml(indexed.c_str());
+  assert(bml.hasSpatialIndex());
+  assert(bml.getNumPoints() == original.getNumPoints());
+
+  const BoundRect& all = bml.getBlockMapHeader()->bounds;
+  mt19937 gen(42);
+  vector<BlockMapLoader::Range> ranges;
+  for (float zoom : {1.0f, 0.25f, 0.05f, 0.01f}) {
+    vector<BoundRect> views;
+    uint32_t visible = 0;
+    for (int i = 0; i < 1000; i++) {
+      views.push_back(randomView(gen, all, zoom));
+      bml.query(views.back(), ranges);
+      vector<uint32_t> expected = scan(bml, views.back());
+      assert(expand(ranges) == expected);
+      visible += expected.size();
+    }
+    cout << "zoom " << zoom << ": " << visible / views.size() << " of "
+         << bml.getNumRegions() << " regions visible\n";
+
+    uint32_t v = 0;
+    CBenchmark<std::micro>::benchmark("  R-tree query", views.size(), [&]() {
+      bml.query(views[v++ % views.size()], ranges);
+    });
+    CBenchmark<std::micro>::benchmark("  linear scan ", views.size(), [&]() {
+      scan(bml, views[v++ % views.size()]);
+    });
+  }
+
+  // segment ranges cover exactly the segments of the visible regions
+  BoundRect view = randomView(gen, all, 0.05f);
+  vector<BlockMapLoader::Range> segmentRanges;
+  bml.querySegments(view, segmentRanges);
+  bml.query(view, ranges);
+  const BlockMapLoader::Region* regions = bml.getRegions();
+  uint32_t fromRegions = 0, fromSegments = 0;
+  for (auto r : ranges)
+    fromRegions += (r.end < bml.getNumRegions() ? regions[r.end].segmentStart
+                                                : bml.getNumSegments()) -
+                   regions[r.start].segmentStart;
+  for (auto s : segmentRanges) fromSegments += s.end - s.start;
+  assert(fromRegions == fromSegments);
+  return 0;
+}
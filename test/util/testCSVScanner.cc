@@ -0,0 +1,140 @@
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "util/CSVParser.hh"
+#include "util/CSVScanner.hh"
+using namespace std;
+
+/*
+  Check CSVScanner reads the same fields as CSVParser, including quoted
+  commas and "" across chunk boundaries, then read the Dow prices into
+  columns and compare GB/s against CSVParser.
+*/
+using Type = CSVScanner::Type;
+
+struct Table : CSVScanner::Sink {
+  vector<vector<string>> rows;
+  void onText(uint32_t col, uint32_t row, string_view v) {
+    if (row >= rows.size()) rows.resize(row + 1);
+    if (col >= rows[row].size()) rows[row].resize(col + 1);
+    string& s = rows[row][col];
+    for (size_t i = 0; i < v.size(); i++) {
+      s += v[i];
+      if (v[i] == '"') i++;  // "" -> "
+    }
+  }
+};
+
+struct Prices : CSVScanner::Sink {
+  vector<int32_t> dates;
+  vector<double> columns[6];
+  Prices(uint32_t n) : dates(n) {
+    for (auto& c : columns) c.resize(n, NAN);
+  }
+  void onDate(uint32_t col, uint32_t row, int32_t days) { dates[row] = days; }
+  void onF64(uint32_t col, uint32_t row, double v) {
+    columns[col - 1][row] = v;
+  }
+};
+
+string randomCSV(uint32_t rows, uint32_t cols) {
+  mt19937 random(1);
+  string text;
+  for (uint32_t r = 0; r < rows; r++) {
+    for (uint32_t c = 0; c < cols; c++) {
+      switch (random() % 4) {
+        case 0:
+          text += to_string(random() % 100000);
+          break;
+        case 1:
+          text += "\"quoted, with commas\"";
+          break;
+        case 2:
+          text += "\"say \"\"hi\"\", ok\"";
+          break;
+        case 3:
+          break;
+      }
+      text += c + 1 < cols ? ',' : '\n';
+    }
+  }
+  return text;
+}
+
+template <typename Func>
+double gigabytesPerSecond(uint64_t bytes, uint32_t times, Func parse) {
+  auto t0 = chrono::steady_clock::now();
+  for (uint32_t i = 0; i < times; i++) parse();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+  return bytes * times / elapsed.count() / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+  const uint32_t numCols = 5;
+  string text = randomCSV(20000, numCols);  // several chunks
+  const char* tmp = "/tmp/testCSVScanner.csv";
+  ofstream(tmp) << text;
+  vector<vector<string>> expected = CSVParser::readCSV(tmp);
+  CSVScanner all(vector<Type>(numCols, Type::text), 0);
+  Table table;
+  assert(all.scan(text.data(), text.size(), table) == expected.size());
+  assert(table.rows == expected);
+
+  // newlines inside quotes, CRLF and no newline at the end
+  Table odd;
+  string quirks = "\"two\nlines\",x\r\nlast,\"row\"";
+  assert(all.scan(quirks.data(), quirks.size(), odd) == 2);
+  assert(odd.rows[0][0] == "two\nlines" && odd.rows[0][1] == "x");
+  assert(odd.rows[1][0] == "last" && odd.rows[1][1] == "row");
+
+  struct Days : CSVScanner::Sink {
+    vector<int32_t> days;
+    void onDate(uint32_t col, uint32_t row, int32_t d) { days.push_back(d); }
+  } days;
+  string dates = "when\n2000-01-01\n2000-03-01\n1999-12-31\n2000-13-01\n";
+  CSVScanner(vector<Type>{Type::date}).scan(dates.data(), dates.size(), days);
+  assert(days.days == vector<int32_t>({0, 60, -1}));
+
+  const char* grail = getenv("GRAIL");
+  string filename = string(grail == nullptr ? "." : grail) + "/test/res/" +
+                    (argc > 1 ? argv[1] : "Dow_daily.csv");
+  MappedFile f(filename);
+  const uint32_t numRows = count(f.getData(), f.getData() + f.getSize(), '\n');
+  vector<vector<string>> dow = CSVParser::readCSV(filename.c_str());
+  CSVScanner prices({Type::date, Type::f64, Type::f64, Type::f64, Type::f64,
+                     Type::f64, Type::f64});
+  Prices p(numRows + 1);
+  const uint32_t n = prices.scan(f.getData(), f.getSize(), p);
+  assert(n == dow.size() - 1);
+  for (uint32_t r = 0; r < n; r++) {
+    assert(r == 0 || p.dates[r] > p.dates[r - 1]);
+    for (uint32_t c = 0; c < 6; c++)
+      assert(p.columns[c][r] == strtod(dow[r + 1][c + 1].c_str(), nullptr));
+  }
+  cout << n << " rows of " << filename << '\n';
+
+  cout << "CSVParser: " << gigabytesPerSecond(f.getSize(), 5, [&]() {
+    CSVParser::readCSV(filename.c_str());
+  }) << " GB/s\n";
+  cout << "CSVScanner to columns: "
+       << gigabytesPerSecond(f.getSize(), 50, [&]() {
+            prices.scanFile(filename.c_str(), p);
+          })
+       << " GB/s\n";
+  CSVScanner fieldsOnly({});
+  CSVScanner::Sink none;
+  cout << "CSVScanner finding fields: "
+       << gigabytesPerSecond(f.getSize(), 50, [&]() {
+            fieldsOnly.scan(f.getData(), f.getSize(), none);
+          })
+       << " GB/s\n";
+  return 0;
+}